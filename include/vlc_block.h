@@ -430,6 +430,24 @@ static inline block_t *block_ChainGather( block_t *p_list )
  */
 VLC_API block_fifo_t *block_FifoNew(void) VLC_USED VLC_MALLOC;
 
+/**
+ * Creates a block FIFO with lock-less producers.
+ *
+ * This works like block_FifoNew(), but block_FifoPut() pushes blocks without
+ * taking the FIFO lock, from any number of threads. The lock is only taken
+ * by producers to wake up a consumer sleeping in vlc_fifo_Wait().
+ * Consumers and all the other functions (including vlc_fifo_QueueUnlocked())
+ * operate as with a normal FIFO, except vlc_fifo_WaitCond() and
+ * vlc_fifo_TimedWaitCond(): producers only signal the FIFO itself, so
+ * consumers must wait with vlc_fifo_Wait() or block_FifoGet().
+ *
+ * This is meant for high packet rate queues, where the FIFO lock would
+ * otherwise be contended for every block.
+ *
+ * @return the FIFO or NULL on memory error
+ */
+VLC_API block_fifo_t *block_FifoNewLockless(void) VLC_USED VLC_MALLOC;
+
 /**
  * Destroys a FIFO created by block_FifoNew().
  *
@@ -526,6 +544,12 @@ VLC_API void vlc_fifo_Signal(vlc_fifo_t *);
  */
 VLC_API void vlc_fifo_Wait(vlc_fifo_t *);
 
+/**
+ * Waits on a condition variable with the FIFO lock.
+ *
+ * @note This cannot be used with a FIFO created by block_FifoNewLockless():
+ * its producers do not signal the condition variable.
+ */
 VLC_API void vlc_fifo_WaitCond(vlc_fifo_t *, vlc_cond_t *);
 
 /**
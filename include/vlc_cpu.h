@@ -44,6 +44,7 @@ VLC_API unsigned vlc_CPU(void);
 #  define VLC_CPU_AVX2   0x00004000
 #  define VLC_CPU_XOP    0x00008000
 #  define VLC_CPU_FMA4   0x00010000
+#  define VLC_CPU_AVX512 0x00020000 /* Foundation and Byte/Word */
 
 # if defined (__MMX__)
 #  define vlc_CPU_MMX() (1)
@@ -107,8 +108,18 @@ VLC_API unsigned vlc_CPU(void);
 
 # ifdef __AVX2__
 #  define vlc_CPU_AVX2() (1)
+#  define VLC_AVX2
 # else
 #  define vlc_CPU_AVX2() ((vlc_CPU() & VLC_CPU_AVX2) != 0)
+#  define VLC_AVX2 __attribute__ ((__target__ ("avx2")))
+# endif
+
+# if defined (__AVX512F__) && defined (__AVX512BW__)
+#  define vlc_CPU_AVX512() (1)
+#  define VLC_AVX512
+# else
+#  define vlc_CPU_AVX512() ((vlc_CPU() & VLC_CPU_AVX512) != 0)
+#  define VLC_AVX512 __attribute__ ((__target__ ("avx512f,avx512bw")))
 # endif
 
 # ifdef __3dNOW__
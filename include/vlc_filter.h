@@ -26,6 +26,7 @@
 #define VLC_FILTER_H 1
 
 #include <vlc_es.h>
+#include <vlc_picture.h>
 
 /**
  * \defgroup filter Filters
@@ -168,6 +169,31 @@ static inline picture_t *filter_NewPicture( filter_t *p_filter )
     return pic;
 }
 
+/**
+ * This function will return a picture usable by p_filter as an output
+ * buffer, for filters that can write their output over their input.
+ * If p_in is not referenced elsewhere and already has the output format, it
+ * is returned with an additional reference and the filter works in place.
+ * Otherwise, this is the same as filter_NewPicture().
+ * In both cases, the caller still has to release p_in.
+ *
+ * \param p_filter filter_t object
+ * \param p_in input picture of the filter
+ * \return output picture on success or NULL on failure
+ */
+static inline picture_t *filter_NewPictureInPlace( filter_t *p_filter,
+                                                   picture_t *p_in )
+{
+    const video_format_t *p_fmt = &p_filter->fmt_out.video;
+
+    if( !picture_IsReferenced( p_in )
+     && p_in->format.i_chroma == p_fmt->i_chroma
+     && p_in->format.i_width == p_fmt->i_width
+     && p_in->format.i_height == p_fmt->i_height )
+        return picture_Hold( p_in );
+    return filter_NewPicture( p_filter );
+}
+
 /**
  * Flush a filter
  *
@@ -278,6 +304,65 @@ VLC_API int filter_Blend( filter_t *, picture_t *p_dst, int i_dst_x, int i_dst_y
  */
 VLC_API void filter_DeleteBlend( filter_t * );
 
+/**
+ * Gets the number of slices a picture should be split into.
+ *
+ * This is the number of threads that filter_ExecuteSlices() can run
+ * concurrently, including the calling thread. It is always at least one.
+ */
+VLC_API unsigned filter_GetSliceCount( filter_t * );
+
+/**
+ * Processes slices of work in parallel.
+ *
+ * func(data, index, count) is invoked once for each index in [0, count),
+ * from the calling thread and from the slice threads. The function returns
+ * once all slices have been processed. Slices must not depend on one
+ * another's completion, but may wait for progress made by a slice with a
+ * lower index.
+ *
+ * There is a single pool of slice threads per LibVLC instance, shared by
+ * all its filters and filter chains. It holds --filter-threads minus one
+ * threads (one per CPU by default), however many filters use it. When
+ * several filters submit slices at once, the pool threads serve the oldest
+ * job first, while each caller keeps processing the slices of its own job.
+ * A call thus always completes, at worst on the calling thread alone.
+ *
+ * \param func slice callback
+ * \param data opaque pointer for the callback
+ * \param count number of slices
+ */
+VLC_API void filter_ExecuteSlices( filter_t *,
+                                   void (*func)( void *data, unsigned index,
+                                                 unsigned count ),
+                                   void *data, unsigned count );
+
+/**
+ * Computes the range of lines covered by a slice.
+ *
+ * Lines are split evenly across slices. Slice boundaries are rounded down
+ * to a multiple of align (e.g. to keep chroma subsampling consistent), save
+ * for the end of the last slice which is always the total line count.
+ *
+ * \param lines total number of lines
+ * \param index slice index
+ * \param count number of slices
+ * \param align line alignment (must be non-zero)
+ * \param begin first line of the slice [OUT]
+ * \param end line after the last line of the slice [OUT]
+ */
+static inline void filter_GetSliceLines( unsigned lines, unsigned index,
+                                         unsigned count, unsigned align,
+                                         unsigned *begin, unsigned *end )
+{
+    *begin = (unsigned)(((uint64_t)lines * index / count) / align * align);
+    if( index + 1 < count )
+        *end = (unsigned)(((uint64_t)lines * (index + 1) / count)
+                          / align * align);
+    else
+        *end = lines;
+}
+
 /**
  * Create a picture_t *(*)( filter_t *, picture_t * ) compatible wrapper
  * using a void (*)( filter_t *, picture_t *, picture_t * ) function
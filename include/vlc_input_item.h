@@ -408,6 +408,17 @@ struct input_stats_t
     /* Aout */
     int64_t i_played_abuffers;
     int64_t i_lost_abuffers;
+
+    /* Block pool (process-wide) */
+    int64_t i_block_pool_hits;
+    int64_t i_block_pool_misses;
+    int64_t i_block_pool_retained;
+
+    /* Loudness of the audio output (EBU R128), NAN without a meter */
+    float f_loudness_momentary;
+    float f_loudness_short_term;
+    float f_loudness_integrated;
+    float f_true_peak;
 };
 
 #endif
@@ -48,6 +48,12 @@ enum vlc_module_properties
     VLC_MODULE_DESCRIPTION,
     VLC_MODULE_HELP,
     VLC_MODULE_TEXTDOMAIN,
+    VLC_MODULE_PROBE_EXTENSIONS,
+    /* comma-separated file extensions, without dots (args=const char *) */
+    VLC_MODULE_PROBE_MIME_TYPES,
+    /* comma-separated MIME types (args=const char *) */
+    VLC_MODULE_PROBE_MAGIC,
+    /* magic bytes at a given offset (args=unsigned, const char *) */
     /* Insert new VLC_MODULE_* here */
 
     /* DO NOT EVER REMOVE, INSERT OR REPLACE ANY ITEM! It would break the ABI!
@@ -304,6 +310,25 @@ VLC_METADATA_EXPORTS
                        (void *)(deactivate))) \
         goto error;
 
+/*
+ * Probing pre-filters: a module declaring any of these is only probed, unless
+ * it is explicitly requested, if at least one of them matches the input. The
+ * module activation callback must reject inputs that match none of them.
+ */
+#define set_probe_extensions( exts ) \
+    if (vlc_module_set (VLC_MODULE_PROBE_EXTENSIONS, (const char *)(exts))) \
+        goto error;
+
+#define set_probe_mime_types( types ) \
+    if (vlc_module_set (VLC_MODULE_PROBE_MIME_TYPES, (const char *)(types))) \
+        goto error;
+
+/* The magic bytes cannot contain nul bytes. */
+#define set_probe_magic( offset, magic ) \
+    if (vlc_module_set (VLC_MODULE_PROBE_MAGIC, (unsigned)(offset), \
+                        (const char *)(magic))) \
+        goto error;
+
 #define cannot_unload_broken_library( ) \
     if (vlc_module_set (VLC_MODULE_NO_UNLOAD)) \
         goto error;
@@ -146,6 +146,101 @@ VLC_API int var_Inherit( vlc_object_t *, const char *, int, vlc_value_t * );
 
 VLC_API void var_FreeList( vlc_value_t *, vlc_value_t * );
 
+/**
+ * \defgroup var_handle Variable handles
+ * Handles avoid looking a variable up by name on every access. They are
+ * meant for variables read very often, e.g. for each picture or block.
+ * @{
+ */
+typedef struct vlc_var_handle vlc_var_handle_t;
+
+/**
+ * Looks a variable up and returns a handle to it.
+ *
+ * The handle holds a reference to the variable, as var_Create() does, so the
+ * variable remains valid until var_HandleRelease(). The handle must be
+ * released before the object is destroyed.
+ *
+ * \return a handle, or NULL if the variable does not exist
+ */
+VLC_API vlc_var_handle_t *var_Lookup( vlc_object_t *, const char * ) VLC_USED;
+#define var_Lookup(o,n) var_Lookup(VLC_OBJECT(o),n)
+
+/**
+ * Releases a handle obtained with var_Lookup().
+ */
+VLC_API void var_HandleRelease( vlc_object_t *, vlc_var_handle_t * );
+#define var_HandleRelease(o,h) var_HandleRelease(VLC_OBJECT(o),h)
+
+/**
+ * Gets the value of a variable through a handle.
+ *
+ * For all types but strings, this does not take any lock.
+ * String values are duplicated and must be freed.
+ */
+VLC_API void var_HandleGet( vlc_object_t *, vlc_var_handle_t *, vlc_value_t * );
+#define var_HandleGet(o,h,v) var_HandleGet(VLC_OBJECT(o),h,v)
+
+/**
+ * Sets the value of a variable through a handle, as var_Set() does.
+ */
+VLC_API void var_HandleSet( vlc_object_t *, vlc_var_handle_t *, vlc_value_t );
+#define var_HandleSet(o,h,v) var_HandleSet(VLC_OBJECT(o),h,v)
+
+static inline bool var_HandleGetBool( vlc_object_t *obj, vlc_var_handle_t *h )
+{
+    vlc_value_t val;
+    var_HandleGet( obj, h, &val );
+    return val.b_bool;
+}
+
+static inline int64_t var_HandleGetInteger( vlc_object_t *obj,
+                                            vlc_var_handle_t *h )
+{
+    vlc_value_t val;
+    var_HandleGet( obj, h, &val );
+    return val.i_int;
+}
+
+static inline float var_HandleGetFloat( vlc_object_t *obj, vlc_var_handle_t *h )
+{
+    vlc_value_t val;
+    var_HandleGet( obj, h, &val );
+    return val.f_float;
+}
+
+static inline void var_HandleSetBool( vlc_object_t *obj, vlc_var_handle_t *h,
+                                      bool b )
+{
+    vlc_value_t val;
+    val.b_bool = b;
+    var_HandleSet( obj, h, val );
+}
+
+static inline void var_HandleSetInteger( vlc_object_t *obj,
+                                         vlc_var_handle_t *h, int64_t i )
+{
+    vlc_value_t val;
+    val.i_int = i;
+    var_HandleSet( obj, h, val );
+}
+
+static inline void var_HandleSetFloat( vlc_object_t *obj, vlc_var_handle_t *h,
+                                       float f )
+{
+    vlc_value_t val;
+    val.f_float = f;
+    var_HandleSet( obj, h, val );
+}
+
+#define var_HandleGetBool(o,h)      var_HandleGetBool(VLC_OBJECT(o),h)
+#define var_HandleGetInteger(o,h)   var_HandleGetInteger(VLC_OBJECT(o),h)
+#define var_HandleGetFloat(o,h)     var_HandleGetFloat(VLC_OBJECT(o),h)
+#define var_HandleSetBool(o,h,b)    var_HandleSetBool(VLC_OBJECT(o),h,b)
+#define var_HandleSetInteger(o,h,i) var_HandleSetInteger(VLC_OBJECT(o),h,i)
+#define var_HandleSetFloat(o,h,f)   var_HandleSetFloat(VLC_OBJECT(o),h,f)
+/** @} */
+
 
 /*****************************************************************************
  * Variable callbacks
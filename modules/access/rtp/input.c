@@ -31,6 +31,7 @@
 
 #include <limits.h>
 #include <errno.h>
+#include <time.h>
 #include <unistd.h>
 #ifdef HAVE_POLL
 # include <poll.h>
@@ -85,6 +86,107 @@ drop:
     block_Release (block);
 }
 
+#ifdef HAVE_RECVMMSG
+/** Maximum number of datagrams received per system call */
+# define RTP_BATCH 16
+
+# ifdef SO_TIMESTAMPNS
+#  define RTP_CMSG_SIZE CMSG_SPACE(sizeof (struct timespec))
+# else
+#  define RTP_CMSG_SIZE 0
+# endif
+
+/**
+ * Receives and processes all pending datagrams, up to RTP_BATCH at once.
+ * Reception times are taken from the kernel time stamps if available,
+ * and stored in the blocks i_pts for the jitter estimation.
+ * @return false if no memory could be allocated even with the default MRU
+ */
+static bool rtp_recv_batch (demux_t *demux, int fd, size_t *mru)
+{
+    block_t *blocks[RTP_BATCH];
+    struct mmsghdr msgs[RTP_BATCH];
+    struct iovec iovs[RTP_BATCH];
+    char cmsgs[RTP_BATCH][RTP_CMSG_SIZE > 0 ? RTP_CMSG_SIZE : 1];
+    unsigned count;
+
+    for (count = 0; count < RTP_BATCH; count++)
+    {
+        blocks[count] = block_Alloc (*mru);
+        if (unlikely(blocks[count] == NULL))
+            break;
+
+        iovs[count].iov_base = blocks[count]->p_buffer;
+        iovs[count].iov_len = *mru;
+        msgs[count].msg_hdr = (struct msghdr) {
+            .msg_iov = &iovs[count],
+            .msg_iovlen = 1,
+            .msg_control = RTP_CMSG_SIZE ? cmsgs[count] : NULL,
+            .msg_controllen = RTP_CMSG_SIZE,
+        };
+    }
+
+    if (unlikely(count == 0))
+    {
+        if (*mru == DEFAULT_MRU)
+            return false; /* we are totallly screwed */
+        *mru = DEFAULT_MRU;
+        return true; /* retry with shrunk MRU */
+    }
+
+    int val = recvmmsg (fd, msgs, count, MSG_DONTWAIT | MSG_TRUNC, NULL);
+    if (val == -1 && errno != EAGAIN)
+        msg_Warn (demux, "RTP network error: %s", vlc_strerror_c(errno));
+
+#ifdef SO_TIMESTAMPNS
+    /* Kernel time stamps use the real-time clock */
+    struct timespec now;
+    clock_gettime (CLOCK_REALTIME, &now);
+    mtime_t offset = mdate () - (INT64_C(1000000) * now.tv_sec)
+                              - (now.tv_nsec / 1000);
+#endif
+
+    for (int i = 0; i < val; i++)
+    {
+        struct msghdr *msg = &msgs[i].msg_hdr;
+        block_t *block = blocks[i];
+        size_t len = msgs[i].msg_len;
+
+        if (msg->msg_flags & MSG_TRUNC)
+        {
+            msg_Err(demux, "%zu bytes packet truncated (MRU was %zu)",
+                    len, *mru);
+            block->i_flags |= BLOCK_FLAG_CORRUPTED;
+            *mru = len;
+        }
+        else
+            block->i_buffer = len;
+
+#ifdef SO_TIMESTAMPNS
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (msg);
+             cmsg != NULL;
+             cmsg = CMSG_NXTHDR (msg, cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET
+             || cmsg->cmsg_type != SCM_TIMESTAMPNS)
+                continue;
+
+            struct timespec ts;
+
+            memcpy (&ts, CMSG_DATA (cmsg), sizeof (ts));
+            block->i_pts = (INT64_C(1000000) * ts.tv_sec)
+                         + (ts.tv_nsec / 1000) + offset;
+        }
+#endif
+        rtp_process (demux, block);
+    }
+
+    for (unsigned i = (val > 0) ? val : 0; i < count; i++)
+        block_Release (blocks[i]);
+    return true;
+}
+#endif
+
 static int rtp_timeout (mtime_t deadline)
 {
     if (deadline == VLC_TS_INVALID)
@@ -109,6 +211,13 @@ void *rtp_dgram_thread (void *opaque)
     demux_sys_t *sys = demux->p_sys;
     mtime_t deadline = VLC_TS_INVALID;
     int rtp_fd = sys->fd;
+#ifdef HAVE_RECVMMSG
+    size_t mru = DEFAULT_MRU;
+# ifdef SO_TIMESTAMPNS
+    setsockopt (rtp_fd, SOL_SOCKET, SO_TIMESTAMPNS, &(int){ 1 },
+                sizeof (int));
+# endif
+#else
     struct iovec iov =
     {
         .iov_len = DEFAULT_MRU,
@@ -118,6 +227,7 @@ void *rtp_dgram_thread (void *opaque)
         .msg_iov = &iov,
         .msg_iovlen = 1,
     };
+#endif
 
     struct pollfd ufd[1];
     ufd[0].fd = rtp_fd;
@@ -139,6 +249,10 @@ void *rtp_dgram_thread (void *opaque)
             if (unlikely(ufd[0].revents & POLLHUP))
                 break; /* RTP socket dead (DCCP only) */
 
+#ifdef HAVE_RECVMMSG
+            if (!rtp_recv_batch (demux, rtp_fd, &mru))
+                break;
+#else
             block_t *block = block_Alloc (iov.iov_len);
             if (unlikely(block == NULL))
             {
@@ -178,6 +292,7 @@ void *rtp_dgram_thread (void *opaque)
                           vlc_strerror_c(errno));
                 block_Release (block);
             }
+#endif
         }
 
     dequeue:
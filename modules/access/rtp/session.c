@@ -257,7 +257,9 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
         block->i_buffer -= padding;
     }
 
-    mtime_t        now = mdate ();
+    /* Prefer the reception time stamp from the input thread, if any */
+    mtime_t        now = (block->i_pts != VLC_TS_INVALID) ? block->i_pts
+                                                          : mdate ();
     rtp_source_t  *src  = NULL;
     const uint16_t seq  = rtp_seq (block);
     const uint32_t ssrc = GetDWBE (block->p_buffer + 8);
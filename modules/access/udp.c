@@ -76,11 +76,27 @@ vlc_module_begin ()
     set_callbacks( Open, Close )
 vlc_module_end ()
 
+#ifdef HAVE_RECVMMSG
+/** Maximum number of datagrams received per system call */
+# define UDP_BATCH 32
+#endif
+
 struct access_sys_t
 {
     int fd;
     int timeout;
     size_t mtu;
+
+#ifdef HAVE_RECVMMSG
+    /* Datagrams received by the last batch but not returned yet */
+    block_t *queue;
+    block_t **queue_last;
+
+    /* Receive slots, refilled with MTU-sized blocks before each batch */
+    block_t *slots[UDP_BATCH];
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iovs[UDP_BATCH];
+#endif
 };
 
 /*****************************************************************************
@@ -174,6 +190,13 @@ static int Open( vlc_object_t *p_this )
     if( sys->timeout > 0)
         sys->timeout *= 1000;
 
+#ifdef HAVE_RECVMMSG
+    sys->queue = NULL;
+    sys->queue_last = &sys->queue;
+    for( unsigned i = 0; i < UDP_BATCH; i++ )
+        sys->slots[i] = NULL;
+#endif
+
     return VLC_SUCCESS;
 }
 
@@ -185,6 +208,12 @@ static void Close( vlc_object_t *p_this )
     stream_t     *p_access = (stream_t*)p_this;
     access_sys_t *sys = p_access->p_sys;
 
+#ifdef HAVE_RECVMMSG
+    block_ChainRelease( sys->queue );
+    for( unsigned i = 0; i < UDP_BATCH; i++ )
+        if( sys->slots[i] != NULL )
+            block_Release( sys->slots[i] );
+#endif
     net_Close( sys->fd );
 }
 
@@ -218,6 +247,7 @@ static int Control( stream_t *p_access, int i_query, va_list args )
     return VLC_SUCCESS;
 }
 
+#ifndef HAVE_RECVMMSG
 /*****************************************************************************
  * BlockUDP:
  *****************************************************************************/
@@ -282,3 +312,101 @@ skip:
 
     return pkt;
 }
+#else
+/*****************************************************************************
+ * BlockUDP: receives up to UDP_BATCH datagrams per system call
+ *****************************************************************************/
+static block_t *BlockUDP(stream_t *access, bool *restrict eof)
+{
+    access_sys_t *sys = access->p_sys;
+    block_t *pkt = sys->queue;
+
+    if (pkt != NULL)
+        goto dequeue;
+
+    struct pollfd ufd[1];
+
+    ufd[0].fd = sys->fd;
+    ufd[0].events = POLLIN;
+
+    switch (vlc_poll_i11e(ufd, 1, sys->timeout))
+    {
+        case 0:
+            msg_Err(access, "receive time-out");
+            *eof = true;
+            /* fall through */
+        case -1:
+            return NULL;
+    }
+
+    unsigned count;
+
+    for (count = 0; count < UDP_BATCH; count++)
+    {
+        block_t *slot = sys->slots[count];
+
+        if (slot != NULL && slot->i_buffer < sys->mtu)
+        {   /* The MTU was raised since this slot was allocated */
+            block_Release(slot);
+            slot = NULL;
+        }
+        if (slot == NULL)
+        {
+            slot = block_Alloc(sys->mtu);
+            if (unlikely(slot == NULL))
+                break;
+            sys->slots[count] = slot;
+        }
+
+        sys->iovs[count].iov_base = slot->p_buffer;
+        sys->iovs[count].iov_len = sys->mtu;
+        sys->msgs[count].msg_hdr = (struct msghdr) {
+            .msg_iov = &sys->iovs[count],
+            .msg_iovlen = 1,
+        };
+    }
+
+    if (unlikely(count == 0))
+    {   /* OOM - dequeue and discard one packet */
+        char dummy;
+        recv(sys->fd, &dummy, 1, 0);
+        return NULL;
+    }
+
+    int val = recvmmsg(sys->fd, sys->msgs, count, MSG_DONTWAIT | MSG_TRUNC,
+                       NULL);
+    if (val <= 0)
+        return NULL;
+
+    for (int i = 0; i < val; i++)
+    {
+        struct msghdr *msg = &sys->msgs[i].msg_hdr;
+        size_t len = sys->msgs[i].msg_len;
+
+        pkt = sys->slots[i];
+        sys->slots[i] = NULL;
+
+        if (msg->msg_flags & MSG_TRUNC)
+        {
+            msg_Err(access, "%zu bytes packet truncated (MTU was %zu)",
+                    len, sys->mtu);
+            pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
+            sys->mtu = len;
+        }
+        else
+            pkt->i_buffer = len;
+
+        *(sys->queue_last) = pkt;
+        sys->queue_last = &pkt->p_next;
+    }
+
+    pkt = sys->queue;
+dequeue:
+    /* The stream layer expects one block at a time */
+    sys->queue = pkt->p_next;
+    if (sys->queue == NULL)
+        sys->queue_last = &sys->queue;
+    pkt->p_next = NULL;
+    return pkt;
+}
+#endif
@@ -46,11 +46,24 @@
 #else
 #   include <sys/socket.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#   include <sys/uio.h>
+#endif
+#ifdef __linux__
+#   include <netinet/udp.h>
+#endif
 
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
 
+#ifdef HAVE_SENDMMSG
+/** Maximum number of packets sent per system call */
+# define MAX_BATCH 64
+/** Maximum payload of a segmentation offload send */
+# define GSO_MAX_SIZE 65507
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -71,6 +84,19 @@ static void Close( vlc_object_t * );
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
 
+#define BATCH_TEXT N_("Batch window (ms)")
+#define BATCH_LONGTEXT N_("Packets due within this time window are sent " \
+                          "together with a single system call, at the date " \
+                          "of the first one. This bounds the timing error " \
+                          "of each packet to the window size. Zero sends " \
+                          "packets one by one. This replaces the grouping " \
+                          "of packets." )
+
+#define GSO_TEXT N_("Segmentation offload")
+#define GSO_LONGTEXT N_("Let the kernel split runs of equally-sized " \
+                        "packets of a batch (UDP generic segmentation " \
+                        "offload). This requires a batch window." )
+
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
     set_shortname( "UDP" )
@@ -79,6 +105,9 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_integer_with_range( SOUT_CFG_PREFIX "batch", 0, 0, 100,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
+    add_bool( SOUT_CFG_PREFIX "gso", false, GSO_TEXT, GSO_LONGTEXT, true )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +121,8 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "batch",
+    "gso",
     NULL
 };
 
@@ -107,6 +138,9 @@ static ssize_t Write   ( sout_access_out_t *, block_t * );
 static int Control( sout_access_out_t *, int, va_list );
 
 static void* ThreadWrite( void * );
+#ifdef HAVE_SENDMMSG
+static void* ThreadWriteBatch( void * );
+#endif
 static block_t *NewUDPPacket( sout_access_out_t *, mtime_t );
 
 struct sout_access_out_sys_t
@@ -121,6 +155,19 @@ struct sout_access_out_sys_t
     block_t      *p_buffer;
 
     vlc_thread_t  thread;
+
+    /* Statistics, written by the sending thread only */
+    uint64_t      i_sent_packets;
+    uint64_t      i_late_packets;
+    uint64_t      i_dropped_packets;
+
+#ifdef HAVE_SENDMMSG
+    mtime_t       i_batch_window;
+    bool          b_gso;
+    block_t      *pp_batch[MAX_BATCH];
+    unsigned      i_batch;
+    block_t      *p_pending; /**< dequeued packet not due for the batch */
+#endif
 };
 
 #define DEFAULT_PORT 1234
@@ -146,7 +193,9 @@ static int Open( vlc_object_t *p_this )
     if (var_Create (p_access, "dst-port", VLC_VAR_INTEGER)
      || var_Create (p_access, "src-port", VLC_VAR_INTEGER)
      || var_Create (p_access, "dst-addr", VLC_VAR_STRING)
-     || var_Create (p_access, "src-addr", VLC_VAR_STRING))
+     || var_Create (p_access, "src-addr", VLC_VAR_STRING)
+     || var_Create (p_access, "late-packets", VLC_VAR_INTEGER)
+     || var_Create (p_access, "dropped-packets", VLC_VAR_INTEGER))
     {
         return VLC_ENOMEM;
     }
@@ -209,11 +258,29 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_handle = i_handle;
     p_sys->i_mtu = var_CreateGetInteger( p_this, "mtu" );
     p_sys->b_mtu_warning = false;
-    p_sys->p_fifo = block_FifoNew();
-    p_sys->p_empty_blocks = block_FifoNew();
+    /* Both queues have a single producer, sending blocks at packet rate. */
+    p_sys->p_fifo = block_FifoNewLockless();
+    p_sys->p_empty_blocks = block_FifoNewLockless();
     p_sys->p_buffer = NULL;
+    p_sys->i_sent_packets = p_sys->i_late_packets = 0;
+    p_sys->i_dropped_packets = 0;
+
+    void *(*thread)( void * ) = ThreadWrite;
+#ifdef HAVE_SENDMMSG
+    p_sys->i_batch_window = INT64_C(1000)
+                          * var_GetInteger( p_access, SOUT_CFG_PREFIX "batch" );
+    p_sys->b_gso = var_GetBool( p_access, SOUT_CFG_PREFIX "gso" );
+    p_sys->i_batch = 0;
+    p_sys->p_pending = NULL;
+    if( p_sys->i_batch_window > 0 )
+    {
+        if( var_GetInteger( p_access, SOUT_CFG_PREFIX "group" ) > 1 )
+            msg_Warn( p_access, "packets grouping ignored with batching" );
+        thread = ThreadWriteBatch;
+    }
+#endif
 
-    if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
+    if( vlc_clone( &p_sys->thread, thread, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
     {
         msg_Err( p_access, "cannot spawn sout access thread" );
@@ -244,6 +311,15 @@ static void Close( vlc_object_t * p_this )
     block_FifoRelease( p_sys->p_empty_blocks );
 
     if( p_sys->p_buffer ) block_Release( p_sys->p_buffer );
+#ifdef HAVE_SENDMMSG
+    for( unsigned i = 0; i < p_sys->i_batch; i++ )
+        block_Release( p_sys->pp_batch[i] );
+    if( p_sys->p_pending ) block_Release( p_sys->p_pending );
+#endif
+
+    msg_Dbg( p_access, "%"PRIu64" packets sent, %"PRIu64" late, "
+             "%"PRIu64" dropped", p_sys->i_sent_packets,
+             p_sys->i_late_packets, p_sys->i_dropped_packets );
 
     net_Close( p_sys->i_handle );
     free( p_sys );
@@ -411,6 +487,7 @@ static void* ThreadWrite( void *data )
 
                 i_date_last = i_date;
                 i_dropped_packets++;
+                p_sys->i_dropped_packets++;
                 continue;
             }
             else if( i_date - i_date_last < -1000 )
@@ -432,9 +509,12 @@ static void* ThreadWrite( void *data )
             msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
         vlc_cleanup_pop();
 
+        p_sys->i_sent_packets++;
         if( i_dropped_packets )
         {
             msg_Dbg( p_access, "dropped %i packets", i_dropped_packets );
+            var_SetInteger( p_access, "dropped-packets",
+                            p_sys->i_dropped_packets );
             i_dropped_packets = 0;
         }
 
@@ -444,6 +524,8 @@ static void* ThreadWrite( void *data )
         {
             msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
                      i_sent - i_date );
+            var_SetInteger( p_access, "late-packets",
+                            ++p_sys->i_late_packets );
         }
 #endif
 
@@ -453,3 +535,193 @@ static void* ThreadWrite( void *data )
     }
     return NULL;
 }
+
+#ifdef HAVE_SENDMMSG
+/*****************************************************************************
+ * SendBatch: send all packets of the current batch
+ *****************************************************************************
+ * Returns the number of packets sent: the following ones are lost.
+ *****************************************************************************/
+static unsigned SendBatch( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iovs[MAX_BATCH];
+#ifdef UDP_SEGMENT
+    char cmsgs[MAX_BATCH][CMSG_SPACE(sizeof (uint16_t))];
+#endif
+    unsigned i_msgs = 0;
+
+    for( unsigned i = 0; i < p_sys->i_batch; )
+    {
+        struct msghdr *msg = &msgs[i_msgs].msg_hdr;
+        const size_t i_size = p_sys->pp_batch[i]->i_buffer;
+        unsigned i_count = 1;
+
+        iovs[i].iov_base = p_sys->pp_batch[i]->p_buffer;
+        iovs[i].iov_len = i_size;
+
+#ifdef UDP_SEGMENT
+        /* Coalesce a run of packets of the same size (but for the last one,
+         * which may be shorter) into a single segmentation offload send. */
+        if( p_sys->b_gso )
+            while( i + i_count < p_sys->i_batch
+                && (i_count + 1) * i_size <= GSO_MAX_SIZE
+                && p_sys->pp_batch[i + i_count - 1]->i_buffer == i_size
+                && p_sys->pp_batch[i + i_count]->i_buffer <= i_size )
+            {
+                iovs[i + i_count].iov_base =
+                    p_sys->pp_batch[i + i_count]->p_buffer;
+                iovs[i + i_count].iov_len =
+                    p_sys->pp_batch[i + i_count]->i_buffer;
+                i_count++;
+            }
+#endif
+        memset( msg, 0, sizeof (*msg) );
+        msg->msg_iov = &iovs[i];
+        msg->msg_iovlen = i_count;
+#ifdef UDP_SEGMENT
+        if( i_count > 1 )
+        {
+            struct cmsghdr *cmsg;
+
+            msg->msg_control = cmsgs[i_msgs];
+            msg->msg_controllen = sizeof (cmsgs[i_msgs]);
+            cmsg = CMSG_FIRSTHDR( msg );
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof (uint16_t));
+            memcpy( CMSG_DATA(cmsg), &(uint16_t){ i_size }, sizeof (uint16_t) );
+        }
+#endif
+        i_msgs++;
+        i += i_count;
+    }
+
+    unsigned i_sent = 0;
+
+    for( unsigned i = 0; i < i_msgs; )
+    {
+        int val = sendmmsg( p_sys->i_handle, msgs + i, i_msgs - i, 0 );
+        if( val == -1 )
+        {
+#ifdef UDP_SEGMENT
+            if( errno == EIO && p_sys->b_gso && i == 0 )
+            {   /* No segmentation offload with this path: send as is */
+                msg_Warn( p_access, "segmentation offload not supported" );
+                p_sys->b_gso = false;
+                return SendBatch( p_access );
+            }
+#endif
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+            break;
+        }
+        for( int j = 0; j < val; j++ )
+            i_sent += msgs[i + j].msg_hdr.msg_iovlen;
+        i += val;
+    }
+    return i_sent;
+}
+
+/*****************************************************************************
+ * ThreadWriteBatch: send packets due within the batch window at once.
+ *****************************************************************************
+ * The first packet of each batch is sent at its date, and the following ones
+ * ahead of time by at most the batch window.
+ *****************************************************************************/
+static void* ThreadWriteBatch( void *data )
+{
+    sout_access_out_t *p_access = data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    mtime_t i_date_last = -1;
+    unsigned i_dropped_packets = 0;
+
+    for (;;)
+    {
+        block_t *p_pk = p_sys->p_pending;
+
+        if( p_pk == NULL )
+            p_pk = block_FifoGet( p_sys->p_fifo );
+        p_sys->p_pending = NULL;
+
+        mtime_t i_date = p_sys->i_caching + p_pk->i_dts;
+        if( i_date_last > 0 && i_date - i_date_last > 2000000 )
+        {
+            if( !i_dropped_packets )
+                msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
+                         i_date - i_date_last );
+
+            block_FifoPut( p_sys->p_empty_blocks, p_pk );
+
+            i_date_last = i_date;
+            i_dropped_packets++;
+            p_sys->i_dropped_packets++;
+            continue;
+        }
+
+        p_sys->pp_batch[0] = p_pk;
+        p_sys->i_batch = 1;
+        mwait( i_date );
+
+        /* Gather the packets due within the window */
+        const mtime_t i_now = mdate();
+        const mtime_t i_deadline = i_now + p_sys->i_batch_window;
+        i_date_last = i_date;
+
+        while( p_sys->i_batch < MAX_BATCH )
+        {
+            vlc_fifo_Lock( p_sys->p_fifo );
+            p_pk = vlc_fifo_DequeueUnlocked( p_sys->p_fifo );
+            vlc_fifo_Unlock( p_sys->p_fifo );
+            if( p_pk == NULL )
+                break;
+
+            mtime_t i_pk_date = p_sys->i_caching + p_pk->i_dts;
+            if( i_pk_date > i_deadline || i_pk_date - i_date_last > 2000000 )
+            {
+                p_sys->p_pending = p_pk;
+                break;
+            }
+            p_sys->pp_batch[p_sys->i_batch++] = p_pk;
+            i_date_last = i_pk_date;
+        }
+
+        const unsigned i_sent = SendBatch( p_access );
+        if( i_sent < p_sys->i_batch )
+        {
+            i_dropped_packets += p_sys->i_batch - i_sent;
+            p_sys->i_dropped_packets += p_sys->i_batch - i_sent;
+        }
+
+        unsigned i_late = 0;
+        for( unsigned i = 0; i < i_sent; i++ )
+            if( i_now > p_sys->i_caching + p_sys->pp_batch[i]->i_dts + 20000 )
+                i_late++;
+
+        block_t *p_list = NULL;
+        for( unsigned i = p_sys->i_batch; i > 0; i-- )
+        {
+            p_sys->pp_batch[i - 1]->p_next = p_list;
+            p_list = p_sys->pp_batch[i - 1];
+        }
+        p_sys->i_sent_packets += i_sent;
+        p_sys->i_batch = 0;
+        block_FifoPut( p_sys->p_empty_blocks, p_list );
+
+        if( i_dropped_packets )
+        {
+            msg_Dbg( p_access, "dropped %i packets", i_dropped_packets );
+            var_SetInteger( p_access, "dropped-packets",
+                            p_sys->i_dropped_packets );
+            i_dropped_packets = 0;
+        }
+        if( i_late )
+        {
+            msg_Dbg( p_access, "%u packets have been sent too late", i_late );
+            p_sys->i_late_packets += i_late;
+            var_SetInteger( p_access, "late-packets", p_sys->i_late_packets );
+        }
+    }
+    return NULL;
+}
+#endif
@@ -0,0 +1,978 @@
+/*****************************************************************************
+ * biquad.c: cascades and banks of biquad filters
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#include "biquad.h"
+
+#if defined(CAN_COMPILE_SSE) || defined(CAN_COMPILE_AVX2)
+# include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+# include <arm_neon.h>
+#endif
+
+struct biquads
+{
+    unsigned sections;
+    unsigned channels;
+    bool parallel;
+    /* In cascade, channels per group of lanes.
+     * In parallel, channels interleaved in the lanes, or 1 if each channel
+     * has its own lanes. */
+    unsigned width;
+    unsigned lanes; /**< In parallel, sections times width, padded to 8 */
+    unsigned groups; /**< In cascade, of width channels */
+    unsigned count; /**< Floats of a set of coefficients */
+    unsigned parity; /**< Half of the state with the newest samples */
+    unsigned steps; /**< Updates left in the ramp */
+    unsigned step_left; /**< Frames before the next update */
+    void (*process)(biquads_t *, const float *, float *, size_t);
+
+    /* In cascade, per section, b0, b1, b2, a1 and a2, each repeated width
+     * times. In parallel, per lane, b0, b1, b2, a1, a2 and the gain, then
+     * the direct gain. */
+    float *coeffs;
+    float *target;
+    float *delta;
+
+    /* In cascade, per group of channels, the last 2 inputs of each section
+     * and the last 2 outputs of the last one, each of width channels.
+     * In parallel, per set of lanes, the last 2 outputs of each lane. */
+    float *state;
+    size_t state_size;
+    /* In parallel, the last 2 inputs, as 2 vectors of the interleaved
+     * channels, or per channel if not interleaved */
+    float *history;
+    size_t history_size;
+};
+
+/*****************************************************************************
+ * Sections in cascade, with channels in the lanes
+ *
+ * The newest and the oldest samples alternate between the 2 halves of the
+ * history of a section, so that the new sample replaces the oldest one.
+ *****************************************************************************/
+static void CascadeC(biquads_t *bq, const float *in, float *out,
+                     size_t frames)
+{
+    const unsigned sections = bq->sections, channels = bq->channels;
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const unsigned p = parity * 4, q = (parity ^ 1) * 4;
+
+        for (unsigned c = 0; c < channels; c++)
+        {
+            float *h = &bq->state[(c / 4) * (sections + 1) * 8 + (c % 4)];
+            const float *k = bq->coeffs;
+            float x = in[c];
+
+            for (unsigned s = 0; s < sections; s++, h += 8, k += 20)
+            {
+                const float y = k[0] * x + k[4] * h[p] + k[8] * h[q]
+                              - k[12] * h[8 + p] - k[16] * h[8 + q];
+                h[q] = x;
+                x = y;
+            }
+            h[q] = x;
+            out[c] = x;
+        }
+        parity ^= 1;
+        in += channels;
+        out += channels;
+    }
+    bq->parity = parity;
+}
+
+#ifdef CAN_COMPILE_SSE
+VLC_SSE
+static inline __m128 LoadSSE(const float *p, unsigned count)
+{
+    const __m128 zero = _mm_setzero_ps();
+
+    switch (count)
+    {
+        case 1:
+            return _mm_load_ss(p);
+        case 2:
+            return _mm_loadl_pi(zero, (const __m64 *)p);
+        case 3:
+            return _mm_movelh_ps(_mm_loadl_pi(zero, (const __m64 *)p),
+                                 _mm_load_ss(p + 2));
+        default:
+            return _mm_loadu_ps(p);
+    }
+}
+
+VLC_SSE
+static inline void StoreSSE(float *p, __m128 v, unsigned count)
+{
+    switch (count)
+    {
+        case 1:
+            _mm_store_ss(p, v);
+            break;
+        case 2:
+            _mm_storel_pi((__m64 *)p, v);
+            break;
+        case 3:
+            _mm_storel_pi((__m64 *)p, v);
+            _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+            break;
+        default:
+            _mm_storeu_ps(p, v);
+    }
+}
+
+VLC_SSE
+static void CascadeSSE(biquads_t *bq, const float *in, float *out,
+                       size_t frames)
+{
+    const unsigned sections = bq->sections, channels = bq->channels;
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const unsigned p = parity * 4, q = (parity ^ 1) * 4;
+
+        for (unsigned g = 0; g < bq->groups; g++)
+        {
+            const unsigned c0 = 4 * g;
+            const unsigned count = channels - c0 < 4 ? channels - c0 : 4;
+            float *h = &bq->state[g * (sections + 1) * 8];
+            const float *k = bq->coeffs;
+            __m128 x = LoadSSE(&in[c0], count);
+
+            for (unsigned s = 0; s < sections; s++, h += 8, k += 20)
+            {
+                __m128 t = _mm_mul_ps(_mm_load_ps(k), x);
+
+                t = _mm_add_ps(t, _mm_mul_ps(_mm_load_ps(k + 4),
+                                             _mm_load_ps(h + p)));
+                t = _mm_add_ps(t, _mm_mul_ps(_mm_load_ps(k + 8),
+                                             _mm_load_ps(h + q)));
+                t = _mm_sub_ps(t, _mm_mul_ps(_mm_load_ps(k + 16),
+                                             _mm_load_ps(h + 8 + q)));
+                _mm_store_ps(h + q, x);
+                x = _mm_sub_ps(t, _mm_mul_ps(_mm_load_ps(k + 12),
+                                             _mm_load_ps(h + 8 + p)));
+            }
+            _mm_store_ps(h + q, x);
+            StoreSSE(&out[c0], x, count);
+        }
+        parity ^= 1;
+        in += channels;
+        out += channels;
+    }
+    bq->parity = parity;
+}
+#endif
+
+#ifdef CAN_COMPILE_AVX2
+VLC_AVX2
+static void CascadeAVX2(biquads_t *bq, const float *in, float *out,
+                        size_t frames)
+{
+    const unsigned sections = bq->sections, channels = bq->channels;
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const unsigned p = parity * 8, q = (parity ^ 1) * 8;
+
+        for (unsigned g = 0; g < bq->groups; g++)
+        {
+            const unsigned c0 = 8 * g;
+            const int count = channels - c0 < 8 ? channels - c0 : 8;
+            const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(count),
+                                    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            float *h = &bq->state[g * (sections + 1) * 16];
+            const float *k = bq->coeffs;
+            __m256 x = _mm256_maskload_ps(&in[c0], mask);
+
+            for (unsigned s = 0; s < sections; s++, h += 16, k += 40)
+            {
+                __m256 t = _mm256_mul_ps(_mm256_load_ps(k), x);
+
+                t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_load_ps(k + 8),
+                                                   _mm256_load_ps(h + p)));
+                t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_load_ps(k + 16),
+                                                   _mm256_load_ps(h + q)));
+                t = _mm256_sub_ps(t, _mm256_mul_ps(_mm256_load_ps(k + 32),
+                                                   _mm256_load_ps(h + 16 + q)));
+                _mm256_store_ps(h + q, x);
+                x = _mm256_sub_ps(t, _mm256_mul_ps(_mm256_load_ps(k + 24),
+                                                   _mm256_load_ps(h + 16 + p)));
+            }
+            _mm256_store_ps(h + q, x);
+            _mm256_maskstore_ps(&out[c0], mask, x);
+        }
+        parity ^= 1;
+        in += channels;
+        out += channels;
+    }
+    bq->parity = parity;
+}
+#endif
+
+#ifdef __ARM_NEON
+static void CascadeNEON(biquads_t *bq, const float *in, float *out,
+                        size_t frames)
+{
+    const unsigned sections = bq->sections, channels = bq->channels;
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const unsigned p = parity * 4, q = (parity ^ 1) * 4;
+
+        for (unsigned g = 0; g < bq->groups; g++)
+        {
+            const unsigned c0 = 4 * g;
+            const unsigned count = channels - c0 < 4 ? channels - c0 : 4;
+            float *h = &bq->state[g * (sections + 1) * 8];
+            const float *k = bq->coeffs;
+            float tmp[4] = { 0.f, 0.f, 0.f, 0.f };
+
+            memcpy(tmp, &in[c0], count * sizeof (float));
+            float32x4_t x = vld1q_f32(tmp);
+
+            for (unsigned s = 0; s < sections; s++, h += 8, k += 20)
+            {
+                float32x4_t t = vmulq_f32(vld1q_f32(k), x);
+
+                t = vmlaq_f32(t, vld1q_f32(k + 4), vld1q_f32(h + p));
+                t = vmlaq_f32(t, vld1q_f32(k + 8), vld1q_f32(h + q));
+                t = vmlsq_f32(t, vld1q_f32(k + 16), vld1q_f32(h + 8 + q));
+                vst1q_f32(h + q, x);
+                x = vmlsq_f32(t, vld1q_f32(k + 12), vld1q_f32(h + 8 + p));
+            }
+            vst1q_f32(h + q, x);
+
+            vst1q_f32(tmp, x);
+            memcpy(&out[c0], tmp, count * sizeof (float));
+        }
+        parity ^= 1;
+        in += channels;
+        out += channels;
+    }
+    bq->parity = parity;
+}
+#endif
+
+/*****************************************************************************
+ * Sections in parallel, with the sections of each channel in the lanes
+ *****************************************************************************/
+static void ParallelC(biquads_t *bq, const float *in, float *out,
+                      size_t frames)
+{
+    const unsigned n = bq->lanes, channels = bq->channels;
+    const float *b0 = bq->coeffs, *b1 = b0 + n, *b2 = b1 + n;
+    const float *a1 = b2 + n, *a2 = a1 + n, *gain = a2 + n;
+    const float direct = gain[n];
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        for (unsigned c = 0; c < channels; c++)
+        {
+            float *st = &bq->state[2 * n * c];
+            const float *y1 = st + parity * n;
+            float *y2 = st + (parity ^ 1) * n;
+            float *h = &bq->history[2 * c];
+            const float x = in[c];
+            float sum = 0.f;
+
+            for (unsigned k = 0; k < bq->sections; k++)
+            {
+                const float y = b0[k] * x + b1[k] * h[0] + b2[k] * h[1]
+                              - a1[k] * y1[k] - a2[k] * y2[k];
+                y2[k] = y;
+                sum += gain[k] * y;
+            }
+            h[1] = h[0];
+            h[0] = x;
+            out[c] = direct * x + sum;
+        }
+        parity ^= 1;
+        in += channels;
+        out += channels;
+    }
+    bq->parity = parity;
+}
+
+#ifdef CAN_COMPILE_SSE
+VLC_SSE
+static void ParallelSSE(biquads_t *bq, const float *in, float *out,
+                        size_t frames)
+{
+    const unsigned n = bq->lanes, channels = bq->channels;
+    const float *b0 = bq->coeffs, *b1 = b0 + n, *b2 = b1 + n;
+    const float *a1 = b2 + n, *a2 = a1 + n, *gain = a2 + n;
+    const float direct = gain[n];
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        for (unsigned c = 0; c < channels; c++)
+        {
+            float *st = &bq->state[2 * n * c];
+            const float *y1 = st + parity * n;
+            float *y2 = st + (parity ^ 1) * n;
+            float *h = &bq->history[2 * c];
+            const float x = in[c];
+            const __m128 vx = _mm_set1_ps(x);
+            const __m128 vx1 = _mm_set1_ps(h[0]), vx2 = _mm_set1_ps(h[1]);
+            __m128 acc = _mm_setzero_ps();
+
+            for (unsigned k = 0; k < n; k += 4)
+            {
+                __m128 t = _mm_mul_ps(_mm_load_ps(&b0[k]), vx);
+
+                t = _mm_add_ps(t, _mm_mul_ps(_mm_load_ps(&b1[k]), vx1));
+                t = _mm_add_ps(t, _mm_mul_ps(_mm_load_ps(&b2[k]), vx2));
+                t = _mm_sub_ps(t, _mm_mul_ps(_mm_load_ps(&a2[k]),
+                                             _mm_load_ps(&y2[k])));
+                const __m128 y = _mm_sub_ps(t, _mm_mul_ps(_mm_load_ps(&a1[k]),
+                                                          _mm_load_ps(&y1[k])));
+                _mm_store_ps(&y2[k], y);
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(&gain[k]), y));
+            }
+            acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+            acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+
+            h[1] = h[0];
+            h[0] = x;
+            out[c] = direct * x + _mm_cvtss_f32(acc);
+        }
+        parity ^= 1;
+        in += channels;
+        out += channels;
+    }
+    bq->parity = parity;
+}
+#endif
+
+#ifdef CAN_COMPILE_AVX2
+VLC_AVX2
+static void ParallelAVX2(biquads_t *bq, const float *in, float *out,
+                         size_t frames)
+{
+    const unsigned n = bq->lanes, channels = bq->channels;
+    const float *b0 = bq->coeffs, *b1 = b0 + n, *b2 = b1 + n;
+    const float *a1 = b2 + n, *a2 = a1 + n, *gain = a2 + n;
+    const float direct = gain[n];
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        for (unsigned c = 0; c < channels; c++)
+        {
+            float *st = &bq->state[2 * n * c];
+            const float *y1 = st + parity * n;
+            float *y2 = st + (parity ^ 1) * n;
+            float *h = &bq->history[2 * c];
+            const float x = in[c];
+            const __m256 vx = _mm256_set1_ps(x);
+            const __m256 vx1 = _mm256_set1_ps(h[0]);
+            const __m256 vx2 = _mm256_set1_ps(h[1]);
+            __m256 acc = _mm256_setzero_ps();
+
+            for (unsigned k = 0; k < n; k += 8)
+            {
+                __m256 t = _mm256_mul_ps(_mm256_load_ps(&b0[k]), vx);
+
+                t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_load_ps(&b1[k]),
+                                                   vx1));
+                t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_load_ps(&b2[k]),
+                                                   vx2));
+                t = _mm256_sub_ps(t, _mm256_mul_ps(_mm256_load_ps(&a2[k]),
+                                                   _mm256_load_ps(&y2[k])));
+                const __m256 y = _mm256_sub_ps(t,
+                    _mm256_mul_ps(_mm256_load_ps(&a1[k]),
+                                  _mm256_load_ps(&y1[k])));
+                _mm256_store_ps(&y2[k], y);
+                acc = _mm256_add_ps(acc,
+                                    _mm256_mul_ps(_mm256_load_ps(&gain[k]), y));
+            }
+
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc),
+                                    _mm256_extractf128_ps(acc, 1));
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+            h[1] = h[0];
+            h[0] = x;
+            out[c] = direct * x + _mm_cvtss_f32(sum);
+        }
+        parity ^= 1;
+        in += channels;
+        out += channels;
+    }
+    bq->parity = parity;
+}
+#endif
+
+#ifdef __ARM_NEON
+static void ParallelNEON(biquads_t *bq, const float *in, float *out,
+                         size_t frames)
+{
+    const unsigned n = bq->lanes, channels = bq->channels;
+    const float *b0 = bq->coeffs, *b1 = b0 + n, *b2 = b1 + n;
+    const float *a1 = b2 + n, *a2 = a1 + n, *gain = a2 + n;
+    const float direct = gain[n];
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        for (unsigned c = 0; c < channels; c++)
+        {
+            float *st = &bq->state[2 * n * c];
+            const float *y1 = st + parity * n;
+            float *y2 = st + (parity ^ 1) * n;
+            float *h = &bq->history[2 * c];
+            const float x = in[c];
+            float32x4_t acc = vdupq_n_f32(0.f);
+
+            for (unsigned k = 0; k < n; k += 4)
+            {
+                float32x4_t t = vmulq_n_f32(vld1q_f32(&b0[k]), x);
+
+                t = vmlaq_n_f32(t, vld1q_f32(&b1[k]), h[0]);
+                t = vmlaq_n_f32(t, vld1q_f32(&b2[k]), h[1]);
+                t = vmlsq_f32(t, vld1q_f32(&a2[k]), vld1q_f32(&y2[k]));
+                const float32x4_t y = vmlsq_f32(t, vld1q_f32(&a1[k]),
+                                                vld1q_f32(&y1[k]));
+                vst1q_f32(&y2[k], y);
+                acc = vmlaq_f32(acc, vld1q_f32(&gain[k]), y);
+            }
+
+            float32x2_t sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+            sum = vpadd_f32(sum, sum);
+
+            h[1] = h[0];
+            h[0] = x;
+            out[c] = direct * x + vget_lane_f32(sum, 0);
+        }
+        parity ^= 1;
+        in += channels;
+        out += channels;
+    }
+    bq->parity = parity;
+}
+#endif
+
+/*****************************************************************************
+ * Sections in parallel, with the channels interleaved in the lanes
+ *
+ * When the channels divide the vector size, lane l filters the channel
+ * l % channels with the section l / channels, so that all the channels of a
+ * frame are processed together, and the lanes of a channel are summed at
+ * the end.
+ *****************************************************************************/
+#ifdef CAN_COMPILE_SSE
+VLC_SSE
+static inline __m128 BroadcastSSE(const float *p, unsigned width)
+{
+    switch (width)
+    {
+        case 1:
+            return _mm_load1_ps(p);
+        case 2:
+        {
+            const __m128 v = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)p);
+            return _mm_movelh_ps(v, v);
+        }
+        default:
+            return _mm_loadu_ps(p);
+    }
+}
+
+VLC_SSE
+static inline void InterleavedSSEWidth(biquads_t *bq, const float *in,
+                                       float *out, size_t frames,
+                                       unsigned width)
+{
+    const unsigned n = bq->lanes;
+    const float *b0 = bq->coeffs, *b1 = b0 + n, *b2 = b1 + n;
+    const float *a1 = b2 + n, *a2 = a1 + n, *gain = a2 + n;
+    const __m128 direct = _mm_set1_ps(gain[n]);
+    __m128 x1 = _mm_load_ps(bq->history), x2 = _mm_load_ps(bq->history + 8);
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const float *y1 = bq->state + parity * n;
+        float *y2 = bq->state + (parity ^ 1) * n;
+        const __m128 x = BroadcastSSE(in, width);
+        __m128 acc = _mm_setzero_ps();
+
+        for (unsigned k = 0; k < n; k += 4)
+        {
+            __m128 t = _mm_mul_ps(_mm_load_ps(&b0[k]), x);
+
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_load_ps(&b1[k]), x1));
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_load_ps(&b2[k]), x2));
+            t = _mm_sub_ps(t, _mm_mul_ps(_mm_load_ps(&a2[k]),
+                                         _mm_load_ps(&y2[k])));
+            const __m128 y = _mm_sub_ps(t, _mm_mul_ps(_mm_load_ps(&a1[k]),
+                                                      _mm_load_ps(&y1[k])));
+            _mm_store_ps(&y2[k], y);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(&gain[k]), y));
+        }
+        if (width <= 2)
+            acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        if (width == 1)
+            acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+        acc = _mm_add_ps(acc, _mm_mul_ps(direct, x));
+        x2 = x1;
+        x1 = x;
+
+        switch (width)
+        {
+            case 1:
+                _mm_store_ss(out, acc);
+                break;
+            case 2:
+                _mm_storel_pi((__m64 *)out, acc);
+                break;
+            default:
+                _mm_storeu_ps(out, acc);
+        }
+        parity ^= 1;
+        in += width;
+        out += width;
+    }
+    _mm_store_ps(bq->history, x1);
+    _mm_store_ps(bq->history + 8, x2);
+    bq->parity = parity;
+}
+
+VLC_SSE
+static void InterleavedSSE(biquads_t *bq, const float *in, float *out,
+                           size_t frames)
+{
+    switch (bq->width)
+    {
+        case 1:
+            InterleavedSSEWidth(bq, in, out, frames, 1);
+            break;
+        case 2:
+            InterleavedSSEWidth(bq, in, out, frames, 2);
+            break;
+        default:
+            InterleavedSSEWidth(bq, in, out, frames, 4);
+    }
+}
+#endif
+
+#ifdef CAN_COMPILE_AVX2
+VLC_AVX2
+static inline __m256 BroadcastAVX2(const float *p, unsigned width)
+{
+    switch (width)
+    {
+        case 1:
+            return _mm256_broadcast_ss(p);
+        case 2:
+            return _mm256_castpd_ps(_mm256_broadcast_sd((const double *)p));
+        case 4:
+            return _mm256_broadcast_ps((const __m128 *)p);
+        default:
+            return _mm256_loadu_ps(p);
+    }
+}
+
+VLC_AVX2
+static inline void InterleavedAVX2Width(biquads_t *bq, const float *in,
+                                        float *out, size_t frames,
+                                        unsigned width)
+{
+    const unsigned n = bq->lanes;
+    const float *b0 = bq->coeffs, *b1 = b0 + n, *b2 = b1 + n;
+    const float *a1 = b2 + n, *a2 = a1 + n, *gain = a2 + n;
+    const __m256 direct = _mm256_set1_ps(gain[n]);
+    __m256 x1 = _mm256_load_ps(bq->history);
+    __m256 x2 = _mm256_load_ps(bq->history + 8);
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const float *y1 = bq->state + parity * n;
+        float *y2 = bq->state + (parity ^ 1) * n;
+        const __m256 x = BroadcastAVX2(in, width);
+        __m256 acc = _mm256_setzero_ps();
+
+        for (unsigned k = 0; k < n; k += 8)
+        {
+            __m256 t = _mm256_mul_ps(_mm256_load_ps(&b0[k]), x);
+
+            t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_load_ps(&b1[k]), x1));
+            t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_load_ps(&b2[k]), x2));
+            t = _mm256_sub_ps(t, _mm256_mul_ps(_mm256_load_ps(&a2[k]),
+                                               _mm256_load_ps(&y2[k])));
+            const __m256 y = _mm256_sub_ps(t,
+                _mm256_mul_ps(_mm256_load_ps(&a1[k]), _mm256_load_ps(&y1[k])));
+            _mm256_store_ps(&y2[k], y);
+            acc = _mm256_add_ps(acc,
+                                _mm256_mul_ps(_mm256_load_ps(&gain[k]), y));
+        }
+
+        if (width == 8)
+            _mm256_storeu_ps(out, _mm256_add_ps(acc, _mm256_mul_ps(direct, x)));
+        else
+        {
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc),
+                                    _mm256_extractf128_ps(acc, 1));
+            if (width <= 2)
+                sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            if (width == 1)
+                sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm256_castps256_ps128(direct),
+                                             _mm256_castps256_ps128(x)));
+            switch (width)
+            {
+                case 1:
+                    _mm_store_ss(out, sum);
+                    break;
+                case 2:
+                    _mm_storel_pi((__m64 *)out, sum);
+                    break;
+                default:
+                    _mm_storeu_ps(out, sum);
+            }
+        }
+        x2 = x1;
+        x1 = x;
+        parity ^= 1;
+        in += width;
+        out += width;
+    }
+    _mm256_store_ps(bq->history, x1);
+    _mm256_store_ps(bq->history + 8, x2);
+    bq->parity = parity;
+}
+
+VLC_AVX2
+static void InterleavedAVX2(biquads_t *bq, const float *in, float *out,
+                            size_t frames)
+{
+    switch (bq->width)
+    {
+        case 1:
+            InterleavedAVX2Width(bq, in, out, frames, 1);
+            break;
+        case 2:
+            InterleavedAVX2Width(bq, in, out, frames, 2);
+            break;
+        case 4:
+            InterleavedAVX2Width(bq, in, out, frames, 4);
+            break;
+        default:
+            InterleavedAVX2Width(bq, in, out, frames, 8);
+    }
+}
+#endif
+
+#ifdef __ARM_NEON
+static inline float32x4_t BroadcastNEON(const float *p, unsigned width)
+{
+    switch (width)
+    {
+        case 1:
+            return vld1q_dup_f32(p);
+        case 2:
+            return vcombine_f32(vld1_f32(p), vld1_f32(p));
+        default:
+            return vld1q_f32(p);
+    }
+}
+
+static inline void InterleavedNEONWidth(biquads_t *bq, const float *in,
+                                        float *out, size_t frames,
+                                        unsigned width)
+{
+    const unsigned n = bq->lanes;
+    const float *b0 = bq->coeffs, *b1 = b0 + n, *b2 = b1 + n;
+    const float *a1 = b2 + n, *a2 = a1 + n, *gain = a2 + n;
+    const float direct = gain[n];
+    float32x4_t x1 = vld1q_f32(bq->history), x2 = vld1q_f32(bq->history + 8);
+    unsigned parity = bq->parity;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const float *y1 = bq->state + parity * n;
+        float *y2 = bq->state + (parity ^ 1) * n;
+        const float32x4_t x = BroadcastNEON(in, width);
+        float32x4_t acc = vdupq_n_f32(0.f);
+
+        for (unsigned k = 0; k < n; k += 4)
+        {
+            float32x4_t t = vmulq_f32(vld1q_f32(&b0[k]), x);
+
+            t = vmlaq_f32(t, vld1q_f32(&b1[k]), x1);
+            t = vmlaq_f32(t, vld1q_f32(&b2[k]), x2);
+            t = vmlsq_f32(t, vld1q_f32(&a2[k]), vld1q_f32(&y2[k]));
+            const float32x4_t y = vmlsq_f32(t, vld1q_f32(&a1[k]),
+                                            vld1q_f32(&y1[k]));
+            vst1q_f32(&y2[k], y);
+            acc = vmlaq_f32(acc, vld1q_f32(&gain[k]), y);
+        }
+
+        if (width == 4)
+            vst1q_f32(out, vmlaq_n_f32(acc, x, direct));
+        else
+        {
+            const float32x2_t sum = vadd_f32(vget_low_f32(acc),
+                                             vget_high_f32(acc));
+            if (width == 2)
+                vst1_f32(out, vmla_n_f32(sum, vget_low_f32(x), direct));
+            else
+                out[0] = vget_lane_f32(vpadd_f32(sum, sum), 0)
+                       + direct * in[0];
+        }
+        x2 = x1;
+        x1 = x;
+        parity ^= 1;
+        in += width;
+        out += width;
+    }
+    vst1q_f32(bq->history, x1);
+    vst1q_f32(bq->history + 8, x2);
+    bq->parity = parity;
+}
+
+static void InterleavedNEON(biquads_t *bq, const float *in, float *out,
+                            size_t frames)
+{
+    switch (bq->width)
+    {
+        case 1:
+            InterleavedNEONWidth(bq, in, out, frames, 1);
+            break;
+        case 2:
+            InterleavedNEONWidth(bq, in, out, frames, 2);
+            break;
+        default:
+            InterleavedNEONWidth(bq, in, out, frames, 4);
+    }
+}
+#endif
+
+/*****************************************************************************
+ * Interface
+ *****************************************************************************/
+static float *AllocFloats(size_t count)
+{
+    count = (count + 7) & ~(size_t)7;
+
+    float *p = aligned_alloc(32, count * sizeof (float));
+    if (likely(p != NULL))
+        memset(p, 0, count * sizeof (float));
+    return p;
+}
+
+biquads_t *BiquadsNew(unsigned sections, unsigned channels, bool parallel)
+{
+    assert(sections > 0 && channels > 0);
+
+    biquads_t *bq = malloc(sizeof (*bq));
+    if (unlikely(bq == NULL))
+        return NULL;
+
+    bq->sections = sections;
+    bq->channels = channels;
+    bq->parallel = parallel;
+    bq->steps = 0;
+
+    if (parallel)
+    {
+        bq->width = 1;
+        bq->process = ParallelC;
+#if defined(CAN_COMPILE_SSE)
+        if (vlc_CPU_SSE())
+        {
+            bq->width = 4 % channels ? 1 : channels;
+            bq->process = 4 % channels ? ParallelSSE : InterleavedSSE;
+        }
+#endif
+#if defined(CAN_COMPILE_AVX2)
+        if (vlc_CPU_AVX2())
+        {
+            bq->width = 8 % channels ? 1 : channels;
+            bq->process = 8 % channels ? ParallelAVX2 : InterleavedAVX2;
+        }
+#endif
+#ifdef __ARM_NEON
+        bq->width = 4 % channels ? 1 : channels;
+        bq->process = 4 % channels ? ParallelNEON : InterleavedNEON;
+#endif
+        bq->lanes = (sections * bq->width + 7) & ~7u;
+        bq->groups = 0;
+        bq->count = 6 * bq->lanes + 8;
+        bq->state_size = 2 * bq->lanes * (channels / bq->width);
+        bq->history_size = __MAX(2 * channels, 16);
+    }
+    else
+    {
+        bq->width = 4;
+        bq->process = CascadeC;
+#if defined(CAN_COMPILE_SSE)
+        if (vlc_CPU_SSE())
+            bq->process = CascadeSSE;
+#endif
+#if defined(CAN_COMPILE_AVX2)
+        if (vlc_CPU_AVX2() && channels > 4)
+        {
+            bq->width = 8;
+            bq->process = CascadeAVX2;
+        }
+#endif
+#ifdef __ARM_NEON
+        bq->process = CascadeNEON;
+#endif
+        bq->lanes = 0;
+        bq->groups = (channels + bq->width - 1) / bq->width;
+        bq->count = (5 * sections * bq->width + 7) & ~7u;
+        bq->state_size = bq->groups * (sections + 1) * 2 * bq->width;
+        bq->history_size = 0;
+    }
+
+    bq->coeffs = AllocFloats(3 * bq->count);
+    bq->state = AllocFloats(bq->state_size);
+    bq->history = bq->history_size ? AllocFloats(bq->history_size) : NULL;
+    if (unlikely(bq->coeffs == NULL || bq->state == NULL
+              || (bq->history_size && bq->history == NULL)))
+    {
+        aligned_free(bq->history);
+        aligned_free(bq->state);
+        aligned_free(bq->coeffs);
+        free(bq);
+        return NULL;
+    }
+    bq->target = bq->coeffs + bq->count;
+    bq->delta = bq->target + bq->count;
+
+    BiquadsReset(bq);
+    return bq;
+}
+
+void BiquadsDelete(biquads_t *bq)
+{
+    aligned_free(bq->history);
+    aligned_free(bq->state);
+    aligned_free(bq->coeffs);
+    free(bq);
+}
+
+void BiquadsSetSection(biquads_t *bq, unsigned section, const float *coeffs)
+{
+    assert(section < bq->sections);
+
+    for (unsigned i = 0; i < 5; i++)
+        for (unsigned j = 0; j < bq->width; j++)
+        {
+            if (bq->parallel)
+                bq->target[i * bq->lanes + section * bq->width + j] = coeffs[i];
+            else
+                bq->target[(section * 5 + i) * bq->width + j] = coeffs[i];
+        }
+}
+
+void BiquadsSetGain(biquads_t *bq, unsigned section, float gain)
+{
+    assert(section < bq->sections);
+
+    if (bq->parallel)
+        for (unsigned j = 0; j < bq->width; j++)
+            bq->target[5 * bq->lanes + section * bq->width + j] = gain;
+}
+
+void BiquadsSetDirect(biquads_t *bq, float gain)
+{
+    if (bq->parallel)
+        bq->target[6 * bq->lanes] = gain;
+}
+
+void BiquadsCommit(biquads_t *bq, unsigned ramp)
+{
+    const unsigned steps = ramp / BIQUADS_RAMP_STEP;
+
+    if (steps <= 1)
+    {
+        memcpy(bq->coeffs, bq->target, bq->count * sizeof (float));
+        bq->steps = 0;
+        return;
+    }
+
+    /* The first step is taken at once, the last one lands on the target */
+    for (unsigned i = 0; i < bq->count; i++)
+    {
+        bq->delta[i] = (bq->target[i] - bq->coeffs[i]) / steps;
+        bq->coeffs[i] += bq->delta[i];
+    }
+    bq->steps = steps - 1;
+    bq->step_left = BIQUADS_RAMP_STEP;
+}
+
+void BiquadsProcess(biquads_t *bq, const float *in, float *out, size_t frames)
+{
+    while (frames > 0)
+    {
+        size_t count = frames;
+
+        if (bq->steps > 0 && count > bq->step_left)
+            count = bq->step_left;
+
+        bq->process(bq, in, out, count);
+        in += count * bq->channels;
+        out += count * bq->channels;
+        frames -= count;
+
+        if (bq->steps > 0 && (bq->step_left -= count) == 0)
+        {
+            bq->step_left = BIQUADS_RAMP_STEP;
+            if (--bq->steps > 0)
+                for (unsigned i = 0; i < bq->count; i++)
+                    bq->coeffs[i] += bq->delta[i];
+            else
+                memcpy(bq->coeffs, bq->target, bq->count * sizeof (float));
+        }
+    }
+}
+
+void BiquadsReset(biquads_t *bq)
+{
+    memset(bq->state, 0, bq->state_size * sizeof (float));
+    if (bq->history != NULL)
+        memset(bq->history, 0, bq->history_size * sizeof (float));
+    bq->parity = 0;
+}
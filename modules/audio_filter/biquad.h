@@ -0,0 +1,72 @@
+/*****************************************************************************
+ * biquad.h: cascades and banks of biquad filters
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_AUDIO_FILTER_BIQUAD_H_
+#define VLC_AUDIO_FILTER_BIQUAD_H_
+
+/* Second order sections in direct form 1, applied to every channel of
+ * interleaved float samples, either:
+ *  - in cascade, the output of a section being the input of the next one.
+ *    The channels are processed in SIMD lanes.
+ *  - in parallel (a bank), the output being the sum of the outputs of the
+ *    sections, each with its own gain, and of the input with a direct gain.
+ *    The sections are processed in SIMD lanes.
+ *
+ * The coefficients of a section are { b0, b1, b2, a1, a2 }, normalized by a0.
+ * Changes of coefficients and gains are applied by BiquadsCommit(), either at
+ * once or linearly over a number of frames, to avoid zipper noise. */
+
+/* Frames between updates of the coefficients while they are ramped */
+#define BIQUADS_RAMP_STEP 32
+
+typedef struct biquads biquads_t;
+
+/**
+ * Creates sections for channels, in cascade or in parallel. All the
+ * coefficients and gains are initially zero.
+ */
+biquads_t *BiquadsNew(unsigned sections, unsigned channels, bool parallel);
+void BiquadsDelete(biquads_t *bq);
+
+/** Sets the coefficients of a section */
+void BiquadsSetSection(biquads_t *bq, unsigned section, const float *coeffs);
+
+/** Sets the gain of a section in parallel */
+void BiquadsSetGain(biquads_t *bq, unsigned section, float gain);
+
+/** Sets the gain of the input in the output of sections in parallel */
+void BiquadsSetDirect(biquads_t *bq, float gain);
+
+/**
+ * Applies the coefficients and gains set since the last call, over ramp
+ * frames, or at once if ramp is 0.
+ */
+void BiquadsCommit(biquads_t *bq, unsigned ramp);
+
+/**
+ * Filters frames of interleaved channels. The input and the output may be
+ * the same buffer.
+ */
+void BiquadsProcess(biquads_t *bq, const float *in, float *out, size_t frames);
+
+/** Clears the signal history */
+void BiquadsReset(biquads_t *bq);
+
+#endif
@@ -39,12 +39,16 @@
 #include <vlc_filter.h>
 #include <vlc_block.h>
 
+#include "../convolution.h"
+
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 static int  OpenFilter ( vlc_object_t * );
 static void CloseFilter( vlc_object_t * );
 static block_t *Convert( filter_t *, block_t * );
+static block_t *Drain( filter_t * );
+static void Flush( filter_t * );
 
 /*****************************************************************************
  * Module descriptor
@@ -72,6 +76,14 @@ static block_t *Convert( filter_t *, block_t * );
      "Dolby Surround encoded streams won't be decoded before being " \
      "processed by this filter. Enabling this setting is not recommended.")
 
+#define HEADPHONE_HRIR_TEXT N_("Impulse responses file")
+#define HEADPHONE_HRIR_LONGTEXT N_( \
+     "WAV file of head-related or room impulse responses, replacing the " \
+     "built-in model. It holds the left ear then right ear responses of " \
+     "each virtual speaker, in the order front left, front right, middle " \
+     "left, middle right, rear left, rear right, rear center, center and " \
+     "LFE. The speakers missing from the file use the built-in model.")
+
 vlc_module_begin ()
     set_description( N_("Headphone virtual spatialization effect") )
     set_shortname( N_("Headphone effect") )
@@ -85,6 +97,8 @@ vlc_module_begin ()
               HEADPHONE_COMPENSATE_LONGTEXT, true )
     add_bool( "headphone-dolby", false, HEADPHONE_DOLBY_TEXT,
               HEADPHONE_DOLBY_LONGTEXT, true )
+    add_loadfile( "headphone-hrir", NULL, HEADPHONE_HRIR_TEXT,
+                  HEADPHONE_HRIR_LONGTEXT, true )
 
     set_capability( "audio filter", 0 )
     set_callbacks( OpenFilter, CloseFilter )
@@ -109,6 +123,10 @@ struct filter_sys_t
     float * p_overflow_buffer;
     unsigned int i_nb_atomic_operations;
     struct atomic_operation_t * p_atomic_operations;
+    convolver_t * p_convolver; /* NULL without impulse responses */
+    unsigned int i_latency; /* frames of delay of the convolver */
+    size_t i_tail; /* frames output by the convolver after the input */
+    mtime_t i_next_pts; /* end of the last input buffer */
 };
 
 /*****************************************************************************
@@ -327,6 +345,100 @@ static int Init( vlc_object_t *p_this, struct filter_sys_t * p_data
     return 0;
 }
 
+/*****************************************************************************
+ * InitConvolver: load impulse responses, applied by a convolution
+ *****************************************************************************/
+static int InitConvolver( filter_t * p_filter, const char * psz_path )
+{
+    /* Order of the speakers, both in the file and in the input */
+    static const uint32_t pi_speakers[] = {
+        AOUT_CHAN_LEFT, AOUT_CHAN_RIGHT, AOUT_CHAN_MIDDLELEFT,
+        AOUT_CHAN_MIDDLERIGHT, AOUT_CHAN_REARLEFT, AOUT_CHAN_REARRIGHT,
+        AOUT_CHAN_REARCENTER, AOUT_CHAN_CENTER, AOUT_CHAN_LFE,
+    };
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const audio_format_t *fmt = &p_filter->fmt_in.audio;
+    impulse_responses_t irs;
+
+    if( ImpulseResponsesLoad( &irs, psz_path, fmt->i_rate ) != VLC_SUCCESS )
+    {
+        msg_Err( p_filter, "cannot load impulse responses from %s",
+                 psz_path );
+        return VLC_EGENERIC;
+    }
+
+    /* The responses of the model are impulses, at the delay of each ear */
+    size_t i_length = irs.length;
+    for( unsigned i = 0; i < p_sys->i_nb_atomic_operations; i++ )
+        i_length = __MAX( i_length,
+                          p_sys->p_atomic_operations[i].i_delay + 1 );
+
+    /* Longer blocks for longer responses, at the expense of the latency */
+    unsigned i_block = 128;
+    while( i_block < 4096 && i_length / i_block > 64 )
+        i_block *= 2;
+
+    float *p_model = malloc( i_length * sizeof( *p_model ) );
+    p_sys->p_convolver = ConvolverNew( aout_FormatNbChannels( fmt ), 2,
+                                       i_block, i_length );
+    if( unlikely( p_model == NULL || p_sys->p_convolver == NULL ) )
+    {
+        if( p_sys->p_convolver != NULL )
+            ConvolverDelete( p_sys->p_convolver );
+        p_sys->p_convolver = NULL;
+        free( p_model );
+        ImpulseResponsesClean( &irs );
+        return VLC_ENOMEM;
+    }
+
+    unsigned i_channel = 0;
+    for( unsigned i = 0; i < ARRAY_SIZE( pi_speakers ); i++ )
+    {
+        if( !( fmt->i_physical_channels & pi_speakers[i] ) )
+            continue;
+
+        for( unsigned i_ear = 0; i_ear < 2; i_ear++ )
+        {
+            const unsigned i_ir = 2 * i + i_ear;
+
+            if( i_ir < irs.count )
+            {
+                ConvolverSetResponse( p_sys->p_convolver, i_channel, i_ear,
+                                      &irs.samples[i_ir * irs.length],
+                                      irs.length );
+                continue;
+            }
+
+            memset( p_model, 0, i_length * sizeof( *p_model ) );
+            for( unsigned j = 0; j < p_sys->i_nb_atomic_operations; j++ )
+            {
+                const struct atomic_operation_t *op =
+                    &p_sys->p_atomic_operations[j];
+
+                if( op->i_source_channel_offset == (int)i_channel
+                 && op->i_dest_channel_offset == (int)i_ear )
+                    p_model[op->i_delay] += op->d_amplitude_factor;
+            }
+            ConvolverSetResponse( p_sys->p_convolver, i_channel, i_ear,
+                                  p_model, i_length );
+        }
+        i_channel++;
+    }
+
+    /* The output is delayed by a block, then the responses ring on */
+    p_sys->i_latency = i_block;
+    p_sys->i_tail = i_block + i_length - 1;
+    p_sys->i_next_pts = VLC_TS_INVALID;
+    p_filter->pf_audio_drain = Drain;
+
+    msg_Dbg( p_filter, "%u impulse responses of %zu frames, "
+             "convolved in blocks of %u frames", irs.count, irs.length,
+             i_block );
+    free( p_model );
+    ImpulseResponsesClean( &irs );
+    return VLC_SUCCESS;
+}
+
 /*****************************************************************************
  * DoWork: convert a buffer
  *****************************************************************************/
@@ -458,10 +570,20 @@ static int OpenFilter( vlc_object_t *p_this )
     p_sys->p_overflow_buffer = NULL;
     p_sys->i_nb_atomic_operations = 0;
     p_sys->p_atomic_operations = NULL;
+    p_sys->p_convolver = NULL;
+
+    /* Dolby Surround is decoded to 5.0 beforehand */
+    uint32_t i_physical_channels = p_filter->fmt_in.audio.i_physical_channels;
+    if( i_physical_channels == AOUT_CHANS_STEREO
+     && (p_filter->fmt_out.audio.i_chan_mode & AOUT_CHANMODE_DOLBYSTEREO)
+     && !var_InheritBool( p_filter, "headphone-dolby" ) )
+    {
+        i_physical_channels = AOUT_CHANS_5_0;
+    }
 
     if( Init( VLC_OBJECT(p_filter), p_sys
-                , aout_FormatNbChannels ( &(p_filter->fmt_in.audio) )
-                , p_filter->fmt_in.audio.i_physical_channels
+                , popcount( i_physical_channels )
+                , i_physical_channels
                 , p_filter->fmt_in.audio.i_rate ) < 0 )
     {
         free( p_sys );
@@ -474,17 +596,21 @@ static int OpenFilter( vlc_object_t *p_this )
     p_filter->fmt_out.audio.i_rate = p_filter->fmt_in.audio.i_rate;
     p_filter->fmt_in.audio.i_chan_mode =
                                    p_filter->fmt_out.audio.i_chan_mode;
-    if( p_filter->fmt_in.audio.i_physical_channels == AOUT_CHANS_STEREO
-     && (p_filter->fmt_in.audio.i_chan_mode & AOUT_CHANMODE_DOLBYSTEREO)
-     && !var_InheritBool( p_filter, "headphone-dolby" ) )
-    {
-        p_filter->fmt_in.audio.i_physical_channels = AOUT_CHANS_5_0;
-    }
+    p_filter->fmt_in.audio.i_physical_channels = i_physical_channels;
     p_filter->pf_audio_filter = Convert;
+    p_filter->pf_flush = Flush;
 
     aout_FormatPrepare(&p_filter->fmt_in.audio);
     aout_FormatPrepare(&p_filter->fmt_out.audio);
 
+    char *psz_hrir = var_InheritString( p_filter, "headphone-hrir" );
+    if( psz_hrir != NULL )
+    {
+        if( InitConvolver( p_filter, psz_hrir ) != VLC_SUCCESS )
+            msg_Warn( p_filter, "using the built-in model" );
+        free( psz_hrir );
+    }
+
     return VLC_SUCCESS;
 }
 
@@ -495,11 +621,25 @@ static void CloseFilter( vlc_object_t *p_this )
 {
     filter_t *p_filter = (filter_t *)p_this;
 
+    if( p_filter->p_sys->p_convolver != NULL )
+        ConvolverDelete( p_filter->p_sys->p_convolver );
     free( p_filter->p_sys->p_overflow_buffer );
     free( p_filter->p_sys->p_atomic_operations );
     free( p_filter->p_sys );
 }
 
+static void Flush( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->p_convolver != NULL )
+    {
+        ConvolverReset( p_sys->p_convolver );
+        p_sys->i_next_pts = VLC_TS_INVALID;
+    }
+    memset( p_sys->p_overflow_buffer, 0, p_sys->i_overflow_buffer_size );
+}
+
 static block_t *Convert( filter_t *p_filter, block_t *p_block )
 {
     if( !p_block || !p_block->i_nb_samples )
@@ -526,8 +666,63 @@ static block_t *Convert( filter_t *p_filter, block_t *p_block )
     p_out->i_pts = p_block->i_pts;
     p_out->i_length = p_block->i_length;
 
-    DoWork( p_filter, p_block, p_out );
+    filter_sys_t *p_sys = p_filter->p_sys;
+    if( p_sys->p_convolver != NULL )
+    {
+        ConvolverProcess( p_sys->p_convolver,
+                          (const float *)p_block->p_buffer,
+                          (float *)p_out->p_buffer, p_block->i_nb_samples );
+
+        /* The output is the input of the convolver latency earlier */
+        const mtime_t i_latency = CLOCK_FREQ * p_sys->i_latency
+                                / p_filter->fmt_in.audio.i_rate;
+        if( p_block->i_pts > VLC_TS_INVALID )
+        {
+            p_sys->i_next_pts = p_block->i_pts + p_block->i_length;
+            p_out->i_pts = p_block->i_pts - i_latency;
+        }
+        if( p_block->i_dts > VLC_TS_INVALID )
+            p_out->i_dts = p_block->i_dts - i_latency;
+    }
+    else
+        DoWork( p_filter, p_block, p_out );
 
     block_Release( p_block );
     return p_out;
 }
+
+/* Outputs what remains in the convolver: the delayed input, then the end of
+ * the responses */
+static block_t *Drain( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->i_next_pts == VLC_TS_INVALID )
+        return NULL;
+
+    const unsigned i_rate = p_filter->fmt_in.audio.i_rate;
+    const size_t i_in_size = p_sys->i_tail
+        * aout_FormatNbChannels( &p_filter->fmt_in.audio ) * sizeof (float);
+    float *p_zeros = calloc( 1, i_in_size );
+    block_t *p_out = block_Alloc( p_sys->i_tail * 2 * sizeof (float) );
+    if( unlikely( p_zeros == NULL || p_out == NULL ) )
+    {
+        free( p_zeros );
+        if( p_out != NULL )
+            block_Release( p_out );
+        return NULL;
+    }
+
+    ConvolverProcess( p_sys->p_convolver, p_zeros,
+                      (float *)p_out->p_buffer, p_sys->i_tail );
+    free( p_zeros );
+
+    p_out->i_nb_samples = p_sys->i_tail;
+    p_out->i_dts = p_out->i_pts = p_sys->i_next_pts
+                                - CLOCK_FREQ * p_sys->i_latency / i_rate;
+    p_out->i_length = CLOCK_FREQ * p_sys->i_tail / i_rate;
+
+    ConvolverReset( p_sys->p_convolver );
+    p_sys->i_next_pts = VLC_TS_INVALID;
+    return p_out;
+}
@@ -0,0 +1,645 @@
+/*****************************************************************************
+ * convolution.c: partitioned convolution of audio signals
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include <vlc_fs.h>
+
+#include "convolution.h"
+#include "resampler/polyphase.h"
+
+/* Longest response loaded from a file, in seconds */
+#define IR_MAX_DURATION 10
+
+/*****************************************************************************
+ * Complex multiply-accumulate of spectra, stored as size real parts followed
+ * by size imaginary parts, size being a multiple of 8
+ *****************************************************************************/
+typedef void (*cmac_t)(float *restrict, const float *restrict,
+                       const float *restrict, unsigned);
+
+static void cmac_c(float *restrict acc, const float *restrict x,
+                   const float *restrict h, unsigned size)
+{
+    float *restrict ar = acc, *restrict ai = acc + size;
+    const float *xr = x, *xi = x + size, *hr = h, *hi = h + size;
+
+    for (unsigned k = 0; k < size; k++)
+    {
+        ar[k] += xr[k] * hr[k] - xi[k] * hi[k];
+        ai[k] += xr[k] * hi[k] + xi[k] * hr[k];
+    }
+}
+
+#ifdef CAN_COMPILE_SSE
+VLC_SSE
+static void cmac_sse(float *restrict acc, const float *restrict x,
+                     const float *restrict h, unsigned size)
+{
+    for (unsigned k = 0; k < size; k += 4)
+    {
+        const __m128 xr = _mm_load_ps(&x[k]), xi = _mm_load_ps(&x[size + k]);
+        const __m128 hr = _mm_load_ps(&h[k]), hi = _mm_load_ps(&h[size + k]);
+        __m128 ar = _mm_load_ps(&acc[k]), ai = _mm_load_ps(&acc[size + k]);
+
+        ar = _mm_add_ps(ar, _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi)));
+        ai = _mm_add_ps(ai, _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr)));
+        _mm_store_ps(&acc[k], ar);
+        _mm_store_ps(&acc[size + k], ai);
+    }
+}
+#endif
+
+#ifdef CAN_COMPILE_AVX2
+VLC_AVX2
+static void cmac_avx2(float *restrict acc, const float *restrict x,
+                      const float *restrict h, unsigned size)
+{
+    for (unsigned k = 0; k < size; k += 8)
+    {
+        const __m256 xr = _mm256_load_ps(&x[k]);
+        const __m256 xi = _mm256_load_ps(&x[size + k]);
+        const __m256 hr = _mm256_load_ps(&h[k]);
+        const __m256 hi = _mm256_load_ps(&h[size + k]);
+        __m256 ar = _mm256_load_ps(&acc[k]);
+        __m256 ai = _mm256_load_ps(&acc[size + k]);
+
+        ar = _mm256_add_ps(ar, _mm256_sub_ps(_mm256_mul_ps(xr, hr),
+                                             _mm256_mul_ps(xi, hi)));
+        ai = _mm256_add_ps(ai, _mm256_add_ps(_mm256_mul_ps(xr, hi),
+                                             _mm256_mul_ps(xi, hr)));
+        _mm256_store_ps(&acc[k], ar);
+        _mm256_store_ps(&acc[size + k], ai);
+    }
+}
+#endif
+
+#ifdef __ARM_NEON
+static void cmac_neon(float *restrict acc, const float *restrict x,
+                      const float *restrict h, unsigned size)
+{
+    for (unsigned k = 0; k < size; k += 4)
+    {
+        const float32x4_t xr = vld1q_f32(&x[k]), xi = vld1q_f32(&x[size + k]);
+        const float32x4_t hr = vld1q_f32(&h[k]), hi = vld1q_f32(&h[size + k]);
+        float32x4_t ar = vld1q_f32(&acc[k]), ai = vld1q_f32(&acc[size + k]);
+
+        ar = vmlsq_f32(vmlaq_f32(ar, xr, hr), xi, hi);
+        ai = vmlaq_f32(vmlaq_f32(ai, xr, hi), xi, hr);
+        vst1q_f32(&acc[k], ar);
+        vst1q_f32(&acc[size + k], ai);
+    }
+}
+#endif
+
+/*****************************************************************************
+ * Convolver
+ *****************************************************************************/
+struct convolver
+{
+    unsigned inputs;
+    unsigned outputs;
+    unsigned block; /**< Frames per block, also the size of the complex FFT */
+    unsigned size; /**< Floats per part of a spectrum (block + 1 bins) */
+    unsigned parts; /**< Partitions of the longest response */
+    unsigned pos; /**< Frames of the current block */
+    unsigned head; /**< Newest spectrum of the delay lines */
+    cmac_t cmac;
+
+    unsigned *bitrev;
+    float *twiddles; /**< Of the complex FFT stages, real then imaginary */
+    float *split; /**< Cosines then sines, of the real FFT */
+    float *work; /**< Complex FFT */
+    float *time; /**< Output of the inverse FFT */
+    float *acc; /**< Output spectrum */
+
+    float *in; /**< Per input, the previous and the current blocks */
+    float *out; /**< Per output, the block being output */
+    float *fdl; /**< Per input, the spectra of the last blocks */
+    float *responses; /**< Per input and output, the partition spectra */
+    unsigned *lengths; /**< Per input and output, the used partitions */
+};
+
+/* In-place complex FFT of n points of bit-reversed order */
+static void FFT(const convolver_t *conv, float *re, float *im)
+{
+    const unsigned n = conv->block;
+    const float *wr = conv->twiddles, *wi = conv->twiddles + n;
+
+    for (unsigned h = 1; h < n; wr += h, wi += h, h *= 2)
+        for (unsigned base = 0; base < n; base += 2 * h)
+        {
+            float *restrict ar = &re[base], *restrict ai = &im[base];
+            float *restrict br = ar + h, *restrict bi = ai + h;
+
+            for (unsigned j = 0; j < h; j++)
+            {
+                const float xr = br[j] * wr[j] - bi[j] * wi[j];
+                const float xi = br[j] * wi[j] + bi[j] * wr[j];
+
+                br[j] = ar[j] - xr;
+                bi[j] = ai[j] - xi;
+                ar[j] += xr;
+                ai[j] += xi;
+            }
+        }
+}
+
+/* Spectrum of 2 blocks of real samples, as the FFT of the even and odd
+ * samples as the real and imaginary parts of a block of complex samples */
+static void RealFFT(const convolver_t *conv, const float *x, float *spectrum)
+{
+    const unsigned n = conv->block;
+    const float *c = conv->split, *s = conv->split + n + 1;
+    float *zr = conv->work, *zi = conv->work + n;
+    float *xr = spectrum, *xi = spectrum + conv->size;
+
+    for (unsigned k = 0; k < n; k++)
+    {
+        zr[conv->bitrev[k]] = x[2 * k];
+        zi[conv->bitrev[k]] = x[2 * k + 1];
+    }
+    FFT(conv, zr, zi);
+
+    for (unsigned k = 0; k <= n; k++)
+    {
+        const unsigned a = k & (n - 1), b = (n - k) & (n - 1);
+        const float er = .5f * (zr[a] + zr[b]), ei = .5f * (zi[a] - zi[b]);
+        const float ur = .5f * (zi[a] + zi[b]), ui = .5f * (zr[b] - zr[a]);
+
+        xr[k] = er + c[k] * ur + s[k] * ui;
+        xi[k] = ei + c[k] * ui - s[k] * ur;
+    }
+}
+
+/* Inverse of RealFFT(), scaled by the block size */
+static void RealIFFT(const convolver_t *conv, const float *spectrum, float *x)
+{
+    const unsigned n = conv->block;
+    const float *c = conv->split, *s = conv->split + n + 1;
+    const float *xr = spectrum, *xi = spectrum + conv->size;
+    float *zr = conv->work, *zi = conv->work + n;
+
+    for (unsigned k = 0; k < n; k++)
+    {
+        const float er = .5f * (xr[k] + xr[n - k]);
+        const float ei = .5f * (xi[k] - xi[n - k]);
+        const float dr = .5f * (xr[k] - xr[n - k]);
+        const float di = .5f * (xi[k] + xi[n - k]);
+        const float ur = dr * c[k] - di * s[k], ui = dr * s[k] + di * c[k];
+
+        zr[conv->bitrev[k]] = er - ui;
+        zi[conv->bitrev[k]] = ei + ur;
+    }
+    FFT(conv, zi, zr); /* inverse, with the real and imaginary parts swapped */
+
+    for (unsigned k = 0; k < n; k++)
+    {
+        x[2 * k] = zr[k];
+        x[2 * k + 1] = zi[k];
+    }
+}
+
+static float *AllocFloats(size_t count)
+{
+    count = (count + 7) & ~(size_t)7;
+
+    float *p = aligned_alloc(32, count * sizeof (float));
+    if (likely(p != NULL))
+        memset(p, 0, count * sizeof (float));
+    return p;
+}
+
+convolver_t *ConvolverNew(unsigned inputs, unsigned outputs, unsigned block,
+                          size_t max_length)
+{
+    assert(block >= 8 && (block & (block - 1)) == 0);
+    assert(inputs > 0 && outputs > 0);
+
+    const size_t parts = __MAX((max_length + block - 1) / block, 1);
+    const size_t spectrum = 2 * (block + 8);
+    if (parts > UINT_MAX / (inputs * outputs)
+     || parts > SIZE_MAX / sizeof (float) / spectrum / (inputs * outputs))
+        return NULL;
+
+    convolver_t *conv = malloc(sizeof (*conv));
+    if (unlikely(conv == NULL))
+        return NULL;
+
+    conv->inputs = inputs;
+    conv->outputs = outputs;
+    conv->block = block;
+    conv->size = block + 8;
+    conv->parts = parts;
+
+    conv->bitrev = malloc(block * sizeof (*conv->bitrev));
+    conv->lengths = calloc(inputs * outputs, sizeof (*conv->lengths));
+    conv->twiddles = AllocFloats(2 * block);
+    conv->split = AllocFloats(2 * (block + 1));
+    conv->work = AllocFloats(2 * block);
+    conv->time = AllocFloats(2 * block);
+    conv->acc = AllocFloats(spectrum);
+    conv->in = AllocFloats((size_t)inputs * 2 * block);
+    conv->out = AllocFloats((size_t)outputs * block);
+    conv->fdl = AllocFloats(inputs * parts * spectrum);
+    conv->responses = AllocFloats(inputs * outputs * parts * spectrum);
+    if (unlikely(conv->bitrev == NULL || conv->lengths == NULL
+     || conv->twiddles == NULL || conv->split == NULL || conv->work == NULL
+     || conv->time == NULL
+     || conv->acc == NULL || conv->in == NULL || conv->out == NULL
+     || conv->fdl == NULL || conv->responses == NULL))
+    {
+        ConvolverDelete(conv);
+        return NULL;
+    }
+
+    unsigned bits = 0;
+    while ((1u << bits) < block)
+        bits++;
+    for (unsigned k = 0; k < block; k++)
+    {
+        unsigned r = 0;
+        for (unsigned b = 0; b < bits; b++)
+            r |= ((k >> b) & 1) << (bits - 1 - b);
+        conv->bitrev[k] = r;
+    }
+
+    /* Stage h of the FFT uses exp(-i pi j / h) for j < h */
+    float *wr = conv->twiddles, *wi = conv->twiddles + block;
+    for (unsigned h = 1; h < block; wr += h, wi += h, h *= 2)
+        for (unsigned j = 0; j < h; j++)
+        {
+            wr[j] = cos(M_PI * j / h);
+            wi[j] = -sin(M_PI * j / h);
+        }
+    for (unsigned k = 0; k <= block; k++)
+    {
+        conv->split[k] = cos(M_PI * k / block);
+        conv->split[block + 1 + k] = sin(M_PI * k / block);
+    }
+
+    conv->cmac = cmac_c;
+#if defined(CAN_COMPILE_SSE)
+    if (vlc_CPU_SSE())
+        conv->cmac = cmac_sse;
+#endif
+#if defined(CAN_COMPILE_AVX2)
+    if (vlc_CPU_AVX2())
+        conv->cmac = cmac_avx2;
+#endif
+#ifdef __ARM_NEON
+    conv->cmac = cmac_neon;
+#endif
+
+    ConvolverReset(conv);
+    return conv;
+}
+
+void ConvolverDelete(convolver_t *conv)
+{
+    free(conv->bitrev);
+    free(conv->lengths);
+    aligned_free(conv->twiddles);
+    aligned_free(conv->split);
+    aligned_free(conv->work);
+    aligned_free(conv->time);
+    aligned_free(conv->acc);
+    aligned_free(conv->in);
+    aligned_free(conv->out);
+    aligned_free(conv->fdl);
+    aligned_free(conv->responses);
+    free(conv);
+}
+
+int ConvolverSetResponse(convolver_t *conv, unsigned input, unsigned output,
+                         const float *response, size_t length)
+{
+    const unsigned block = conv->block;
+    const size_t spectrum = 2 * conv->size;
+    const unsigned pair = input * conv->outputs + output;
+    float *h = &conv->responses[pair * conv->parts * spectrum];
+
+    assert(input < conv->inputs && output < conv->outputs);
+
+    length = __MIN(length, (size_t)conv->parts * block);
+    conv->lengths[pair] = (length + block - 1) / block;
+
+    float *x = AllocFloats(2 * block);
+    if (unlikely(x == NULL))
+        return VLC_ENOMEM;
+
+    /* Zero-padded partitions, including the scale of the inverse FFT */
+    for (unsigned p = 0; p < conv->lengths[pair]; p++, h += spectrum)
+    {
+        const size_t n = __MIN(length - p * block, (size_t)block);
+
+        memcpy(x, &response[p * block], n * sizeof (float));
+        memset(&x[n], 0, (2 * block - n) * sizeof (float));
+        RealFFT(conv, x, h);
+        for (size_t k = 0; k < spectrum; k++)
+            h[k] /= block;
+    }
+    aligned_free(x);
+    return VLC_SUCCESS;
+}
+
+void ConvolverReset(convolver_t *conv)
+{
+    const size_t spectrum = 2 * conv->size;
+
+    memset(conv->in, 0, conv->inputs * 2 * conv->block * sizeof (float));
+    memset(conv->out, 0, conv->outputs * conv->block * sizeof (float));
+    memset(conv->fdl, 0, conv->inputs * conv->parts * spectrum
+                         * sizeof (float));
+    conv->pos = 0;
+    conv->head = 0;
+}
+
+static void ProcessBlock(convolver_t *conv)
+{
+    const unsigned block = conv->block, parts = conv->parts;
+    const size_t spectrum = 2 * conv->size;
+
+    /* Input spectra, in delay lines from the newest */
+    conv->head = (conv->head == 0 ? parts : conv->head) - 1;
+    for (unsigned c = 0; c < conv->inputs; c++)
+    {
+        float *in = &conv->in[c * 2 * block];
+
+        RealFFT(conv, in, &conv->fdl[(c * parts + conv->head) * spectrum]);
+        memcpy(in, in + block, block * sizeof (float));
+    }
+
+    for (unsigned o = 0; o < conv->outputs; o++)
+    {
+        memset(conv->acc, 0, spectrum * sizeof (float));
+
+        for (unsigned c = 0; c < conv->inputs; c++)
+        {
+            const unsigned pair = c * conv->outputs + o;
+            const float *h = &conv->responses[pair * parts * spectrum];
+            const float *fdl = &conv->fdl[c * parts * spectrum];
+            unsigned idx = conv->head;
+
+            for (unsigned p = 0; p < conv->lengths[pair]; p++)
+            {
+                conv->cmac(conv->acc, &fdl[idx * spectrum], &h[p * spectrum],
+                           conv->size);
+                if (++idx == parts)
+                    idx = 0;
+            }
+        }
+
+        /* Overlap-save: only the second half is a linear convolution */
+        RealIFFT(conv, conv->acc, conv->time);
+        memcpy(&conv->out[o * block], conv->time + block,
+               block * sizeof (float));
+    }
+}
+
+void ConvolverProcess(convolver_t *conv, const float *in, float *out,
+                      size_t frames)
+{
+    const unsigned block = conv->block;
+    const unsigned inputs = conv->inputs, outputs = conv->outputs;
+
+    while (frames > 0)
+    {
+        const size_t n = __MIN(frames, (size_t)(block - conv->pos));
+
+        for (unsigned c = 0; c < inputs; c++)
+        {
+            float *buf = &conv->in[(2 * c + 1) * block + conv->pos];
+            for (size_t i = 0; i < n; i++)
+                buf[i] = in[i * inputs + c];
+        }
+        for (unsigned o = 0; o < outputs; o++)
+        {
+            const float *buf = &conv->out[o * block + conv->pos];
+            for (size_t i = 0; i < n; i++)
+                out[i * outputs + o] = buf[i];
+        }
+
+        in += n * inputs;
+        out += n * outputs;
+        frames -= n;
+        conv->pos += n;
+        if (conv->pos == block)
+        {
+            ProcessBlock(conv);
+            conv->pos = 0;
+        }
+    }
+}
+
+/*****************************************************************************
+ * Impulse responses
+ *****************************************************************************/
+static float *Resample(const float *in, unsigned count, size_t length,
+                       unsigned in_rate, unsigned out_rate,
+                       size_t *restrict out_length)
+{
+    const unsigned gcd = GCD(in_rate, out_rate);
+    const unsigned phases = out_rate / gcd;
+    const bool interp = phases > PP_MAX_PHASES;
+    const double cutoff = pp_cutoff(in_rate, out_rate);
+    pp_bank_t bank;
+
+    if (pp_bank_init(&bank, interp ? PP_INTERP_PHASES : phases,
+                     pp_taps(cutoff), cutoff, interp))
+        return NULL;
+
+    const uint64_t step = interp ? ((uint64_t)in_rate << 32) / out_rate
+                                 : in_rate / gcd;
+    const unsigned taps = bank.taps;
+    const size_t avail = length + taps;
+    const size_t max = ((uint64_t)length * out_rate + in_rate - 1) / in_rate;
+    float *plane = calloc(avail, sizeof (float));
+    float *out = calloc(count * max, sizeof (float));
+
+    if (unlikely(plane == NULL || out == NULL))
+    {
+        free(out);
+        out = NULL;
+        goto end;
+    }
+
+    /* Sampled more densely, the response shall be lower for the same gain */
+    const float gain = (float)in_rate / out_rate;
+    for (unsigned r = 0; r < count; r++)
+    {
+        const float *planes[] = { plane };
+        pp_pos_t pos = { 0, 0 };
+        float *dst = &out[r * max];
+
+        memcpy(&plane[taps / 2 - 1], &in[r * length], length * sizeof (float));
+
+        const size_t n = pp_resample(&bank, pp_dot_c, &pos, step, planes, 1,
+                                     avail, dst, max);
+        for (size_t i = 0; i < n; i++)
+            dst[i] *= gain;
+    }
+    *out_length = max;
+end:
+    free(plane);
+    pp_bank_clean(&bank);
+    return out;
+}
+
+static float DecodeSample(const uint8_t *p, unsigned format, unsigned bits)
+{
+    switch (bits)
+    {
+        case 16:
+            return (int16_t)GetWLE(p) / 32768.f;
+        case 24:
+            return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16
+                             | (uint32_t)p[2] << 24) / 2147483648.f;
+        default:
+            if (format == 3 /* IEEE float */)
+            {
+                const uint32_t u = GetDWLE(p);
+                float f;
+
+                memcpy(&f, &u, sizeof (f));
+                return f;
+            }
+            return (int32_t)GetDWLE(p) / 2147483648.f;
+    }
+}
+
+int ImpulseResponsesLoad(impulse_responses_t *irs, const char *path,
+                         unsigned rate)
+{
+    unsigned format = 0, channels = 0, file_rate = 0, bits = 0;
+    uint32_t data_size;
+    uint8_t *data = NULL;
+    float *planar = NULL;
+    uint8_t hdr[12];
+
+    irs->count = 0;
+    irs->length = 0;
+    irs->samples = NULL;
+
+    FILE *file = vlc_fopen(path, "rb");
+    if (file == NULL)
+        return VLC_EGENERIC;
+
+    if (fread(hdr, 1, sizeof (hdr), file) != sizeof (hdr)
+     || memcmp(hdr, "RIFF", 4) || memcmp(&hdr[8], "WAVE", 4))
+        goto error;
+
+    /* Chunks up to the samples */
+    for (;;)
+    {
+        uint8_t chunk[8];
+
+        if (fread(chunk, 1, sizeof (chunk), file) != sizeof (chunk))
+            goto error;
+
+        uint32_t size = GetDWLE(&chunk[4]);
+        if (!memcmp(chunk, "data", 4))
+        {
+            data_size = size;
+            break;
+        }
+
+        size += size & 1;
+        if (!memcmp(chunk, "fmt ", 4))
+        {
+            uint8_t fmt[40];
+            const uint32_t len = __MIN(size, sizeof (fmt));
+
+            if (size < 16 || fread(fmt, 1, len, file) != len)
+                goto error;
+            size -= len;
+
+            format = GetWLE(fmt);
+            channels = GetWLE(&fmt[2]);
+            file_rate = GetDWLE(&fmt[4]);
+            bits = GetWLE(&fmt[14]);
+            if (format == 0xFFFE /* extensible */ && len >= 26)
+                format = GetWLE(&fmt[24]);
+        }
+        if (size > 0 && fseek(file, size, SEEK_CUR))
+            goto error;
+    }
+
+    if (channels == 0 || file_rate == 0
+     || !((format == 1 && (bits == 16 || bits == 24 || bits == 32))
+       || (format == 3 && bits == 32)))
+        goto error;
+
+    const size_t frame_size = channels * (bits / 8);
+    size_t frames = __MIN(data_size / frame_size,
+                          (size_t)IR_MAX_DURATION * file_rate);
+
+    data = malloc(frames * frame_size);
+    planar = malloc(frames * channels * sizeof (float));
+    if (unlikely(data == NULL || planar == NULL))
+        goto error;
+    frames = fread(data, frame_size, frames, file);
+    if (frames == 0)
+        goto error;
+
+    for (size_t i = 0; i < frames; i++)
+        for (unsigned c = 0; c < channels; c++)
+            planar[c * frames + i] = DecodeSample(
+                &data[i * frame_size + c * (bits / 8)], format, bits);
+
+    if (file_rate != rate)
+    {
+        size_t length;
+        float *resampled = Resample(planar, channels, frames, file_rate, rate,
+                                    &length);
+        if (resampled == NULL)
+            goto error;
+        free(planar);
+        planar = resampled;
+        frames = length;
+    }
+
+    free(data);
+    fclose(file);
+    irs->count = channels;
+    irs->length = frames;
+    irs->samples = planar;
+    return VLC_SUCCESS;
+
+error:
+    free(planar);
+    free(data);
+    fclose(file);
+    return VLC_EGENERIC;
+}
+
+void ImpulseResponsesClean(impulse_responses_t *irs)
+{
+    free(irs->samples);
+}
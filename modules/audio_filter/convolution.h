@@ -0,0 +1,74 @@
+/*****************************************************************************
+ * convolution.h: partitioned convolution of audio signals
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_AUDIO_FILTER_CONVOLUTION_H_
+#define VLC_AUDIO_FILTER_CONVOLUTION_H_
+
+/* The convolver filters each of its inputs with an impulse response per
+ * output, and sums the results on the outputs. The responses are split in
+ * partitions of the block size, which are applied in the frequency domain
+ * (uniformly partitioned overlap-save), so that the cost per sample grows
+ * with the number of partitions rather than with the length of the
+ * responses. The output is delayed by one block. */
+
+typedef struct convolver convolver_t;
+
+/**
+ * Creates a convolver of inputs to outputs channels, with responses of up to
+ * max_length frames, processed in blocks of block frames (a power of 2).
+ * All responses are initially null.
+ */
+convolver_t *ConvolverNew(unsigned inputs, unsigned outputs, unsigned block,
+                          size_t max_length);
+void ConvolverDelete(convolver_t *conv);
+
+/**
+ * Sets the response from an input to an output. It is cut at the maximum
+ * length of the convolver.
+ */
+int ConvolverSetResponse(convolver_t *conv, unsigned input, unsigned output,
+                         const float *response, size_t length);
+
+/**
+ * Convolves frames of interleaved input channels into interleaved output
+ * channels. The input and output buffers shall not overlap.
+ */
+void ConvolverProcess(convolver_t *conv, const float *in, float *out,
+                      size_t frames);
+
+/** Clears the signal history */
+void ConvolverReset(convolver_t *conv);
+
+typedef struct
+{
+    unsigned count; /**< Number of responses */
+    size_t   length; /**< Frames per response */
+    float   *samples; /**< count planes of length frames */
+} impulse_responses_t;
+
+/**
+ * Loads impulse responses from the channels of a WAV file, resampled to the
+ * given rate.
+ */
+int ImpulseResponsesLoad(impulse_responses_t *irs, const char *path,
+                         unsigned rate);
+void ImpulseResponsesClean(impulse_responses_t *irs);
+
+#endif
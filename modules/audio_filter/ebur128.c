@@ -0,0 +1,537 @@
+/*****************************************************************************
+ * ebur128.c: loudness and true peak meter (EBU R128, ITU-R BS.1770)
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include <vlc_aout.h>
+
+#include "biquad.h"
+#include "ebur128.h"
+#include "resampler/polyphase.h"
+
+#define CHUNK        1024 /* frames measured at once */
+#define SUBBLOCKS    30   /* of 100 ms, in the short-term window */
+#define MOMENTARY    4    /* sub-blocks in the momentary window */
+#define GATE_ABS     (-70.)
+#define GATE_REL     (-10.)
+#define BINS_PER_LU  10
+#define BINS         (100 * BINS_PER_LU) /* from -70 to +30 LUFS */
+#define PEAK_TAPS    32   /* per phase */
+
+struct ebur128
+{
+    unsigned channels;
+    float weights[AOUT_CHAN_MAX];
+    biquads_t *kweight;
+    float *weighted; /**< K-weighted chunk */
+
+    /* Mean squares of the sub-blocks */
+    unsigned step; /**< Frames per sub-block */
+    unsigned step_frames; /**< Frames in the current sub-block */
+    double sums[AOUT_CHAN_MAX];
+    double subblocks[SUBBLOCKS]; /**< Weighted, oldest first from index */
+    unsigned index;
+    uint64_t count; /**< Sub-blocks since the start */
+
+    /* Gating blocks above the absolute gate */
+    uint64_t hist_count[BINS];
+    double hist_energy[BINS];
+    float momentary, short_term, integrated;
+
+    /* True peak */
+    pp_bank_t bank; /**< One phase per oversampled point */
+    size_t (*find_peaks)(const float *, unsigned, const float *, float *,
+                         size_t);
+    float *planes; /**< channels planes of PEAK_TAPS - 1 + CHUNK frames */
+    float *peaks; /**< Of the chunk, if the caller does not want them */
+    float peak;
+};
+
+/*****************************************************************************
+ * True peaks
+ *
+ * The window of the taps of frame i starts at plane[i], and is centered on
+ * the frame PEAK_TAPS / 2 before the last one. The peak of a frame is the
+ * highest absolute value of the sample itself (the first phase) and of the
+ * other phases, and is accumulated over the channels. The SIMD versions
+ * take the frames in the lanes, and return how many they processed.
+ *****************************************************************************/
+static size_t FindPeaksC(const float *coeffs, unsigned phases,
+                         const float *plane, float *peaks, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++)
+    {
+        const float *x = &plane[i];
+        float peak = fmaxf(peaks[i], fabsf(x[PEAK_TAPS / 2 - 1]));
+
+        for (unsigned p = 1; p < phases; p++)
+        {
+            const float *h = &coeffs[p * PEAK_TAPS];
+            float acc = 0.f;
+
+            for (unsigned k = 0; k < PEAK_TAPS; k++)
+                acc += h[k] * x[k];
+            peak = fmaxf(peak, fabsf(acc));
+        }
+        peaks[i] = peak;
+    }
+    return frames;
+}
+
+#ifdef CAN_COMPILE_SSE
+VLC_SSE
+static size_t FindPeaksSSE(const float *coeffs, unsigned phases,
+                           const float *plane, float *peaks, size_t frames)
+{
+    const __m128 sign = _mm_set1_ps(-0.f);
+    size_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+    {
+        const float *x = &plane[i];
+        __m128 peak = _mm_andnot_ps(sign,
+                                    _mm_loadu_ps(&x[PEAK_TAPS / 2 - 1]));
+
+        for (unsigned p = 1; p < phases; p++)
+        {
+            const float *h = &coeffs[p * PEAK_TAPS];
+            __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+            __m128 a2 = _mm_setzero_ps(), a3 = _mm_setzero_ps();
+
+            for (unsigned k = 0; k < PEAK_TAPS; k += 4)
+            {
+                a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_load1_ps(&h[k]),
+                                               _mm_loadu_ps(&x[k])));
+                a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_load1_ps(&h[k + 1]),
+                                               _mm_loadu_ps(&x[k + 1])));
+                a2 = _mm_add_ps(a2, _mm_mul_ps(_mm_load1_ps(&h[k + 2]),
+                                               _mm_loadu_ps(&x[k + 2])));
+                a3 = _mm_add_ps(a3, _mm_mul_ps(_mm_load1_ps(&h[k + 3]),
+                                               _mm_loadu_ps(&x[k + 3])));
+            }
+            a0 = _mm_add_ps(_mm_add_ps(a0, a1), _mm_add_ps(a2, a3));
+            peak = _mm_max_ps(peak, _mm_andnot_ps(sign, a0));
+        }
+        _mm_storeu_ps(&peaks[i], _mm_max_ps(peak, _mm_loadu_ps(&peaks[i])));
+    }
+    return i;
+}
+#endif
+
+#ifdef CAN_COMPILE_AVX2
+VLC_AVX2
+static size_t FindPeaksAVX2(const float *coeffs, unsigned phases,
+                            const float *plane, float *peaks, size_t frames)
+{
+    const __m256 sign = _mm256_set1_ps(-0.f);
+    size_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+    {
+        const float *x = &plane[i];
+        __m256 peak = _mm256_andnot_ps(sign,
+                                       _mm256_loadu_ps(&x[PEAK_TAPS / 2 - 1]));
+
+        for (unsigned p = 1; p < phases; p++)
+        {
+            const float *h = &coeffs[p * PEAK_TAPS];
+            __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+            __m256 a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+
+            for (unsigned k = 0; k < PEAK_TAPS; k += 4)
+            {
+                a0 = _mm256_add_ps(a0, _mm256_mul_ps(
+                    _mm256_broadcast_ss(&h[k]), _mm256_loadu_ps(&x[k])));
+                a1 = _mm256_add_ps(a1, _mm256_mul_ps(
+                    _mm256_broadcast_ss(&h[k + 1]),
+                    _mm256_loadu_ps(&x[k + 1])));
+                a2 = _mm256_add_ps(a2, _mm256_mul_ps(
+                    _mm256_broadcast_ss(&h[k + 2]),
+                    _mm256_loadu_ps(&x[k + 2])));
+                a3 = _mm256_add_ps(a3, _mm256_mul_ps(
+                    _mm256_broadcast_ss(&h[k + 3]),
+                    _mm256_loadu_ps(&x[k + 3])));
+            }
+            a0 = _mm256_add_ps(_mm256_add_ps(a0, a1), _mm256_add_ps(a2, a3));
+            peak = _mm256_max_ps(peak, _mm256_andnot_ps(sign, a0));
+        }
+        _mm256_storeu_ps(&peaks[i],
+                         _mm256_max_ps(peak, _mm256_loadu_ps(&peaks[i])));
+    }
+    return i;
+}
+#endif
+
+#ifdef __ARM_NEON
+static size_t FindPeaksNEON(const float *coeffs, unsigned phases,
+                            const float *plane, float *peaks, size_t frames)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+    {
+        const float *x = &plane[i];
+        float32x4_t peak = vabsq_f32(vld1q_f32(&x[PEAK_TAPS / 2 - 1]));
+
+        for (unsigned p = 1; p < phases; p++)
+        {
+            const float *h = &coeffs[p * PEAK_TAPS];
+            float32x4_t a0 = vdupq_n_f32(0.f), a1 = vdupq_n_f32(0.f);
+            float32x4_t a2 = vdupq_n_f32(0.f), a3 = vdupq_n_f32(0.f);
+
+            for (unsigned k = 0; k < PEAK_TAPS; k += 4)
+            {
+                a0 = vmlaq_n_f32(a0, vld1q_f32(&x[k]), h[k]);
+                a1 = vmlaq_n_f32(a1, vld1q_f32(&x[k + 1]), h[k + 1]);
+                a2 = vmlaq_n_f32(a2, vld1q_f32(&x[k + 2]), h[k + 2]);
+                a3 = vmlaq_n_f32(a3, vld1q_f32(&x[k + 3]), h[k + 3]);
+            }
+            a0 = vaddq_f32(vaddq_f32(a0, a1), vaddq_f32(a2, a3));
+            peak = vmaxq_f32(peak, vabsq_f32(a0));
+        }
+        vst1q_f32(&peaks[i], vmaxq_f32(peak, vld1q_f32(&peaks[i])));
+    }
+    return i;
+}
+#endif
+
+/*****************************************************************************
+ * Loudness
+ *****************************************************************************/
+static float Loudness(double energy)
+{
+    return energy > 0. ? -0.691 + 10. * log10(energy) : -INFINITY;
+}
+
+/* The pre-filter (a high shelf) and the RLB filter (a high-pass) of
+ * BS.1770, computed for the sample rate */
+static void KWeighting(biquads_t *bq, unsigned rate)
+{
+    double f0 = 1681.974450955533, q = .7071752369554196;
+    double k = tan(M_PI * f0 / rate);
+    const double vh = pow(10., 3.999843853973347 / 20.);
+    const double vb = pow(vh, .4996667741545416);
+    double a0 = 1. + k / q + k * k;
+    const float shelf[5] = {
+        (vh + vb * k / q + k * k) / a0,
+        2. * (k * k - vh) / a0,
+        (vh - vb * k / q + k * k) / a0,
+        2. * (k * k - 1.) / a0,
+        (1. - k / q + k * k) / a0,
+    };
+
+    f0 = 38.13547087602444;
+    q = .5003270373238773;
+    k = tan(M_PI * f0 / rate);
+    a0 = 1. + k / q + k * k;
+    const float highpass[5] = {
+        1.f, -2.f, 1.f,
+        2. * (k * k - 1.) / a0,
+        (1. - k / q + k * k) / a0,
+    };
+
+    BiquadsSetSection(bq, 0, shelf);
+    BiquadsSetSection(bq, 1, highpass);
+    BiquadsCommit(bq, 0);
+}
+
+static void Weights(float *weights, unsigned channels, uint16_t physical)
+{
+    for (unsigned c = 0; c < channels; c++)
+        weights[c] = 1.f;
+    if (popcount(physical) != channels)
+        return;
+
+    unsigned c = 0;
+    for (unsigned i = 0; pi_vlc_chan_order_wg4[i]; i++)
+    {
+        const uint32_t chan = pi_vlc_chan_order_wg4[i];
+
+        if (!(physical & chan))
+            continue;
+        if (chan == AOUT_CHAN_LFE)
+            weights[c] = 0.f;
+        else if (chan & (AOUT_CHANS_MIDDLE | AOUT_CHANS_REAR
+                       | AOUT_CHAN_REARCENTER))
+            weights[c] = 1.41f;
+        c++;
+    }
+}
+
+ebur128_t *EbuR128New(unsigned rate, unsigned channels, uint16_t physical)
+{
+    assert(rate > 0 && channels > 0 && channels <= AOUT_CHAN_MAX);
+
+    ebur128_t *meter = malloc(sizeof (*meter));
+    if (unlikely(meter == NULL))
+        return NULL;
+
+    meter->channels = channels;
+    Weights(meter->weights, channels, physical);
+    meter->step = (rate + 5) / 10;
+
+    const unsigned phases = rate < 96000 ? 4 : rate < 192000 ? 2 : 1;
+
+    meter->kweight = BiquadsNew(2, channels, false);
+    meter->weighted = malloc(CHUNK * channels * sizeof (float));
+    meter->planes = malloc((PEAK_TAPS - 1 + CHUNK) * channels
+                           * sizeof (float));
+    meter->peaks = malloc(CHUNK * sizeof (float));
+    if (unlikely(meter->kweight == NULL || meter->weighted == NULL
+              || meter->planes == NULL || meter->peaks == NULL
+              || pp_bank_init(&meter->bank, phases, PEAK_TAPS, PP_CUTOFF,
+                              false)))
+    {
+        if (meter->kweight != NULL)
+            BiquadsDelete(meter->kweight);
+        free(meter->peaks);
+        free(meter->planes);
+        free(meter->weighted);
+        free(meter);
+        return NULL;
+    }
+    KWeighting(meter->kweight, rate);
+
+    meter->find_peaks = FindPeaksC;
+#if defined(CAN_COMPILE_SSE)
+    if (vlc_CPU_SSE())
+        meter->find_peaks = FindPeaksSSE;
+#endif
+#if defined(CAN_COMPILE_AVX2)
+    if (vlc_CPU_AVX2())
+        meter->find_peaks = FindPeaksAVX2;
+#endif
+#ifdef __ARM_NEON
+    meter->find_peaks = FindPeaksNEON;
+#endif
+
+    EbuR128Reset(meter);
+    return meter;
+}
+
+void EbuR128Delete(ebur128_t *meter)
+{
+    pp_bank_clean(&meter->bank);
+    BiquadsDelete(meter->kweight);
+    free(meter->peaks);
+    free(meter->planes);
+    free(meter->weighted);
+    free(meter);
+}
+
+void EbuR128Reset(ebur128_t *meter)
+{
+    BiquadsReset(meter->kweight);
+    meter->step_frames = 0;
+    memset(meter->sums, 0, sizeof (meter->sums));
+    memset(meter->subblocks, 0, sizeof (meter->subblocks));
+    meter->index = 0;
+    meter->count = 0;
+    memset(meter->hist_count, 0, sizeof (meter->hist_count));
+    memset(meter->hist_energy, 0, sizeof (meter->hist_energy));
+    meter->momentary = meter->short_term = meter->integrated = -INFINITY;
+    for (unsigned c = 0; c < meter->channels; c++)
+        memset(&meter->planes[c * (PEAK_TAPS - 1 + CHUNK)], 0,
+               (PEAK_TAPS - 1) * sizeof (float));
+    meter->peak = 0.f;
+}
+
+static void Integrate(ebur128_t *meter)
+{
+    double energy = 0.;
+    uint64_t count = 0;
+
+    for (unsigned i = 0; i < BINS; i++)
+    {
+        energy += meter->hist_energy[i];
+        count += meter->hist_count[i];
+    }
+    if (count == 0)
+        return;
+
+    /* Only the blocks above the relative gate. The gate falls within a bin,
+     * which is kept whole, at most 0.1 LU below the gate. */
+    const double gate = Loudness(energy / count) + GATE_REL;
+    unsigned first = 0;
+    if (gate > GATE_ABS)
+        first = __MIN((unsigned)((gate - GATE_ABS) * BINS_PER_LU), BINS - 1);
+
+    energy = 0.;
+    count = 0;
+    for (unsigned i = first; i < BINS; i++)
+    {
+        energy += meter->hist_energy[i];
+        count += meter->hist_count[i];
+    }
+    meter->integrated = Loudness(energy / count);
+}
+
+/* Ends a sub-block of 100 ms, and updates the measurements */
+static void EndSubBlock(ebur128_t *meter)
+{
+    double energy = 0.;
+
+    for (unsigned c = 0; c < meter->channels; c++)
+    {
+        energy += meter->weights[c] * meter->sums[c];
+        meter->sums[c] = 0.;
+    }
+    meter->subblocks[meter->index] = energy / meter->step;
+    meter->index = (meter->index + 1) % SUBBLOCKS;
+    meter->count++;
+    meter->step_frames = 0;
+
+    double momentary = 0., short_term = 0.;
+    for (unsigned i = 0; i < SUBBLOCKS; i++)
+    {
+        const double e = meter->subblocks[(meter->index + i) % SUBBLOCKS];
+
+        short_term += e;
+        if (i >= SUBBLOCKS - MOMENTARY)
+            momentary += e;
+    }
+    momentary /= MOMENTARY;
+    meter->momentary = Loudness(momentary);
+    meter->short_term = Loudness(short_term / SUBBLOCKS);
+
+    /* The momentary windows overlap by 75%, as the gating blocks */
+    if (meter->count < MOMENTARY || !(meter->momentary > GATE_ABS))
+        return;
+
+    const unsigned bin = __MIN((unsigned)((meter->momentary - GATE_ABS)
+                                          * BINS_PER_LU), BINS - 1);
+    meter->hist_count[bin]++;
+    meter->hist_energy[bin] += momentary;
+    Integrate(meter);
+}
+
+static void MeasureLoudness(ebur128_t *meter, const float *in, size_t frames)
+{
+    const unsigned channels = meter->channels;
+    const float *weighted = meter->weighted;
+
+    BiquadsProcess(meter->kweight, in, meter->weighted, frames);
+
+    while (frames > 0)
+    {
+        const size_t count = __MIN(frames,
+                                   meter->step - meter->step_frames);
+        float sums[AOUT_CHAN_MAX] = { 0.f };
+
+        for (size_t i = 0; i < count; i++)
+        {
+            for (unsigned c = 0; c < channels; c++)
+                sums[c] += weighted[c] * weighted[c];
+            weighted += channels;
+        }
+        for (unsigned c = 0; c < channels; c++)
+            meter->sums[c] += sums[c];
+
+        meter->step_frames += count;
+        frames -= count;
+        if (meter->step_frames == meter->step)
+            EndSubBlock(meter);
+    }
+}
+
+static void MeasurePeaks(ebur128_t *meter, const float *in, float *peaks,
+                         size_t frames)
+{
+    const unsigned channels = meter->channels;
+    const size_t size = PEAK_TAPS - 1 + CHUNK;
+
+    if (peaks == NULL)
+        peaks = meter->peaks;
+    memset(peaks, 0, frames * sizeof (*peaks));
+
+    for (unsigned c = 0; c < channels; c++)
+    {
+        float *plane = &meter->planes[c * size];
+
+        /* Append the input to the history of the channel */
+        for (size_t i = 0; i < frames; i++)
+            plane[PEAK_TAPS - 1 + i] = in[i * channels + c];
+
+        const size_t done = meter->find_peaks(meter->bank.coeffs,
+                                              meter->bank.phases, plane,
+                                              peaks, frames);
+        FindPeaksC(meter->bank.coeffs, meter->bank.phases, plane + done,
+                   peaks + done, frames - done);
+
+        memmove(plane, plane + frames, (PEAK_TAPS - 1) * sizeof (float));
+    }
+
+    float max = meter->peak;
+    for (size_t i = 0; i < frames; i++)
+        max = fmaxf(max, peaks[i]);
+    meter->peak = max;
+}
+
+void EbuR128Process(ebur128_t *meter, const float *in, float *peaks,
+                    size_t frames)
+{
+    while (frames > 0)
+    {
+        const size_t count = __MIN(frames, CHUNK);
+
+        MeasureLoudness(meter, in, count);
+        MeasurePeaks(meter, in, peaks, count);
+
+        in += count * meter->channels;
+        if (peaks != NULL)
+            peaks += count;
+        frames -= count;
+    }
+}
+
+unsigned EbuR128PeakDelay(const ebur128_t *meter)
+{
+    (void) meter;
+    return PEAK_TAPS / 2;
+}
+
+float EbuR128Momentary(const ebur128_t *meter)
+{
+    return meter->momentary;
+}
+
+float EbuR128ShortTerm(const ebur128_t *meter)
+{
+    return meter->short_term;
+}
+
+float EbuR128Integrated(const ebur128_t *meter)
+{
+    return meter->integrated;
+}
+
+float EbuR128TruePeak(const ebur128_t *meter)
+{
+    return meter->peak > 0.f ? 20.f * log10f(meter->peak) : -INFINITY;
+}
@@ -0,0 +1,67 @@
+/*****************************************************************************
+ * ebur128.h: loudness and true peak meter (EBU R128, ITU-R BS.1770)
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_AUDIO_FILTER_EBUR128_H_
+#define VLC_AUDIO_FILTER_EBUR128_H_
+
+/* The channels are K-weighted by 2 biquad sections in cascade, and their
+ * mean squares are summed with the weights of their positions every 100 ms.
+ * The momentary and short-term loudness are the means over the last 400 ms
+ * and 3 s. The integrated loudness is the mean of the 400 ms blocks above
+ * the absolute (-70 LUFS) and relative (-10 LU) gates, from a histogram of
+ * the blocks in steps of 0.1 LU, so that it takes constant memory.
+ *
+ * The true peak is the highest sample of the signal oversampled 4 times
+ * (2 times from 96 kHz, not at all from 192 kHz) by a polyphase filter. */
+
+typedef struct ebur128 ebur128_t;
+
+/**
+ * Creates a meter for channels at rate. The positions of the channels, in
+ * the order of the VLC audio filters, come from the physical channels mask.
+ * If the mask does not match the number of channels, all are weighted 1.
+ */
+ebur128_t *EbuR128New(unsigned rate, unsigned channels, uint16_t physical);
+void EbuR128Delete(ebur128_t *meter);
+
+/**
+ * Measures frames of interleaved channels. If peaks is not NULL, it
+ * receives the true peak of each frame, as the highest of its channels,
+ * EbuR128PeakDelay() frames late (the first ones are null).
+ */
+void EbuR128Process(ebur128_t *meter, const float *in, float *peaks,
+                    size_t frames);
+
+/** Frames between a frame of the input and its true peak */
+unsigned EbuR128PeakDelay(const ebur128_t *meter);
+
+/** Loudness of the last 400 ms, in LUFS (-INFINITY for silence) */
+float EbuR128Momentary(const ebur128_t *meter);
+/** Loudness of the last 3 s, in LUFS */
+float EbuR128ShortTerm(const ebur128_t *meter);
+/** Gated loudness since the start, in LUFS */
+float EbuR128Integrated(const ebur128_t *meter);
+/** Highest true peak since the start, in dBTP */
+float EbuR128TruePeak(const ebur128_t *meter);
+
+/** Clears the measurements and the signal history */
+void EbuR128Reset(ebur128_t *meter);
+
+#endif
@@ -39,9 +39,9 @@
 #include <vlc_filter.h>
 
 #include "equalizer_presets.h"
+#include "biquad.h"
 
 /* TODO:
- *  - optimize a bit (you can hardly do slower ;)
  *  - add tables for more bands (15 and 32 would be cool), maybe with auto coeffs
  *    computation (not too hard once the Q is found).
  *  - support for external preset
@@ -105,22 +105,15 @@ struct filter_sys_t
 {
     /* Filter static config */
     int i_band;
-    float *f_alpha;
-    float *f_beta;
-    float *f_gamma;
+    unsigned i_ramp; /* Frames over which the gains change */
 
     /* Filter dyn config */
     float *f_amp;   /* Per band amp */
     float f_gamp;   /* Global preamp */
     bool b_2eqz;
 
-    /* Filter state */
-    float x[32][2];
-    float y[32][128][2];
-
-    /* Second filter state */
-    float x2[32][2];
-    float y2[32][128][2];
+    /* Band filters of the first and second passes */
+    biquads_t *p_bands[2];
 
     vlc_mutex_t lock;
 };
@@ -129,8 +122,9 @@ static block_t *DoWork( filter_t *, block_t * );
 
 #define EQZ_IN_FACTOR (0.25f)
 static int  EqzInit( filter_t *, int );
-static void EqzFilter( filter_t *, float *, float *, int, int );
+static void EqzFilter( filter_t *, float *, float *, int );
 static void EqzClean( filter_t * );
+static void EqzUpdate( filter_sys_t *, unsigned );
 
 static int PresetCallback ( vlc_object_t *, char const *, vlc_value_t,
                             vlc_value_t, void * );
@@ -192,8 +186,7 @@ static void Close( vlc_object_t *p_this )
 static block_t * DoWork( filter_t * p_filter, block_t * p_in_buf )
 {
     EqzFilter( p_filter, (float*)p_in_buf->p_buffer,
-               (float*)p_in_buf->p_buffer, p_in_buf->i_nb_samples,
-               aout_FormatNbChannels( &p_filter->fmt_in.audio ) );
+               (float*)p_in_buf->p_buffer, p_in_buf->i_nb_samples );
     return p_in_buf;
 }
 
@@ -281,27 +274,33 @@ static int EqzInit( filter_t *p_filter, int i_rate )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
     eqz_config_t cfg;
-    int i, ch;
+    int i;
     vlc_value_t val1, val2, val3;
     vlc_object_t *p_aout = p_filter->obj.parent;
     int i_ret = VLC_ENOMEM;
+    unsigned i_channels = aout_FormatNbChannels( &p_filter->fmt_in.audio );
 
     bool b_vlcFreqs = var_InheritBool( p_aout, "equalizer-vlcfreqs" );
     EqzCoeffs( i_rate, 1.0f, b_vlcFreqs, &cfg );
 
     /* Create the static filter config */
     p_sys->i_band = cfg.i_band;
-    p_sys->f_alpha = malloc( p_sys->i_band * sizeof(float) );
-    p_sys->f_beta  = malloc( p_sys->i_band * sizeof(float) );
-    p_sys->f_gamma = malloc( p_sys->i_band * sizeof(float) );
-    if( !p_sys->f_alpha || !p_sys->f_beta || !p_sys->f_gamma )
+    p_sys->i_ramp = i_rate / 50;
+    p_sys->f_amp  = NULL;
+    p_sys->p_bands[0] = BiquadsNew( p_sys->i_band, i_channels, true );
+    p_sys->p_bands[1] = BiquadsNew( p_sys->i_band, i_channels, true );
+    if( !p_sys->p_bands[0] || !p_sys->p_bands[1] )
         goto error;
 
     for( i = 0; i < p_sys->i_band; i++ )
     {
-        p_sys->f_alpha[i] = cfg.band[i].f_alpha;
-        p_sys->f_beta[i]  = cfg.band[i].f_beta;
-        p_sys->f_gamma[i] = cfg.band[i].f_gamma;
+        /* y[n] = alpha * (x[n] - x[n-2]) + gamma * y[n-1] - beta * y[n-2] */
+        const float coeffs[5] = {
+            cfg.band[i].f_alpha, 0.0f, -cfg.band[i].f_alpha,
+            -cfg.band[i].f_gamma, cfg.band[i].f_beta };
+
+        BiquadsSetSection( p_sys->p_bands[0], i, coeffs );
+        BiquadsSetSection( p_sys->p_bands[1], i, coeffs );
     }
 
     /* Filter dyn config */
@@ -316,23 +315,6 @@ static int EqzInit( filter_t *p_filter, int i_rate )
         p_sys->f_amp[i] = 0.0f;
     }
 
-    /* Filter state */
-    for( ch = 0; ch < 32; ch++ )
-    {
-        p_sys->x[ch][0]  =
-        p_sys->x[ch][1]  =
-        p_sys->x2[ch][0] =
-        p_sys->x2[ch][1] = 0.0f;
-
-        for( i = 0; i < p_sys->i_band; i++ )
-        {
-            p_sys->y[ch][i][0]  =
-            p_sys->y[ch][i][1]  =
-            p_sys->y2[ch][i][0] =
-            p_sys->y2[ch][i][1] = 0.0f;
-        }
-    }
-
     var_Create( p_aout, "equalizer-bands", VLC_VAR_STRING | VLC_VAR_DOINHERIT );
     var_Create( p_aout, "equalizer-preset", VLC_VAR_STRING | VLC_VAR_DOINHERIT );
 
@@ -357,12 +339,14 @@ static int EqzInit( filter_t *p_filter, int i_rate )
     {
         msg_Err(p_filter, "No preset selected");
         free( val2.psz_string );
-        free( p_sys->f_amp );
         i_ret = VLC_EGENERIC;
         goto error;
     }
     free( val2.psz_string );
 
+    /* Start with the initial gains rather than ramping to them */
+    EqzUpdate( p_sys, 0 );
+
     /* Add our own callbacks */
     var_AddCallback( p_aout, "equalizer-preset", PresetCallback, p_sys );
     var_AddCallback( p_aout, "equalizer-bands", BandsCallback, p_sys );
@@ -375,77 +359,52 @@ static int EqzInit( filter_t *p_filter, int i_rate )
     {
         msg_Dbg( p_filter, "   %.2f Hz -> factor:%f alpha:%f beta:%f gamma:%f",
                  cfg.band[i].f_frequency, p_sys->f_amp[i],
-                 p_sys->f_alpha[i], p_sys->f_beta[i], p_sys->f_gamma[i]);
+                 cfg.band[i].f_alpha, cfg.band[i].f_beta, cfg.band[i].f_gamma);
     }
     return VLC_SUCCESS;
 
 error:
-    free( p_sys->f_alpha );
-    free( p_sys->f_beta );
-    free( p_sys->f_gamma );
+    free( p_sys->f_amp );
+    if( p_sys->p_bands[0] )
+        BiquadsDelete( p_sys->p_bands[0] );
+    if( p_sys->p_bands[1] )
+        BiquadsDelete( p_sys->p_bands[1] );
     return i_ret;
 }
 
-static void EqzFilter( filter_t *p_filter, float *out, float *in,
-                       int i_samples, int i_channels )
+/* Each pass outputs EQZ_IN_FACTOR * x plus the bands weighted by f_amp, and
+ * the preamp is applied once per pass, to the last one */
+static void EqzUpdate( filter_sys_t *p_sys, unsigned i_ramp )
 {
-    filter_sys_t *p_sys = p_filter->p_sys;
-    int i, ch, j;
+    float f_gain[2];
 
-    vlc_mutex_lock( &p_sys->lock );
-    for( i = 0; i < i_samples; i++ )
+    if( p_sys->b_2eqz )
     {
-        for( ch = 0; ch < i_channels; ch++ )
-        {
-            const float x = in[ch];
-            float o = 0.0f;
-
-            for( j = 0; j < p_sys->i_band; j++ )
-            {
-                float y = p_sys->f_alpha[j] * ( x - p_sys->x[ch][1] ) +
-                          p_sys->f_gamma[j] * p_sys->y[ch][j][0] -
-                          p_sys->f_beta[j]  * p_sys->y[ch][j][1];
-
-                p_sys->y[ch][j][1] = p_sys->y[ch][j][0];
-                p_sys->y[ch][j][0] = y;
-
-                o += y * p_sys->f_amp[j];
-            }
-            p_sys->x[ch][1] = p_sys->x[ch][0];
-            p_sys->x[ch][0] = x;
-
-            /* Second filter */
-            if( p_sys->b_2eqz )
-            {
-                const float x2 = EQZ_IN_FACTOR * x + o;
-                o = 0.0f;
-                for( j = 0; j < p_sys->i_band; j++ )
-                {
-                    float y = p_sys->f_alpha[j] * ( x2 - p_sys->x2[ch][1] ) +
-                              p_sys->f_gamma[j] * p_sys->y2[ch][j][0] -
-                              p_sys->f_beta[j]  * p_sys->y2[ch][j][1];
-
-                    p_sys->y2[ch][j][1] = p_sys->y2[ch][j][0];
-                    p_sys->y2[ch][j][0] = y;
-
-                    o += y * p_sys->f_amp[j];
-                }
-                p_sys->x2[ch][1] = p_sys->x2[ch][0];
-                p_sys->x2[ch][0] = x2;
-
-                /* We add source PCM + filtered PCM */
-                out[ch] = p_sys->f_gamp * p_sys->f_gamp *( EQZ_IN_FACTOR * x2 + o );
-            }
-            else
-            {
-                /* We add source PCM + filtered PCM */
-                out[ch] = p_sys->f_gamp *( EQZ_IN_FACTOR * x + o );
-            }
-        }
+        f_gain[0] = 1.0f;
+        f_gain[1] = p_sys->f_gamp * p_sys->f_gamp;
+    }
+    else
+        f_gain[0] = f_gain[1] = p_sys->f_gamp;
 
-        in  += i_channels;
-        out += i_channels;
+    for( int p = 0; p < 2; p++ )
+    {
+        BiquadsSetDirect( p_sys->p_bands[p], f_gain[p] * EQZ_IN_FACTOR );
+        for( int i = 0; i < p_sys->i_band; i++ )
+            BiquadsSetGain( p_sys->p_bands[p], i, f_gain[p] * p_sys->f_amp[i] );
+        BiquadsCommit( p_sys->p_bands[p], i_ramp );
     }
+}
+
+static void EqzFilter( filter_t *p_filter, float *out, float *in,
+                       int i_samples )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    vlc_mutex_lock( &p_sys->lock );
+    BiquadsProcess( p_sys->p_bands[0], in, out, i_samples );
+    /* Second filter */
+    if( p_sys->b_2eqz )
+        BiquadsProcess( p_sys->p_bands[1], out, out, i_samples );
     vlc_mutex_unlock( &p_sys->lock );
 }
 
@@ -459,9 +418,8 @@ static void EqzClean( filter_t *p_filter )
     var_DelCallback( p_aout, "equalizer-preamp", PreampCallback, p_sys );
     var_DelCallback( p_aout, "equalizer-2pass", TwoPassCallback, p_sys );
 
-    free( p_sys->f_alpha );
-    free( p_sys->f_beta );
-    free( p_sys->f_gamma );
+    BiquadsDelete( p_sys->p_bands[0] );
+    BiquadsDelete( p_sys->p_bands[1] );
 
     free( p_sys->f_amp );
 }
@@ -530,6 +488,7 @@ static int PreampCallback( vlc_object_t *p_this, char const *psz_cmd,
 
     vlc_mutex_lock( &p_sys->lock );
     p_sys->f_gamp = preamp;
+    EqzUpdate( p_sys, p_sys->i_ramp );
     vlc_mutex_unlock( &p_sys->lock );
     return VLC_SUCCESS;
 }
@@ -560,6 +519,7 @@ static int BandsCallback( vlc_object_t *p_this, char const *psz_cmd,
     }
     while( i < p_sys->i_band )
         p_sys->f_amp[i++] = EqzConvertdB( 0.f );
+    EqzUpdate( p_sys, p_sys->i_ramp );
     vlc_mutex_unlock( &p_sys->lock );
     return VLC_SUCCESS;
 }
@@ -570,7 +530,10 @@ static int TwoPassCallback( vlc_object_t *p_this, char const *psz_cmd,
     filter_sys_t *p_sys = p_data;
 
     vlc_mutex_lock( &p_sys->lock );
+    if( newval.b_bool && !p_sys->b_2eqz )
+        BiquadsReset( p_sys->p_bands[1] );
     p_sys->b_2eqz = newval.b_bool;
+    EqzUpdate( p_sys, 0 );
     vlc_mutex_unlock( &p_sys->lock );
     return VLC_SUCCESS;
 }
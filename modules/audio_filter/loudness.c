@@ -0,0 +1,443 @@
+/*****************************************************************************
+ * loudness.c: loudness normalizer and true peak limiter (EBU R128)
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+
+#include "ebur128.h"
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+
+#define CHUNK 1024
+
+static int  Open ( vlc_object_t * );
+static void Close( vlc_object_t * );
+
+static const char *const ppsz_meters[] = {
+    "loudness-momentary", "loudness-short-term", "loudness-integrated",
+    "loudness-peak",
+};
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+
+#define TARGET_TEXT N_( "Target loudness" )
+#define TARGET_LONGTEXT N_( "Integrated loudness of the output, in LUFS." )
+
+#define PEAK_TEXT N_( "Maximum true peak" )
+#define PEAK_LONGTEXT N_( "The output is limited below this true peak " \
+    "level, in dBTP." )
+
+#define GAIN_TEXT N_( "Maximum gain" )
+#define GAIN_LONGTEXT N_( "Largest amplification or attenuation applied " \
+    "to reach the target loudness, in dB." )
+
+#define LOOKAHEAD_TEXT N_( "Limiter lookahead" )
+#define LOOKAHEAD_LONGTEXT N_( "Delay of the signal in milliseconds, over " \
+    "which the limiter lowers the gain before a peak." )
+
+#define RELEASE_TEXT N_( "Limiter release time" )
+#define RELEASE_LONGTEXT N_( "Time constant of the recovery of the gain " \
+    "after a peak, in milliseconds." )
+
+vlc_module_begin()
+    set_shortname( N_("Loudness") )
+    set_description( N_("EBU R128 loudness normalizer") )
+    set_capability( "audio filter", 0 )
+    set_category( CAT_AUDIO )
+    set_subcategory( SUBCAT_AUDIO_AFILTER )
+
+    add_float_with_range( "loudness-target", -23.0, -70.0, 0.0,
+                          TARGET_TEXT, TARGET_LONGTEXT, false )
+    add_float_with_range( "loudness-max-true-peak", -1.0, -20.0, 0.0,
+                          PEAK_TEXT, PEAK_LONGTEXT, false )
+    add_float_with_range( "loudness-max-gain", 12.0, 0.0, 40.0,
+                          GAIN_TEXT, GAIN_LONGTEXT, true )
+    add_integer_with_range( "loudness-lookahead", 5, 1, 100,
+                            LOOKAHEAD_TEXT, LOOKAHEAD_LONGTEXT, true )
+    add_integer_with_range( "loudness-release", 100, 10, 2000,
+                            RELEASE_TEXT, RELEASE_LONGTEXT, true )
+    set_callbacks( Open, Close )
+    add_shortcut( "loudness", "ebur128" )
+vlc_module_end ()
+
+struct filter_sys_t
+{
+    ebur128_t *p_meter;
+    unsigned i_channels;
+    unsigned i_rate;
+    unsigned i_step; /* frames between updates, 100 ms */
+    unsigned i_update_frames;
+
+    /* Normalization gain, ramped over a step to its target */
+    float f_target;
+    float f_max_gain;
+    float f_integrated;
+    float f_gain;
+    float f_gain_target;
+    float f_gain_delta;
+    unsigned i_ramp;
+
+    /* Limiter: the required gains of the frames are held at their minimum
+     * over a window, released exponentially, then averaged over the same
+     * window, so that the gain of a frame is reached when it gets out of
+     * the delay line, and never above its required gain. */
+    float f_ceiling;
+    float f_release;
+    unsigned i_window;
+    uint64_t i_frame;
+    float *p_min_gains; /* increasing gains over the window, as a deque */
+    uint64_t *p_min_frames;
+    unsigned i_min_first;
+    unsigned i_min_count;
+    float f_env;
+    float *p_avg_gains;
+    unsigned i_avg_pos;
+    double d_avg_sum;
+
+    /* Lookahead of the input, for the limiter and the true peak meter */
+    float *p_delay;
+    unsigned i_delay;
+    unsigned i_delay_pos;
+
+    float *p_peaks;
+    mtime_t i_next_pts;
+};
+
+/*****************************************************************************
+ * Limiter
+ *****************************************************************************/
+
+/* Minimum of the gains of the last frames of the window */
+static float SlidingMin( filter_sys_t *p_sys, float f_gain )
+{
+    const unsigned i_window = p_sys->i_window;
+    const uint64_t i_frame = p_sys->i_frame++;
+
+    while( p_sys->i_min_count > 0 )
+    {
+        const unsigned i_last = (p_sys->i_min_first + p_sys->i_min_count - 1)
+                              % i_window;
+        if( p_sys->p_min_gains[i_last] < f_gain )
+            break;
+        p_sys->i_min_count--;
+    }
+    if( p_sys->i_min_count > 0
+     && p_sys->p_min_frames[p_sys->i_min_first] + i_window <= i_frame )
+    {
+        p_sys->i_min_first = (p_sys->i_min_first + 1) % i_window;
+        p_sys->i_min_count--;
+    }
+
+    const unsigned i_next = (p_sys->i_min_first + p_sys->i_min_count)
+                          % i_window;
+    p_sys->p_min_gains[i_next] = f_gain;
+    p_sys->p_min_frames[i_next] = i_frame;
+    p_sys->i_min_count++;
+    return p_sys->p_min_gains[p_sys->i_min_first];
+}
+
+static float AverageGain( filter_sys_t *p_sys, float f_gain )
+{
+    p_sys->d_avg_sum += f_gain - p_sys->p_avg_gains[p_sys->i_avg_pos];
+    p_sys->p_avg_gains[p_sys->i_avg_pos] = f_gain;
+
+    if( ++p_sys->i_avg_pos == p_sys->i_window )
+    {
+        /* Drop the rounding errors */
+        p_sys->i_avg_pos = 0;
+        p_sys->d_avg_sum = 0.;
+        for( unsigned i = 0; i < p_sys->i_window; i++ )
+            p_sys->d_avg_sum += p_sys->p_avg_gains[i];
+    }
+    return p_sys->d_avg_sum / p_sys->i_window;
+}
+
+static void Reset( filter_sys_t *p_sys )
+{
+    p_sys->i_frame = 0;
+    p_sys->i_min_first = p_sys->i_min_count = 0;
+    p_sys->f_env = p_sys->f_gain;
+    for( unsigned i = 0; i < p_sys->i_window; i++ )
+        p_sys->p_avg_gains[i] = p_sys->f_gain;
+    p_sys->i_avg_pos = 0;
+    p_sys->d_avg_sum = (double)p_sys->f_gain * p_sys->i_window;
+    memset( p_sys->p_delay, 0,
+            p_sys->i_delay * p_sys->i_channels * sizeof (float) );
+    p_sys->i_delay_pos = 0;
+    p_sys->i_next_pts = VLC_TS_INVALID;
+}
+
+/*****************************************************************************
+ * Normalization
+ *****************************************************************************/
+
+static void UpdateGain( filter_sys_t *p_sys )
+{
+    const float f_integrated = EbuR128Integrated( p_sys->p_meter );
+
+    if( f_integrated == p_sys->f_integrated || !isfinite( f_integrated ) )
+        return;
+    p_sys->f_integrated = f_integrated;
+
+    float f_db = p_sys->f_target - f_integrated;
+    f_db = VLC_CLIP( f_db, -p_sys->f_max_gain, p_sys->f_max_gain );
+    p_sys->f_gain_target = powf( 10.f, f_db / 20.f );
+    p_sys->f_gain_delta = (p_sys->f_gain_target - p_sys->f_gain)
+                        / p_sys->i_step;
+    p_sys->i_ramp = p_sys->i_step;
+}
+
+static void Publish( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    vlc_object_t *p_parent = p_filter->obj.parent;
+
+    var_SetFloat( p_parent, ppsz_meters[0],
+                  EbuR128Momentary( p_sys->p_meter ) );
+    var_SetFloat( p_parent, ppsz_meters[1],
+                  EbuR128ShortTerm( p_sys->p_meter ) );
+    var_SetFloat( p_parent, ppsz_meters[2],
+                  EbuR128Integrated( p_sys->p_meter ) );
+    var_SetFloat( p_parent, ppsz_meters[3],
+                  EbuR128TruePeak( p_sys->p_meter ) );
+}
+
+/*****************************************************************************
+ * Process: measures, normalizes and limits frames in place
+ *****************************************************************************/
+
+static void Process( filter_t *p_filter, float *p_buf, size_t i_frames )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const unsigned i_channels = p_sys->i_channels;
+
+    while( i_frames > 0 )
+    {
+        const size_t i_count = __MIN( i_frames, CHUNK );
+
+        EbuR128Process( p_sys->p_meter, p_buf, p_sys->p_peaks, i_count );
+        UpdateGain( p_sys );
+
+        for( size_t i = 0; i < i_count; i++ )
+        {
+            if( p_sys->i_ramp > 0 )
+            {
+                p_sys->f_gain += p_sys->f_gain_delta;
+                if( --p_sys->i_ramp == 0 )
+                    p_sys->f_gain = p_sys->f_gain_target;
+            }
+
+            /* The peaks are late by the delay of the meter, which is part
+             * of the delay line */
+            const float f_peak = p_sys->p_peaks[i] * p_sys->f_gain;
+            float f_gain = p_sys->f_gain;
+            if( f_peak > p_sys->f_ceiling )
+                f_gain *= p_sys->f_ceiling / f_peak;
+
+            f_gain = SlidingMin( p_sys, f_gain );
+            p_sys->f_env += (p_sys->f_gain - p_sys->f_env) * p_sys->f_release;
+            p_sys->f_env = fminf( p_sys->f_env, f_gain );
+            f_gain = AverageGain( p_sys, p_sys->f_env );
+
+            float *p_delayed = &p_sys->p_delay[p_sys->i_delay_pos
+                                               * i_channels];
+            for( unsigned c = 0; c < i_channels; c++ )
+            {
+                const float f_in = p_buf[c];
+
+                p_buf[c] = p_delayed[c] * f_gain;
+                p_delayed[c] = f_in;
+            }
+            if( ++p_sys->i_delay_pos == p_sys->i_delay )
+                p_sys->i_delay_pos = 0;
+            p_buf += i_channels;
+        }
+
+        p_sys->i_update_frames += i_count;
+        if( p_sys->i_update_frames >= p_sys->i_step )
+        {
+            p_sys->i_update_frames %= p_sys->i_step;
+            Publish( p_filter );
+        }
+        i_frames -= i_count;
+    }
+}
+
+static block_t *DoWork( filter_t *p_filter, block_t *p_block )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    /* The output is the input of the delay line earlier */
+    const mtime_t i_latency = CLOCK_FREQ * p_sys->i_delay / p_sys->i_rate;
+
+    Process( p_filter, (float *)p_block->p_buffer, p_block->i_nb_samples );
+    if( p_block->i_pts > VLC_TS_INVALID )
+    {
+        p_sys->i_next_pts = p_block->i_pts + p_block->i_length;
+        p_block->i_pts -= i_latency;
+    }
+    if( p_block->i_dts > VLC_TS_INVALID )
+        p_block->i_dts -= i_latency;
+    return p_block;
+}
+
+/* Flushes the delay line */
+static block_t *Drain( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->i_next_pts == VLC_TS_INVALID )
+        return NULL;
+
+    const size_t i_size = p_sys->i_delay * p_sys->i_channels * sizeof (float);
+    block_t *p_block = block_Alloc( i_size );
+    if( unlikely( p_block == NULL ) )
+        return NULL;
+
+    memset( p_block->p_buffer, 0, i_size );
+    p_block->i_nb_samples = p_sys->i_delay;
+    p_block->i_length = CLOCK_FREQ * p_sys->i_delay / p_sys->i_rate;
+    p_block->i_dts = p_block->i_pts = p_sys->i_next_pts - p_block->i_length;
+    Process( p_filter, (float *)p_block->p_buffer, p_sys->i_delay );
+
+    Reset( p_sys );
+    return p_block;
+}
+
+static void Flush( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    /* The K-weighting and true peak filters hold the signal before the
+     * seek */
+    EbuR128Reset( p_sys->p_meter );
+    p_sys->f_integrated = -INFINITY;
+    Reset( p_sys );
+}
+
+/*****************************************************************************
+ * Open/Close
+ *****************************************************************************/
+
+static void Clean( filter_sys_t *p_sys )
+{
+    EbuR128Delete( p_sys->p_meter );
+    free( p_sys->p_peaks );
+    free( p_sys->p_delay );
+    free( p_sys->p_avg_gains );
+    free( p_sys->p_min_frames );
+    free( p_sys->p_min_gains );
+    free( p_sys );
+}
+
+static int Open( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    vlc_object_t *p_parent = p_filter->obj.parent;
+    const unsigned i_channels =
+        aout_FormatNbChannels( &p_filter->fmt_in.audio );
+    const unsigned i_rate = p_filter->fmt_in.audio.i_rate;
+
+    if( i_channels == 0 || i_channels > AOUT_CHAN_MAX || i_rate == 0 )
+        return VLC_EGENERIC;
+
+    filter_sys_t *p_sys = p_filter->p_sys = calloc( 1, sizeof(*p_sys) );
+    if( unlikely( p_sys == NULL ) )
+        return VLC_ENOMEM;
+
+    p_sys->i_channels = i_channels;
+    p_sys->i_rate = i_rate;
+    p_sys->i_step = (i_rate + 5) / 10;
+    p_sys->f_target = var_InheritFloat( p_filter, "loudness-target" );
+    p_sys->f_max_gain = var_InheritFloat( p_filter, "loudness-max-gain" );
+    p_sys->f_ceiling = powf( 10.f, var_InheritFloat( p_filter,
+                                     "loudness-max-true-peak" ) / 20.f );
+    p_sys->f_release = -expm1f( -1000.f / ( i_rate *
+                        var_InheritInteger( p_filter, "loudness-release" ) ) );
+    p_sys->i_window = __MAX( 1, i_rate * var_InheritInteger( p_filter,
+                                             "loudness-lookahead" ) / 1000 );
+    p_sys->f_integrated = -INFINITY;
+    p_sys->f_gain = p_sys->f_gain_target = 1.f;
+
+    p_sys->p_meter = EbuR128New( i_rate, i_channels,
+                                 p_filter->fmt_in.audio.i_physical_channels );
+    if( unlikely( p_sys->p_meter == NULL ) )
+    {
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+    p_sys->i_delay = EbuR128PeakDelay( p_sys->p_meter ) + p_sys->i_window - 1;
+
+    p_sys->p_min_gains = malloc( p_sys->i_window * sizeof (float) );
+    p_sys->p_min_frames = malloc( p_sys->i_window * sizeof (uint64_t) );
+    p_sys->p_avg_gains = malloc( p_sys->i_window * sizeof (float) );
+    p_sys->p_delay = malloc( p_sys->i_delay * i_channels * sizeof (float) );
+    p_sys->p_peaks = malloc( CHUNK * sizeof (float) );
+    if( unlikely( p_sys->p_min_gains == NULL || p_sys->p_min_frames == NULL
+               || p_sys->p_avg_gains == NULL || p_sys->p_delay == NULL
+               || p_sys->p_peaks == NULL ) )
+    {
+        Clean( p_sys );
+        return VLC_ENOMEM;
+    }
+    Reset( p_sys );
+
+    /* The measurements, for the statistics of the input */
+    for( unsigned i = 0; i < ARRAY_SIZE(ppsz_meters); i++ )
+    {
+        var_Create( p_parent, ppsz_meters[i], VLC_VAR_FLOAT );
+        var_SetFloat( p_parent, ppsz_meters[i], -INFINITY );
+    }
+
+    p_filter->fmt_in.audio.i_format = VLC_CODEC_FL32;
+    aout_FormatPrepare( &p_filter->fmt_in.audio );
+    p_filter->fmt_out.audio = p_filter->fmt_in.audio;
+    p_filter->pf_audio_filter = DoWork;
+    p_filter->pf_audio_drain = Drain;
+    p_filter->pf_flush = Flush;
+
+    msg_Dbg( p_filter, "target %.1f LUFS, lookahead of %u frames",
+             p_sys->f_target, p_sys->i_delay );
+    return VLC_SUCCESS;
+}
+
+static void Close( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+
+    for( unsigned i = 0; i < ARRAY_SIZE(ppsz_meters); i++ )
+        var_Destroy( p_filter->obj.parent, ppsz_meters[i] );
+    Clean( p_filter->p_sys );
+}
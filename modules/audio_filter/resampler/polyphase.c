@@ -0,0 +1,479 @@
+/*****************************************************************************
+ * polyphase.c : polyphase filter bank resampler
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include <vlc_block.h>
+#include <vlc_cpu.h>
+
+#include "polyphase.h"
+
+static int  OpenConverter( vlc_object_t * );
+static int  OpenResampler( vlc_object_t * );
+static void Close( vlc_object_t * );
+
+vlc_module_begin ()
+    set_shortname( N_("Polyphase") )
+    set_description( N_("Polyphase filter bank audio resampler") )
+    set_category( CAT_AUDIO )
+    set_subcategory( SUBCAT_AUDIO_RESAMPLER )
+    set_capability( "audio converter", 40 )
+    set_callbacks( OpenConverter, Close )
+
+    add_submodule()
+    set_capability( "audio resampler", 40 )
+    set_callbacks( OpenResampler, Close )
+vlc_module_end ()
+
+/*****************************************************************************
+ * Filter banks, shared by all the resamplers of the process
+ *****************************************************************************/
+typedef struct bank_entry
+{
+    struct bank_entry *p_next;
+    unsigned           i_refs;
+    unsigned           i_cutoff; /**< in thousandths of the Nyquist frequency */
+    pp_bank_t          bank;
+} bank_entry_t;
+
+static vlc_mutex_t bank_lock = VLC_STATIC_MUTEX;
+static bank_entry_t *bank_list = NULL;
+
+static const pp_bank_t *BankHold( unsigned i_phases, unsigned i_cutoff,
+                                  bool b_interp )
+{
+    bank_entry_t *p_entry;
+    const double f_cutoff = i_cutoff / 1000.;
+
+    vlc_mutex_lock( &bank_lock );
+    for( p_entry = bank_list; p_entry != NULL; p_entry = p_entry->p_next )
+        if( p_entry->bank.phases == i_phases && p_entry->i_cutoff == i_cutoff
+         && p_entry->bank.interp == b_interp )
+        {
+            p_entry->i_refs++;
+            goto out;
+        }
+
+    p_entry = malloc( sizeof( *p_entry ) );
+    if( unlikely( p_entry == NULL ) )
+        goto out;
+    if( pp_bank_init( &p_entry->bank, i_phases, pp_taps( f_cutoff ), f_cutoff,
+                      b_interp ) )
+    {
+        free( p_entry );
+        p_entry = NULL;
+        goto out;
+    }
+    p_entry->i_refs = 1;
+    p_entry->i_cutoff = i_cutoff;
+    p_entry->p_next = bank_list;
+    bank_list = p_entry;
+out:
+    vlc_mutex_unlock( &bank_lock );
+    return p_entry != NULL ? &p_entry->bank : NULL;
+}
+
+static void BankRelease( const pp_bank_t *p_bank )
+{
+    vlc_mutex_lock( &bank_lock );
+    for( bank_entry_t **pp = &bank_list; *pp != NULL; pp = &(*pp)->p_next )
+    {
+        bank_entry_t *p_entry = *pp;
+
+        if( &p_entry->bank != p_bank )
+            continue;
+        if( --p_entry->i_refs == 0 )
+        {
+            *pp = p_entry->p_next;
+            pp_bank_clean( &p_entry->bank );
+            free( p_entry );
+        }
+        break;
+    }
+    vlc_mutex_unlock( &bank_lock );
+}
+
+/*****************************************************************************
+ * Local structures
+ *****************************************************************************/
+struct filter_sys_t
+{
+    pp_dot_t         pf_dot;
+    unsigned         i_channels;
+
+    /* Current rates and their bank */
+    unsigned         i_in_rate, i_out_rate;
+    const pp_bank_t *p_bank;
+    unsigned         i_bank_cutoff;
+    uint64_t         i_step;
+
+    /* Input frames, in one plane per channel */
+    float           *p_planes;
+    size_t           i_plane_size;
+    size_t           i_frames;
+    pp_pos_t         pos;
+
+    date_t           end_date;
+    bool             b_first;
+};
+
+static unsigned Gcd( unsigned a, unsigned b )
+{
+    while( b != 0 )
+    {
+        unsigned c = a % b;
+        a = b;
+        b = c;
+    }
+    return a;
+}
+
+/* Makes room for i_count more frames in the planes */
+static int Reserve( filter_sys_t *p_sys, size_t i_count )
+{
+    const size_t i_needed = p_sys->i_frames + i_count;
+
+    if( i_needed <= p_sys->i_plane_size )
+        return VLC_SUCCESS;
+
+    const size_t i_size = i_needed + i_needed / 2;
+    float *p_planes = malloc( i_size * p_sys->i_channels * sizeof (float) );
+    if( unlikely( p_planes == NULL ) )
+        return VLC_ENOMEM;
+
+    for( unsigned c = 0; c < p_sys->i_channels; c++ )
+        memcpy( &p_planes[c * i_size],
+                &p_sys->p_planes[c * p_sys->i_plane_size],
+                p_sys->i_frames * sizeof (float) );
+    free( p_sys->p_planes );
+    p_sys->p_planes = p_planes;
+    p_sys->i_plane_size = i_size;
+    return VLC_SUCCESS;
+}
+
+/* Selects the bank for the current rates. The exact ratio is used when its
+ * bank is small enough, otherwise the phases are interpolated, with a
+ * coarser cutoff so that the rates of the drift compensation share a bank. */
+static int SetRates( filter_t *p_filter, unsigned i_in, unsigned i_out )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const unsigned i_gcd = Gcd( i_in, i_out );
+    const unsigned i_phases = i_out / i_gcd;
+    const bool b_interp = i_phases > PP_MAX_PHASES;
+
+    unsigned i_cutoff = lround( 1000. * pp_cutoff( i_in, i_out ) );
+    if( b_interp )
+        i_cutoff = (i_cutoff + 5) / 10 * 10;
+
+    const pp_bank_t *p_bank = p_sys->p_bank;
+    if( p_bank == NULL || p_bank->interp != b_interp
+     || (!b_interp && p_bank->phases != i_phases)
+     || p_sys->i_bank_cutoff != i_cutoff )
+    {
+        p_bank = BankHold( b_interp ? PP_INTERP_PHASES : i_phases, i_cutoff,
+                           b_interp );
+        if( unlikely( p_bank == NULL ) )
+            return VLC_ENOMEM;
+
+        if( p_sys->p_bank != NULL )
+        {
+            /* Keep the position, and the center of the window */
+            const uint32_t i_frac = pp_phase_to_frac( p_sys->p_bank,
+                                                      p_sys->pos.phase );
+            const size_t i_center = p_sys->pos.index
+                                  + p_sys->p_bank->taps / 2;
+
+            BankRelease( p_sys->p_bank );
+            p_sys->p_bank = NULL;
+            if( i_center >= p_bank->taps / 2 )
+                p_sys->pos.index = i_center - p_bank->taps / 2;
+            else
+            {
+                /* The new window is longer: pad its start with silence */
+                const size_t i_pad = p_bank->taps / 2 - i_center;
+                if( Reserve( p_sys, i_pad ) )
+                {
+                    BankRelease( p_bank );
+                    p_sys->b_first = true;
+                    return VLC_ENOMEM;
+                }
+                for( unsigned c = 0; c < p_sys->i_channels; c++ )
+                {
+                    float *p_plane = &p_sys->p_planes[c * p_sys->i_plane_size];
+                    memmove( p_plane + i_pad, p_plane,
+                             p_sys->i_frames * sizeof (float) );
+                    memset( p_plane, 0, i_pad * sizeof (float) );
+                }
+                p_sys->i_frames += i_pad;
+                p_sys->pos.index = 0;
+            }
+            pp_frac_to_phase( p_bank, &p_sys->pos, i_frac );
+        }
+        p_sys->p_bank = p_bank;
+        p_sys->i_bank_cutoff = i_cutoff;
+        msg_Dbg( p_filter, "%u -> %u Hz with %u%s phases of %u taps", i_in,
+                 i_out, p_bank->phases, b_interp ? " interpolated" : "",
+                 p_bank->taps );
+    }
+
+    if( b_interp )
+        p_sys->i_step = ((uint64_t)i_in << 32) / i_out;
+    else
+        p_sys->i_step = i_in / i_gcd;
+    p_sys->i_in_rate = i_in;
+    p_sys->i_out_rate = i_out;
+    return VLC_SUCCESS;
+}
+
+/* Clears the history, with silence up to the center of the first window */
+static int Reset( filter_sys_t *p_sys )
+{
+    const size_t i_pad = p_sys->p_bank->taps / 2 - 1;
+
+    p_sys->i_frames = 0;
+    if( Reserve( p_sys, i_pad ) )
+        return VLC_ENOMEM;
+    for( unsigned c = 0; c < p_sys->i_channels; c++ )
+        memset( &p_sys->p_planes[c * p_sys->i_plane_size], 0,
+                i_pad * sizeof (float) );
+    p_sys->i_frames = i_pad;
+    p_sys->pos.index = 0;
+    p_sys->pos.phase = 0;
+    return VLC_SUCCESS;
+}
+
+/* Resamples the buffered frames, and drops those no longer needed */
+static block_t *Process( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const pp_bank_t *p_bank = p_sys->p_bank;
+    const float *pp_planes[AOUT_CHAN_MAX];
+
+    if( p_sys->i_frames < p_sys->pos.index + p_bank->taps )
+        return NULL;
+
+    const size_t i_max = (uint64_t)(p_sys->i_frames - p_sys->pos.index)
+                       * p_sys->i_out_rate / p_sys->i_in_rate + 2;
+    block_t *p_out = block_Alloc( i_max * p_sys->i_channels
+                                  * sizeof (float) );
+    if( unlikely( p_out == NULL ) )
+        return NULL;
+
+    for( unsigned c = 0; c < p_sys->i_channels; c++ )
+        pp_planes[c] = &p_sys->p_planes[c * p_sys->i_plane_size];
+
+    const size_t i_count = pp_resample( p_bank, p_sys->pf_dot, &p_sys->pos,
+                                        p_sys->i_step, pp_planes,
+                                        p_sys->i_channels, p_sys->i_frames,
+                                        (float *)p_out->p_buffer, i_max );
+
+    /* Keep the frames from the next window on */
+    const size_t i_drop = __MIN(p_sys->pos.index, p_sys->i_frames);
+    for( unsigned c = 0; c < p_sys->i_channels; c++ )
+    {
+        float *p_plane = &p_sys->p_planes[c * p_sys->i_plane_size];
+        memmove( p_plane, p_plane + i_drop,
+                 (p_sys->i_frames - i_drop) * sizeof (float) );
+    }
+    p_sys->i_frames -= i_drop;
+    p_sys->pos.index -= i_drop;
+
+    p_out->i_nb_samples = i_count;
+    p_out->i_buffer = i_count * p_sys->i_channels * sizeof (float);
+    p_out->i_dts = p_out->i_pts = date_Get( &p_sys->end_date );
+    p_out->i_length = date_Increment( &p_sys->end_date, i_count )
+                    - p_out->i_pts;
+    return p_out;
+}
+
+/*****************************************************************************
+ * Resample: convert a buffer
+ *****************************************************************************/
+static block_t *Resample( filter_t *p_filter, block_t *p_in )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const unsigned i_in_rate = p_filter->fmt_in.audio.i_rate;
+    const unsigned i_out_rate = p_filter->fmt_out.audio.i_rate;
+
+    if( i_in_rate != p_sys->i_in_rate || i_out_rate != p_sys->i_out_rate )
+        if( SetRates( p_filter, i_in_rate, i_out_rate ) )
+        {
+            block_Release( p_in );
+            return NULL;
+        }
+
+    if( (p_in->i_flags & BLOCK_FLAG_DISCONTINUITY) || p_sys->b_first )
+    {
+        if( Reset( p_sys ) )
+        {
+            block_Release( p_in );
+            return NULL;
+        }
+        date_Init( &p_sys->end_date, i_out_rate, 1 );
+        date_Set( &p_sys->end_date, p_in->i_pts );
+        p_sys->b_first = false;
+    }
+
+    if( Reserve( p_sys, p_in->i_nb_samples ) )
+    {
+        block_Release( p_in );
+        return NULL;
+    }
+
+    /* Deinterleave the input */
+    const float *p_src = (const float *)p_in->p_buffer;
+    for( unsigned c = 0; c < p_sys->i_channels; c++ )
+    {
+        float *p_dst = &p_sys->p_planes[c * p_sys->i_plane_size
+                                        + p_sys->i_frames];
+        for( size_t i = 0; i < p_in->i_nb_samples; i++ )
+            p_dst[i] = p_src[i * p_sys->i_channels + c];
+    }
+    p_sys->i_frames += p_in->i_nb_samples;
+
+    block_t *p_out = Process( p_filter );
+    if( p_out != NULL )
+        p_out->i_flags = p_in->i_flags & BLOCK_FLAG_DISCONTINUITY;
+    block_Release( p_in );
+    return p_out;
+}
+
+static block_t *Drain( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->b_first || p_sys->p_bank == NULL )
+        return NULL;
+
+    /* Silence up to the end of the window of the last input frame */
+    const size_t i_pad = p_sys->p_bank->taps / 2;
+    if( Reserve( p_sys, i_pad ) )
+        return NULL;
+    for( unsigned c = 0; c < p_sys->i_channels; c++ )
+        memset( &p_sys->p_planes[c * p_sys->i_plane_size + p_sys->i_frames],
+                0, i_pad * sizeof (float) );
+    p_sys->i_frames += i_pad;
+
+    block_t *p_out = Process( p_filter );
+    p_sys->b_first = true;
+    return p_out;
+}
+
+static void Flush( filter_t *p_filter )
+{
+    p_filter->p_sys->b_first = true;
+}
+
+/*****************************************************************************
+ * Open/Close
+ *****************************************************************************/
+static int Open( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+
+    if( p_filter->fmt_in.audio.i_format != VLC_CODEC_FL32
+     || p_filter->fmt_out.audio.i_format != VLC_CODEC_FL32
+     || p_filter->fmt_in.audio.i_channels != p_filter->fmt_out.audio.i_channels
+     || p_filter->fmt_in.audio.i_channels == 0
+     || p_filter->fmt_in.audio.i_channels > AOUT_CHAN_MAX
+     || p_filter->fmt_in.audio.i_rate == 0
+     || p_filter->fmt_out.audio.i_rate == 0 )
+        return VLC_EGENERIC;
+
+    filter_sys_t *p_sys = malloc( sizeof( *p_sys ) );
+    if( unlikely( p_sys == NULL ) )
+        return VLC_ENOMEM;
+    p_filter->p_sys = p_sys;
+
+    p_sys->i_channels = p_filter->fmt_in.audio.i_channels;
+    p_sys->i_in_rate = p_sys->i_out_rate = 0;
+    p_sys->p_bank = NULL;
+    p_sys->p_planes = NULL;
+    p_sys->i_plane_size = 0;
+    p_sys->i_frames = 0;
+    p_sys->pos.index = 0;
+    p_sys->pos.phase = 0;
+    p_sys->b_first = true;
+
+    p_sys->pf_dot = pp_dot_c;
+#if defined(CAN_COMPILE_SSE)
+    if( vlc_CPU_SSE() )
+        p_sys->pf_dot = pp_dot_sse;
+#endif
+#if defined(CAN_COMPILE_AVX2)
+    if( vlc_CPU_AVX2() )
+        p_sys->pf_dot = pp_dot_avx2;
+#endif
+#ifdef __ARM_NEON
+    p_sys->pf_dot = pp_dot_neon;
+#endif
+
+    if( SetRates( p_filter, p_filter->fmt_in.audio.i_rate,
+                  p_filter->fmt_out.audio.i_rate ) )
+    {
+        Close( p_this );
+        return VLC_ENOMEM;
+    }
+
+    const unsigned i_out_rate = p_filter->fmt_out.audio.i_rate;
+    p_filter->fmt_out.audio = p_filter->fmt_in.audio;
+    p_filter->fmt_out.audio.i_rate = i_out_rate;
+
+    p_filter->pf_audio_filter = Resample;
+    p_filter->pf_audio_drain = Drain;
+    p_filter->pf_flush = Flush;
+    return VLC_SUCCESS;
+}
+
+static int OpenResampler( vlc_object_t *p_this )
+{
+    return Open( p_this );
+}
+
+static int OpenConverter( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+
+    /* Only converts the rate */
+    if( p_filter->fmt_in.audio.i_rate == p_filter->fmt_out.audio.i_rate )
+        return VLC_EGENERIC;
+    return Open( p_this );
+}
+
+static void Close( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->p_bank != NULL )
+        BankRelease( p_sys->p_bank );
+    free( p_sys->p_planes );
+    free( p_sys );
+}
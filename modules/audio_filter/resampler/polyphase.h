@@ -0,0 +1,334 @@
+/*****************************************************************************
+ * polyphase.h: polyphase resampling kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Resampling by L / M (the reduced ratio of the output and input rates)
+ * interpolates each output sample at an input position i + p / L. The
+ * Kaiser-windowed sinc low-pass filter is sampled for each of the L phases
+ * p into a bank of coefficients, so that an output sample is a single dot
+ * product of the coefficients of its phase with the input samples around i.
+ *
+ * When L is too large for a bank, as for the slightly off rates used to
+ * compensate the clock drift, the position is tracked as a 32-bits
+ * fraction and the filter is interpolated between the two nearest of
+ * PP_INTERP_PHASES phases.
+ *
+ * The input samples are kept in one plane per channel, where the window of
+ * an output sample starts at frame i. The output is interleaved. */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CAN_COMPILE_SSE) || defined(CAN_COMPILE_AVX2)
+# include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+# include <arm_neon.h>
+#endif
+
+#define PP_TAPS          64   /* taps of the filter without decimation */
+#define PP_MAX_TAPS      512
+#define PP_MAX_PHASES    1024 /* above, phases are interpolated */
+#define PP_INTERP_BITS   8
+#define PP_INTERP_PHASES (1 << PP_INTERP_BITS)
+#define PP_CUTOFF        0.91 /* of the lowest Nyquist frequency */
+#define PP_BETA          7.   /* Kaiser window, about 70 dB of attenuation */
+
+typedef struct
+{
+    unsigned phases;
+    unsigned taps; /* per phase, a multiple of 8 */
+    bool interp; /* one extra phase, for the interpolation of the last one */
+    float *coeffs; /* NULL for a single phase, which copies the input */
+} pp_bank_t;
+
+typedef struct
+{
+    size_t index; /* first input frame of the window */
+    uint32_t phase; /* in [0, phases), or a 32-bits fraction if interpolated */
+} pp_pos_t;
+
+typedef float (*pp_dot_t)(const float *, const float *, unsigned);
+
+/*****************************************************************************
+ * Dot products of n floats, n being a multiple of 8
+ *****************************************************************************/
+static inline float pp_dot_c(const float *a, const float *b, unsigned n)
+{
+    float s0 = 0.f, s1 = 0.f, s2 = 0.f, s3 = 0.f;
+
+    for (unsigned i = 0; i < n; i += 4)
+    {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef CAN_COMPILE_SSE
+VLC_SSE
+static inline float pp_dot_sse(const float *a, const float *b, unsigned n)
+{
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+
+    for (unsigned i = 0; i < n; i += 8)
+    {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_load_ps(&a[i]),
+                                       _mm_loadu_ps(&b[i])));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_load_ps(&a[i + 4]),
+                                       _mm_loadu_ps(&b[i + 4])));
+    }
+    s0 = _mm_add_ps(s0, s1);
+    s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+    s0 = _mm_add_ss(s0, _mm_shuffle_ps(s0, s0, 1));
+    return _mm_cvtss_f32(s0);
+}
+#endif
+
+#ifdef CAN_COMPILE_AVX2
+VLC_AVX2
+static inline float pp_dot_avx2(const float *a, const float *b, unsigned n)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    unsigned i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_load_ps(&a[i]),
+                                             _mm256_loadu_ps(&b[i])));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_load_ps(&a[i + 8]),
+                                             _mm256_loadu_ps(&b[i + 8])));
+    }
+    if (i < n)
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_load_ps(&a[i]),
+                                             _mm256_loadu_ps(&b[i])));
+    s0 = _mm256_add_ps(s0, s1);
+
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(s0),
+                          _mm256_extractf128_ps(s0, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+#endif
+
+#ifdef __ARM_NEON
+static inline float pp_dot_neon(const float *a, const float *b, unsigned n)
+{
+    float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f);
+
+    for (unsigned i = 0; i < n; i += 8)
+    {
+        s0 = vmlaq_f32(s0, vld1q_f32(&a[i]), vld1q_f32(&b[i]));
+        s1 = vmlaq_f32(s1, vld1q_f32(&a[i + 4]), vld1q_f32(&b[i + 4]));
+    }
+    s0 = vaddq_f32(s0, s1);
+
+    float32x2_t s = vadd_f32(vget_low_f32(s0), vget_high_f32(s0));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+#endif
+
+/*****************************************************************************
+ * Filter banks
+ *****************************************************************************/
+
+/* Cutoff of the filter, relatively to the input Nyquist frequency */
+static inline double pp_cutoff(unsigned in_rate, unsigned out_rate)
+{
+    return PP_CUTOFF * (out_rate < in_rate ? (double)out_rate / in_rate : 1.);
+}
+
+/* The filter gets longer as the cutoff decreases, for the same steepness */
+static inline unsigned pp_taps(double cutoff)
+{
+    unsigned taps = ceil(PP_TAPS * PP_CUTOFF / cutoff);
+
+    taps = (taps + 7) & ~7u;
+    return taps < PP_MAX_TAPS ? taps : PP_MAX_TAPS;
+}
+
+/* Modified Bessel function of the first kind, of order 0 */
+static inline double pp_bessel_i0(double x)
+{
+    double sum = 1., term = 1.;
+
+    for (unsigned k = 1; term > sum * 1e-12; k++)
+    {
+        term *= (x / (2. * k)) * (x / (2. * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * Computes a bank of phases, with a cutoff relative to the input Nyquist
+ * frequency. Each phase is normalized to a unity gain.
+ */
+static inline int pp_bank_init(pp_bank_t *bank, unsigned phases,
+                               unsigned taps, double cutoff, bool interp)
+{
+    const unsigned rows = phases + interp;
+    const double half = taps / 2;
+
+    bank->phases = phases;
+    bank->taps = taps;
+    bank->interp = interp;
+    bank->coeffs = NULL;
+    if (phases == 1 && !interp)
+        return 0;
+
+    bank->coeffs = aligned_alloc(32, rows * taps * sizeof (float));
+    if (bank->coeffs == NULL)
+        return -1;
+
+    const double norm = pp_bessel_i0(PP_BETA);
+    for (unsigned p = 0; p < rows; p++)
+    {
+        float *row = &bank->coeffs[p * taps];
+        double sum = 0.;
+
+        for (unsigned k = 0; k < taps; k++)
+        {
+            /* Distance to the output position, in input samples */
+            const double t = k - half + 1. - (double)p / phases;
+            const double u = t / half;
+            double h = cutoff;
+
+            if (t != 0.)
+                h = sin(M_PI * cutoff * t) / (M_PI * t);
+            h *= u * u < 1. ? pp_bessel_i0(PP_BETA * sqrt(1. - u * u)) / norm
+                            : 0.;
+            row[k] = h;
+            sum += h;
+        }
+        for (unsigned k = 0; k < taps; k++)
+            row[k] /= sum;
+    }
+    return 0;
+}
+
+static inline void pp_bank_clean(pp_bank_t *bank)
+{
+    aligned_free(bank->coeffs);
+}
+
+/*****************************************************************************
+ * Resampling
+ *****************************************************************************/
+
+/* Position as a 32-bits fraction of input frame, and back */
+static inline uint32_t pp_phase_to_frac(const pp_bank_t *bank, uint32_t phase)
+{
+    return bank->interp ? phase : ((uint64_t)phase << 32) / bank->phases;
+}
+
+static inline void pp_frac_to_phase(const pp_bank_t *bank, pp_pos_t *pos,
+                                    uint32_t frac)
+{
+    if (bank->interp)
+    {
+        pos->phase = frac;
+        return;
+    }
+
+    uint64_t p = ((uint64_t)frac * bank->phases + (UINT64_C(1) << 31)) >> 32;
+    if (p >= bank->phases)
+    {
+        p = 0;
+        pos->index++;
+    }
+    pos->phase = p;
+}
+
+/**
+ * Resamples up to max frames of channels planes of avail frames from in,
+ * to interleaved out. The position advances by step, that is M for a bank
+ * of L phases, or the ratio of the input and output rates as a 32.32 fixed
+ * point value for an interpolated bank.
+ *
+ * \return the number of output frames
+ */
+static inline size_t pp_resample(const pp_bank_t *bank, pp_dot_t dot,
+                                 pp_pos_t *pos, uint64_t step,
+                                 const float *const *in, unsigned channels,
+                                 size_t avail, float *restrict out, size_t max)
+{
+    const unsigned taps = bank->taps;
+    size_t n = 0;
+
+    if (avail < taps)
+        return 0;
+
+    if (bank->interp)
+    {
+        const float scale = 1.f / (UINT32_C(1) << (32 - PP_INTERP_BITS));
+        const uint32_t mask = (UINT32_C(1) << (32 - PP_INTERP_BITS)) - 1;
+
+        for (; n < max && pos->index <= avail - taps; n++)
+        {
+            const float *h = &bank->coeffs[
+                (pos->phase >> (32 - PP_INTERP_BITS)) * taps];
+            const float t = (pos->phase & mask) * scale;
+
+            for (unsigned c = 0; c < channels; c++)
+            {
+                const float a = dot(h, &in[c][pos->index], taps);
+                const float b = dot(h + taps, &in[c][pos->index], taps);
+                *out++ = a + t * (b - a);
+            }
+
+            const uint64_t p = pos->phase + step;
+            pos->index += p >> 32;
+            pos->phase = p;
+        }
+        return n;
+    }
+
+    const size_t q = step / bank->phases;
+    const uint32_t r = step % bank->phases;
+
+    for (; n < max && pos->index <= avail - taps; n++)
+    {
+        if (bank->coeffs == NULL)
+            for (unsigned c = 0; c < channels; c++)
+                *out++ = in[c][pos->index + taps / 2 - 1];
+        else
+        {
+            const float *h = &bank->coeffs[pos->phase * taps];
+
+            for (unsigned c = 0; c < channels; c++)
+                *out++ = dot(h, &in[c][pos->index], taps);
+        }
+
+        pos->index += q;
+        pos->phase += r;
+        if (pos->phase >= bank->phases)
+        {
+            pos->phase -= bank->phases;
+            pos->index++;
+        }
+    }
+    return n;
+}
@@ -1760,6 +1760,29 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
     msg_rc(_("| sending bitrate  :   %6.0f kb/s"),
             (float)(p_item->p_stats->f_send_bitrate*8)*1000 );
     msg_rc("|");
+    /* Block pool */
+    msg_rc("%s", _("+-[Block pool]"));
+    msg_rc(_("| pool hits        :    %5"PRIi64),
+           p_item->p_stats->i_block_pool_hits );
+    msg_rc(_("| pool misses      :    %5"PRIi64),
+           p_item->p_stats->i_block_pool_misses );
+    msg_rc(_("| bytes retained   : %8.0f KiB"),
+            (float)(p_item->p_stats->i_block_pool_retained)/1024 );
+    msg_rc("|");
+    /* Loudness */
+    if( !isnan( p_item->p_stats->f_loudness_momentary ) )
+    {
+        msg_rc("%s", _("+-[Loudness]"));
+        msg_rc(_("| momentary        :  %7.1f LUFS"),
+               p_item->p_stats->f_loudness_momentary );
+        msg_rc(_("| short-term       :  %7.1f LUFS"),
+               p_item->p_stats->f_loudness_short_term );
+        msg_rc(_("| integrated       :  %7.1f LUFS"),
+               p_item->p_stats->f_loudness_integrated );
+        msg_rc(_("| true peak        :  %7.1f dBTP"),
+               p_item->p_stats->f_true_peak );
+        msg_rc("|");
+    }
     msg_rc( "+----[ end of statistical info ]" );
     vlc_mutex_unlock( &p_item->p_stats->lock );
     vlc_mutex_unlock( &p_item->lock );
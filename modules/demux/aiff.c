@@ -50,6 +50,7 @@ vlc_module_begin ()
     set_description( N_("AIFF demuxer" ) )
     set_capability( "demux", 10 )
     set_callbacks( Open, Close )
+    set_probe_magic( 0, "FORM" )
     add_shortcut( "aiff" )
 vlc_module_end ()
 
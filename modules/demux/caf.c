@@ -53,6 +53,7 @@ set_subcategory( SUBCAT_INPUT_DEMUX )
 set_description( N_( "CAF demuxer" ))
 set_capability( "demux", 140 )
 set_callbacks( Open, Close )
+set_probe_magic( 0, "caff" )
 add_shortcut( "caf" )
 vlc_module_end ()
 
@@ -45,6 +45,7 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_capability( "demux", 3 )
     set_callbacks( Open, Close )
+    set_probe_extensions( "cdg" )
     add_shortcut( "cdg", "subtitle" )
 vlc_module_end ()
 
@@ -54,6 +54,8 @@ vlc_module_begin ()
     set_capability( "demux", 6 )
     add_float( "h264-fps", 0.0, FPS_TEXT, FPS_LONGTEXT, true )
     set_callbacks( OpenH264, Close )
+    set_probe_extensions( "h264,264,bin,bit,raw" )
+    set_probe_mime_types( "video/H264,video/avc" )
     add_shortcut( "h264" )
 
     add_submodule()
@@ -64,6 +66,8 @@ vlc_module_begin ()
         set_capability( "demux", 6 )
         add_float( "hevc-fps", 0.0, FPS_TEXT, FPS_LONGTEXT, true )
         set_callbacks( OpenHEVC, Close )
+        set_probe_extensions( "h265,265,hevc,bin,bit,raw" )
+        set_probe_mime_types( "video/h265,video/hevc" )
         add_shortcut( "hevc", "h265" )
 
 vlc_module_end ()
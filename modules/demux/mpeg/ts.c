@@ -46,6 +46,7 @@
 #include "ts_hotfixes.h"
 #include "ts_sl.h"
 #include "ts_metadata.h"
+#include "ts_workers.h"
 #include "sections.h"
 #include "pes.h"
 #include "timestamps.h"
@@ -114,6 +115,12 @@ static void Close ( vlc_object_t * );
 #define PCR_TEXT N_("Trust in-stream PCR")
 #define PCR_LONGTEXT N_("Use the stream PCR as a reference.")
 
+#define WORKERS_TEXT N_("PES output threads")
+#define WORKERS_LONGTEXT N_( \
+    "Number of threads reassembling and sending out elementary stream " \
+    "packets, so that the input thread does not wait while they are sent. " \
+    "0 does everything on the input thread." )
+
 static const char *const ts_standards_list[] =
     { "auto", "mpeg", "dvb", "arib", "atsc", "tdmb" };
 static const char *const ts_standards_list_text[] =
@@ -148,6 +155,7 @@ vlc_module_begin ()
 
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
+    add_integer_with_range( "ts-workers", 0, 0, 16, WORKERS_TEXT, WORKERS_LONGTEXT, true )
 
     add_obsolete_bool( "ts-silent" );
 
@@ -169,6 +177,23 @@ static bool PIDReferencedByProgram( const ts_pmt_t *, uint16_t );
 void UpdatePESFilters( demux_t *p_demux, bool b_all );
 static inline void FlushESBuffer( ts_stream_t *p_pes );
 static void UpdatePIDScrambledState( demux_t *p_demux, ts_pid_t *p_pid, bool );
+/* Waits for all async output to complete before changing ES/program state */
+static inline void WaitPESOutput( demux_sys_t *p_sys )
+{
+    if( p_sys->p_workers )
+        ts_workers_Barrier( p_sys->p_workers );
+}
+/* Same, limited to the output of a program */
+static void WaitProgramPESOutput( demux_sys_t *p_sys, const ts_pmt_t *p_pmt )
+{
+    if( p_sys->p_workers )
+    {
+        for( int i=0; i<p_pmt->e_streams.i_size; i++ )
+            ts_workers_Wait( p_sys->p_workers,
+                             p_pmt->e_streams.p_elems[i]->i_pid );
+    }
+}
+
 static inline int PIDGet( block_t *p )
 {
     return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
@@ -180,7 +205,11 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk, size_
 static bool GatherSectionsData( demux_t *p_demux, ts_pid_t *, block_t *, size_t );
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
+static const uint8_t * ReadTSPacketData( demux_t *p_demux );
 static block_t* ReadTSPacket( demux_t *p_demux );
+static uint64_t TSTell( demux_sys_t * );
+static void TSBulkReset( demux_sys_t * );
+static int TSSeek( demux_sys_t *, uint64_t );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, mtime_t );
@@ -192,6 +221,9 @@ static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
 
+/* How many TS packets are read from the stream at once */
+#define TS_BULK_PACKETS 1024
+
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
     const uint8_t *p_peek;
@@ -386,6 +418,8 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->bulk.p_buffer = NULL;
+    p_sys->bulk.i_size = p_sys->bulk.i_pos = 0;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -483,6 +517,11 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_canfastseek = false;
     p_sys->b_ignore_time_for_positions = var_InheritBool( p_demux, "ts-seek-percent" );
 
+    p_sys->p_workers = NULL;
+    unsigned i_workers = var_InheritInteger( p_demux, "ts-workers" );
+    if( i_workers > 0 )
+        p_sys->p_workers = ts_workers_New( p_this, i_workers );
+
     p_sys->standard = TS_STANDARD_AUTO;
     char *psz_standard = var_InheritString( p_demux, "ts-standard" );
     if( psz_standard )
@@ -539,6 +578,10 @@ static void Close( vlc_object_t *p_this )
     demux_t     *p_demux = (demux_t*)p_this;
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    /* Flush pending output before any ES goes away */
+    if( p_sys->p_workers )
+        ts_workers_Delete( p_sys->p_workers );
+
     PIDRelease( p_demux, GetPID(p_sys, 0) );
 
     vlc_mutex_lock( &p_sys->csa_lock );
@@ -571,6 +614,7 @@ static void Close( vlc_object_t *p_this )
     /* Clear up attachments */
     vlc_dictionary_clear( &p_sys->attachments, FreeDictAttachment, NULL );
 
+    free( p_sys->bulk.p_buffer );
     free( p_sys );
 }
 
@@ -607,6 +651,7 @@ static int Demux( demux_t *p_demux )
     /* If we had no PAT within MIN_PAT_INTERVAL, create PAT/PMT from probed streams */
     if( p_sys->i_pmt_es == 0 && !SEEN(GetPID(p_sys, 0)) && p_sys->patfix.status == PAT_MISSING )
     {
+        WaitPESOutput( p_sys );
         MissingPATPMTFixup( p_demux );
         p_sys->patfix.status = PAT_FIXTRIED;
     }
@@ -617,6 +662,18 @@ static int Demux( demux_t *p_demux )
         bool         b_frame = false;
         int          i_header = 0;
         block_t     *p_pkt;
+        const uint8_t *p_data = ReadTSPacketData( p_demux );
+        if( p_data == NULL )
+            return VLC_DEMUXER_EOF;
+
+        /* Null packets are stuffing: drop them before any processing */
+        p_data += p_sys->i_packet_header_size;
+        if( ((p_data[1] & 0x1f) << 8 | p_data[2]) == 0x1fff )
+        {
+            p_sys->bulk.i_pos += p_sys->i_packet_size;
+            continue;
+        }
+
         if( !(p_pkt = ReadTSPacket( p_demux )) )
         {
             return VLC_DEMUXER_EOF;
@@ -624,7 +681,8 @@ static int Demux( demux_t *p_demux )
 
         if( p_sys->b_start_record )
         {
-            /* Enable recording once synchronized */
+            /* Enable recording once synchronized, from the next packet */
+            TSBulkRewind( p_demux );
             vlc_stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE, true,
                                 "ts" );
             p_sys->b_start_record = false;
@@ -686,6 +744,8 @@ static int Demux( demux_t *p_demux )
         {
         case TYPE_PAT:
         case TYPE_PMT:
+            /* Tables updates can change or delete ES */
+            WaitPESOutput( p_sys );
             /* PAT and PMT are not allowed to be scrambled */
             ts_psi_Packet_Push( p_pid, p_pkt->p_buffer );
             block_Release( p_pkt );
@@ -715,6 +775,7 @@ static int Demux( demux_t *p_demux )
             }
             else if( p_pid->u.p_stream->transport == TS_TRANSPORT_SECTIONS )
             {
+                WaitPESOutput( p_sys );
                 b_frame = GatherSectionsData( p_demux, p_pid, p_pkt, i_header );
             }
             else // pid->u.p_pes->transport == TS_TRANSPORT_IGNORE
@@ -791,6 +852,7 @@ static inline void HasSelectedES( es_out_t *out, const ts_es_t *p_es,
 void UpdatePESFilters( demux_t *p_demux, bool b_all )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
+    WaitPESOutput( p_sys );
     ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
 
     /* We need 3 pass to avoid loss on deselect/relesect with hw filters and
@@ -880,6 +942,8 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     const ts_pmt_t *p_pmt = NULL;
     const ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
 
+    WaitPESOutput( p_sys );
+
     for( int i=0; i<p_pat->programs.i_size && !p_pmt; i++ )
     {
         if( p_pat->programs.p_elems[i]->u.p_pmt->b_selected )
@@ -925,7 +989,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            uint64_t offset = vlc_stream_Tell( p_sys->stream );
+            uint64_t offset = TSTell( p_sys );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -972,7 +1036,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         i64 = stream_Size( p_sys->stream );
         if( i64 > 0 &&
-            vlc_stream_Seek( p_sys->stream, (int64_t)(i64 * f) ) == VLC_SUCCESS )
+            TSSeek( p_sys, (int64_t)(i64 * f) ) == VLC_SUCCESS )
         {
             ReadyQueuesPostSeek( p_demux );
             return VLC_SUCCESS;
@@ -1104,9 +1168,12 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     }
 
     case DEMUX_SET_TITLE:
+        /* The buffered packets belong to the previous position */
+        TSBulkReset( p_sys );
         return vlc_stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args );
 
     case DEMUX_SET_SEEKPOINT:
+        TSBulkReset( p_sys );
         return vlc_stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT,
                                      args );
 
@@ -1122,8 +1189,13 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
         b_bool = va_arg( args, int );
 
         if( !b_bool )
+        {
+            /* Stop on a packet boundary, then read the packets buffered
+             * ahead again, as they were not recorded as demuxed */
+            TSBulkRewind( p_demux );
             vlc_stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE,
                                 false );
+        }
         p_sys->b_start_record = b_bool;
         return VLC_SUCCESS;
 
@@ -1294,7 +1366,7 @@ invalid:
 
 static block_t * ConvertPESBlock( demux_t *p_demux, ts_es_t *p_es,
                                   size_t i_pes_size, uint8_t i_stream_id,
-                                  block_t *p_block )
+                                  mtime_t i_pcr, block_t *p_block )
 {
     if(!p_block)
         return NULL;
@@ -1316,7 +1388,6 @@ static block_t * ConvertPESBlock( demux_t *p_demux, ts_es_t *p_es,
         {
             /* Teletext may have missing PTS (ETSI EN 300 472 Annexe A)
              * In this case use the last PCR + 40ms */
-            mtime_t i_pcr = p_es->p_program->pcr.i_current;
             if( i_pcr > VLC_TS_INVALID )
                 p_block->i_pts = FROM_SCALE(i_pcr) + 40000;
         }
@@ -1358,8 +1429,11 @@ static block_t * ConvertPESBlock( demux_t *p_demux, ts_es_t *p_es,
 
 /****************************************************************************
  * fanouts current block to all subdecoders / shared pid es
+ * i_flags are added to the first block only. The PES workers call it too, so
+ * it must not touch the ES state, i_next_block_flags included.
  ****************************************************************************/
-static void SendDataChain( demux_t *p_demux, ts_es_t *p_es, block_t *p_chain )
+static void SendDataChain( demux_t *p_demux, ts_es_t *p_es, int i_flags,
+                           block_t *p_chain )
 {
     while( p_chain )
     {
@@ -1368,11 +1442,8 @@ static void SendDataChain( demux_t *p_demux, ts_es_t *p_es, block_t *p_chain )
         p_block->p_next = NULL;
 
         ts_es_t *p_es_send = p_es;
-        if( p_es_send->i_next_block_flags )
-        {
-            p_block->i_flags |= p_es_send->i_next_block_flags;
-            p_es_send->i_next_block_flags = 0;
-        }
+        p_block->i_flags |= i_flags;
+        i_flags = 0;
 
         while( p_es_send )
         {
@@ -1417,11 +1488,71 @@ static void SendDataChain( demux_t *p_demux, ts_es_t *p_es, block_t *p_chain )
     }
 }
 
+/****************************************************************************
+ * PES output workers
+ ****************************************************************************/
+typedef struct
+{
+    ts_worker_job_t job;
+    demux_t    *p_demux;
+    ts_es_t    *p_es;
+    block_t    *p_pes;      /* unit, possibly not reassembled yet */
+    unsigned    i_pes_size;
+    uint8_t     i_stream_id;
+    int         i_flags;    /* pending ES flags for the first output block */
+    mtime_t     i_pcr;      /* program PCR when the unit was gathered */
+} ts_pes_job_t;
+
+static void OutputPESJob( ts_worker_job_t *p_job )
+{
+    ts_pes_job_t *p_pesjob = container_of( p_job, ts_pes_job_t, job );
+
+    block_t *p_block = block_ChainGather( p_pesjob->p_pes );
+    if( likely(p_block) )
+    {
+        p_block = ConvertPESBlock( p_pesjob->p_demux, p_pesjob->p_es,
+                                   p_pesjob->i_pes_size, p_pesjob->i_stream_id,
+                                   p_pesjob->i_pcr, p_block );
+        SendDataChain( p_pesjob->p_demux, p_pesjob->p_es, p_pesjob->i_flags,
+                       p_block );
+    }
+    else block_ChainRelease( p_pesjob->p_pes );
+
+    free( p_pesjob );
+}
+
+/* Hands the unit over to the pid's worker, keeping per ES order */
+static void OutputPESAsync( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes,
+                            unsigned i_pes_size, uint8_t i_stream_id )
+{
+    ts_es_t *p_es = pid->u.p_stream->p_es;
+    ts_pes_job_t *p_pesjob = malloc( sizeof(*p_pesjob) );
+    if( unlikely(p_pesjob == NULL) )
+    {
+        block_ChainRelease( p_pes );
+        return;
+    }
+
+    p_pesjob->job.pf_run = OutputPESJob;
+    p_pesjob->p_demux = p_demux;
+    p_pesjob->p_es = p_es;
+    p_pesjob->p_pes = p_pes;
+    p_pesjob->i_pes_size = i_pes_size;
+    p_pesjob->i_stream_id = i_stream_id;
+    /* only the demux thread can touch the ES state */
+    p_pesjob->i_flags = p_es->i_next_block_flags;
+    p_es->i_next_block_flags = 0;
+    p_pesjob->i_pcr = p_es->p_program->pcr.i_current;
+
+    ts_workers_Push( p_demux->p_sys->p_workers, pid->i_pid, &p_pesjob->job );
+}
+
 /****************************************************************************
  * gathering stuff
  ****************************************************************************/
 static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
 {
+    demux_sys_t *p_sys = p_demux->p_sys;
     uint8_t header[34];
     unsigned i_pes_size = 0;
     unsigned i_skip = 0;
@@ -1547,12 +1678,24 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
 
         p_pes->i_length = FROM_SCALE_NZ(i_length);
 
-        /* Can become a chain on next call due to prepcr */
-        block_t *p_chain = block_ChainGather( p_pes );
+        /* Can become a chain on next call due to prepcr.
+         * With output workers, reassembly is left to the worker and the
+         * first unit is the whole packets chain. */
+        bool b_async = p_sys->p_workers && !pid->u.p_stream->p_proc;
+        bool b_unit_chain = b_async;
+        block_t *p_chain = b_async ? p_pes : block_ChainGather( p_pes );
         while ( p_chain ) {
             block_t *p_block = p_chain;
-            p_chain = p_chain->p_next;
-            p_block->p_next = NULL;
+            if( b_unit_chain )
+            {
+                p_chain = NULL;
+                b_unit_chain = false;
+            }
+            else
+            {
+                p_chain = p_chain->p_next;
+                p_block->p_next = NULL;
+            }
 
             if( !p_pmt->pcr.b_fix_done ) /* Not seen yet */
                 PCRFixHandle( p_demux, p_pmt, p_block );
@@ -1561,6 +1704,9 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
             {
                 if( pid->u.p_stream->prepcr.p_head )
                 {
+                    p_block = block_ChainGather( p_block );
+                    if( unlikely(!p_block) )
+                        continue;
                     /* Rebuild current output chain, appending any prepcr outqueue */
                     block_ChainLastAppend( &pid->u.p_stream->prepcr.pp_last, p_block );
                     if( p_chain )
@@ -1606,8 +1752,16 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
 
                 /*** From here, block can become a chain again though conversion below ***/
 
+                if( b_async )
+                {
+                    OutputPESAsync( p_demux, pid, p_block, i_pes_size, i_stream_id );
+                    continue;
+                }
+
                 if( pid->u.p_stream->p_proc )
                 {
+                    /* Processors can change other ES */
+                    WaitPESOutput( p_sys );
                     if( p_block->i_flags & BLOCK_FLAG_DISCONTINUITY )
                         ts_stream_processor_Reset( pid->u.p_stream->p_proc );
                     p_block = ts_stream_processor_Push( pid->u.p_stream->p_proc, i_stream_id, p_block );
@@ -1615,17 +1769,25 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
                 else
                 /* Some codecs might need xform or AU splitting */
                 {
-                    p_block = ConvertPESBlock( p_demux, p_es, i_pes_size, i_stream_id, p_block );
+                    p_block = ConvertPESBlock( p_demux, p_es, i_pes_size, i_stream_id,
+                                               p_es->p_program->pcr.i_current, p_block );
                 }
 
-                SendDataChain( p_demux, p_es, p_block );
+                if( p_block )
+                {
+                    SendDataChain( p_demux, p_es, p_es->i_next_block_flags,
+                                   p_block );
+                    p_es->i_next_block_flags = 0;
+                }
             }
             else
             {
                 if( !p_pmt->pcr.b_fix_done ) /* Not seen yet */
                     PCRFixHandle( p_demux, p_pmt, p_block );
 
-                block_ChainLastAppend( &pid->u.p_stream->prepcr.pp_last, p_block );
+                p_block = block_ChainGather( p_block );
+                if( likely(p_block) )
+                    block_ChainLastAppend( &pid->u.p_stream->prepcr.pp_last, p_block );
 
                 /* PCR Seen and no es->id, cleanup current and prepcr blocks */
                 if( p_pmt->pcr.i_current > -1)
@@ -1684,79 +1846,194 @@ static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, bool
     return b_ret;
 }
 
-static block_t* ReadTSPacket( demux_t *p_demux )
+/* Bulk reading:
+ * The stream is read by chunks of up to TS_BULK_PACKETS packets into a single
+ * buffer, from which the packets are then parsed in place. The stream position
+ * is thus ahead of the demuxer position by the buffered amount. */
+static uint64_t TSTell( demux_sys_t *p_sys )
+{
+    return vlc_stream_Tell( p_sys->stream )
+         - ( p_sys->bulk.i_size - p_sys->bulk.i_pos );
+}
+
+static void TSBulkReset( demux_sys_t *p_sys )
+{
+    p_sys->bulk.i_size = p_sys->bulk.i_pos = 0;
+}
+
+static int TSSeek( demux_sys_t *p_sys, uint64_t i_pos )
+{
+    TSBulkReset( p_sys );
+    return vlc_stream_Seek( p_sys->stream, i_pos );
+}
+
+/* Gives the buffered data back to the stream, before a change of what reads
+ * it (recording, descrambling filter). The partial packet at the end of the
+ * buffer is completed first, so that the stream is left on a packet boundary
+ * even when it cannot seek back, in which case the buffered packets stay. */
+void TSBulkRewind( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_size = p_sys->i_packet_size;
+    size_t i_left = p_sys->bulk.i_size - p_sys->bulk.i_pos;
 
-    block_t     *p_pkt;
+    if( i_left % i_size )
+    {
+        memmove( p_sys->bulk.p_buffer,
+                 p_sys->bulk.p_buffer + p_sys->bulk.i_pos, i_left );
+        p_sys->bulk.i_pos = 0;
+        p_sys->bulk.i_size = i_left;
+
+        i_left += i_size - i_left % i_size;
+        ssize_t i_read = vlc_stream_Read( p_sys->stream,
+                                          p_sys->bulk.p_buffer + p_sys->bulk.i_size,
+                                          i_left - p_sys->bulk.i_size );
+        if( i_read > 0 )
+            p_sys->bulk.i_size += i_read;
+    }
 
-    /* Get a new TS packet */
-    if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+    if( p_sys->bulk.i_pos == p_sys->bulk.i_size )
+        TSBulkReset( p_sys );
+    else if( vlc_stream_Seek( p_sys->stream, TSTell( p_sys ) ) == VLC_SUCCESS )
+        TSBulkReset( p_sys );
+    else
+        msg_Warn( p_demux, "%zu buffered bytes cannot be read again",
+                  p_sys->bulk.i_size - p_sys->bulk.i_pos );
+}
+
+/* Makes sure at least i_len bytes are buffered after the current position */
+static bool TSBulkFill( demux_t *p_demux, size_t i_len )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_max = TS_BULK_PACKETS * p_sys->i_packet_size;
+
+    assert( i_len <= i_max );
+    if( p_sys->bulk.i_size - p_sys->bulk.i_pos >= i_len )
+        return true;
+
+    if( p_sys->bulk.p_buffer == NULL )
     {
-        int64_t size = stream_Size( p_sys->stream );
-        if( size >= 0 && (uint64_t)size == vlc_stream_Tell( p_sys->stream ) )
-            msg_Dbg( p_demux, "EOF at %"PRIu64, vlc_stream_Tell( p_sys->stream ) );
-        else
-            msg_Dbg( p_demux, "Can't read TS packet at %"PRIu64, vlc_stream_Tell(p_sys->stream) );
-        return NULL;
+        p_sys->bulk.p_buffer = malloc( i_max );
+        if( unlikely(p_sys->bulk.p_buffer == NULL) )
+            return false;
     }
 
-    if( p_pkt->i_buffer < TS_HEADER_SIZE + p_sys->i_packet_header_size )
+    /* Move the remaining partial data to the front */
+    p_sys->bulk.i_size -= p_sys->bulk.i_pos;
+    memmove( p_sys->bulk.p_buffer, p_sys->bulk.p_buffer + p_sys->bulk.i_pos,
+             p_sys->bulk.i_size );
+    p_sys->bulk.i_pos = 0;
+
+    while( p_sys->bulk.i_size < i_len )
     {
-        block_Release( p_pkt );
-        return NULL;
+        /* Do not wait for a whole chunk, only for the requested length */
+        ssize_t i_read = vlc_stream_ReadPartial( p_sys->stream,
+                                    p_sys->bulk.p_buffer + p_sys->bulk.i_size,
+                                    i_max - p_sys->bulk.i_size );
+        if( i_read == 0 )
+            return false;
+        if( i_read > 0 )
+            p_sys->bulk.i_size += i_read;
     }
+    return true;
+}
 
-    /* Skip header (BluRay streams).
-     * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
-     * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
-     */
-    p_pkt->p_buffer += p_sys->i_packet_header_size;
-    p_pkt->i_buffer -= p_sys->i_packet_header_size;
+/* Returns the next TS packet (including its extra header, if any) in the bulk
+ * buffer, re-synchronizing if needed. The packet is left in the buffer. */
+static const uint8_t * ReadTSPacketData( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_header = p_sys->i_packet_header_size;
+    const size_t i_size = p_sys->i_packet_size;
+
+    if( !TSBulkFill( p_demux, i_size ) )
+    {
+        int64_t size = stream_Size( p_sys->stream );
+        if( size >= 0 && (uint64_t)size == TSTell( p_sys ) )
+            msg_Dbg( p_demux, "EOF at %"PRIu64, TSTell( p_sys ) );
+        else
+            msg_Dbg( p_demux, "Can't read TS packet at %"PRIu64, TSTell( p_sys ) );
+        return NULL;
+    }
 
     /* Check sync byte and re-sync if needed */
-    if( p_pkt->p_buffer[0] != 0x47 )
+    if( likely(p_sys->bulk.p_buffer[p_sys->bulk.i_pos + i_header] == 0x47) )
+        return &p_sys->bulk.p_buffer[p_sys->bulk.i_pos];
+
+    msg_Warn( p_demux, "lost synchro" );
+    for( size_t i_skip = 1;; )
     {
-        msg_Warn( p_demux, "lost synchro" );
-        block_Release( p_pkt );
-        for( ;; )
+        /* A packet start is a sync byte followed by another one a packet
+         * later. Candidates are found with memchr(), which is vectorized. */
+        if( !TSBulkFill( p_demux, i_skip + i_header + i_size + 1 ) )
         {
-            const uint8_t *p_peek;
-            int i_peek = 0;
-            unsigned i_skip = 0;
-
-            i_peek = vlc_stream_Peek( p_sys->stream, &p_peek,
-                    p_sys->i_packet_size * 10 );
-            if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
-            {
-                msg_Dbg( p_demux, "eof ?" );
-                return NULL;
-            }
+            msg_Dbg( p_demux, "eof ?" );
+            return NULL;
+        }
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
-                {
-                    break;
-                }
-                i_skip++;
-            }
-            msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-            if (vlc_stream_Read( p_sys->stream, NULL, i_skip ) != i_skip)
-                return NULL;
+        const uint8_t *p_peek = &p_sys->bulk.p_buffer[p_sys->bulk.i_pos];
+        const size_t i_peek = p_sys->bulk.i_size - p_sys->bulk.i_pos;
+        const size_t i_last = i_peek - i_header - i_size; /* excluded */
+        const uint8_t *p_sync = NULL;
 
-            if( i_skip < i_peek - p_sys->i_packet_size )
+        while( i_skip < i_last )
+        {
+            p_sync = memchr( &p_peek[i_skip + i_header], 0x47, i_last - i_skip );
+            if( p_sync == NULL )
             {
+                i_skip = i_last;
                 break;
             }
+            i_skip = p_sync - p_peek - i_header;
+            if( p_sync[i_size] == 0x47 )
+                break;
+            p_sync = NULL;
+            i_skip++;
         }
-        if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+
+        if( p_sync != NULL )
         {
-            msg_Dbg( p_demux, "eof ?" );
-            return NULL;
+            msg_Dbg( p_demux, "skipping %zu bytes of garbage", i_skip );
+            p_sys->bulk.i_pos += i_skip;
+            return &p_sys->bulk.p_buffer[p_sys->bulk.i_pos];
+        }
+
+        /* Nothing found: drop the scanned bytes and read more */
+        if( i_skip + i_header + i_size + 1 > TS_BULK_PACKETS * i_size )
+        {
+            msg_Dbg( p_demux, "skipping %zu bytes of garbage", i_skip );
+            p_sys->bulk.i_pos += i_skip;
+            i_skip = 0;
         }
     }
+}
+
+static block_t* ReadTSPacket( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    const uint8_t *p_data = ReadTSPacketData( p_demux );
+    if( p_data == NULL )
+        return NULL;
+
+    /* The packet is copied out of the bulk buffer rather than referencing
+     * it: a pooled block_Alloc() and a packet-sized copy cost about as much
+     * as a referencing block (which also needs a header allocation and an
+     * atomic reference count), and references held by PES units gathered
+     * slowly would pin whole bulk buffers. */
+    block_t *p_pkt = block_Alloc( p_sys->i_packet_size );
+    if( unlikely(p_pkt == NULL) )
+        return NULL;
+    memcpy( p_pkt->p_buffer, p_data, p_sys->i_packet_size );
+    p_sys->bulk.i_pos += p_sys->i_packet_size;
+
+    /* Skip header (BluRay streams).
+     * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
+     * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
+     */
+    p_pkt->p_buffer += p_sys->i_packet_header_size;
+    p_pkt->i_buffer -= p_sys->i_packet_header_size;
+
     return p_pkt;
 }
 
@@ -1866,13 +2143,13 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
 
     /* Deal with common but worst binary search case */
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
-        return vlc_stream_Seek( p_sys->stream, 0 );
+        return TSSeek( p_sys, 0 );
 
     const int64_t i_stream_size = stream_Size( p_sys->stream );
     if( !p_sys->b_canfastseek || i_stream_size < p_sys->i_packet_size )
         return VLC_EGENERIC;
 
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = TSTell( p_sys );
 
     /* Find the time position by using binary search algorithm. */
     uint64_t i_head_pos = 0;
@@ -1888,7 +2165,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
         uint64_t i_div = i_splitpos % p_sys->i_packet_size;
         i_splitpos -= i_div;
 
-        if ( vlc_stream_Seek( p_sys->stream, i_splitpos ) != VLC_SUCCESS )
+        if ( TSSeek( p_sys, i_splitpos ) != VLC_SUCCESS )
             break;
 
         uint64_t i_pos = i_splitpos;
@@ -1902,7 +2179,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
                 break;
             }
             else
-                i_pos = vlc_stream_Tell( p_sys->stream );
+                i_pos = TSTell( p_sys );
 
             int i_pid = PIDGet( p_pkt );
             ts_pid_t *p_pid = GetPID(p_sys, i_pid);
@@ -1957,7 +2234,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( !b_found )
     {
         msg_Dbg( p_demux, "Seek():cannot find a time position." );
-        vlc_stream_Seek( p_sys->stream, i_initial_pos );
+        TSSeek( p_sys, i_initial_pos );
         return VLC_EGENERIC;
     }
     return VLC_SUCCESS;
@@ -2040,7 +2317,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
                         if( b_end )
                         {
                             p_pmt->i_last_dts = *pi_pcr;
-                            p_pmt->i_last_dts_byte = vlc_stream_Tell( p_sys->stream );
+                            p_pmt->i_last_dts_byte = TSTell( p_sys );
                         }
                         /* Start, only keep first */
                         else if( b_pcrresult && p_pmt->pcr.i_first == -1 )
@@ -2068,7 +2345,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
 int ProbeStart( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = TSTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = 0;
@@ -2081,7 +2358,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_pos = p_sys->i_packet_size * i_probe_count;
         i_pos = __MIN( i_pos, i_stream_size );
 
-        if( vlc_stream_Seek( p_sys->stream, i_pos ) )
+        if( TSSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, false, &i_pcr, &b_found );
@@ -2090,7 +2367,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (2 * PROBE_CHUNK_COUNT) );
 
-    if( vlc_stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( TSSeek( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -2099,7 +2376,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
 int ProbeEnd( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = TSTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = PROBE_CHUNK_COUNT;
@@ -2112,7 +2389,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_pos = i_stream_size - (p_sys->i_packet_size * i_probe_count);
         i_pos = __MAX( i_pos, 0 );
 
-        if( vlc_stream_Seek( p_sys->stream, i_pos ) )
+        if( TSSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, true, &i_pcr, &b_found );
@@ -2121,7 +2398,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (6 * PROBE_CHUNK_COUNT) );
 
-    if( vlc_stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( TSSeek( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -2131,6 +2408,9 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    /* Data of the program preceding the PCR must reach es_out first */
+    WaitProgramPESOutput( p_sys, p_pmt );
+
     /* Check if we have enqueued blocks waiting the/before the
        PCR barrier, and then adapt pcr so they have valid PCR when dequeuing */
     if( p_pmt->pcr.i_current == -1 && p_pmt->pcr.b_fix_done )
@@ -2172,10 +2452,10 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
         es_out_Control( p_demux->out, ES_OUT_SET_GROUP_PCR, p_pmt->i_number, FROM_SCALE(i_pcr) );
         /* growing files/named fifo handling */
         if( p_sys->b_access_control == false &&
-            vlc_stream_Tell( p_sys->stream ) > p_pmt->i_last_dts_byte )
+            TSTell( p_sys ) > p_pmt->i_last_dts_byte )
         {
             p_pmt->i_last_dts = i_pcr;
-            p_pmt->i_last_dts_byte = vlc_stream_Tell( p_sys->stream );
+            p_pmt->i_last_dts_byte = TSTell( p_sys );
         }
     }
 }
@@ -2788,6 +3068,7 @@ static void DoCreateES( demux_t *p_demux, ts_es_t *p_es, const ts_es_t *p_parent
 void AddAndCreateES( demux_t *p_demux, ts_pid_t *pid, bool b_create_delayed )
 {
     demux_sys_t  *p_sys = p_demux->p_sys;
+    WaitPESOutput( p_sys );
 
     if( b_create_delayed )
         p_sys->es_creation = CREATE_ES;
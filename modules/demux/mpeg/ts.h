@@ -25,6 +25,8 @@
 #endif
 typedef struct csa_t csa_t;
 
+#include "ts_workers.h"
+
 #define TS_USER_PMT_NUMBER (0)
 
 #define TS_PSI_PAT_PID 0x00
@@ -60,6 +62,17 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* Bulk read buffer: data read from the stream, not demuxed yet */
+    struct
+    {
+        uint8_t *p_buffer;
+        size_t   i_size;   /* buffered bytes */
+        size_t   i_pos;    /* position of the next packet */
+    } bulk;
+
+    /* PES output workers, NULL if output runs on the input thread */
+    ts_workers_t *p_workers;
+
     bool        b_ignore_time_for_positions;
 
     ts_standards_e standard;
@@ -133,6 +146,8 @@ bool ProgramIsSelected( demux_sys_t *, uint16_t i_pgrm );
 
 void UpdatePESFilters( demux_t *p_demux, bool b_all );
 
+void TSBulkRewind( demux_t *p_demux );
+
 int ProbeStart( demux_t *p_demux, int i_program );
 int ProbeEnd( demux_t *p_demux, int i_program );
 
@@ -0,0 +1,179 @@
+/*****************************************************************************
+ * ts_workers.c : TS demuxer PES output worker pool
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+
+#include <assert.h>
+
+#include "ts_workers.h"
+
+/* Max jobs waiting on a single worker before the demuxer thread blocks */
+#define TS_WORKER_QUEUE 64
+
+typedef struct
+{
+    vlc_thread_t     thread;
+    vlc_mutex_t      lock;
+    vlc_cond_t       wait;      /* signaled on new job / exit */
+    vlc_cond_t       wait_done; /* signaled on job completion */
+    ts_worker_job_t *p_first;
+    ts_worker_job_t **pp_last;
+    unsigned         i_queued;
+    bool             b_busy;
+    bool             b_exit;
+} ts_worker_t;
+
+struct ts_workers_t
+{
+    unsigned    i_count;
+    ts_worker_t workers[];
+};
+
+static void *ts_worker_Run( void *data )
+{
+    ts_worker_t *p_worker = data;
+
+    vlc_mutex_lock( &p_worker->lock );
+    for( ;; )
+    {
+        while( p_worker->p_first == NULL && !p_worker->b_exit )
+            vlc_cond_wait( &p_worker->wait, &p_worker->lock );
+
+        ts_worker_job_t *p_job = p_worker->p_first;
+        if( p_job == NULL )
+            break; /* exiting, and queue is drained */
+
+        p_worker->p_first = p_job->p_next;
+        if( p_worker->p_first == NULL )
+            p_worker->pp_last = &p_worker->p_first;
+        p_worker->i_queued--;
+        p_worker->b_busy = true;
+        vlc_mutex_unlock( &p_worker->lock );
+
+        p_job->p_next = NULL;
+        p_job->pf_run( p_job );
+
+        vlc_mutex_lock( &p_worker->lock );
+        p_worker->b_busy = false;
+        vlc_cond_broadcast( &p_worker->wait_done );
+    }
+    vlc_mutex_unlock( &p_worker->lock );
+
+    return NULL;
+}
+
+ts_workers_t * ts_workers_New( vlc_object_t *p_obj, unsigned i_count )
+{
+    ts_workers_t *p_pool = malloc( sizeof(*p_pool) + i_count * sizeof(ts_worker_t) );
+    if( unlikely(p_pool == NULL) )
+        return NULL;
+
+    p_pool->i_count = 0;
+    for( unsigned i=0; i<i_count; i++ )
+    {
+        ts_worker_t *p_worker = &p_pool->workers[i];
+        vlc_mutex_init( &p_worker->lock );
+        vlc_cond_init( &p_worker->wait );
+        vlc_cond_init( &p_worker->wait_done );
+        p_worker->p_first = NULL;
+        p_worker->pp_last = &p_worker->p_first;
+        p_worker->i_queued = 0;
+        p_worker->b_busy = false;
+        p_worker->b_exit = false;
+
+        if( vlc_clone( &p_worker->thread, ts_worker_Run, p_worker,
+                       VLC_THREAD_PRIORITY_INPUT ) )
+        {
+            vlc_cond_destroy( &p_worker->wait_done );
+            vlc_cond_destroy( &p_worker->wait );
+            vlc_mutex_destroy( &p_worker->lock );
+            break;
+        }
+        p_pool->i_count++;
+    }
+
+    if( p_pool->i_count == 0 )
+    {
+        free( p_pool );
+        return NULL;
+    }
+
+    msg_Dbg( p_obj, "using %u PES output workers", p_pool->i_count );
+    return p_pool;
+}
+
+void ts_workers_Delete( ts_workers_t *p_pool )
+{
+    for( unsigned i=0; i<p_pool->i_count; i++ )
+    {
+        ts_worker_t *p_worker = &p_pool->workers[i];
+
+        vlc_mutex_lock( &p_worker->lock );
+        p_worker->b_exit = true;
+        vlc_cond_signal( &p_worker->wait );
+        vlc_mutex_unlock( &p_worker->lock );
+
+        vlc_join( p_worker->thread, NULL );
+        assert( p_worker->p_first == NULL );
+
+        vlc_cond_destroy( &p_worker->wait_done );
+        vlc_cond_destroy( &p_worker->wait );
+        vlc_mutex_destroy( &p_worker->lock );
+    }
+    free( p_pool );
+}
+
+void ts_workers_Push( ts_workers_t *p_pool, unsigned i_key, ts_worker_job_t *p_job )
+{
+    ts_worker_t *p_worker = &p_pool->workers[i_key % p_pool->i_count];
+
+    p_job->p_next = NULL;
+
+    vlc_mutex_lock( &p_worker->lock );
+    while( p_worker->i_queued >= TS_WORKER_QUEUE )
+        vlc_cond_wait( &p_worker->wait_done, &p_worker->lock );
+
+    *p_worker->pp_last = p_job;
+    p_worker->pp_last = &p_job->p_next;
+    p_worker->i_queued++;
+    vlc_cond_signal( &p_worker->wait );
+    vlc_mutex_unlock( &p_worker->lock );
+}
+
+static void ts_worker_WaitIdle( ts_worker_t *p_worker )
+{
+    vlc_mutex_lock( &p_worker->lock );
+    while( p_worker->p_first != NULL || p_worker->b_busy )
+        vlc_cond_wait( &p_worker->wait_done, &p_worker->lock );
+    vlc_mutex_unlock( &p_worker->lock );
+}
+
+void ts_workers_Barrier( ts_workers_t *p_pool )
+{
+    for( unsigned i=0; i<p_pool->i_count; i++ )
+        ts_worker_WaitIdle( &p_pool->workers[i] );
+}
+
+void ts_workers_Wait( ts_workers_t *p_pool, unsigned i_key )
+{
+    ts_worker_WaitIdle( &p_pool->workers[i_key % p_pool->i_count] );
+}
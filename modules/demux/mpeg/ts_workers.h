@@ -0,0 +1,48 @@
+/*****************************************************************************
+ * ts_workers.h : TS demuxer PES output worker pool
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef VLC_TS_WORKERS_H
+#define VLC_TS_WORKERS_H
+
+typedef struct ts_workers_t ts_workers_t;
+typedef struct ts_worker_job_t ts_worker_job_t;
+
+/* Jobs are embedded into a caller defined structure.
+ * pf_run is called on the worker thread and owns the job afterwards. */
+struct ts_worker_job_t
+{
+    ts_worker_job_t *p_next;
+    void (*pf_run)( ts_worker_job_t * );
+};
+
+ts_workers_t * ts_workers_New( vlc_object_t *, unsigned i_count );
+void ts_workers_Delete( ts_workers_t * );
+
+/* Queues a job. All jobs pushed with the same key run on the same worker,
+ * in push order. Blocks while that worker's queue is full. */
+void ts_workers_Push( ts_workers_t *, unsigned i_key, ts_worker_job_t * );
+
+/* Waits until all pushed jobs have completed. Must be called before touching
+ * any state the jobs can access. */
+void ts_workers_Barrier( ts_workers_t * );
+
+/* Waits until the jobs pushed with that key have completed, along with the
+ * other jobs of its worker. */
+void ts_workers_Wait( ts_workers_t *, unsigned i_key );
+
+#endif
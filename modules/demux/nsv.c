@@ -51,6 +51,7 @@ vlc_module_begin ()
     set_category( CAT_INPUT )
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_callbacks( Open, Close )
+    set_probe_magic( 0, "NSV" )
     add_shortcut( "nsv" )
 vlc_module_end ()
 
@@ -54,6 +54,7 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_DEMUX )
     add_bool( "rawdv-hurry-up", false, HURRYUP_TEXT, HURRYUP_LONGTEXT, false )
     set_callbacks( Open, Close )
+    set_probe_extensions( "dv" )
     add_shortcut( "rawdv" )
 vlc_module_end ()
 
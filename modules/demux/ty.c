@@ -66,6 +66,8 @@ vlc_module_begin ()
      * Something must be wrong.
      */
     set_callbacks( Open, Close )
+    set_probe_extensions( "ty,ty+" )
+    set_probe_magic( 0, "\xf5\x46\x7a\xbd" ) /* TIVO_PES_FILEID */
     add_shortcut("ty", "tivo")
 vlc_module_end ()
 
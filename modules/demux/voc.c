@@ -45,6 +45,7 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_capability( "demux", 10 )
     set_callbacks( Open, Close )
+    set_probe_magic( 0, "Creative Voice File\x1a" )
 vlc_module_end ()
 
 /*****************************************************************************
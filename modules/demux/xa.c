@@ -46,6 +46,7 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_capability( "demux", 10 )
     set_callbacks( Open, Close )
+    set_probe_magic( 0, "XA" )
 vlc_module_end ()
 
 /*****************************************************************************
@@ -28,6 +28,8 @@
 
 #include <va/va.h>
 
+#include <inttypes.h>
+
 #include <vlc_common.h>
 #include <vlc_filter.h>
 #include <vlc_plugin.h>
@@ -45,10 +47,22 @@ struct filter_sys_t
     VASurfaceID *       va_surface_ids;
     copy_cache_t        cache;
 
+    /* One cache per slice of the readback, the first one is cache */
+    copy_cache_t *      slice_caches;
+    unsigned            slice_count;
+
+    /* Readback throughput */
+    uint64_t            download_count;
+    uint64_t            download_bytes;
+    mtime_t             download_time;
+
     bool                derive_failed;
     bool                image_fallback_failed;
 };
 
+/* Minimum number of lines per readback slice */
+#define SLICE_MIN_LINES 128
+
 static int CreateFallbackImage(filter_t *filter, picture_t *src_pic,
                                VADisplay va_dpy, VAImage *image_fallback)
 {
@@ -85,19 +99,28 @@ static int CreateFallbackImage(filter_t *filter, picture_t *src_pic,
 
 static inline void
 FillPictureFromVAImage(picture_t *dest,
-                       VAImage *src_img, uint8_t *src_buf, copy_cache_t *cache)
+                       VAImage *src_img, uint8_t *src_buf, copy_cache_t *cache,
+                       unsigned begin, unsigned end)
 {
     switch (src_img->format.fourcc)
     {
     case VA_FOURCC_NV12:
     {
-        uint8_t *       src_planes[2] = { src_buf + src_img->offsets[0],
-                                          src_buf + src_img->offsets[1] };
+        uint8_t *       src_planes[2] = {
+            src_buf + src_img->offsets[0] + begin * src_img->pitches[0],
+            src_buf + src_img->offsets[1] + begin / 2 * src_img->pitches[1] };
         size_t          src_pitches[2] = { src_img->pitches[0],
                                            src_img->pitches[1] };
+        picture_t       slice = { .i_planes = dest->i_planes };
 
-        CopyFromNv12ToI420(dest, src_planes, src_pitches,
-                           src_img->height, cache);
+        for (int i = 0; i < dest->i_planes; i++)
+        {
+            slice.p[i] = dest->p[i];
+            slice.p[i].p_pixels += (i ? begin / 2 : begin) * dest->p[i].i_pitch;
+        }
+
+        CopyFromNv12ToI420(&slice, src_planes, src_pitches,
+                           end - begin, cache);
         break;
     }
     /* TODO
@@ -109,6 +132,24 @@ FillPictureFromVAImage(picture_t *dest,
     }
 }
 
+struct download_slices
+{
+    picture_t *     dest;
+    VAImage *       src_img;
+    uint8_t *       src_buf;
+    copy_cache_t *  caches;
+};
+
+static void DownloadSlice(void *data, unsigned index, unsigned count)
+{
+    struct download_slices *sl = data;
+    unsigned begin, end;
+
+    filter_GetSliceLines(sl->src_img->height, index, count, 2, &begin, &end);
+    FillPictureFromVAImage(sl->dest, sl->src_img, sl->src_buf,
+                           &sl->caches[index], begin, end);
+}
+
 static picture_t *
 DownloadSurface(filter_t *filter, picture_t *src_pic)
 {
@@ -157,7 +198,25 @@ DownloadSurface(filter_t *filter, picture_t *src_pic)
     if (vlc_vaapi_MapBuffer(VLC_OBJECT(filter), va_dpy, src_img.buf, &src_buf))
         goto error;
 
-    FillPictureFromVAImage(dest, &src_img, src_buf, &filter->p_sys->cache);
+    /* Surfaces are read with streaming loads, which do not saturate the
+     * memory bus from a single core: large ones are split across threads */
+    struct download_slices slices = {
+        .dest = dest, .src_img = &src_img, .src_buf = src_buf,
+        .caches = filter_sys->slice_caches,
+    };
+    unsigned count = __MIN(filter_sys->slice_count,
+                           src_img.height / SLICE_MIN_LINES);
+    mtime_t start = mdate();
+
+    if (count > 1)
+        filter_ExecuteSlices(filter, DownloadSlice, &slices, count);
+    else
+        DownloadSlice(&slices, 0, 1);
+
+    filter_sys->download_time += mdate() - start;
+    filter_sys->download_count++;
+    filter_sys->download_bytes += (uint64_t)src_img.pitches[0] * src_img.height
+                    + (uint64_t)src_img.pitches[1] * (src_img.height / 2);
 
     vlc_vaapi_UnmapBuffer(VLC_OBJECT(filter), va_dpy, src_img.buf);
     vlc_vaapi_DestroyImage(VLC_OBJECT(filter), va_dpy, src_img.image_id);
@@ -323,19 +382,39 @@ vlc_vaapi_OpenChroma(vlc_object_t *obj)
     }
 
     if (CopyInitCache(&filter_sys->cache, filter->fmt_in.video.i_width))
+        goto error;
+
+    filter_sys->slice_caches = &filter_sys->cache;
+    filter_sys->slice_count = 1;
+    if (!is_upload)
     {
-        if (is_upload)
+        unsigned count = filter_GetSliceCount(filter);
+        copy_cache_t *caches = count > 1 ? malloc(count * sizeof (*caches))
+                                         : NULL;
+        if (caches != NULL)
         {
-            picture_pool_Release(filter_sys->dest_pics);
-            vlc_vaapi_FilterReleaseInstance(filter, filter_sys->va_inst);
+            caches[0] = filter_sys->cache;
+            for (filter_sys->slice_count = 1;
+                 filter_sys->slice_count < count; filter_sys->slice_count++)
+                if (CopyInitCache(&caches[filter_sys->slice_count],
+                                  filter->fmt_in.video.i_width))
+                    break;
+            filter_sys->slice_caches = caches;
         }
-        free(filter_sys);
-        return VLC_EGENERIC;
     }
 
     filter->p_sys = filter_sys;
 
     return VLC_SUCCESS;
+
+error:
+    if (is_upload)
+    {
+        picture_pool_Release(filter_sys->dest_pics);
+        vlc_vaapi_FilterReleaseInstance(filter, filter_sys->va_inst);
+    }
+    free(filter_sys);
+    return VLC_EGENERIC;
 }
 
 void
@@ -348,6 +427,20 @@ vlc_vaapi_CloseChroma(vlc_object_t *obj)
         picture_pool_Release(filter_sys->dest_pics);
     if (filter_sys->va_inst != NULL)
         vlc_vaapi_FilterReleaseInstance(filter, filter_sys->va_inst);
+
+    if (filter_sys->download_count > 0)
+        msg_Dbg(filter, "read back %"PRIu64" surfaces in %"PRId64" ms, "
+                "%.1f MB/s (%u slices)", filter_sys->download_count,
+                filter_sys->download_time / 1000,
+                filter_sys->download_time > 0
+                    ? (double)filter_sys->download_bytes
+                      / filter_sys->download_time : 0.,
+                filter_sys->slice_count);
+
+    for (unsigned i = 1; i < filter_sys->slice_count; i++)
+        CopyCleanCache(&filter_sys->slice_caches[i]);
+    if (filter_sys->slice_caches != &filter_sys->cache)
+        free(filter_sys->slice_caches);
     CopyCleanCache(&filter_sys->cache);
 
     free(filter_sys);
@@ -396,8 +396,10 @@ static subpicture_t *FilterSub( filter_t *p_filter, mtime_t date )
         goto exit;
     }
 
-    /* */
-    picture_Copy( p_region->p_picture, p_pic );
+    /* Share the logo picture: it is never modified once loaded, and the
+     * SPU renderer can then reuse its scaled version for every subpicture */
+    picture_Release( p_region->p_picture );
+    p_region->p_picture = picture_Hold( p_pic );
 
     /*  where to locate the logo: */
     if( p_sys->i_pos < 0 )
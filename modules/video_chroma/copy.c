@@ -32,6 +32,7 @@
 #include <assert.h>
 
 #include "copy.h"
+#include "pack.h"
 
 int CopyInitCache(copy_cache_t *cache, unsigned width)
 {
@@ -185,6 +186,20 @@ SSE_InterleaveUV(uint8_t *dst, size_t dst_pitch,
     assert(!((intptr_t)srcu & 0xf) && !(srcu_pitch & 0x0f) &&
            !((intptr_t)srcv & 0xf) && !(srcv_pitch & 0x0f));
 
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        for (unsigned y = 0; y < height; y++)
+        {
+            pack_uv8_avx2(dst, srcu, srcv, width);
+            srcu += srcu_pitch;
+            srcv += srcv_pitch;
+            dst += dst_pitch;
+        }
+        return;
+    }
+#endif
+
 #if defined(__SSSE3__) || !defined (CAN_COMPILE_SSSE3)
     VLC_UNUSED(cpu);
 #endif
@@ -294,6 +309,20 @@ static void SSE_SplitUV(uint8_t *dstu, size_t dstu_pitch,
 
     assert(((intptr_t)src & 0xf) == 0 && (src_pitch & 0x0f) == 0);
 
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        for (unsigned y = 0; y < height; y++)
+        {
+            unpack_uv8_avx2(dstu, dstv, src, width);
+            src  += src_pitch;
+            dstu += dstu_pitch;
+            dstv += dstv_pitch;
+        }
+        return;
+    }
+#endif
+
     for (unsigned y = 0; y < height; y++) {
         unsigned x = 0;
 
@@ -366,30 +395,45 @@ static void SSE_SplitUV(uint8_t *dstu, size_t dstu_pitch,
     }
 }
 
+/* The copies from the (USWC) source go through the cache in blocks of lines,
+ * so that each block is read with streaming loads and converted to the
+ * destination while it is still in the CPU cache. Lines wider than the cache
+ * are split into columns, so any pitch works with any cache size. */
+static unsigned CacheColumns(size_t cache_size, unsigned width)
+{
+    return __MIN((width + 63) & ~63, cache_size & ~63);
+}
+
 static void SSE_CopyPlane(uint8_t *dst, size_t dst_pitch,
                           const uint8_t *src, size_t src_pitch,
                           uint8_t *cache, size_t cache_size,
                           unsigned height, unsigned cpu)
 {
-    const unsigned w16 = (src_pitch+15) & ~15;
-    const unsigned hstep = cache_size / w16;
-    assert(hstep > 0);
-
-    if (src_pitch == dst_pitch)
+    const unsigned width = __MIN(src_pitch, dst_pitch);
+    const unsigned wstep = CacheColumns(cache_size, width);
+    if (wstep == 0)
+        return;
+    const unsigned hstep = cache_size / wstep;
+
+    /* Without streaming loads, the cache does not help */
+    if (!vlc_CPU_SSE4_1() && src_pitch == dst_pitch) {
         memcpy(dst, src, src_pitch * height);
-    else
+        return;
+    }
+
     for (unsigned y = 0; y < height; y += hstep) {
         const unsigned hblock =  __MIN(hstep, height - y);
 
-        /* Copy a bunch of line into our cache */
-        CopyFromUswc(cache, w16,
-                     src, src_pitch,
-                     src_pitch, hblock, cpu);
+        for (unsigned x = 0; x < width; x += wstep) {
+            const unsigned wblock = __MIN(wstep, width - x);
 
-        /* Copy from our cache to the destination */
-        Copy2d(dst, dst_pitch,
-               cache, w16,
-               src_pitch, hblock);
+            /* Copy a bunch of line into our cache */
+            CopyFromUswc(cache, wstep, src + x, src_pitch,
+                         wblock, hblock, cpu);
+
+            /* Copy from our cache to the destination */
+            Copy2d(dst + x, dst_pitch, cache, wstep, wblock, hblock);
+        }
 
         /* */
         src += src_pitch * hblock;
@@ -406,23 +450,31 @@ SSE_InterleavePlanes(uint8_t *dst, size_t dst_pitch,
                      unsigned int cpu)
 {
     assert(srcu_pitch == srcv_pitch);
-    unsigned int const  w16 = (srcu_pitch+15) & ~15;
-    unsigned int const  hstep = (cache_size) / (2*w16);
-    assert(hstep > 0);
+    unsigned int const  width = __MIN(srcu_pitch, dst_pitch / 2);
+    unsigned int const  wstep = CacheColumns(cache_size / 2, width);
+    if (wstep == 0)
+        return;
+    unsigned int const  hstep = cache_size / (2 * wstep);
 
     for (unsigned int y = 0; y < height; y += hstep)
     {
         unsigned int const      hblock = __MIN(hstep, height - y);
 
-        /* Copy a bunch of line into our cache */
-        CopyFromUswc(cache, w16, srcu, srcu_pitch,
-                     srcu_pitch, hblock, cpu);
-        CopyFromUswc(cache+w16*hblock, w16, srcv, srcv_pitch,
-                     srcv_pitch, hblock, cpu);
-
-        /* Copy from our cache to the destination */
-        SSE_InterleaveUV(dst, dst_pitch, cache, w16,
-                         cache+w16*hblock, w16, srcu_pitch, hblock, cpu);
+        for (unsigned int x = 0; x < width; x += wstep)
+        {
+            unsigned int const  wblock = __MIN(wstep, width - x);
+            uint8_t *const      cachev = cache + wstep * hblock;
+
+            /* Copy a bunch of line into our cache */
+            CopyFromUswc(cache, wstep, srcu + x, srcu_pitch,
+                         wblock, hblock, cpu);
+            CopyFromUswc(cachev, wstep, srcv + x, srcv_pitch,
+                         wblock, hblock, cpu);
+
+            /* Copy from our cache to the destination */
+            SSE_InterleaveUV(dst + 2 * x, dst_pitch, cache, wstep,
+                             cachev, wstep, wblock, hblock, cpu);
+        }
 
         /* */
         srcu += hblock * srcu_pitch;
@@ -437,20 +489,28 @@ static void SSE_SplitPlanes(uint8_t *dstu, size_t dstu_pitch,
                             uint8_t *cache, size_t cache_size,
                             unsigned height, unsigned cpu)
 {
-    const unsigned w16 = (src_pitch+15) & ~15;
-    const unsigned hstep = cache_size / w16;
-    assert(hstep > 0);
+    /* In bytes of the source, i.e. twice the samples of each destination */
+    const unsigned width = __MIN(src_pitch,
+                                 2 * __MIN(dstu_pitch, dstv_pitch)) & ~1u;
+    const unsigned wstep = CacheColumns(cache_size, width);
+    if (wstep == 0)
+        return;
+    const unsigned hstep = cache_size / wstep;
 
     for (unsigned y = 0; y < height; y += hstep) {
         const unsigned hblock =  __MIN(hstep, height - y);
 
-        /* Copy a bunch of line into our cache */
-        CopyFromUswc(cache, w16, src, src_pitch,
-                     src_pitch, hblock, cpu);
+        for (unsigned x = 0; x < width; x += wstep) {
+            const unsigned wblock = __MIN(wstep, width - x);
+
+            /* Copy a bunch of line into our cache */
+            CopyFromUswc(cache, wstep, src + x, src_pitch,
+                         wblock, hblock, cpu);
 
-        /* Copy from our cache to the destination */
-        SSE_SplitUV(dstu, dstu_pitch, dstv, dstv_pitch,
-                    cache, w16, src_pitch, hblock, cpu);
+            /* Copy from our cache to the destination */
+            SSE_SplitUV(dstu + x / 2, dstu_pitch, dstv + x / 2, dstv_pitch,
+                        cache, wstep, wblock / 2, hblock, cpu);
+        }
 
         /* */
         src  += src_pitch  * hblock;
@@ -549,7 +609,7 @@ static void CopyPlane(uint8_t *dst, size_t dst_pitch,
         memcpy(dst, src, src_pitch * height);
     else
     for (unsigned y = 0; y < height; y++) {
-        memcpy(dst, src, src_pitch);
+        memcpy(dst, src, __MIN(src_pitch, dst_pitch));
         src += src_pitch;
         dst += dst_pitch;
     }
@@ -560,11 +620,10 @@ static void SplitPlanes(uint8_t *dstu, size_t dstu_pitch,
                         const uint8_t *src, size_t src_pitch,
                         unsigned height)
 {
+    const unsigned width = __MIN(src_pitch / 2, __MIN(dstu_pitch, dstv_pitch));
+
     for (unsigned y = 0; y < height; y++) {
-        for (unsigned x = 0; x < src_pitch / 2; x++) {
-            dstu[x] = src[2*x+0];
-            dstv[x] = src[2*x+1];
-        }
+        unpack_uv8_c(dstu, dstv, src, width);
         src  += src_pitch;
         dstu += dstu_pitch;
         dstv += dstv_pitch;
@@ -642,25 +701,17 @@ void CopyFromI420ToNv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
               src[0], src_pitch[0], height);
 
     const unsigned copy_lines = height / 2;
-    const unsigned copy_pitch = src_pitch[1];
-
-    const int i_extra_pitch_uv = dst->p[1].i_pitch - 2 * copy_pitch;
-    const int i_extra_pitch_u  = src_pitch[U_PLANE] - copy_pitch;
-    const int i_extra_pitch_v  = src_pitch[V_PLANE] - copy_pitch;
+    const unsigned copy_pitch = __MIN(src_pitch[U_PLANE],
+                                      (size_t)dst->p[1].i_pitch / 2);
 
     uint8_t *dstUV = dst->p[1].p_pixels;
-    uint8_t *srcU  = src[U_PLANE];
-    uint8_t *srcV  = src[V_PLANE];
-    for ( unsigned int line = 0; line < copy_lines; line++ )
-    {
-        for ( unsigned int col = 0; col < copy_pitch; col++ )
-        {
-            *dstUV++ = *srcU++;
-            *dstUV++ = *srcV++;
-        }
-        dstUV += i_extra_pitch_uv;
-        srcU  += i_extra_pitch_u;
-        srcV  += i_extra_pitch_v;
+    const uint8_t *srcU = src[U_PLANE];
+    const uint8_t *srcV = src[V_PLANE];
+    for (unsigned line = 0; line < copy_lines; line++) {
+        pack_uv8_c(dstUV, srcU, srcV, copy_pitch);
+        dstUV += dst->p[1].i_pitch;
+        srcU  += src_pitch[U_PLANE];
+        srcV  += src_pitch[V_PLANE];
     }
 }
 
@@ -669,42 +720,41 @@ void CopyFromI420_10ToP010(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
 {
     (void) cache;
 
-    const int i_extra_pitch_dst_y = (dst->p[0].i_pitch  - src_pitch[0]) / 2;
-    const int i_extra_pitch_src_y = (src_pitch[Y_PLANE] - src_pitch[0]) / 2;
-    uint16_t *dstY = dst->p[0].p_pixels;
-    uint16_t *srcY = src[Y_PLANE];
+    shift16_t shift = shift16_c;
+    pack_uv16_t pack = pack_uv16_c;
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        shift = shift16_avx2;
+        pack = pack_uv16_avx2;
+    }
+#endif
+
+    uint8_t *dstY = dst->p[0].p_pixels;
+    const uint8_t *srcY = src[Y_PLANE];
     for (unsigned y = 0; y < height; y++) {
-        for (unsigned x = 0; x < (src_pitch[0] / 2); x++) {
-            *dstY++ = *srcY++ << 6;
-        }
-        dstY += i_extra_pitch_dst_y;
-        srcY += i_extra_pitch_src_y;
+        shift((uint16_t *)dstY, (const uint16_t *)srcY,
+              __MIN(src_pitch[Y_PLANE], (size_t)dst->p[0].i_pitch) / 2, 6);
+        dstY += dst->p[0].i_pitch;
+        srcY += src_pitch[Y_PLANE];
     }
 
     const unsigned copy_lines = height / 2;
-    const unsigned copy_pitch = src_pitch[1] / 2;
-
-    const int i_extra_pitch_uv = dst->p[1].i_pitch / 2 - 2 * copy_pitch;
-    const int i_extra_pitch_u  = src_pitch[U_PLANE] / 2 - copy_pitch;
-    const int i_extra_pitch_v  = src_pitch[V_PLANE] / 2 - copy_pitch;
+    const unsigned copy_pitch = __MIN(src_pitch[U_PLANE],
+                                      (size_t)dst->p[1].i_pitch / 2) / 2;
 
-    uint16_t *dstUV = dst->p[1].p_pixels;
-    uint16_t *srcU  = src[U_PLANE];
-    uint16_t *srcV  = src[V_PLANE];
-    for ( unsigned int line = 0; line < copy_lines; line++ )
-    {
-        for ( unsigned int col = 0; col < copy_pitch; col++ )
-        {
-            *dstUV++ = *srcU++ << 6;
-            *dstUV++ = *srcV++ << 6;
-        }
-        dstUV += i_extra_pitch_uv;
-        srcU  += i_extra_pitch_u;
-        srcV  += i_extra_pitch_v;
+    uint8_t *dstUV = dst->p[1].p_pixels;
+    const uint8_t *srcU = src[U_PLANE];
+    const uint8_t *srcV = src[V_PLANE];
+    for (unsigned line = 0; line < copy_lines; line++) {
+        pack((uint16_t *)dstUV, (const uint16_t *)srcU,
+             (const uint16_t *)srcV, copy_pitch, 6);
+        dstUV += dst->p[1].i_pitch;
+        srcU  += src_pitch[U_PLANE];
+        srcV  += src_pitch[V_PLANE];
     }
 }
 
-
 void CopyFromYv12ToYv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
                         unsigned height, copy_cache_t *cache)
 {
@@ -33,6 +33,9 @@
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#include "pack.h"
 
 #define SRC_FOURCC  "GREY"
 #define DEST_FOURCC "I420,YUY2"
@@ -111,46 +114,23 @@ VIDEO_FILTER_WRAPPER( GREY_YUY2 )
 static void GREY_I420( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
-    uint8_t *p_line = p_source->p->p_pixels;
-    uint8_t *p_y = p_dest->Y_PIXELS;
-    uint8_t *p_u = p_dest->U_PIXELS;
-    uint8_t *p_v = p_dest->V_PIXELS;
-
-    int i_x, i_y;
-
-    const int i_source_margin = p_source->p->i_pitch
-                                 - p_source->p->i_visible_pitch;
-    const int i_dest_margin = p_dest->p[0].i_pitch
-                               - p_dest->p[0].i_visible_pitch;
-    const int i_dest_margin_c = p_dest->p[1].i_pitch
-                                 - p_dest->p[1].i_visible_pitch;
-
-    for( i_y = p_filter->fmt_in.video.i_height / 2; i_y-- ; )
-    {
-        memset(p_u, 0x80, p_dest->p[1].i_visible_pitch);
-        p_u += i_dest_margin_c;
-
-        memset(p_v, 0x80, p_dest->p[1].i_visible_pitch);
-        p_v += i_dest_margin_c;
-    }
-
-    for( i_y = p_filter->fmt_in.video.i_height; i_y-- ; )
+    const unsigned i_width = p_filter->fmt_in.video.i_width;
+    const unsigned i_height = p_filter->fmt_in.video.i_height;
+    const plane_t *p_in = p_source->p;
+    plane_t *p_y = &p_dest->p[Y_PLANE];
+    plane_t *p_u = &p_dest->p[U_PLANE];
+    plane_t *p_v = &p_dest->p[V_PLANE];
+
+    for( unsigned i_y = 0; i_y < i_height; i_y++ )
+        memcpy( p_y->p_pixels + i_y * p_y->i_pitch,
+                p_in->p_pixels + i_y * p_in->i_pitch, i_width );
+
+    for( unsigned i_y = 0; i_y < i_height / 2; i_y++ )
     {
-        for( i_x = p_filter->fmt_in.video.i_width / 8; i_x-- ; )
-        {
-            *p_y++ = *p_line++; *p_y++ = *p_line++;
-            *p_y++ = *p_line++; *p_y++ = *p_line++;
-            *p_y++ = *p_line++; *p_y++ = *p_line++;
-            *p_y++ = *p_line++; *p_y++ = *p_line++;
-        }
-
-        for( i_x = p_filter->fmt_in.video.i_width % 8; i_x-- ; )
-        {
-            *p_y++ = *p_line++;
-        }
-
-        p_line += i_source_margin;
-        p_y += i_dest_margin;
+        memset( p_u->p_pixels + i_y * p_u->i_pitch, 0x80,
+                p_u->i_visible_pitch );
+        memset( p_v->p_pixels + i_y * p_v->i_pitch, 0x80,
+                p_v->i_visible_pitch );
     }
 }
 
@@ -160,38 +140,14 @@ static void GREY_I420( filter_t *p_filter, picture_t *p_source,
 static void GREY_YUY2( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
-    uint8_t *p_in = p_source->p->p_pixels;
-    uint8_t *p_out = p_dest->p->p_pixels;
-
-    int i_x, i_y;
-
-    const int i_source_margin = p_source->p->i_pitch
-                                 - p_source->p->i_visible_pitch;
-    const int i_dest_margin = p_dest->p->i_pitch
-                               - p_dest->p->i_visible_pitch;
+    pack_grey_t pack = pack_grey_c;
+#ifdef CAN_COMPILE_AVX2
+    if( vlc_CPU_AVX2() )
+        pack = pack_grey_avx2;
+#endif
 
-    for( i_y = p_filter->fmt_out.video.i_height; i_y-- ; )
-    {
-        for( i_x = p_filter->fmt_out.video.i_width / 8; i_x-- ; )
-        {
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-        }
-
-        for( i_x = (p_filter->fmt_out.video.i_width % 8) / 2; i_x-- ; )
-        {
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-            *p_out++ = *p_in++; *p_out++ = 0x80;
-        }
-
-        p_in += i_source_margin;
-        p_out += i_dest_margin;
-    }
+    for( unsigned i_y = 0; i_y < p_filter->fmt_out.video.i_height; i_y++ )
+        pack( p_dest->p->p_pixels + i_y * p_dest->p->i_pitch,
+              p_source->p->p_pixels + i_y * p_source->p->i_pitch,
+              p_filter->fmt_out.video.i_width & ~1u );
 }
-
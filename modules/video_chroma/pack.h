@@ -0,0 +1,303 @@
+/*****************************************************************************
+ * pack.h: line kernels for packed and semi-planar YUV/RGB conversions
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Each conversion moves one line of n pixels (or chroma samples) and has a
+ * C version and, when it can be compiled, an AVX2 version. The AVX2 versions
+ * only read and write the same bytes as the C ones: the pixels that do not
+ * fill a whole vector at the end of the line are handled by the C version.
+ *
+ * 4:2:2 packed lines are YUYV (or YVYU with U and V swapped) or UYVY. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef CAN_COMPILE_AVX2
+# include <immintrin.h>
+#endif
+
+typedef void (*pack_uv8_t)(uint8_t *, const uint8_t *, const uint8_t *,
+                           unsigned);
+typedef void (*unpack_uv8_t)(uint8_t *, uint8_t *, const uint8_t *,
+                             unsigned);
+typedef void (*pack_uv16_t)(uint16_t *, const uint16_t *, const uint16_t *,
+                            unsigned, unsigned);
+typedef void (*shift16_t)(uint16_t *, const uint16_t *, unsigned, unsigned);
+typedef void (*unpack_422_t)(uint8_t *, uint8_t *, uint8_t *,
+                             const uint8_t *, unsigned, bool);
+typedef void (*pack_grey_t)(uint8_t *, const uint8_t *, unsigned);
+typedef void (*rgb24_rgb32_t)(uint8_t *, const uint8_t *, unsigned);
+
+/** Interleaves n U and n V samples (I420 to NV12) */
+static inline void pack_uv8_c(uint8_t *restrict uv, const uint8_t *u,
+                              const uint8_t *v, unsigned n)
+{
+    for (unsigned x = 0; x < n; x++)
+    {
+        uv[2 * x]     = u[x];
+        uv[2 * x + 1] = v[x];
+    }
+}
+
+/** Splits n interleaved U and V samples (NV12 to I420) */
+static inline void unpack_uv8_c(uint8_t *restrict u, uint8_t *restrict v,
+                                const uint8_t *uv, unsigned n)
+{
+    for (unsigned x = 0; x < n; x++)
+    {
+        u[x] = uv[2 * x];
+        v[x] = uv[2 * x + 1];
+    }
+}
+
+/** Interleaves n U and n V 16-bits samples shifted left (I420_10 to P010) */
+static inline void pack_uv16_c(uint16_t *restrict uv, const uint16_t *u,
+                               const uint16_t *v, unsigned n, unsigned shift)
+{
+    for (unsigned x = 0; x < n; x++)
+    {
+        uv[2 * x]     = u[x] << shift;
+        uv[2 * x + 1] = v[x] << shift;
+    }
+}
+
+/** Shifts n 16-bits samples left */
+static inline void shift16_c(uint16_t *restrict dst, const uint16_t *src,
+                             unsigned n, unsigned shift)
+{
+    for (unsigned x = 0; x < n; x++)
+        dst[x] = src[x] << shift;
+}
+
+/**
+ * Splits a packed 4:2:2 line of n pixels (n even) into its planes. The
+ * chroma samples are skipped if u is NULL.
+ */
+static inline void unpack_422_c(uint8_t *restrict y, uint8_t *restrict u,
+                                uint8_t *restrict v, const uint8_t *src,
+                                unsigned n, bool uyvy)
+{
+    const unsigned oy = uyvy ? 1 : 0, oc = uyvy ? 0 : 1;
+
+    for (unsigned x = 0; x < n / 2; x++)
+    {
+        y[2 * x]     = src[4 * x + oy];
+        y[2 * x + 1] = src[4 * x + oy + 2];
+        if (u != NULL)
+        {
+            u[x] = src[4 * x + oc];
+            v[x] = src[4 * x + oc + 2];
+        }
+    }
+}
+
+/** Packs n grey pixels (n even) into YUYV */
+static inline void pack_grey_c(uint8_t *restrict dst, const uint8_t *src,
+                               unsigned n)
+{
+    for (unsigned x = 0; x < n; x++)
+    {
+        dst[2 * x]     = src[x];
+        dst[2 * x + 1] = 0x80;
+    }
+}
+
+/** Converts n RGB24 pixels to RGB32, swapping red and blue */
+static inline void rgb24_rgb32_c(uint8_t *restrict dst, const uint8_t *src,
+                                 unsigned n)
+{
+    for (unsigned x = 0; x < n; x++)
+    {
+        dst[4 * x]     = src[3 * x + 2];
+        dst[4 * x + 1] = src[3 * x + 1];
+        dst[4 * x + 2] = src[3 * x];
+        dst[4 * x + 3] = 0xff;
+    }
+}
+
+#ifdef CAN_COMPILE_AVX2
+/* The unpack instructions interleave within each 128-bits lane: the
+ * results are put back in order by exchanging the lanes. */
+#define STORE_LANES(p, lo, hi) do { \
+    _mm256_storeu_si256((__m256i *)(p), \
+                        _mm256_permute2x128_si256(lo, hi, 0x20)); \
+    _mm256_storeu_si256((__m256i *)(p) + 1, \
+                        _mm256_permute2x128_si256(lo, hi, 0x31)); \
+} while (0)
+
+VLC_AVX2
+static inline void pack_uv8_avx2(uint8_t *restrict uv, const uint8_t *u,
+                                 const uint8_t *v, unsigned n)
+{
+    unsigned x = 0;
+
+    for (; x + 32 <= n; x += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&u[x]);
+        __m256i b = _mm256_loadu_si256((const __m256i *)&v[x]);
+
+        STORE_LANES(&uv[2 * x], _mm256_unpacklo_epi8(a, b),
+                    _mm256_unpackhi_epi8(a, b));
+    }
+    pack_uv8_c(&uv[2 * x], &u[x], &v[x], n - x);
+}
+
+/* Deinterleaves the even and odd bytes of 64 bytes: the even ones are
+ * returned in the low 128-bits of each lane, the odd ones in the high */
+VLC_AVX2
+static inline void deinterleave8_avx2(const uint8_t *src, __m256i *even,
+                                      __m256i *odd)
+{
+    const __m256i mask = _mm256_set1_epi16(0xff);
+    __m256i a = _mm256_loadu_si256((const __m256i *)src);
+    __m256i b = _mm256_loadu_si256((const __m256i *)src + 1);
+
+    *even = _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_and_si256(a, mask),
+                            _mm256_and_si256(b, mask)), 0xd8);
+    *odd = _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_srli_epi16(a, 8),
+                            _mm256_srli_epi16(b, 8)), 0xd8);
+}
+
+VLC_AVX2
+static inline void unpack_uv8_avx2(uint8_t *restrict u, uint8_t *restrict v,
+                                   const uint8_t *uv, unsigned n)
+{
+    unsigned x = 0;
+
+    for (; x + 32 <= n; x += 32)
+    {
+        __m256i even, odd;
+
+        deinterleave8_avx2(&uv[2 * x], &even, &odd);
+        _mm256_storeu_si256((__m256i *)&u[x], even);
+        _mm256_storeu_si256((__m256i *)&v[x], odd);
+    }
+    unpack_uv8_c(&u[x], &v[x], &uv[2 * x], n - x);
+}
+
+VLC_AVX2
+static inline void pack_uv16_avx2(uint16_t *restrict uv, const uint16_t *u,
+                                  const uint16_t *v, unsigned n,
+                                  unsigned shift)
+{
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    unsigned x = 0;
+
+    for (; x + 16 <= n; x += 16)
+    {
+        __m256i a = _mm256_sll_epi16(
+            _mm256_loadu_si256((const __m256i *)&u[x]), count);
+        __m256i b = _mm256_sll_epi16(
+            _mm256_loadu_si256((const __m256i *)&v[x]), count);
+
+        STORE_LANES(&uv[2 * x], _mm256_unpacklo_epi16(a, b),
+                    _mm256_unpackhi_epi16(a, b));
+    }
+    pack_uv16_c(&uv[2 * x], &u[x], &v[x], n - x, shift);
+}
+
+VLC_AVX2
+static inline void shift16_avx2(uint16_t *restrict dst, const uint16_t *src,
+                                unsigned n, unsigned shift)
+{
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    unsigned x = 0;
+
+    for (; x + 16 <= n; x += 16)
+        _mm256_storeu_si256((__m256i *)&dst[x], _mm256_sll_epi16(
+            _mm256_loadu_si256((const __m256i *)&src[x]), count));
+    shift16_c(&dst[x], &src[x], n - x, shift);
+}
+
+VLC_AVX2
+static inline void unpack_422_avx2(uint8_t *restrict y, uint8_t *restrict u,
+                                   uint8_t *restrict v, const uint8_t *src,
+                                   unsigned n, bool uyvy)
+{
+    unsigned x = 0;
+
+    for (; x + 32 <= n; x += 32)
+    {
+        __m256i even, odd;
+
+        deinterleave8_avx2(&src[2 * x], &even, &odd);
+        _mm256_storeu_si256((__m256i *)&y[x], uyvy ? odd : even);
+        if (u != NULL)
+        {
+            /* 16 U and 16 V, interleaved */
+            __m256i c = uyvy ? even : odd;
+            __m256i mask = _mm256_set1_epi16(0xff);
+
+            c = _mm256_permute4x64_epi64(
+                _mm256_packus_epi16(_mm256_and_si256(c, mask),
+                                    _mm256_srli_epi16(c, 8)), 0xd8);
+            _mm_storeu_si128((__m128i *)&u[x / 2],
+                             _mm256_castsi256_si128(c));
+            _mm_storeu_si128((__m128i *)&v[x / 2],
+                             _mm256_extracti128_si256(c, 1));
+        }
+    }
+    unpack_422_c(&y[x], u ? &u[x / 2] : NULL, u ? &v[x / 2] : NULL,
+                 &src[2 * x], n - x, uyvy);
+}
+
+VLC_AVX2
+static inline void pack_grey_avx2(uint8_t *restrict dst, const uint8_t *src,
+                                  unsigned n)
+{
+    const __m256i c = _mm256_set1_epi8(0x80);
+    unsigned x = 0;
+
+    for (; x + 32 <= n; x += 32)
+    {
+        __m256i g = _mm256_loadu_si256((const __m256i *)&src[x]);
+
+        STORE_LANES(&dst[2 * x], _mm256_unpacklo_epi8(g, c),
+                    _mm256_unpackhi_epi8(g, c));
+    }
+    pack_grey_c(&dst[2 * x], &src[x], n - x);
+}
+
+VLC_AVX2
+static inline void rgb24_rgb32_avx2(uint8_t *restrict dst, const uint8_t *src,
+                                    unsigned n)
+{
+    /* 4 pixels per lane, from 12 of the 16 bytes loaded in each lane */
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    unsigned x = 0;
+
+    /* The last load reads 4 bytes past the 8 pixels */
+    for (; 3 * x + 28 <= 3 * n; x += 8)
+    {
+        __m256i p = _mm256_inserti128_si256(_mm256_castsi128_si256(
+            _mm_loadu_si128((const __m128i *)&src[3 * x])),
+            _mm_loadu_si128((const __m128i *)&src[3 * x + 12]), 1);
+
+        _mm256_storeu_si256((__m256i *)&dst[4 * x],
+            _mm256_or_si256(_mm256_shuffle_epi8(p, shuffle), alpha));
+    }
+    rgb24_rgb32_c(&dst[4 * x], &src[3 * x], n - x);
+}
+#undef STORE_LANES
+#endif
@@ -32,6 +32,9 @@
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#include "pack.h"
 
 /****************************************************************************
  * Local prototypes
@@ -79,8 +82,12 @@ static int OpenFilter( vlc_object_t *p_this )
 static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
 {
     picture_t *p_pic_dst;
-    int i_plane, i;
-    unsigned int j;
+    rgb24_rgb32_t convert = rgb24_rgb32_c;
+
+#ifdef CAN_COMPILE_AVX2
+    if( vlc_CPU_AVX2() )
+        convert = rgb24_rgb32_avx2;
+#endif
 
     /* Request output picture */
     p_pic_dst = filter_NewPicture( p_filter );
@@ -91,25 +98,15 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
     }
 
     /* Convert RV24 to RV32 */
-    for( i_plane = 0; i_plane < p_pic_dst->i_planes; i_plane++ )
+    for( int i_plane = 0; i_plane < p_pic_dst->i_planes; i_plane++ )
     {
-        uint8_t *p_src = p_pic->p[i_plane].p_pixels;
-        uint8_t *p_dst = p_pic_dst->p[i_plane].p_pixels;
-        unsigned int i_width = p_filter->fmt_out.video.i_width;
-
-        for( i = 0; i < p_pic_dst->p[i_plane].i_lines; i++ )
-        {
-            for( j = 0; j < i_width; j++ )
-            {
-                *(p_dst++) = p_src[2];
-                *(p_dst++) = p_src[1];
-                *(p_dst++) = p_src[0];
-                *(p_dst++) = 0xff;  /* Alpha */
-                p_src += 3;
-            }
-            p_src += p_pic->p[i_plane].i_pitch - 3 * i_width;
-            p_dst += p_pic_dst->p[i_plane].i_pitch - 4 * i_width;
-        }
+        const plane_t *p_src = &p_pic->p[i_plane];
+        plane_t *p_dst = &p_pic_dst->p[i_plane];
+
+        for( int i = 0; i < p_dst->i_lines; i++ )
+            convert( p_dst->p_pixels + i * p_dst->i_pitch,
+                     p_src->p_pixels + i * p_src->i_pitch,
+                     p_filter->fmt_out.video.i_width );
     }
 
     picture_CopyProperties( p_pic_dst, p_pic );
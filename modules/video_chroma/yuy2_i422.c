@@ -33,6 +33,9 @@
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#include "pack.h"
 
 #define SRC_FOURCC "YUY2,YUNV,YVYU,UYVY,UYNV,Y422"
 #define DEST_FOURCC  "I422"
@@ -107,139 +110,53 @@ static int Activate( vlc_object_t *p_this )
 }
 
 /* Following functions are local */
-
 VIDEO_FILTER_WRAPPER( YUY2_I422 )
 VIDEO_FILTER_WRAPPER( YVYU_I422 )
 VIDEO_FILTER_WRAPPER( UYVY_I422 )
 
 /*****************************************************************************
- * YUY2_I422: packed YUY2 4:2:2 to planar YUV 4:2:2
+ * Convert: packed YUV 4:2:2 to planar YUV 4:2:2
+ *****************************************************************************
+ * YVYU is YUY2 with the chroma planes swapped.
  *****************************************************************************/
-static void YUY2_I422( filter_t *p_filter, picture_t *p_source,
-                                           picture_t *p_dest )
+static void Convert( filter_t *p_filter, picture_t *p_source,
+                     picture_t *p_dest, bool b_swap_uv, bool b_uyvy )
 {
-    uint8_t *p_line = p_source->p->p_pixels;
+    unpack_422_t unpack = unpack_422_c;
+#ifdef CAN_COMPILE_AVX2
+    if( vlc_CPU_AVX2() )
+        unpack = unpack_422_avx2;
+#endif
 
-    uint8_t *p_y = p_dest->Y_PIXELS;
-    uint8_t *p_u = p_dest->U_PIXELS;
-    uint8_t *p_v = p_dest->V_PIXELS;
+    const unsigned i_width = p_filter->fmt_out.video.i_width;
+    const unsigned i_height = p_filter->fmt_out.video.i_height;
+    uint8_t *p_u = p_dest->p[b_swap_uv ? V_PLANE : U_PLANE].p_pixels;
+    uint8_t *p_v = p_dest->p[b_swap_uv ? U_PLANE : V_PLANE].p_pixels;
 
-    int i_x, i_y;
+    uint8_t *p_y = p_dest->p[Y_PLANE].p_pixels;
+    const uint8_t *p_line = p_source->p[0].p_pixels;
 
-    const int i_dest_margin = p_dest->p[0].i_pitch
-                                 - p_dest->p[0].i_visible_pitch;
-    const int i_dest_margin_c = p_dest->p[1].i_pitch
-                                 - p_dest->p[1].i_visible_pitch;
-    const int i_source_margin = p_source->p->i_pitch
-                               - p_source->p->i_visible_pitch;
+    for( unsigned i_y = 0; i_y < i_height; i_y++ )
+        unpack( p_y + i_y * p_dest->p[Y_PLANE].i_pitch,
+                p_u + i_y * p_dest->p[U_PLANE].i_pitch,
+                p_v + i_y * p_dest->p[V_PLANE].i_pitch,
+                p_line + i_y * p_source->p[0].i_pitch, i_width, b_uyvy );
+}
 
-    for( i_y = p_filter->fmt_out.video.i_height ; i_y-- ; )
-    {
-        for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
-        {
-#define C_YUYV_YUV422( p_line, p_y, p_u, p_v )      \
-            *p_y++ = *p_line++; *p_u++ = *p_line++; \
-            *p_y++ = *p_line++; *p_v++ = *p_line++
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-        }
-        for( i_x = ( p_filter->fmt_out.video.i_width % 8 ) / 2; i_x-- ; )
-        {
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-        }
-        p_line += i_source_margin;
-        p_y += i_dest_margin;
-        p_u += i_dest_margin_c;
-        p_v += i_dest_margin_c;
-    }
+static void YUY2_I422( filter_t *p_filter, picture_t *p_source,
+                       picture_t *p_dest )
+{
+    Convert( p_filter, p_source, p_dest, false, false );
 }
 
-/*****************************************************************************
- * YVYU_I422: packed YVYU 4:2:2 to planar YUV 4:2:2
- *****************************************************************************/
 static void YVYU_I422( filter_t *p_filter, picture_t *p_source,
-                                           picture_t *p_dest )
+                       picture_t *p_dest )
 {
-    uint8_t *p_line = p_source->p->p_pixels;
-
-    uint8_t *p_y = p_dest->Y_PIXELS;
-    uint8_t *p_u = p_dest->U_PIXELS;
-    uint8_t *p_v = p_dest->V_PIXELS;
-
-    int i_x, i_y;
-
-    const int i_dest_margin = p_dest->p[0].i_pitch
-                                 - p_dest->p[0].i_visible_pitch;
-    const int i_dest_margin_c = p_dest->p[1].i_pitch
-                                 - p_dest->p[1].i_visible_pitch;
-    const int i_source_margin = p_source->p->i_pitch
-                               - p_source->p->i_visible_pitch;
-
-    for( i_y = p_filter->fmt_out.video.i_height ; i_y-- ; )
-    {
-        for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
-        {
-#define C_YVYU_YUV422( p_line, p_y, p_u, p_v )      \
-            *p_y++ = *p_line++; *p_v++ = *p_line++; \
-            *p_y++ = *p_line++; *p_u++ = *p_line++
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-        }
-        for( i_x = ( p_filter->fmt_out.video.i_width % 8 ) / 2; i_x-- ; )
-        {
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-        }
-        p_line += i_source_margin;
-        p_y += i_dest_margin;
-        p_u += i_dest_margin_c;
-        p_v += i_dest_margin_c;
-    }
+    Convert( p_filter, p_source, p_dest, true, false );
 }
 
-/*****************************************************************************
- * UYVY_I422: packed UYVY 4:2:2 to planar YUV 4:2:2
- *****************************************************************************/
 static void UYVY_I422( filter_t *p_filter, picture_t *p_source,
-                                           picture_t *p_dest )
+                       picture_t *p_dest )
 {
-    uint8_t *p_line = p_source->p->p_pixels;
-
-    uint8_t *p_y = p_dest->Y_PIXELS;
-    uint8_t *p_u = p_dest->U_PIXELS;
-    uint8_t *p_v = p_dest->V_PIXELS;
-
-    int i_x, i_y;
-
-    const int i_dest_margin = p_dest->p[0].i_pitch
-                                 - p_dest->p[0].i_visible_pitch;
-    const int i_dest_margin_c = p_dest->p[1].i_pitch
-                                 - p_dest->p[1].i_visible_pitch;
-    const int i_source_margin = p_source->p->i_pitch
-                               - p_source->p->i_visible_pitch;
-
-    for( i_y = p_filter->fmt_out.video.i_height ; i_y-- ; )
-    {
-        for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
-        {
-#define C_UYVY_YUV422( p_line, p_y, p_u, p_v )      \
-            *p_u++ = *p_line++; *p_y++ = *p_line++; \
-            *p_v++ = *p_line++; *p_y++ = *p_line++
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-        }
-        for( i_x = ( p_filter->fmt_out.video.i_width % 8 ) / 2; i_x-- ; )
-        {
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-        }
-        p_line += i_source_margin;
-        p_y += i_dest_margin;
-        p_u += i_dest_margin_c;
-        p_v += i_dest_margin_c;
-    }
+    Convert( p_filter, p_source, p_dest, false, true );
 }
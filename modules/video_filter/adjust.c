@@ -225,6 +225,197 @@ static void Destroy( vlc_object_t *p_this )
     free( p_sys );
 }
 
+/*****************************************************************************
+ * Slices: the picture is processed in horizontal slices in parallel
+ *****************************************************************************/
+struct adjust_slices
+{
+    picture_t *p_pic;
+    picture_t *p_outpic;
+    const int *pi_luma;
+    void (*pf_luma)( const struct adjust_slices *, picture_t *, picture_t * );
+    int (*pf_sat_hue)( picture_t *, picture_t *, int, int, int, int, int );
+    int i_y_offset;
+    int i_sin, i_cos, i_sat, i_x, i_y;
+};
+
+/* Makes a picture pointing to one horizontal slice of every plane of p_pic.
+ * Slice boundaries are aligned so that all planes are split at the same
+ * relative height whatever their vertical subsampling. */
+static void SlicePicture( picture_t *p_slice, const picture_t *p_pic,
+                          unsigned i_slice, unsigned i_slices )
+{
+    const unsigned i_lines = p_pic->p[0].i_visible_lines;
+    unsigned i_align = 1;
+
+    for( int i = 1; i < p_pic->i_planes; i++ )
+    {
+        unsigned i_plane_lines = __MAX( p_pic->p[i].i_visible_lines, 1 );
+        i_align = __MAX( i_align,
+                         (i_lines + i_plane_lines - 1) / i_plane_lines );
+    }
+
+    unsigned i_begin, i_end;
+    filter_GetSliceLines( i_lines, i_slice, i_slices, i_align,
+                          &i_begin, &i_end );
+
+    p_slice->format = p_pic->format;
+    p_slice->i_planes = p_pic->i_planes;
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        const plane_t *p_plane = &p_pic->p[i];
+        unsigned i_plane_begin = 0, i_plane_end = 0;
+
+        if( i_lines > 0 )
+        {
+            i_plane_begin = (uint64_t)i_begin * p_plane->i_visible_lines
+                          / i_lines;
+            i_plane_end = (i_end < i_lines)
+                ? (uint64_t)i_end * p_plane->i_visible_lines / i_lines
+                : (unsigned)p_plane->i_visible_lines;
+        }
+
+        p_slice->p[i] = *p_plane;
+        p_slice->p[i].p_pixels += i_plane_begin * p_plane->i_pitch;
+        p_slice->p[i].i_lines = i_plane_end - i_plane_begin;
+        p_slice->p[i].i_visible_lines = i_plane_end - i_plane_begin;
+    }
+}
+
+static void PlanarLuma8( const struct adjust_slices *p_ctx,
+                         picture_t *p_pic, picture_t *p_outpic )
+{
+    const int *pi_luma = p_ctx->pi_luma;
+    uint8_t *p_in, *p_in_end, *p_line_end;
+    uint8_t *p_out;
+    p_in = p_pic->p[Y_PLANE].p_pixels;
+    p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
+             * p_pic->p[Y_PLANE].i_pitch - 8;
+
+    p_out = p_outpic->p[Y_PLANE].p_pixels;
+
+    for( ; p_in < p_in_end ; )
+    {
+        p_line_end = p_in + p_pic->p[Y_PLANE].i_visible_pitch - 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            /* Do 8 pixels at a time */
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_line_end += 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_in += p_pic->p[Y_PLANE].i_pitch
+              - p_pic->p[Y_PLANE].i_visible_pitch;
+        p_out += p_outpic->p[Y_PLANE].i_pitch
+               - p_outpic->p[Y_PLANE].i_visible_pitch;
+    }
+}
+
+static void PlanarLuma16( const struct adjust_slices *p_ctx,
+                          picture_t *p_pic, picture_t *p_outpic )
+{
+    const int *pi_luma = p_ctx->pi_luma;
+    uint16_t *p_in, *p_in_end, *p_line_end;
+    uint16_t *p_out;
+    p_in = (uint16_t *) p_pic->p[Y_PLANE].p_pixels;
+    p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
+        * (p_pic->p[Y_PLANE].i_pitch >> 1) - 8;
+
+    p_out = (uint16_t *) p_outpic->p[Y_PLANE].p_pixels;
+
+    for( ; p_in < p_in_end ; )
+    {
+        p_line_end = p_in + (p_pic->p[Y_PLANE].i_visible_pitch >> 1) - 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            /* Do 8 pixels at a time */
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_line_end += 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_in += (p_pic->p[Y_PLANE].i_pitch >> 1)
+            - (p_pic->p[Y_PLANE].i_visible_pitch >> 1);
+        p_out += (p_outpic->p[Y_PLANE].i_pitch >> 1)
+            - (p_outpic->p[Y_PLANE].i_visible_pitch >> 1);
+    }
+}
+
+static void PackedLuma( const struct adjust_slices *p_ctx,
+                        picture_t *p_pic, picture_t *p_outpic )
+{
+    const int *pi_luma = p_ctx->pi_luma;
+    const int i_pitch = p_pic->p->i_pitch;
+    const int i_visible_pitch = p_pic->p->i_visible_pitch;
+    uint8_t *p_in, *p_in_end, *p_line_end;
+    uint8_t *p_out;
+
+    p_in = p_pic->p->p_pixels + p_ctx->i_y_offset;
+    p_in_end = p_in + p_pic->p->i_visible_lines * p_pic->p->i_pitch - 8 * 4;
+
+    p_out = p_outpic->p->p_pixels + p_ctx->i_y_offset;
+
+    for( ; p_in < p_in_end ; )
+    {
+        p_line_end = p_in + i_visible_pitch - 8 * 4;
+
+        for( ; p_in < p_line_end ; )
+        {
+            /* Do 8 pixels at a time */
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+        }
+
+        p_line_end += 8 * 4;
+
+        for( ; p_in < p_line_end ; )
+        {
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+        }
+
+        p_in += i_pitch - p_pic->p->i_visible_pitch;
+        p_out += i_pitch - p_outpic->p->i_visible_pitch;
+    }
+}
+
+static void AdjustSlice( void *data, unsigned i_slice, unsigned i_slices )
+{
+    const struct adjust_slices *p_ctx = data;
+    picture_t in, out;
+
+    SlicePicture( &in, p_ctx->p_pic, i_slice, i_slices );
+    SlicePicture( &out, p_ctx->p_outpic, i_slice, i_slices );
+
+    p_ctx->pf_luma( p_ctx, &in, &out );
+    p_ctx->pf_sat_hue( &in, &out, p_ctx->i_sin, p_ctx->i_cos, p_ctx->i_sat,
+                       p_ctx->i_x, p_ctx->i_y );
+}
+
 /*****************************************************************************
  * Run the filter on a Planar YUV picture
  *****************************************************************************/
@@ -240,7 +431,8 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
 
     if( !p_pic ) return NULL;
 
-    p_outpic = filter_NewPicture( p_filter );
+    /* Every pixel is read before it is written: this can work in place */
+    p_outpic = filter_NewPictureInPlace( p_filter, p_pic );
     if( !p_outpic )
     {
         picture_Release( p_pic );
@@ -316,82 +508,6 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
         i_sat = 0;
     }
 
-    /*
-     * Do the Y plane
-     */
-    if ( b_16bit )
-    {
-        uint16_t *p_in, *p_in_end, *p_line_end;
-        uint16_t *p_out;
-        p_in = (uint16_t *) p_pic->p[Y_PLANE].p_pixels;
-        p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
-            * (p_pic->p[Y_PLANE].i_pitch >> 1) - 8;
-
-        p_out = (uint16_t *) p_outpic->p[Y_PLANE].p_pixels;
-
-        for( ; p_in < p_in_end ; )
-        {
-            p_line_end = p_in + (p_pic->p[Y_PLANE].i_visible_pitch >> 1) - 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                /* Do 8 pixels at a time */
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_line_end += 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_in += (p_pic->p[Y_PLANE].i_pitch >> 1)
-                - (p_pic->p[Y_PLANE].i_visible_pitch >> 1);
-            p_out += (p_outpic->p[Y_PLANE].i_pitch >> 1)
-                - (p_outpic->p[Y_PLANE].i_visible_pitch >> 1);
-        }
-    }
-    else
-    {
-        uint8_t *p_in, *p_in_end, *p_line_end;
-        uint8_t *p_out;
-        p_in = p_pic->p[Y_PLANE].p_pixels;
-        p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
-                 * p_pic->p[Y_PLANE].i_pitch - 8;
-
-        p_out = p_outpic->p[Y_PLANE].p_pixels;
-
-        for( ; p_in < p_in_end ; )
-        {
-            p_line_end = p_in + p_pic->p[Y_PLANE].i_visible_pitch - 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                /* Do 8 pixels at a time */
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_line_end += 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_in += p_pic->p[Y_PLANE].i_pitch
-                  - p_pic->p[Y_PLANE].i_visible_pitch;
-            p_out += p_outpic->p[Y_PLANE].i_pitch
-                   - p_outpic->p[Y_PLANE].i_visible_pitch;
-        }
-    }
-
     /*
      * Do the U and V planes
      */
@@ -403,24 +519,27 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     int i_x = ( cosf(f_hue) + sinf(f_hue) ) * f_range * i_mid;
     int i_y = ( cosf(f_hue) - sinf(f_hue) ) * f_range * i_mid;
 
-    if ( i_sat > i_range )
-    {
-        /* Currently no errors are implemented in the function, if any are added
-         * check them here */
-        p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
-    }
-    else
-    {
-        /* Currently no errors are implemented in the function, if any are added
-         * check them here */
-        p_sys->pf_process_sat_hue( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
-    }
+    struct adjust_slices ctx = {
+        .p_pic = p_pic,
+        .p_outpic = p_outpic,
+        .pi_luma = pi_luma,
+        .pf_luma = b_16bit ? PlanarLuma16 : PlanarLuma8,
+        /* Currently no errors are implemented in the functions, if any are
+         * added check them here */
+        .pf_sat_hue = ( i_sat > i_range ) ? p_sys->pf_process_sat_hue_clip
+                                          : p_sys->pf_process_sat_hue,
+        .i_sin = i_sin, .i_cos = i_cos, .i_sat = i_sat,
+        .i_x = i_x, .i_y = i_y,
+    };
+
+    /* Do the Y, U and V planes, one horizontal slice at a time */
+    filter_ExecuteSlices( p_filter, AdjustSlice, &ctx,
+                          filter_GetSliceCount( p_filter ) );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
 
+
 /*****************************************************************************
  * Run the filter on a Packed YUV picture
  *****************************************************************************/
@@ -430,12 +549,8 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
     int pi_gamma[256];
 
     picture_t *p_outpic;
-    uint8_t *p_in, *p_in_end, *p_line_end;
-    uint8_t *p_out;
     int i_y_offset, i_u_offset, i_v_offset;
 
-    int i_pitch, i_visible_pitch;
-
     double  f_hue;
     double  f_gamma;
     int32_t i_cont, i_lum;
@@ -445,9 +560,6 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
 
     if( !p_pic ) return NULL;
 
-    i_pitch = p_pic->p->i_pitch;
-    i_visible_pitch = p_pic->p->i_visible_pitch;
-
     if( GetPackedYuvOffsets( p_pic->format.i_chroma, &i_y_offset,
                              &i_u_offset, &i_v_offset ) != VLC_SUCCESS )
     {
@@ -513,43 +625,6 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
         i_sat = 0;
     }
 
-    /*
-     * Do the Y plane
-     */
-
-    p_in = p_pic->p->p_pixels + i_y_offset;
-    p_in_end = p_in + p_pic->p->i_visible_lines * p_pic->p->i_pitch - 8 * 4;
-
-    p_out = p_outpic->p->p_pixels + i_y_offset;
-
-    for( ; p_in < p_in_end ; )
-    {
-        p_line_end = p_in + i_visible_pitch - 8 * 4;
-
-        for( ; p_in < p_line_end ; )
-        {
-            /* Do 8 pixels at a time */
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-        }
-
-        p_line_end += 8 * 4;
-
-        for( ; p_in < p_line_end ; )
-        {
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-        }
-
-        p_in += i_pitch - p_pic->p->i_visible_pitch;
-        p_out += i_pitch - p_outpic->p->i_visible_pitch;
-    }
-
     /*
      * Do the U and V planes
      */
@@ -560,32 +635,22 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
     i_x = ( cos(f_hue) + sin(f_hue) ) * 32768;
     i_y = ( cos(f_hue) - sin(f_hue) ) * 32768;
 
-    if ( i_sat > 256 )
-    {
-        if ( p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                             i_x, i_y ) != VLC_SUCCESS )
-        {
-            /* Currently only one error can happen in the function, but if there
-             * will be more of them, this message must go away */
-            msg_Warn( p_filter, "Unsupported input chroma (%4.4s)",
-                      (char*)&(p_pic->format.i_chroma) );
-            picture_Release( p_pic );
-            return NULL;
-        }
-    }
-    else
-    {
-        if ( p_sys->pf_process_sat_hue( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y ) != VLC_SUCCESS )
-        {
-            /* Currently only one error can happen in the function, but if there
-             * will be more of them, this message must go away */
-            msg_Warn( p_filter, "Unsupported input chroma (%4.4s)",
-                      (char*)&(p_pic->format.i_chroma) );
-            picture_Release( p_pic );
-            return NULL;
-        }
-    }
+    struct adjust_slices ctx = {
+        .p_pic = p_pic,
+        .p_outpic = p_outpic,
+        .pi_luma = pi_luma,
+        .pf_luma = PackedLuma,
+        /* The chroma was checked above: the functions cannot fail */
+        .pf_sat_hue = ( i_sat > 256 ) ? p_sys->pf_process_sat_hue_clip
+                                      : p_sys->pf_process_sat_hue,
+        .i_y_offset = i_y_offset,
+        .i_sin = i_sin, .i_cos = i_cos, .i_sat = i_sat,
+        .i_x = i_x, .i_y = i_y,
+    };
+
+    /* Do the Y, U and V components, one horizontal slice at a time */
+    filter_ExecuteSlices( p_filter, AdjustSlice, &ctx,
+                          filter_GetSliceCount( p_filter ) );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
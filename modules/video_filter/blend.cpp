@@ -32,8 +32,13 @@
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
+#ifdef CAN_COMPILE_AVX2
+# include <immintrin.h>
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -197,6 +202,58 @@ private:
     uint8_t *data[2];
 };
 
+/* 10 bits in the most significant bits of 16 bits samples */
+class CPictureP010 : public CPicture {
+public:
+    CPictureP010(const CPicture &cfg) : CPicture(cfg)
+    {
+        data[0] = CPicture::getLine<1>(0);
+        data[1] = CPicture::getLine<2>(1);
+    }
+    void get(CPixel *px, unsigned dx, bool full = true) const
+    {
+        px->i = *getPointer(0, dx) >> 6;
+        if (full) {
+            px->j = getPointer(1, dx)[0] >> 6;
+            px->k = getPointer(1, dx)[1] >> 6;
+        }
+    }
+    void merge(unsigned dx, const CPixel &spx, unsigned a, bool full)
+    {
+        merge10(getPointer(0, dx), spx.i, a);
+        if (full) {
+            merge10(&getPointer(1, dx)[0], spx.j, a);
+            merge10(&getPointer(1, dx)[1], spx.k, a);
+        }
+    }
+    bool isFull(unsigned dx) const
+    {
+        return (y % 2) == 0 && ((x + dx) % 2) == 0;
+    }
+    void nextLine()
+    {
+        y++;
+        data[0] += picture->p[0].i_pitch;
+        if ((y % 2) == 0)
+            data[1] += picture->p[1].i_pitch;
+    }
+private:
+    static void merge10(uint16_t *dst, unsigned src, unsigned a)
+    {
+        unsigned value = *dst >> 6;
+        ::merge(&value, src, a);
+        *dst = (value << 6) | (*dst & 0x3f);
+    }
+    uint16_t *getPointer(unsigned plane, unsigned dx) const
+    {
+        if (plane == 0)
+            return (uint16_t *)&data[plane][(x + dx) * 2];
+        else
+            return (uint16_t *)&data[plane][(x + dx) / 2 * 4];
+    }
+    uint8_t *data[2];
+};
+
 template <unsigned offset_y, unsigned offset_u, unsigned offset_v>
 class CPictureYUVPacked : public CPicture {
 public:
@@ -332,7 +389,7 @@ public:
         y++;
         data += picture->p[0].i_pitch;
     }
-private:
+protected:
     uint8_t *getPointer(unsigned dx) const
     {
         return &data[(x + dx) * bytes];
@@ -582,6 +639,9 @@ static const struct {
     YUV(VLC_CODEC_YV12,     CPictureYV12,     convertNone),
     YUV(VLC_CODEC_NV12,     CPictureNV12,     convertNone),
     YUV(VLC_CODEC_NV21,     CPictureNV21,     convertNone),
+#ifndef WORDS_BIGENDIAN
+    YUV(VLC_CODEC_P010,     CPictureP010,     convert8To10Bits),
+#endif
     YUV(VLC_CODEC_J420,     CPictureI420_8,   convertNone),
     YUV(VLC_CODEC_I420,     CPictureI420_8,   convertNone),
 #ifdef WORDS_BIGENDIAN
@@ -623,6 +683,650 @@ static const struct {
 #undef YUV
 };
 
+/*****************************************************************************
+ * Fast paths
+ *
+ * The most common pairs are blended by blocks of pixels, with kernels
+ * working on whole runs of samples. Fully transparent blocks are skipped.
+ * The results are identical to the generic Blend() above.
+ *****************************************************************************/
+#define BLOCK 64
+
+/* Source samples of a block: 4:4:4 8 bits YUV and final alpha, or RGBA */
+struct CBlock {
+    const uint8_t *y, *u, *v, *a;
+    const uint8_t *rgba;
+    int alpha;
+    uint8_t buffer[4][BLOCK];
+};
+
+struct KernelsC {
+    static bool isTransparent(const uint8_t *a, unsigned n, unsigned step)
+    {
+        unsigned any = 0;
+        for (unsigned i = 0; i < n; i++)
+            any |= a[i * step];
+        return any == 0;
+    }
+    static void scaleAlpha(uint8_t *dst, const uint8_t *a, unsigned n,
+                           int alpha)
+    {
+        for (unsigned i = 0; i < n; i++)
+            dst[i] = div255(alpha * a[i]);
+    }
+    static void rgbaToYuva(uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a,
+                           const uint8_t *rgba, unsigned n, int alpha)
+    {
+        for (unsigned i = 0; i < n; i++, rgba += 4) {
+            rgb_to_yuv(&y[i], &u[i], &v[i], rgba[0], rgba[1], rgba[2]);
+            a[i] = div255(alpha * rgba[3]);
+        }
+    }
+    /* Blends n samples */
+    static void blend8(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                       unsigned n)
+    {
+        for (unsigned i = 0; i < n; i++)
+            merge(&dst[i], src[i], a[i]);
+    }
+    /* Blends the subsampled chroma of a block of n pixels: the samples of
+     * the pixels of the given parity go to consecutive destination samples
+     * (planar) or pairs of samples (semi-planar) */
+    static void blendChroma8(uint8_t *dst, const uint8_t *src,
+                             const uint8_t *a, unsigned n, unsigned parity)
+    {
+        for (unsigned i = parity; i < n; i += 2)
+            merge(&dst[i / 2], src[i], a[i]);
+    }
+    static void blendUV8(uint8_t *dst, const uint8_t *u, const uint8_t *v,
+                         const uint8_t *a, unsigned n, unsigned parity)
+    {
+        for (unsigned i = parity; i < n; i += 2) {
+            merge(&dst[i / 2 * 2 + 0], u[i], a[i]);
+            merge(&dst[i / 2 * 2 + 1], v[i], a[i]);
+        }
+    }
+    /* Same for 10 bits samples, stored in the low (shift 0) or high
+     * (shift 6) bits of 16 bits samples */
+    static void merge10(uint16_t *dst, unsigned src, unsigned a, unsigned shift)
+    {
+        /* Unlike 8 bits samples, merging is not exact for null alpha */
+        if (a == 0)
+            return;
+        const unsigned low = (1 << shift) - 1;
+        unsigned value = *dst >> shift;
+        merge(&value, src * 1023 / 255, a);
+        *dst = (value << shift) | (*dst & low);
+    }
+    static void blend16(uint16_t *dst, const uint8_t *src, const uint8_t *a,
+                        unsigned n, unsigned shift)
+    {
+        for (unsigned i = 0; i < n; i++)
+            merge10(&dst[i], src[i], a[i], shift);
+    }
+    static void blendChroma16(uint16_t *dst, const uint8_t *src,
+                              const uint8_t *a, unsigned n, unsigned parity,
+                              unsigned shift)
+    {
+        for (unsigned i = parity; i < n; i += 2)
+            merge10(&dst[i / 2], src[i], a[i], shift);
+    }
+    static void blendUV16(uint16_t *dst, const uint8_t *u, const uint8_t *v,
+                          const uint8_t *a, unsigned n, unsigned parity,
+                          unsigned shift)
+    {
+        for (unsigned i = parity; i < n; i += 2) {
+            merge10(&dst[i / 2 * 2 + 0], u[i], a[i], shift);
+            merge10(&dst[i / 2 * 2 + 1], v[i], a[i], shift);
+        }
+    }
+    /* Blends RGBA onto 32 bits RGB, with the given R, G and B offsets */
+    static void blendRGB32(uint8_t *dst, const uint8_t *rgba, unsigned n,
+                           int alpha, const unsigned offset[3])
+    {
+        for (unsigned i = 0; i < n; i++, dst += 4, rgba += 4) {
+            unsigned a = div255(alpha * rgba[3]);
+            merge(&dst[offset[0]], rgba[0], a);
+            merge(&dst[offset[1]], rgba[1], a);
+            merge(&dst[offset[2]], rgba[2], a);
+        }
+    }
+};
+
+#ifdef CAN_COMPILE_AVX2
+/* div255() of 16 or 32 bits lanes */
+VLC_AVX2 static inline __m256i div255_epu16(__m256i v)
+{
+    v = _mm256_add_epi16(v, _mm256_srli_epi16(v, 8));
+    return _mm256_srli_epi16(_mm256_add_epi16(v, _mm256_set1_epi16(1)), 8);
+}
+
+VLC_AVX2 static inline __m256i div255_epu32(__m256i v)
+{
+    v = _mm256_add_epi32(v, _mm256_srli_epi32(v, 8));
+    return _mm256_srli_epi32(_mm256_add_epi32(v, _mm256_set1_epi32(1)), 8);
+}
+
+/* merge() of 16 samples of up to 8 bits */
+VLC_AVX2 static inline __m256i blend_epu16(__m256i d, __m256i s, __m256i a)
+{
+    __m256i na = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+    return div255_epu16(_mm256_add_epi16(_mm256_mullo_epi16(d, na),
+                                         _mm256_mullo_epi16(s, a)));
+}
+
+/* merge() of 32 samples of 8 bits */
+VLC_AVX2 static inline __m256i blend_epu8(__m256i d, __m256i s, __m256i a)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = blend_epu16(_mm256_unpacklo_epi8(d, zero),
+                             _mm256_unpacklo_epi8(s, zero),
+                             _mm256_unpacklo_epi8(a, zero));
+    __m256i hi = blend_epu16(_mm256_unpackhi_epi8(d, zero),
+                             _mm256_unpackhi_epi8(s, zero),
+                             _mm256_unpackhi_epi8(a, zero));
+    return _mm256_packus_epi16(lo, hi);
+}
+
+/* merge() of 16 samples of 10 bits, with 8 bits sources */
+VLC_AVX2 static inline __m256i blend_epu10(__m256i d, __m256i s, __m256i a)
+{
+    /* s * 1023 / 255 is 4 * s + (s >= 85) + (s >= 170) + (s == 255) */
+    __m256i s10 = _mm256_slli_epi16(s, 2);
+    s10 = _mm256_sub_epi16(s10, _mm256_cmpgt_epi16(s, _mm256_set1_epi16(84)));
+    s10 = _mm256_sub_epi16(s10, _mm256_cmpgt_epi16(s, _mm256_set1_epi16(169)));
+    s10 = _mm256_sub_epi16(s10, _mm256_cmpgt_epi16(s, _mm256_set1_epi16(254)));
+
+    __m256i na = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(d, s10),
+                                   _mm256_unpacklo_epi16(na, a));
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(d, s10),
+                                   _mm256_unpackhi_epi16(na, a));
+    return _mm256_packus_epi32(div255_epu32(lo), div255_epu32(hi));
+}
+
+VLC_AVX2 static inline __m256i blend_epu10_shift(__m256i d, __m256i s,
+                                                 __m256i a, unsigned shift)
+{
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    __m256i low = _mm256_and_si256(d, _mm256_set1_epi16((1 << shift) - 1));
+    __m256i v = blend_epu10(_mm256_srl_epi16(d, count), s, a);
+    v = _mm256_or_si256(_mm256_sll_epi16(v, count), low);
+    /* Unlike 8 bits samples, merging is not exact for null alpha */
+    return _mm256_blendv_epi8(v, d, _mm256_cmpeq_epi16(a, _mm256_setzero_si256()));
+}
+
+/* Loads the 16 samples of the given parity out of 32 bytes */
+VLC_AVX2 static inline __m256i load_parity(const uint8_t *p, unsigned parity)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    v = _mm256_srl_epi16(v, _mm_cvtsi32_si128(8 * parity));
+    return _mm256_and_si256(v, _mm256_set1_epi16(0xff));
+}
+
+VLC_AVX2 static inline __m256i load_epu8(const uint8_t *p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+struct KernelsAVX2 : public KernelsC {
+    VLC_AVX2
+    static void scaleAlpha(uint8_t *dst, const uint8_t *a, unsigned n,
+                           int alpha)
+    {
+        const __m256i va = _mm256_set1_epi16(alpha);
+        unsigned i;
+        for (i = 0; i + 16 <= n; i += 16) {
+            __m256i v = div255_epu16(_mm256_mullo_epi16(load_epu8(&a[i]), va));
+            v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+            _mm_storeu_si128((__m128i *)&dst[i], _mm256_castsi256_si128(v));
+        }
+        KernelsC::scaleAlpha(&dst[i], &a[i], n - i, alpha);
+    }
+    VLC_AVX2
+    static void rgbaToYuva(uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a,
+                           const uint8_t *rgba, unsigned n, int alpha)
+    {
+        const __m256i mask = _mm256_set1_epi32(0x00ff00ff);
+        const __m256i cy_rb = _mm256_set1_epi32( 66 | (25 << 16));
+        const __m256i cu_rb = _mm256_set1_epi32((uint16_t)-38 | (112 << 16));
+        const __m256i cv_rb = _mm256_set1_epi32(112 | ((uint32_t)(uint16_t)-18 << 16));
+        const __m256i cy_g  = _mm256_set1_epi32(129);
+        const __m256i cu_g  = _mm256_set1_epi32((uint16_t)-74);
+        const __m256i cv_g  = _mm256_set1_epi32((uint16_t)-94);
+        const __m256i round = _mm256_set1_epi32(128);
+        const __m256i va = _mm256_set1_epi32(alpha);
+        unsigned i;
+
+/* 8 RGBA pixels to 8 32 bits components */
+#define CONVERT(px, vy, vu, vv, vaa) do { \
+        __m256i rb = _mm256_and_si256(px, mask); \
+        __m256i g  = _mm256_and_si256(_mm256_srli_epi32(px, 8), mask); \
+        vy = _mm256_add_epi32(_mm256_madd_epi16(rb, cy_rb), \
+                              _mm256_madd_epi16(g, cy_g)); \
+        vu = _mm256_add_epi32(_mm256_madd_epi16(rb, cu_rb), \
+                              _mm256_madd_epi16(g, cu_g)); \
+        vv = _mm256_add_epi32(_mm256_madd_epi16(rb, cv_rb), \
+                              _mm256_madd_epi16(g, cv_g)); \
+        vy = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(vy, round), 8), \
+                              _mm256_set1_epi32(16)); \
+        vu = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(vu, round), 8), \
+                              round); \
+        vv = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(vv, round), 8), \
+                              round); \
+        vaa = div255_epu32(_mm256_mullo_epi32(_mm256_srli_epi32(px, 24), va)); \
+    } while (0)
+/* Packs 2 x 8 32 bits lanes to 16 bytes */
+#define STORE(p, lo, hi) do { \
+        __m256i w = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8); \
+        w = _mm256_permute4x64_epi64(_mm256_packus_epi16(w, w), 0x08); \
+        _mm_storeu_si128((__m128i *)(p), _mm256_castsi256_si128(w)); \
+    } while (0)
+
+        for (i = 0; i + 16 <= n; i += 16) {
+            __m256i px0 = _mm256_loadu_si256((const __m256i *)&rgba[4 * i]);
+            __m256i px1 = _mm256_loadu_si256((const __m256i *)&rgba[4 * i + 32]);
+            __m256i y0, u0, v0, a0, y1, u1, v1, a1;
+
+            CONVERT(px0, y0, u0, v0, a0);
+            CONVERT(px1, y1, u1, v1, a1);
+            STORE(&y[i], y0, y1);
+            STORE(&u[i], u0, u1);
+            STORE(&v[i], v0, v1);
+            STORE(&a[i], a0, a1);
+        }
+#undef STORE
+#undef CONVERT
+        KernelsC::rgbaToYuva(&y[i], &u[i], &v[i], &a[i], &rgba[4 * i],
+                             n - i, alpha);
+    }
+    VLC_AVX2
+    static void blend8(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                       unsigned n)
+    {
+        unsigned i;
+        for (i = 0; i + 32 <= n; i += 32) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+            __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+            __m256i va = _mm256_loadu_si256((const __m256i *)&a[i]);
+            _mm256_storeu_si256((__m256i *)&dst[i], blend_epu8(d, s, va));
+        }
+        KernelsC::blend8(&dst[i], &src[i], &a[i], n - i);
+    }
+    VLC_AVX2
+    static void blendChroma8(uint8_t *dst, const uint8_t *src,
+                             const uint8_t *a, unsigned n, unsigned parity)
+    {
+        unsigned i;
+        for (i = 0; i + 64 <= n; i += 64) {
+            __m256i s = _mm256_packus_epi16(load_parity(&src[i], parity),
+                                            load_parity(&src[i + 32], parity));
+            __m256i va = _mm256_packus_epi16(load_parity(&a[i], parity),
+                                             load_parity(&a[i + 32], parity));
+            __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i / 2]);
+            s = _mm256_permute4x64_epi64(s, 0xd8);
+            va = _mm256_permute4x64_epi64(va, 0xd8);
+            _mm256_storeu_si256((__m256i *)&dst[i / 2], blend_epu8(d, s, va));
+        }
+        KernelsC::blendChroma8(&dst[i / 2], &src[i], &a[i], n - i, parity);
+    }
+    VLC_AVX2
+    static void blendUV8(uint8_t *dst, const uint8_t *u, const uint8_t *v,
+                         const uint8_t *a, unsigned n, unsigned parity)
+    {
+        unsigned i;
+        for (i = 0; i + 32 <= n; i += 32) {
+            __m256i s = _mm256_or_si256(load_parity(&u[i], parity),
+                          _mm256_slli_epi16(load_parity(&v[i], parity), 8));
+            __m256i va = load_parity(&a[i], parity);
+            va = _mm256_or_si256(va, _mm256_slli_epi16(va, 8));
+            __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+            _mm256_storeu_si256((__m256i *)&dst[i], blend_epu8(d, s, va));
+        }
+        KernelsC::blendUV8(&dst[i], &u[i], &v[i], &a[i], n - i, parity);
+    }
+    VLC_AVX2
+    static void blend16(uint16_t *dst, const uint8_t *src, const uint8_t *a,
+                        unsigned n, unsigned shift)
+    {
+        unsigned i;
+        for (i = 0; i + 16 <= n; i += 16) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+            d = blend_epu10_shift(d, load_epu8(&src[i]), load_epu8(&a[i]),
+                                  shift);
+            _mm256_storeu_si256((__m256i *)&dst[i], d);
+        }
+        KernelsC::blend16(&dst[i], &src[i], &a[i], n - i, shift);
+    }
+    VLC_AVX2
+    static void blendChroma16(uint16_t *dst, const uint8_t *src,
+                              const uint8_t *a, unsigned n, unsigned parity,
+                              unsigned shift)
+    {
+        unsigned i;
+        for (i = 0; i + 32 <= n; i += 32) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i / 2]);
+            d = blend_epu10_shift(d, load_parity(&src[i], parity),
+                                  load_parity(&a[i], parity), shift);
+            _mm256_storeu_si256((__m256i *)&dst[i / 2], d);
+        }
+        KernelsC::blendChroma16(&dst[i / 2], &src[i], &a[i], n - i, parity,
+                                shift);
+    }
+    VLC_AVX2
+    static void blendUV16(uint16_t *dst, const uint8_t *u, const uint8_t *v,
+                          const uint8_t *a, unsigned n, unsigned parity,
+                          unsigned shift)
+    {
+        const __m128i count = _mm_cvtsi32_si128(8 * parity);
+        const __m128i mask = _mm_set1_epi16(0xff);
+        unsigned i;
+        for (i = 0; i + 16 <= n; i += 16) {
+#define LOAD(p) _mm_and_si128(_mm_srl_epi16(_mm_loadu_si128( \
+                                  (const __m128i *)(p)), count), mask)
+            __m128i vu = LOAD(&u[i]), vv = LOAD(&v[i]), va = LOAD(&a[i]);
+#undef LOAD
+            __m256i s = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                            _mm_unpacklo_epi16(vu, vv)),
+                            _mm_unpackhi_epi16(vu, vv), 1);
+            __m256i aa = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                            _mm_unpacklo_epi16(va, va)),
+                            _mm_unpackhi_epi16(va, va), 1);
+            __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+            _mm256_storeu_si256((__m256i *)&dst[i],
+                                blend_epu10_shift(d, s, aa, shift));
+        }
+        KernelsC::blendUV16(&dst[i], &u[i], &v[i], &a[i], n - i, parity,
+                            shift);
+    }
+    VLC_AVX2
+    static void blendRGB32(uint8_t *dst, const uint8_t *rgba, unsigned n,
+                           int alpha, const unsigned offset[3])
+    {
+        /* Moves R, G and B to their destination offsets, and clears the
+         * remaining byte, so that its alpha is null */
+        uint8_t shuffle[32];
+        uint32_t spread = 0;
+        memset(shuffle, 0x80, sizeof(shuffle));
+        for (unsigned c = 0; c < 3; c++) {
+            for (unsigned p = 0; p < 8; p++)
+                shuffle[4 * p + offset[c]] = 4 * (p % 4) + c;
+            spread |= 1u << (8 * offset[c]);
+        }
+        const __m256i ctrl = _mm256_loadu_si256((const __m256i *)shuffle);
+        const __m256i vspread = _mm256_set1_epi32(spread);
+        const __m256i va = _mm256_set1_epi32(alpha);
+        unsigned i;
+
+        for (i = 0; i + 8 <= n; i += 8) {
+            __m256i px = _mm256_loadu_si256((const __m256i *)&rgba[4 * i]);
+            __m256i a = div255_epu32(_mm256_mullo_epi32(
+                                     _mm256_srli_epi32(px, 24), va));
+            __m256i d = _mm256_loadu_si256((const __m256i *)&dst[4 * i]);
+            _mm256_storeu_si256((__m256i *)&dst[4 * i],
+                blend_epu8(d, _mm256_shuffle_epi8(px, ctrl),
+                           _mm256_mullo_epi32(a, vspread)));
+        }
+        KernelsC::blendRGB32(&dst[4 * i], &rgba[4 * i], n - i, alpha, offset);
+    }
+};
+#endif
+
+class CBlockYUVA : public CPicture {
+public:
+    CBlockYUVA(const CPicture &cfg) : CPicture(cfg)
+    {
+        for (unsigned i = 0; i < 4; i++)
+            data[i] = CPicture::getLine<1>(i) + x;
+    }
+    template <class K>
+    bool isTransparent(unsigned dx, unsigned n) const
+    {
+        return K::isTransparent(&data[3][dx], n, 1);
+    }
+    template <class K>
+    void get(CBlock *b, unsigned dx, unsigned n, bool) const
+    {
+        b->y = &data[0][dx];
+        b->u = &data[1][dx];
+        b->v = &data[2][dx];
+        b->a = &data[3][dx];
+        if (b->alpha != 255) {
+            K::scaleAlpha(b->buffer[3], b->a, n, b->alpha);
+            b->a = b->buffer[3];
+        }
+    }
+    void nextLine()
+    {
+        for (unsigned i = 0; i < 4; i++)
+            data[i] += picture->p[i].i_pitch;
+    }
+private:
+    const uint8_t *data[4];
+};
+
+class CBlockRGBA : public CPicture {
+public:
+    CBlockRGBA(const CPicture &cfg) : CPicture(cfg)
+    {
+        data = CPicture::getLine<1>(0) + 4 * x;
+    }
+    template <class K>
+    bool isTransparent(unsigned dx, unsigned n) const
+    {
+        return K::isTransparent(&data[4 * dx + 3], n, 4);
+    }
+    template <class K>
+    void get(CBlock *b, unsigned dx, unsigned n, bool yuv) const
+    {
+        b->rgba = &data[4 * dx];
+        if (yuv) {
+            K::rgbaToYuva(b->buffer[0], b->buffer[1], b->buffer[2],
+                          b->buffer[3], b->rgba, n, b->alpha);
+            b->y = b->buffer[0];
+            b->u = b->buffer[1];
+            b->v = b->buffer[2];
+            b->a = b->buffer[3];
+        }
+    }
+    void nextLine()
+    {
+        data += picture->p[0].i_pitch;
+    }
+private:
+    const uint8_t *data;
+};
+
+template <bool swap_uv>
+class CBlockI420 : public CPicture {
+public:
+    enum { yuv = true };
+    CBlockI420(const CPicture &cfg) : CPicture(cfg)
+    {
+        data[0] = CPicture::getLine<1>(0);
+        data[1] = CPicture::getLine<2>(swap_uv ? 2 : 1);
+        data[2] = CPicture::getLine<2>(swap_uv ? 1 : 2);
+    }
+    template <class K>
+    void blend(unsigned dx, const CBlock &b, unsigned n)
+    {
+        K::blend8(&data[0][x + dx], b.y, b.a, n);
+        if ((y % 2) == 0) {
+            const unsigned parity = (x + dx) % 2;
+            const unsigned c = (x + dx + parity) / 2;
+            K::blendChroma8(&data[1][c], b.u, b.a, n, parity);
+            K::blendChroma8(&data[2][c], b.v, b.a, n, parity);
+        }
+    }
+    void nextLine()
+    {
+        y++;
+        data[0] += picture->p[0].i_pitch;
+        if ((y % 2) == 0) {
+            data[1] += picture->p[swap_uv ? 2 : 1].i_pitch;
+            data[2] += picture->p[swap_uv ? 1 : 2].i_pitch;
+        }
+    }
+private:
+    uint8_t *data[3];
+};
+
+template <bool swap_uv>
+class CBlockNV12 : public CPicture {
+public:
+    enum { yuv = true };
+    CBlockNV12(const CPicture &cfg) : CPicture(cfg)
+    {
+        data[0] = CPicture::getLine<1>(0);
+        data[1] = CPicture::getLine<2>(1);
+    }
+    template <class K>
+    void blend(unsigned dx, const CBlock &b, unsigned n)
+    {
+        K::blend8(&data[0][x + dx], b.y, b.a, n);
+        if ((y % 2) == 0) {
+            const unsigned parity = (x + dx) % 2;
+            uint8_t *uv = &data[1][(x + dx + parity) / 2 * 2];
+            if (swap_uv)
+                K::blendUV8(uv, b.v, b.u, b.a, n, parity);
+            else
+                K::blendUV8(uv, b.u, b.v, b.a, n, parity);
+        }
+    }
+    void nextLine()
+    {
+        y++;
+        data[0] += picture->p[0].i_pitch;
+        if ((y % 2) == 0)
+            data[1] += picture->p[1].i_pitch;
+    }
+private:
+    uint8_t *data[2];
+};
+
+/* 10 bits 4:2:0, planar (I420_10L) or semi-planar (P010) */
+template <bool semi_planar>
+class CBlockI420_10 : public CPicture {
+public:
+    enum { yuv = true };
+    CBlockI420_10(const CPicture &cfg) : CPicture(cfg)
+    {
+        data[0] = CPicture::getLine<1>(0);
+        data[1] = CPicture::getLine<2>(1);
+        if (!semi_planar)
+            data[2] = CPicture::getLine<2>(2);
+    }
+    template <class K>
+    void blend(unsigned dx, const CBlock &b, unsigned n)
+    {
+        const unsigned shift = semi_planar ? 6 : 0;
+        K::blend16(getPointer(0, x + dx), b.y, b.a, n, shift);
+        if ((y % 2) == 0) {
+            const unsigned parity = (x + dx) % 2;
+            const unsigned c = (x + dx + parity) / 2;
+            if (semi_planar) {
+                K::blendUV16(getPointer(1, 2 * c), b.u, b.v, b.a, n, parity,
+                             shift);
+            } else {
+                K::blendChroma16(getPointer(1, c), b.u, b.a, n, parity, shift);
+                K::blendChroma16(getPointer(2, c), b.v, b.a, n, parity, shift);
+            }
+        }
+    }
+    void nextLine()
+    {
+        y++;
+        data[0] += picture->p[0].i_pitch;
+        if ((y % 2) == 0) {
+            data[1] += picture->p[1].i_pitch;
+            if (!semi_planar)
+                data[2] += picture->p[2].i_pitch;
+        }
+    }
+private:
+    uint16_t *getPointer(unsigned plane, unsigned index) const
+    {
+        return (uint16_t *)&data[plane][index * 2];
+    }
+    uint8_t *data[3];
+};
+
+class CBlockRGB32 : public CPictureRGB32 {
+public:
+    enum { yuv = false };
+    CBlockRGB32(const CPicture &cfg) : CPictureRGB32(cfg)
+    {
+        offset[0] = offset_r;
+        offset[1] = offset_g;
+        offset[2] = offset_b;
+    }
+    template <class K>
+    void blend(unsigned dx, const CBlock &b, unsigned n)
+    {
+        K::blendRGB32(getPointer(dx), b.rgba, n, b.alpha, offset);
+    }
+private:
+    unsigned offset[3];
+};
+
+template <class TDst, class TSrc, class K>
+void BlendBlocks(const CPicture &dst_data, const CPicture &src_data,
+                 unsigned width, unsigned height, int alpha)
+{
+    TSrc src(src_data);
+    TDst dst(dst_data);
+    CBlock block;
+
+    block.alpha = alpha;
+    for (unsigned y = 0; y < height; y++) {
+        for (unsigned x = 0; x < width; x += BLOCK) {
+            const unsigned n = __MIN(width - x, BLOCK);
+
+            if (src.template isTransparent<K>(x, n))
+                continue;
+            src.template get<K>(&block, x, n, TDst::yuv);
+            dst.template blend<K>(x, block, n);
+        }
+        src.nextLine();
+        dst.nextLine();
+    }
+}
+
+static const struct {
+    vlc_fourcc_t     dst;
+    vlc_fourcc_t     src;
+    blend_function_t blend;
+#ifdef CAN_COMPILE_AVX2
+    blend_function_t blend_avx2;
+#endif
+} fast_blends[] = {
+#ifdef CAN_COMPILE_AVX2
+# define FAST(csp, src, dst_block, src_block) \
+    { csp, src, BlendBlocks<dst_block, src_block, KernelsC>, \
+                BlendBlocks<dst_block, src_block, KernelsAVX2> }
+#else
+# define FAST(csp, src, dst_block, src_block) \
+    { csp, src, BlendBlocks<dst_block, src_block, KernelsC> }
+#endif
+#define YUV(csp, dst_block) \
+    FAST(csp, VLC_CODEC_YUVA, dst_block, CBlockYUVA), \
+    FAST(csp, VLC_CODEC_RGBA, dst_block, CBlockRGBA)
+
+    YUV(VLC_CODEC_I420,     CBlockI420<false>),
+    YUV(VLC_CODEC_J420,     CBlockI420<false>),
+    YUV(VLC_CODEC_YV12,     CBlockI420<true>),
+    YUV(VLC_CODEC_NV12,     CBlockNV12<false>),
+    YUV(VLC_CODEC_NV21,     CBlockNV12<true>),
+#ifndef WORDS_BIGENDIAN
+    YUV(VLC_CODEC_I420_10L, CBlockI420_10<false>),
+    YUV(VLC_CODEC_P010,     CBlockI420_10<true>),
+#endif
+    FAST(VLC_CODEC_RGB32, VLC_CODEC_RGBA, CBlockRGB32, CBlockRGBA),
+
+#undef YUV
+#undef FAST
+};
+
 struct filter_sys_t {
     filter_sys_t() : blend(NULL)
     {
@@ -675,6 +1379,15 @@ static int Open(vlc_object_t *object)
         if (blends[i].src == src && blends[i].dst == dst)
             sys->blend = blends[i].blend;
     }
+    for (size_t i = 0; i < sizeof(fast_blends) / sizeof(*fast_blends); i++) {
+        if (fast_blends[i].src == src && fast_blends[i].dst == dst) {
+            sys->blend = fast_blends[i].blend;
+#ifdef CAN_COMPILE_AVX2
+            if (vlc_CPU_AVX2())
+                sys->blend = fast_blends[i].blend_avx2;
+#endif
+        }
+    }
 
     if (!sys->blend) {
        msg_Err(filter, "no matching alpha blending routine (chroma: %4.4s -> %4.4s)",
@@ -38,6 +38,8 @@
 #include <vlc_picture.h>
 #include <vlc_image.h>
 
+#include "filter_picture.h"
+
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
@@ -56,18 +58,29 @@ static picture_t *Filter( filter_t *, picture_t * );
 #define ALPHA_TEXT N_("Alpha of the blended image")
 #define ALPHA_LONGTEXT N_("Alpha with which the blend image is blended")
 
+#define WIDTH_TEXT N_("Width of the generated images")
+#define WIDTH_LONGTEXT N_("Width of the images generated when no image " \
+                          "file is given")
+
+#define HEIGHT_TEXT N_("Height of the generated images")
+#define HEIGHT_LONGTEXT N_("Height of the images generated when no image " \
+                           "file is given")
+
 #define BASE_IMAGE_TEXT N_("Image to be blended onto")
-#define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto")
+#define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto. " \
+    "If empty, a video frame is generated.")
 
 #define BASE_CHROMA_TEXT N_("Chroma for the base image")
-#define BASE_CHROMA_LONGTEXT N_("Chroma which the base image will be loaded in")
+#define BASE_CHROMA_LONGTEXT N_("Chroma which the base image will be loaded " \
+    "in. If empty, every chroma supported by the blending modules is tested.")
 
 #define BLEND_IMAGE_TEXT N_("Image which will be blended")
-#define BLEND_IMAGE_LONGTEXT N_("The image blended onto the base image")
+#define BLEND_IMAGE_LONGTEXT N_("The image blended onto the base image. " \
+    "If empty, a subtitle-like image is generated.")
 
 #define BLEND_CHROMA_TEXT N_("Chroma for the blend image")
 #define BLEND_CHROMA_LONGTEXT N_("Chroma which the blend image will be loaded" \
-                                 " in")
+    " in. If empty, YUVA, RGBA and YUVP are tested.")
 
 #define CFG_PREFIX "blendbench-"
 
@@ -79,29 +92,47 @@ vlc_module_begin ()
     set_capability( "video filter", 0 )
 
     set_section( N_("Benchmarking"), NULL )
-    add_integer( CFG_PREFIX "loops", 1000, LOOPS_TEXT,
+    add_integer( CFG_PREFIX "loops", 100, LOOPS_TEXT,
               LOOPS_LONGTEXT, false )
     add_integer_with_range( CFG_PREFIX "alpha", 128, 0, 255, ALPHA_TEXT,
               ALPHA_LONGTEXT, false )
+    add_integer( CFG_PREFIX "width", 1920, WIDTH_TEXT, WIDTH_LONGTEXT, true )
+    add_integer( CFG_PREFIX "height", 1080, HEIGHT_TEXT, HEIGHT_LONGTEXT,
+                 true )
 
     set_section( N_("Base image"), NULL )
     add_loadfile( CFG_PREFIX "base-image", NULL, BASE_IMAGE_TEXT,
                   BASE_IMAGE_LONGTEXT, false )
-    add_string( CFG_PREFIX "base-chroma", "I420", BASE_CHROMA_TEXT,
+    add_string( CFG_PREFIX "base-chroma", NULL, BASE_CHROMA_TEXT,
               BASE_CHROMA_LONGTEXT, false )
 
     set_section( N_("Blend image"), NULL )
     add_loadfile( CFG_PREFIX "blend-image", NULL, BLEND_IMAGE_TEXT,
                   BLEND_IMAGE_LONGTEXT, false )
-    add_string( CFG_PREFIX "blend-chroma", "YUVA", BLEND_CHROMA_TEXT,
+    add_string( CFG_PREFIX "blend-chroma", NULL, BLEND_CHROMA_TEXT,
               BLEND_CHROMA_LONGTEXT, false )
 
     set_callbacks( Create, Destroy )
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
-    "loops", "alpha", "base-image", "base-chroma", "blend-image",
-    "blend-chroma", NULL
+    "loops", "alpha", "width", "height", "base-image", "base-chroma",
+    "blend-image", "blend-chroma", NULL
+};
+
+/* Chromas tested when none is specified */
+static const vlc_fourcc_t pi_base_chromas[] = {
+    VLC_CODEC_I420, VLC_CODEC_J420, VLC_CODEC_YV12, VLC_CODEC_NV12,
+    VLC_CODEC_NV21, VLC_CODEC_I420_10L, VLC_CODEC_P010,
+    VLC_CODEC_I422, VLC_CODEC_I422_10L, VLC_CODEC_I444, VLC_CODEC_I444_10L,
+    VLC_CODEC_I444_16L, VLC_CODEC_I411, VLC_CODEC_I410, VLC_CODEC_YV9,
+    VLC_CODEC_YUYV, VLC_CODEC_UYVY, VLC_CODEC_YVYU, VLC_CODEC_VYUY,
+    VLC_CODEC_RGB15, VLC_CODEC_RGB16, VLC_CODEC_RGB24, VLC_CODEC_RGB32,
+    VLC_CODEC_RGBA, VLC_CODEC_BGRA,
+};
+
+static const vlc_fourcc_t pi_blend_chromas[] = {
+    VLC_CODEC_YUVA, VLC_CODEC_RGBA, VLC_CODEC_YUVP,
 };
 
 /*****************************************************************************
@@ -111,12 +142,16 @@ struct filter_sys_t
 {
     bool b_done;
     int i_loops, i_alpha;
+    unsigned i_width, i_height;
 
-    picture_t *p_base_image;
-    picture_t *p_blend_image;
+    char *psz_base_image;
+    char *psz_blend_image;
 
     vlc_fourcc_t i_base_chroma;
     vlc_fourcc_t i_blend_chroma;
+
+    /* Palette of the generated YUVP images, which do not own it */
+    video_palette_t palette;
 };
 
 static int blendbench_LoadImage( vlc_object_t *p_this, picture_t **pp_pic,
@@ -146,6 +181,199 @@ static int blendbench_LoadImage( vlc_object_t *p_this, picture_t **pp_pic,
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * Generated images: they only depend on the settings, so that results are
+ * reproducible
+ *****************************************************************************/
+static picture_t *blendbench_NewPicture( vlc_fourcc_t i_chroma,
+                                         unsigned i_width, unsigned i_height )
+{
+    video_format_t fmt;
+
+    video_format_Init( &fmt, i_chroma );
+    video_format_Setup( &fmt, i_chroma, i_width, i_height,
+                        i_width, i_height, 1, 1 );
+    return picture_NewFromFormat( &fmt );
+}
+
+/* A video frame: smooth gradients within the range of each sample size */
+static picture_t *blendbench_NewBase( vlc_fourcc_t i_chroma,
+                                      unsigned i_width, unsigned i_height )
+{
+    const vlc_chroma_description_t *p_dsc =
+        vlc_fourcc_GetChromaDescription( i_chroma );
+    if( !p_dsc )
+        return NULL;
+
+    picture_t *p_pic = blendbench_NewPicture( i_chroma, i_width, i_height );
+    if( !p_pic )
+        return NULL;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        const plane_t *p = &p_pic->p[i];
+
+        for( int y = 0; y < p->i_lines; y++ )
+        {
+            uint8_t *p_line = &p->p_pixels[y * p->i_pitch];
+
+            if( p_dsc->pixel_size == 2 && p_dsc->plane_count > 1 )
+            {
+                const unsigned i_max = (1 << p_dsc->pixel_bits) - 1;
+                uint16_t *p_line16 = (uint16_t *)p_line;
+                for( int x = 0; x < p->i_pitch / 2; x++ )
+                    p_line16[x] = (x * 3 + y * 5 + i * 1000) % (i_max + 1);
+            }
+            else
+                for( int x = 0; x < p->i_pitch; x++ )
+                    p_line[x] = x + 2 * y + 64 * i;
+        }
+    }
+    return p_pic;
+}
+
+/* Subtitle-like image: transparent but for two lines of "text" with
+ * antialiased edges, over a semi-transparent box */
+static void blendbench_Pixel( unsigned x, unsigned y, unsigned i_width,
+                              unsigned i_height, uint8_t px[4] )
+{
+    const unsigned i_top = i_height * 3 / 4, i_bottom = i_height * 9 / 10;
+    const unsigned i_left = i_width / 6, i_right = i_width * 5 / 6;
+
+    px[0] = 235;
+    px[1] = 128 + (x * 16 / i_width);
+    px[2] = 128 - (y * 16 / i_height);
+    px[3] = 0;
+
+    if( y < i_top || y >= i_bottom || x < i_left || x >= i_right )
+        return;
+
+    /* Box */
+    px[3] = 96;
+    px[0] = 16;
+
+    /* Glyphs: strokes with 2 pixels of edges */
+    const unsigned i_line = (i_bottom - i_top) / 2;
+    const unsigned v = (y - i_top) % i_line, u = (x - i_left) % 24;
+    if( v < i_line / 8 || v >= i_line * 7 / 8 || (x / 24) % 5 == 4 )
+        return;
+
+    const unsigned d = __MIN( u % 8, (v + x / 24) % 8 );
+    if( d < 3 )
+    {
+        px[0] = 235;
+        px[3] = 255;
+    }
+    else if( d < 5 )
+    {
+        px[0] = 128;
+        px[3] = 96 + (5 - d) * 64;
+    }
+}
+
+static picture_t *blendbench_NewBlend( vlc_fourcc_t i_chroma,
+                                       unsigned i_width, unsigned i_height,
+                                       video_palette_t *p_palette )
+{
+    picture_t *p_pic = blendbench_NewPicture( i_chroma, i_width, i_height );
+    if( !p_pic )
+        return NULL;
+
+    if( i_chroma == VLC_CODEC_YUVP )
+    {
+        /* Each entry is a (luma, alpha) pair of the image */
+        static const uint8_t pi_entries[][2] = {
+            { 235, 0 }, { 16, 96 }, { 128, 160 }, { 128, 224 }, { 235, 255 },
+        };
+        p_pic->format.p_palette = p_palette;
+        p_palette->i_entries = ARRAY_SIZE(pi_entries);
+        for( unsigned i = 0; i < ARRAY_SIZE(pi_entries); i++ )
+        {
+            p_palette->palette[i][0] = pi_entries[i][0];
+            p_palette->palette[i][1] = 128;
+            p_palette->palette[i][2] = 128;
+            p_palette->palette[i][3] = pi_entries[i][1];
+        }
+    }
+
+    for( unsigned y = 0; y < i_height; y++ )
+        for( unsigned x = 0; x < i_width; x++ )
+        {
+            uint8_t px[4];
+            blendbench_Pixel( x, y, i_width, i_height, px );
+
+            if( i_chroma == VLC_CODEC_YUVA )
+            {
+                for( int i = 0; i < 4; i++ )
+                    p_pic->p[i].p_pixels[y * p_pic->p[i].i_pitch + x] = px[i];
+            }
+            else if( i_chroma == VLC_CODEC_RGBA )
+            {
+                uint8_t *p_rgba = &p_pic->p[0].p_pixels[y * p_pic->p[0].i_pitch
+                                                        + 4 * x];
+                int r, g, b;
+                yuv_to_rgb( &r, &g, &b, px[0], px[1], px[2] );
+                p_rgba[0] = r;
+                p_rgba[1] = g;
+                p_rgba[2] = b;
+                p_rgba[3] = px[3];
+            }
+            else
+            {
+                uint8_t i_index = 0;
+                for( int i = 0; i < p_pic->format.p_palette->i_entries; i++ )
+                    if( p_pic->format.p_palette->palette[i][3] == px[3] )
+                        i_index = i;
+                p_pic->p[0].p_pixels[y * p_pic->p[0].i_pitch + x] = i_index;
+            }
+        }
+    return p_pic;
+}
+
+static picture_t *blendbench_GetImage( filter_t *p_filter, char *psz_file,
+                                       vlc_fourcc_t i_chroma, bool b_base )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    picture_t *p_pic;
+
+    if( psz_file && *psz_file )
+    {
+        if( blendbench_LoadImage( VLC_OBJECT(p_filter), &p_pic, i_chroma,
+                                  psz_file, b_base ? "Base" : "Blend" ) )
+            return NULL;
+        return p_pic;
+    }
+    if( b_base )
+        return blendbench_NewBase( i_chroma, p_sys->i_width,
+                                   p_sys->i_height );
+    return blendbench_NewBlend( i_chroma, p_sys->i_width, p_sys->i_height,
+                                &p_sys->palette );
+}
+
+static uint32_t blendbench_Checksum( const picture_t *p_pic )
+{
+    uint32_t i_sum = 2166136261u;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+        for( int y = 0; y < p_pic->p[i].i_visible_lines; y++ )
+        {
+            const uint8_t *p_line = &p_pic->p[i].p_pixels[y * p_pic->p[i].i_pitch];
+            for( int x = 0; x < p_pic->p[i].i_visible_pitch; x++ )
+                i_sum = (i_sum ^ p_line[x]) * 16777619u;
+        }
+    return i_sum;
+}
+
+static vlc_fourcc_t blendbench_GetChroma( filter_t *p_filter,
+                                          const char *psz_name )
+{
+    char *psz_temp = var_CreateGetStringCommand( p_filter, psz_name );
+    vlc_fourcc_t i_chroma = !psz_temp || strlen( psz_temp ) != 4 ? 0 :
+        VLC_FOURCC( psz_temp[0], psz_temp[1], psz_temp[2], psz_temp[3] );
+    free( psz_temp );
+    return i_chroma;
+}
+
 /*****************************************************************************
  * Create: allocates video thread output method
  *****************************************************************************/
@@ -153,8 +381,6 @@ static int Create( vlc_object_t *p_this )
 {
     filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys;
-    char *psz_temp, *psz_cmd;
-    int i_ret;
 
     /* Allocate structure */
     p_filter->p_sys = malloc( sizeof( filter_sys_t ) );
@@ -175,39 +401,19 @@ static int Create( vlc_object_t *p_this )
                                                   CFG_PREFIX "loops" );
     p_sys->i_alpha = var_CreateGetIntegerCommand( p_filter,
                                                   CFG_PREFIX "alpha" );
-
-    psz_temp = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-chroma" );
-    p_sys->i_base_chroma = !psz_temp || strlen( psz_temp ) != 4 ? 0 :
-        VLC_FOURCC( psz_temp[0], psz_temp[1], psz_temp[2], psz_temp[3] );
-    psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-image" );
-    i_ret = blendbench_LoadImage( p_this, &p_sys->p_base_image,
-                                  p_sys->i_base_chroma, psz_cmd, "Base" );
-    free( psz_temp );
-    free( psz_cmd );
-    if( i_ret != VLC_SUCCESS )
-    {
-        free( p_sys );
-        return i_ret;
-    }
-
-    psz_temp = var_CreateGetStringCommand( p_filter,
-                                           CFG_PREFIX "blend-chroma" );
-    p_sys->i_blend_chroma = !psz_temp || strlen( psz_temp ) != 4
-        ? 0 : VLC_FOURCC( psz_temp[0], psz_temp[1], psz_temp[2], psz_temp[3] );
-    psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "blend-image" );
-    i_ret = blendbench_LoadImage( p_this, &p_sys->p_blend_image, p_sys->i_blend_chroma,
-                                  psz_cmd, "Blend" );
-
-    free( psz_temp );
-    free( psz_cmd );
-
-    if( i_ret != VLC_SUCCESS )
-    {
-        picture_Release( p_sys->p_base_image );
-        free( p_sys );
-
-        return VLC_EGENERIC;
-    }
+    p_sys->i_width = __MAX( var_CreateGetIntegerCommand( p_filter,
+                                                CFG_PREFIX "width" ), 16 );
+    p_sys->i_height = __MAX( var_CreateGetIntegerCommand( p_filter,
+                                                CFG_PREFIX "height" ), 16 );
+
+    p_sys->i_base_chroma = blendbench_GetChroma( p_filter,
+                                                 CFG_PREFIX "base-chroma" );
+    p_sys->psz_base_image = var_CreateGetStringCommand( p_filter,
+                                                  CFG_PREFIX "base-image" );
+    p_sys->i_blend_chroma = blendbench_GetChroma( p_filter,
+                                                  CFG_PREFIX "blend-chroma" );
+    p_sys->psz_blend_image = var_CreateGetStringCommand( p_filter,
+                                                  CFG_PREFIX "blend-image" );
 
     return VLC_SUCCESS;
 }
@@ -220,57 +426,101 @@ static void Destroy( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
-    picture_Release( p_sys->p_base_image );
-    picture_Release( p_sys->p_blend_image );
+    free( p_sys->psz_base_image );
+    free( p_sys->psz_blend_image );
+    free( p_sys );
 }
 
 /*****************************************************************************
- * Render: displays previously rendered output
+ * Bench: blends one pair of chromas
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+static void Bench( filter_t *p_filter, vlc_fourcc_t i_base_chroma,
+                   vlc_fourcc_t i_blend_chroma )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
-    filter_t *p_blend;
-
-    if( p_sys->b_done )
-        return p_pic;
-
-    p_blend = vlc_object_create( p_filter, sizeof(filter_t) );
-    if( !p_blend )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
-    p_blend->fmt_out.video = p_sys->p_base_image->format;
-    p_blend->fmt_in.video = p_sys->p_blend_image->format;
-    p_blend->p_module = module_need( p_blend, "video blending", NULL, false );
-    if( !p_blend->p_module )
+    picture_t *p_base, *p_blend, *p_dst;
+    filter_t *p_blend_filter;
+
+    p_base = blendbench_GetImage( p_filter, p_sys->psz_base_image,
+                                  i_base_chroma, true );
+    p_blend = blendbench_GetImage( p_filter, p_sys->psz_blend_image,
+                                   i_blend_chroma, false );
+    p_dst = p_base ? picture_NewFromFormat( &p_base->format ) : NULL;
+    p_blend_filter = vlc_object_create( p_filter, sizeof(filter_t) );
+    if( !p_base || !p_blend || !p_dst || !p_blend_filter )
+        goto end;
+
+    p_blend_filter->fmt_out.video = p_base->format;
+    p_blend_filter->fmt_in.video = p_blend->format;
+    p_blend_filter->p_module = module_need( p_blend_filter, "video blending",
+                                            NULL, false );
+    if( !p_blend_filter->p_module )
     {
-        picture_Release( p_pic );
-        vlc_object_release( p_blend );
-        return NULL;
+        msg_Dbg( p_filter, "%4.4s -> %4.4s: not supported",
+                 (const char *)&i_blend_chroma, (const char *)&i_base_chroma );
+        goto end;
     }
 
+    /* The checksum of a single blend can be compared across builds */
+    picture_Copy( p_dst, p_base );
+    p_blend_filter->pf_video_blend( p_blend_filter, p_dst, p_blend,
+                                    0, 0, p_sys->i_alpha );
+    uint32_t i_checksum = blendbench_Checksum( p_dst );
+
     mtime_t time = mdate();
     for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
     {
-        p_blend->pf_video_blend( p_blend,
-                                 p_sys->p_base_image, p_sys->p_blend_image,
-                                 0, 0, p_sys->i_alpha );
+        p_blend_filter->pf_video_blend( p_blend_filter, p_dst, p_blend,
+                                        0, 0, p_sys->i_alpha );
     }
     time = mdate() - time;
 
-    msg_Info( p_filter, "Blended %d images in %f sec", p_sys->i_loops,
-              time / 1000000.0f );
+    msg_Info( p_filter, "%4.4s -> %4.4s: %d blends in %f sec, %f ms per "
+              "blend, checksum %08"PRIx32,
+              (const char *)&i_blend_chroma, (const char *)&i_base_chroma,
+              p_sys->i_loops, time / 1000000.0f,
+              p_sys->i_loops > 0 ? time / 1000.0f / p_sys->i_loops : 0.f,
+              i_checksum );
     msg_Info( p_filter, "Speed is: %f images/second, %f pixels/second",
               (float) p_sys->i_loops / time * 1000000,
               (float) p_sys->i_loops / time * 1000000 *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_pitch *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_lines );
+                  p_blend->format.i_visible_width *
+                  p_blend->format.i_visible_height );
+
+    module_unneed( p_blend_filter, p_blend_filter->p_module );
+end:
+    if( p_blend_filter )
+        vlc_object_release( p_blend_filter );
+    if( p_dst )
+        picture_Release( p_dst );
+    if( p_blend )
+        picture_Release( p_blend );
+    if( p_base )
+        picture_Release( p_base );
+}
+
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
 
-    module_unneed( p_blend, p_blend->p_module );
+    if( p_sys->b_done )
+        return p_pic;
 
-    vlc_object_release( p_blend );
+    for( size_t i = 0; i < ARRAY_SIZE(pi_base_chromas); i++ )
+    {
+        if( p_sys->i_base_chroma && p_sys->i_base_chroma != pi_base_chromas[i] )
+            continue;
+        for( size_t j = 0; j < ARRAY_SIZE(pi_blend_chromas); j++ )
+        {
+            if( p_sys->i_blend_chroma
+             && p_sys->i_blend_chroma != pi_blend_chromas[j] )
+                continue;
+            Bench( p_filter, pi_base_chromas[i], pi_blend_chromas[j] );
+        }
+    }
 
     p_sys->b_done = true;
     return p_pic;
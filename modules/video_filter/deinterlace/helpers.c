@@ -30,6 +30,10 @@
 #   include <stdalign.h>
 #endif
 
+#if defined(CAN_COMPILE_AVX2)
+#   include <immintrin.h>
+#endif
+
 #include <stdint.h>
 #include <assert.h>
 
@@ -246,6 +250,59 @@ static int TestForMotionInBlockMMX( uint8_t *p_pix_p, uint8_t *p_pix_c,
     return (i_motion >= 8);
 }
 #endif
+
+#ifdef CAN_COMPILE_AVX2
+/**
+ * AVX2 version of TestForMotionInBlock(), which tests 4 horizontally
+ * adjacent blocks at once. The results are bit-exact with the C version.
+ *
+ * @return number of blocks (0 to 4) with motion; the number of blocks
+ *         whose top and bottom fields had motion are returned likewise.
+ */
+VLC_AVX2
+static int TestForMotionInBlocksAVX2( uint8_t *p_pix_p, uint8_t *p_pix_c,
+                                      int i_pitch_prev, int i_pitch_curr,
+                                      int* pi_top, int* pi_bot )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8( 1 );
+    const __m256i threshold = _mm256_set1_epi8( T + 1 );
+    __m256i score[2] = { zero, zero }; /* top, bottom */
+
+    for( int y = 0; y < 8; ++y )
+    {
+        __m256i c = _mm256_loadu_si256( (const __m256i *)p_pix_c );
+        __m256i p = _mm256_loadu_si256( (const __m256i *)p_pix_p );
+        __m256i diff = _mm256_or_si256( _mm256_subs_epu8( c, p ),
+                                        _mm256_subs_epu8( p, c ) );
+        /* diff > T, as unsigned bytes */
+        __m256i moved = _mm256_cmpeq_epi8(
+                            _mm256_max_epu8( diff, threshold ), diff );
+
+        /* Each 64-bits lane sums the 8 pixels of one block */
+        score[y % 2] = _mm256_add_epi64( score[y % 2],
+            _mm256_sad_epu8( _mm256_and_si256( moved, one ), zero ) );
+
+        p_pix_c += i_pitch_curr;
+        p_pix_p += i_pitch_prev;
+    }
+
+    uint64_t top[4], bot[4];
+    _mm256_storeu_si256( (__m256i *)top, score[0] );
+    _mm256_storeu_si256( (__m256i *)bot, score[1] );
+
+    int i_motion = 0;
+    *pi_top = *pi_bot = 0;
+    for( int i = 0; i < 4; i++ )
+    {
+        /* Same thresholds as TestForMotionInBlock() */
+        *pi_top += ( top[i] >= 8 );
+        *pi_bot += ( bot[i] >= 8 );
+        i_motion += ( top[i] + bot[i] >= 8 );
+    }
+    return i_motion;
+}
+#endif
 #undef T
 
 /*****************************************************************************
@@ -395,11 +452,19 @@ int EstimateNumBlocksWithMotion( const picture_t* p_prev,
 
     int (*motion_in_block)(uint8_t *, uint8_t *, int , int, int *, int *) =
         TestForMotionInBlock;
+    int i_blocks = 1; /* number of blocks tested by motion_in_block() */
     /* We must tell our inline helper whether to use MMX acceleration. */
 #ifdef CAN_COMPILE_MMXEXT
     if (vlc_CPU_MMXEXT())
         motion_in_block = TestForMotionInBlockMMX;
 #endif
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        motion_in_block = TestForMotionInBlocksAVX2;
+        i_blocks = 4;
+    }
+#endif
 
     int i_score = 0;
     for( int i_plane = 0 ; i_plane < p_prev->i_planes ; i_plane++ )
@@ -424,7 +489,8 @@ int EstimateNumBlocksWithMotion( const picture_t* p_prev,
             uint8_t *p_pix_p = &p_prev->p[i_plane].p_pixels[i_pitch_prev*8*by];
             uint8_t *p_pix_c = &p_curr->p[i_plane].p_pixels[i_pitch_curr*8*by];
 
-            for( int bx = 0; bx < i_mbx; ++bx )
+            int bx = 0;
+            for( ; bx + i_blocks <= i_mbx; bx += i_blocks )
             {
                 int i_top_temp, i_bot_temp;
                 i_score += motion_in_block( p_pix_p, p_pix_c,
@@ -433,6 +499,19 @@ int EstimateNumBlocksWithMotion( const picture_t* p_prev,
                 i_score_top += i_top_temp;
                 i_score_bot += i_bot_temp;
 
+                p_pix_p += 8 * i_blocks;
+                p_pix_c += 8 * i_blocks;
+            }
+            /* Remaining blocks, if motion_in_block() tests several */
+            for( ; bx < i_mbx; ++bx )
+            {
+                int i_top_temp, i_bot_temp;
+                i_score += TestForMotionInBlock( p_pix_p, p_pix_c,
+                                                 i_pitch_prev, i_pitch_curr,
+                                                 &i_top_temp, &i_bot_temp );
+                i_score_top += i_top_temp;
+                i_score_bot += i_bot_temp;
+
                 p_pix_p += 8;
                 p_pix_c += 8;
             }
@@ -450,6 +529,99 @@ int EstimateNumBlocksWithMotion( const picture_t* p_prev,
 /* Threshold (value from Transcode 1.1.5) */
 #define T 100
 
+/**
+ * Internal helper function for CalculateInterlaceScore():
+ * counts the combed pixels of one line.
+ *
+ * @param p_c Current line
+ * @param p_p Previous line of the other field
+ * @param p_n Next line of the other field
+ * @param w Number of pixels
+ * @return number of pixels whose comb metric exceeds the threshold
+ */
+static int32_t CalculateCombScore( const uint8_t *p_c, const uint8_t *p_p,
+                                   const uint8_t *p_n, int w )
+{
+    int32_t i_score = 0;
+
+    for( int x = 0; x < w; ++x )
+    {
+        /* Worst case: need 17 bits for "comb". */
+        int_fast32_t C = *p_c;
+        int_fast32_t P = *p_p;
+        int_fast32_t N = *p_n;
+
+        /* Comments in Transcode's filter_ivtc.c attribute this
+           combing metric to Gunnar Thalin.
+
+            The idea is that if the picture is interlaced, both
+            expressions will have the same sign, and this comes
+            up positive. The value T = 100 has been chosen such
+            that a pixel difference of 10 (on average) will
+            trigger the detector.
+        */
+        int_fast32_t comb = (P - C) * (N - C);
+        if( comb > T )
+            ++i_score;
+
+        ++p_c;
+        ++p_p;
+        ++p_n;
+    }
+    return i_score;
+}
+
+#ifdef CAN_COMPILE_AVX2
+/**
+ * AVX2 version of CalculateCombScore(). The results are bit-exact.
+ *
+ * The product of the differences needs 17 bits, but only matters when both
+ * differences have the same sign: it is then the product of their absolute
+ * values, which fits in 16 unsigned bits.
+ */
+VLC_AVX2
+static int32_t CalculateCombScoreAVX2( const uint8_t *p_c, const uint8_t *p_p,
+                                       const uint8_t *p_n, int w )
+{
+    const __m256i one = _mm256_set1_epi16( 1 );
+    const __m256i threshold = _mm256_set1_epi16( T + 1 );
+    __m256i score = _mm256_setzero_si256();
+    int x = 0;
+
+    for( ; x + 16 <= w; x += 16 )
+    {
+        __m256i C = _mm256_cvtepu8_epi16(
+                        _mm_loadu_si128( (const __m128i *)&p_c[x] ) );
+        __m256i P = _mm256_cvtepu8_epi16(
+                        _mm_loadu_si128( (const __m128i *)&p_p[x] ) );
+        __m256i N = _mm256_cvtepu8_epi16(
+                        _mm_loadu_si128( (const __m128i *)&p_n[x] ) );
+        __m256i dp = _mm256_sub_epi16( P, C );
+        __m256i dn = _mm256_sub_epi16( N, C );
+        __m256i comb = _mm256_mullo_epi16( _mm256_abs_epi16( dp ),
+                                           _mm256_abs_epi16( dn ) );
+        /* comb > T, as unsigned words */
+        __m256i combed = _mm256_cmpeq_epi16(
+                             _mm256_max_epu16( comb, threshold ), comb );
+        /* ...and the differences have the same sign */
+        combed = _mm256_andnot_si256(
+                     _mm256_srai_epi16( _mm256_xor_si256( dp, dn ), 15 ),
+                     combed );
+
+        score = _mm256_add_epi32( score, _mm256_madd_epi16(
+                    _mm256_and_si256( combed, one ), one ) );
+    }
+
+    __m128i sum = _mm_add_epi32( _mm256_castsi256_si128( score ),
+                                 _mm256_extracti128_si256( score, 1 ) );
+    sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, 0x4E ) );
+    sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, 0xB1 ) );
+
+    return _mm_cvtsi128_si32( sum )
+         + CalculateCombScore( &p_c[x], &p_p[x], &p_n[x], w - x );
+}
+#endif
+
 #ifdef CAN_COMPILE_MMXEXT
 VLC_MMX
 static int CalculateInterlaceScoreMMX( const picture_t* p_pic_top,
@@ -606,8 +778,14 @@ int CalculateInterlaceScore( const picture_t* p_pic_top,
     if( p_pic_top->i_planes != p_pic_bot->i_planes )
         return -1;
 
+    int32_t (*comb_score)( const uint8_t *, const uint8_t *,
+                           const uint8_t *, int ) = CalculateCombScore;
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+        comb_score = CalculateCombScoreAVX2;
+#endif
 #ifdef CAN_COMPILE_MMXEXT
-    if (vlc_CPU_MMXEXT())
+    if (comb_score == CalculateCombScore && vlc_CPU_MMXEXT())
         return CalculateInterlaceScoreMMX( p_pic_top, p_pic_bot );
 #endif
 
@@ -640,30 +818,7 @@ int CalculateInterlaceScore( const picture_t* p_pic_top,
             uint8_t *p_p = &ngh->p[i_plane].p_pixels[(y-1)*wn]; /* prev line */
             uint8_t *p_n = &ngh->p[i_plane].p_pixels[(y+1)*wn]; /* next line */
 
-            for( int x = 0; x < w; ++x )
-            {
-                /* Worst case: need 17 bits for "comb". */
-                int_fast32_t C = *p_c;
-                int_fast32_t P = *p_p;
-                int_fast32_t N = *p_n;
-
-                /* Comments in Transcode's filter_ivtc.c attribute this
-                   combing metric to Gunnar Thalin.
-
-                    The idea is that if the picture is interlaced, both
-                    expressions will have the same sign, and this comes
-                    up positive. The value T = 100 has been chosen such
-                    that a pixel difference of 10 (on average) will
-                    trigger the detector.
-                */
-                int_fast32_t comb = (P - C) * (N - C);
-                if( comb > T )
-                    ++i_score;
-
-                ++p_c;
-                ++p_p;
-                ++p_n;
-            }
+            i_score += comb_score( p_c, p_p, p_n, w );
 
             /* Now the other field - swap current and neighbour pictures */
             const picture_t *tmp = cur;
@@ -139,11 +139,62 @@ static void yadif_filter_line_c(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8
     FILTER
 }
 
-static void yadif_filter_line_c_16bit(uint16_t *dst, uint16_t *prev, uint16_t *cur, uint16_t *next, int w, int prefs, int mrefs, int parity, int mode) {
+static void yadif_filter_line_c_16bit(uint8_t *dst8, uint8_t *prev8, uint8_t *cur8, uint8_t *next8, int w, int prefs, int mrefs, int parity, int mode) {
     int x;
+    uint16_t *dst = (uint16_t *)dst8;
+    uint16_t *prev = (uint16_t *)prev8;
+    uint16_t *cur = (uint16_t *)cur8;
+    uint16_t *next = (uint16_t *)next8;
     uint16_t *prev2= parity ? prev : cur ;
     uint16_t *next2= parity ? cur  : next;
+    w /= 2;
     mrefs /= 2;
     prefs /= 2;
     FILTER
 }
+
+#if defined(CAN_COMPILE_AVX2) || defined(CAN_COMPILE_AVX512)
+#include <immintrin.h>
+#endif
+
+#ifdef CAN_COMPILE_AVX512
+// ================ AVX-512 ================
+/* GCC 12 warns about the undefined vectors that its own AVX-512 intrinsics
+ * use as pass-through operands (__Y = __Y in _mm512_undefined_epi32()), in
+ * every function inlining them. Nothing in the template is uninitialized. */
+#if defined(__GNUC__) && !defined(__clang__)
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#define HAVE_YADIF_AVX512
+#define COMPILE_TEMPLATE_AVX512 1
+#define VLC_TARGET VLC_AVX512
+#define RENAME(a) a ## _avx512
+#include "yadif_avx_template.h"
+#undef RENAME
+#define COMPILE_TEMPLATE_16BIT 1
+#define RENAME(a) a ## _16bit_avx512
+#include "yadif_avx_template.h"
+#undef COMPILE_TEMPLATE_16BIT
+#undef COMPILE_TEMPLATE_AVX512
+#undef VLC_TARGET
+#undef RENAME
+#if defined(__GNUC__) && !defined(__clang__)
+# pragma GCC diagnostic pop
+#endif
+#endif
+
+#ifdef CAN_COMPILE_AVX2
+// ================= AVX2 =================
+#define HAVE_YADIF_AVX2
+#define VLC_TARGET VLC_AVX2
+#define RENAME(a) a ## _avx2
+#include "yadif_avx_template.h"
+#undef RENAME
+#define COMPILE_TEMPLATE_16BIT 1
+#define RENAME(a) a ## _16bit_avx2
+#include "yadif_avx_template.h"
+#undef COMPILE_TEMPLATE_16BIT
+#undef VLC_TARGET
+#undef RENAME
+#endif
@@ -0,0 +1,209 @@
+/*****************************************************************************
+ * yadif_avx_template.h : AVX2 and AVX-512 Yadif line filters
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This template is included once per instruction set and pixel size, with:
+ *  - COMPILE_TEMPLATE_AVX512 defined for AVX-512, undefined for AVX2,
+ *  - COMPILE_TEMPLATE_16BIT defined for 16-bits pixels,
+ *  - VLC_TARGET and RENAME() defined as for yadif_template.h.
+ *
+ * Pixels are widened to 16-bits lanes (8-bits pixels) or 32-bits lanes
+ * (16-bits pixels), so that every intermediate value of the C version fits
+ * and the output is bit-exact. The pixels that do not fill a whole vector
+ * at the end of the line are filtered by the C version. */
+
+#ifdef COMPILE_TEMPLATE_16BIT
+# define pixel uint16_t
+# define yadif_filter_line_tail yadif_filter_line_c_16bit
+#else
+# define pixel uint8_t
+# define yadif_filter_line_tail yadif_filter_line_c
+#endif
+
+#ifdef COMPILE_TEMPLATE_AVX512
+# define vec __m512i
+# ifdef COMPILE_TEMPLATE_16BIT
+#  define mask_t __mmask16
+#  define STEP 16
+#  define LOAD(p) _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)(p)))
+#  define STORE(p, v) _mm256_storeu_si256((__m256i *)(p), _mm512_cvtepi32_epi16(v))
+#  define OP(op) _mm512_##op##_epi32
+#  define CMPLT(a, b) _mm512_cmplt_epi32_mask(a, b)
+#  define SELECT(m, a, b) _mm512_mask_blend_epi32(m, b, a)
+# else
+#  define mask_t __mmask32
+#  define STEP 32
+#  define LOAD(p) _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(p)))
+#  define STORE(p, v) _mm256_storeu_si256((__m256i *)(p), _mm512_cvtepi16_epi8(v))
+#  define OP(op) _mm512_##op##_epi16
+#  define CMPLT(a, b) _mm512_cmplt_epi16_mask(a, b)
+#  define SELECT(m, a, b) _mm512_mask_blend_epi16(m, b, a)
+# endif
+# define AND_MASK(m1, m2) ((m1) & (m2))
+# define ZERO() _mm512_setzero_si512()
+#else
+# define vec __m256i
+# define mask_t __m256i
+# ifdef COMPILE_TEMPLATE_16BIT
+#  define STEP 8
+#  define LOAD(p) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+#  define STORE(p, v) \
+    _mm_storeu_si128((__m128i *)(p), _mm256_castsi256_si128( \
+        _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08)))
+#  define OP(op) _mm256_##op##_epi32
+# else
+#  define STEP 16
+#  define LOAD(p) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#  define STORE(p, v) \
+    _mm_storeu_si128((__m128i *)(p), _mm256_castsi256_si128( \
+        _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08)))
+#  define OP(op) _mm256_##op##_epi16
+# endif
+# define CMPLT(a, b) OP(cmpgt)(b, a)
+# define SELECT(m, a, b) _mm256_blendv_epi8(b, a, m)
+# define AND_MASK(m1, m2) _mm256_and_si256(m1, m2)
+# define ZERO() _mm256_setzero_si256()
+#endif
+
+#define ADD(a, b) OP(add)(a, b)
+#define SUB(a, b) OP(sub)(a, b)
+#define ABSDIFF(a, b) OP(abs)(SUB(a, b))
+#define VMAX(a, b) OP(max)(a, b)
+#define VMIN(a, b) OP(min)(a, b)
+#define HALF(a) OP(srai)(a, 1)
+
+/* Edge-directed interpolation score and prediction along direction j */
+#define SCORE(j) \
+    ADD(ADD(ABSDIFF(LOAD(&cur[mrefs-1+(j)]), LOAD(&cur[prefs-1-(j)])), \
+            ABSDIFF(LOAD(&cur[mrefs  +(j)]), LOAD(&cur[prefs  -(j)]))), \
+            ABSDIFF(LOAD(&cur[mrefs+1+(j)]), LOAD(&cur[prefs+1-(j)])))
+#define PRED(j) \
+    HALF(ADD(LOAD(&cur[mrefs+(j)]), LOAD(&cur[prefs-(j)])))
+
+VLC_TARGET
+static void RENAME(yadif_filter_line)(uint8_t *dst8, uint8_t *prev8,
+                                      uint8_t *cur8, uint8_t *next8, int w,
+                                      int prefs, int mrefs, int parity,
+                                      int mode)
+{
+    pixel *dst = (pixel *)dst8;
+    pixel *prev = (pixel *)prev8;
+    pixel *cur = (pixel *)cur8;
+    pixel *next = (pixel *)next8;
+    pixel *prev2 = parity ? prev : cur;
+    pixel *next2 = parity ? cur  : next;
+
+    /* Width and line offsets are given in bytes */
+    const int size = sizeof (pixel);
+    const int pixels = w / size;
+    prefs /= size;
+    mrefs /= size;
+
+    const vec one = OP(set1)(1);
+    int x;
+
+    for (x = 0; x + STEP <= pixels; x += STEP) {
+        vec c = LOAD(&cur[mrefs]);
+        vec e = LOAD(&cur[prefs]);
+        vec p2 = LOAD(prev2);
+        vec n2 = LOAD(next2);
+        vec d = HALF(ADD(p2, n2));
+
+        vec temporal_diff0 = ABSDIFF(p2, n2);
+        vec temporal_diff1 = HALF(ADD(ABSDIFF(LOAD(&prev[mrefs]), c),
+                                      ABSDIFF(LOAD(&prev[prefs]), e)));
+        vec temporal_diff2 = HALF(ADD(ABSDIFF(LOAD(&next[mrefs]), c),
+                                      ABSDIFF(LOAD(&next[prefs]), e)));
+        vec diff = VMAX(VMAX(HALF(temporal_diff0), temporal_diff1),
+                       temporal_diff2);
+
+        vec spatial_pred = HALF(ADD(c, e));
+        vec spatial_score = SUB(SCORE(0), one);
+        vec score;
+        mask_t better;
+
+        /* As CHECK(-1) CHECK(-2) in the C version: the second direction is
+         * only tried where the first one improved the score. */
+        score = SCORE(-1);
+        better = CMPLT(score, spatial_score);
+        spatial_score = SELECT(better, score, spatial_score);
+        spatial_pred = SELECT(better, PRED(-1), spatial_pred);
+        score = SCORE(-2);
+        better = AND_MASK(better, CMPLT(score, spatial_score));
+        spatial_score = SELECT(better, score, spatial_score);
+        spatial_pred = SELECT(better, PRED(-2), spatial_pred);
+
+        score = SCORE(1);
+        better = CMPLT(score, spatial_score);
+        spatial_score = SELECT(better, score, spatial_score);
+        spatial_pred = SELECT(better, PRED(1), spatial_pred);
+        score = SCORE(2);
+        better = AND_MASK(better, CMPLT(score, spatial_score));
+        spatial_pred = SELECT(better, PRED(2), spatial_pred);
+
+        if (mode < 2) {
+            vec b = HALF(ADD(LOAD(&prev2[2*mrefs]), LOAD(&next2[2*mrefs])));
+            vec f = HALF(ADD(LOAD(&prev2[2*prefs]), LOAD(&next2[2*prefs])));
+            vec de = SUB(d, e), dc = SUB(d, c);
+            vec bc = SUB(b, c), fe = SUB(f, e);
+            vec max = VMAX(VMAX(de, dc), VMIN(bc, fe));
+            vec min = VMIN(VMIN(de, dc), VMAX(bc, fe));
+
+            diff = VMAX(VMAX(diff, min), SUB(ZERO(), max));
+        }
+
+        /* diff is never negative, so clipping is a plain min/max */
+        spatial_pred = VMIN(VMAX(spatial_pred, SUB(d, diff)), ADD(d, diff));
+        STORE(dst, spatial_pred);
+
+        dst += STEP;
+        cur += STEP;
+        prev += STEP;
+        next += STEP;
+        prev2 += STEP;
+        next2 += STEP;
+    }
+
+    if (x < pixels)
+        yadif_filter_line_tail((uint8_t *)dst, (uint8_t *)prev,
+                               (uint8_t *)cur, (uint8_t *)next,
+                               (pixels - x) * size, prefs * size, mrefs * size,
+                               parity, mode);
+}
+
+#undef pixel
+#undef yadif_filter_line_tail
+#undef vec
+#undef mask_t
+#undef STEP
+#undef LOAD
+#undef STORE
+#undef OP
+#undef CMPLT
+#undef SELECT
+#undef AND_MASK
+#undef ZERO
+#undef ADD
+#undef SUB
+#undef ABSDIFF
+#undef VMAX
+#undef VMIN
+#undef HALF
+#undef SCORE
+#undef PRED
@@ -108,6 +108,8 @@ struct filter_sys_t {
     int              radius;
     const vlc_chroma_description_t *chroma;
     struct vf_priv_s cfg;
+    unsigned         slices;
+    size_t           slice_size; /* scratch elements per slice */
 };
 
 static int Open(vlc_object_t *object)
@@ -133,6 +135,9 @@ static int Open(vlc_object_t *object)
     var_AddCallback(filter, CFG_PREFIX "radius",   Callback, NULL);
     sys->cfg.buf = NULL;
 
+    sys->slices = filter_GetSliceCount(filter);
+    sys->slice_size = 0;
+
     struct vf_priv_s *cfg = &sys->cfg;
     cfg->thresh      = 0.0;
     cfg->radius      = 0;
@@ -173,6 +178,68 @@ static void Close(vlc_object_t *object)
     free(sys);
 }
 
+struct gradfun_frame
+{
+    filter_sys_t *sys;
+    const video_format_t *fmt;
+    picture_t    *src;
+    picture_t    *dst;
+};
+
+/* Filters one horizontal slice of every plane. The blur window spans r
+ * lines above and below each line, so slices other than the first one
+ * start within (r, height - r) and rebuild the blur state from there. */
+static void FilterSlice(void *data, unsigned index, unsigned count)
+{
+    const struct gradfun_frame *frame = data;
+    filter_sys_t *sys = frame->sys;
+    struct vf_priv_s *cfg = &sys->cfg;
+    const video_format_t *fmt = frame->fmt;
+    uint16_t *scratch = cfg->buf + index * sys->slice_size;
+
+    for (int i = 0; i < frame->dst->i_planes; i++) {
+        const plane_t *srcp = &frame->src->p[i];
+        plane_t       *dstp = &frame->dst->p[i];
+
+        const vlc_chroma_description_t *chroma = sys->chroma;
+        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
+        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
+        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
+                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
+        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
+
+        if (__MIN(w, h) > 2 * r && cfg->buf) {
+            /* Slice boundaries must lie in [r + 2, h - r - 1], on even
+             * lines; small planes are filtered by the first slice only. */
+            int lo = r + 2, hi = (h - r - 1) & ~1;
+            unsigned begin = 0, end = h;
+
+            if (hi >= lo) {
+                filter_GetSliceLines(h, index, count, 2, &begin, &end);
+                if (index > 0)
+                    begin = VLC_CLIP((int)begin, lo, hi);
+                if (index + 1 < count)
+                    end = VLC_CLIP((int)end, lo, hi);
+            } else if (index > 0)
+                continue;
+
+            if (begin < end)
+                filter_plane(cfg, scratch, dstp->p_pixels, srcp->p_pixels,
+                             w, h, dstp->i_pitch, srcp->i_pitch, r,
+                             begin, end);
+        } else {
+            /* Copy the lines of this slice */
+            unsigned begin, end;
+            filter_GetSliceLines(dstp->i_visible_lines, index, count, 1,
+                                 &begin, &end);
+            for (unsigned y = begin; y < end; y++)
+                memcpy(&dstp->p_pixels[y * dstp->i_pitch],
+                       &srcp->p_pixels[y * srcp->i_pitch],
+                       __MIN(dstp->i_visible_pitch, srcp->i_visible_pitch));
+        }
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     filter_sys_t *sys = filter->p_sys;
@@ -194,27 +261,18 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     cfg->thresh = (1 << 15) / strength;
     if (cfg->radius != radius) {
         cfg->radius = radius;
-        cfg->buf    = aligned_alloc(16,
-                                   (((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32) * sizeof(*cfg->buf));
+        /* Keep every slice scratch buffer 16-bytes aligned */
+        sys->slice_size = ((((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2
+                            + 32) + 7) & ~7;
+        aligned_free(cfg->buf);
+        cfg->buf    = aligned_alloc(16, sys->slices * sys->slice_size
+                                        * sizeof(*cfg->buf));
     }
 
-    for (int i = 0; i < dst->i_planes; i++) {
-        const plane_t *srcp = &src->p[i];
-        plane_t       *dstp = &dst->p[i];
-
-        const vlc_chroma_description_t *chroma = sys->chroma;
-        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
-        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
-        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
-                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
-        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
-        if (__MIN(w, h) > 2 * r && cfg->buf) {
-            filter_plane(cfg, dstp->p_pixels, srcp->p_pixels,
-                         w, h, dstp->i_pitch, srcp->i_pitch, r);
-        } else {
-            plane_CopyPixels(dstp, srcp);
-        }
-    }
+    struct gradfun_frame frame = {
+        .sys = sys, .fmt = fmt, .src = src, .dst = dst,
+    };
+    filter_ExecuteSlices(filter, FilterSlice, &frame, sys->slices);
 
     picture_CopyProperties(dst, src);
     picture_Release(src);
@@ -222,19 +222,36 @@ static void blur_line_sse2(uint16_t *dc, uint16_t *buf, uint16_t *buf1,
 }
 #endif // HAVE_6REGS && HAVE_SSE2
 
-static void filter_plane(struct vf_priv_s *ctx, uint8_t *dst, uint8_t *src,
-                         int width, int height, int dstride, int sstride, int r)
+/* Filters the lines [ystart, yend) of a plane, using buf as scratch space.
+ * The first line of a slice must be even, and either be zero or lie in
+ * (r, height - r): the vertical blur state is then rebuilt from the r pairs
+ * of lines above the slice. */
+static void filter_plane(struct vf_priv_s *ctx, uint16_t *scratch,
+                         uint8_t *dst, uint8_t *src,
+                         int width, int height, int dstride, int sstride, int r,
+                         int ystart, int yend)
 {
     int bstride = ((width+15)&~15)/2;
     int y;
     uint32_t dc_factor = (1<<21)/(r*r);
-    uint16_t *dc = ctx->buf+16;
-    uint16_t *buf = ctx->buf+bstride+32;
+    uint16_t *dc = scratch+16;
+    uint16_t *buf = scratch+bstride+32;
     int thresh = ctx->thresh;
 
     memset(dc, 0, (bstride+16)*sizeof(*buf));
-    for (y=0; y<r; y++)
-        ctx->blur_line(dc, buf+y*bstride, buf+(y-1)*bstride, src+2*y*sstride, sstride, width/2);
+    if (ystart == 0) {
+        for (y=0; y<r; y++)
+            ctx->blur_line(dc, buf+y*bstride, buf+(y-1)*bstride, src+2*y*sstride, sstride, width/2);
+    } else {
+        /* Only differences between the running sums matter: they can start
+         * from zero at any pair of lines. */
+        int p0 = (ystart+r)/2 - r;
+        for (int p = p0; p < p0+r; p++)
+            ctx->blur_line(dc, buf+(p%r)*bstride,
+                           p == p0 ? buf-bstride : buf+((p-1)%r)*bstride,
+                           src+2*p*sstride, sstride, width/2);
+        y = ystart;
+    }
     for (;;) {
         if (y < height-r) {
             int mod = ((y+r)/2)%r;
@@ -253,14 +270,13 @@ static void filter_plane(struct vf_priv_s *ctx, uint8_t *dst, uint8_t *src,
             for (x=-r/2; x<0; x++)
                 dc[x] = dc[0];
         }
-        if (y == r) {
+        if (y == r && ystart == 0) {
             for (y=0; y<r; y++)
                 ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
         }
         ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
-        if (++y >= height) break;
+        if (++y >= yend) break;
         ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
-        if (++y >= height) break;
+        if (++y >= yend) break;
     }
 }
-
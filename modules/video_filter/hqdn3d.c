@@ -30,6 +30,7 @@
 #endif
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
@@ -54,6 +55,9 @@ static int DenoiseCallback( vlc_object_t *p_this, char const *psz_var,
 
 #define FILTER_PREFIX       "hqdn3d-"
 
+#define BAND_MIN_WIDTH      64 /* narrowest band of columns, in pixels */
+#define BAND_LINES          16 /* lines between band synchronizations */
+
 #define LUMA_SPAT_TEXT          N_("Spatial luma strength (0-254)")
 #define CHROMA_SPAT_TEXT        N_("Spatial chroma strength (0-254)")
 #define LUMA_TEMP_TEXT          N_("Temporal luma strength (0-254)")
@@ -92,6 +96,13 @@ struct filter_sys_t
     const vlc_chroma_description_t *chroma;
     int w[3], h[3];
 
+    /* Column bands processed in parallel, as a wavefront */
+    unsigned bands;
+    unsigned int *edge[3]; /* horizontal filter state between bands */
+    atomic_uint *progress; /* lines done by each band of each plane */
+    vlc_mutex_t band_mutex;
+    vlc_cond_t  band_wait;
+
     struct vf_priv_s cfg;
     bool   b_recalc_coefs;
     vlc_mutex_t coefs_mutex;
@@ -110,7 +121,7 @@ static int Open(vlc_object_t *this)
     const video_format_t *fmt_out = &filter->fmt_out.video;
     const vlc_fourcc_t fourcc_in  = fmt_in->i_chroma;
     const vlc_fourcc_t fourcc_out = fmt_out->i_chroma;
-    int wmax = 0;
+    int wmin = fmt_in->i_width, hsum = 0;
 
     const vlc_chroma_description_t *chroma =
             vlc_fourcc_GetChromaDescription(fourcc_in);
@@ -135,14 +146,31 @@ static int Open(vlc_object_t *this)
 
     for (int i = 0; i < 3; ++i) {
         sys->w[i] = fmt_in->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
-        if (sys->w[i] > wmax) wmax = sys->w[i];
+        if (sys->w[i] < wmin) wmin = sys->w[i];
         sys->h[i] = fmt_out->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
+        hsum += sys->h[i];
     }
-    cfg->Line = malloc(wmax*sizeof(unsigned int));
-    if (!cfg->Line) {
+
+    /* Keep bands at least BAND_MIN_WIDTH pixels wide */
+    sys->bands = __MAX(__MIN(filter_GetSliceCount(filter),
+                             (unsigned)wmin / BAND_MIN_WIDTH), 1);
+    sys->progress = malloc(3 * sys->bands * sizeof(*sys->progress));
+    sys->edge[0] = malloc((sys->bands - 1) * hsum * sizeof(unsigned int));
+    for (int i = 0; i < 3; ++i)
+        cfg->Line[i] = malloc(sys->w[i] * sizeof(unsigned int));
+    if (!sys->progress || (sys->bands > 1 && !sys->edge[0])
+     || !cfg->Line[0] || !cfg->Line[1] || !cfg->Line[2]) {
+        for (int i = 0; i < 3; ++i)
+            free(cfg->Line[i]);
+        free(sys->edge[0]);
+        free(sys->progress);
         free(sys);
         return VLC_ENOMEM;
     }
+    for (int i = 1; i < 3; ++i)
+        sys->edge[i] = sys->edge[i - 1] + (sys->bands - 1) * sys->h[i - 1];
+    vlc_mutex_init(&sys->band_mutex);
+    vlc_cond_init(&sys->band_wait);
 
     config_ChainParse(filter, FILTER_PREFIX, filter_options,
                       filter->p_cfg);
@@ -181,14 +209,90 @@ static void Close(vlc_object_t *this)
     var_DelCallback( filter, FILTER_PREFIX "chroma-temp", DenoiseCallback, sys );
 
     vlc_mutex_destroy( &sys->coefs_mutex );
+    vlc_cond_destroy( &sys->band_wait );
+    vlc_mutex_destroy( &sys->band_mutex );
 
     for (int i = 0; i < 3; ++i) {
         free(cfg->Frame[i]);
+        free(cfg->Line[i]);
     }
-    free(cfg->Line);
+    free(sys->edge[0]);
+    free(sys->progress);
     free(sys);
 }
 
+/*****************************************************************************
+ * Bands
+ *****************************************************************************/
+struct hqdn3d_frame
+{
+    filter_sys_t *sys;
+    picture_t *src;
+    picture_t *dst;
+};
+
+static void WaitBand(filter_sys_t *sys, atomic_uint *progress, unsigned lines)
+{
+    if (atomic_load_explicit(progress, memory_order_acquire) >= lines)
+        return;
+
+    vlc_mutex_lock(&sys->band_mutex);
+    while (atomic_load_explicit(progress, memory_order_relaxed) < lines)
+        vlc_cond_wait(&sys->band_wait, &sys->band_mutex);
+    vlc_mutex_unlock(&sys->band_mutex);
+}
+
+static void PostBand(filter_sys_t *sys, atomic_uint *progress, unsigned lines)
+{
+    vlc_mutex_lock(&sys->band_mutex);
+    atomic_store_explicit(progress, lines, memory_order_release);
+    vlc_cond_broadcast(&sys->band_wait);
+    vlc_mutex_unlock(&sys->band_mutex);
+}
+
+/* Denoises one band of columns of every plane. The recursive filters make
+ * each band depend on the band to its left, so bands run as a wavefront:
+ * a band processes BAND_LINES lines once its left neighbour has done so. */
+static void FilterBand(void *data, unsigned band, unsigned bands)
+{
+    const struct hqdn3d_frame *frame = data;
+    filter_sys_t *sys = frame->sys;
+    struct vf_priv_s *cfg = &sys->cfg;
+
+    for (int i = 0; i < 3; ++i) {
+        const plane_t *srcp = &frame->src->p[i];
+        plane_t *dstp = &frame->dst->p[i];
+        int *spatial = cfg->Coefs[i ? 2 : 0];
+        int *temporal = cfg->Coefs[i ? 3 : 1];
+        /* Purely temporal denoising has no horizontal dependency */
+        bool wavefront = spatial[0] != 0;
+
+        int w = sys->w[i], h = sys->h[i];
+        int x0 = (int64_t)w * band / bands;
+        int x1 = (int64_t)w * (band + 1) / bands;
+        atomic_uint *left = band > 0 ? &sys->progress[i * bands + band - 1]
+                                     : NULL;
+        atomic_uint *self = &sys->progress[i * bands + band];
+        const unsigned int *edge_in = band > 0
+                                    ? sys->edge[i] + (band - 1) * h : NULL;
+        unsigned int *edge_out = band + 1 < bands
+                               ? sys->edge[i] + band * h : NULL;
+
+        for (int y0 = 0; y0 < h; y0 += BAND_LINES) {
+            int y1 = __MIN(y0 + BAND_LINES, h);
+
+            if (left != NULL && wavefront)
+                WaitBand(sys, left, y1);
+            deNoise(srcp->p_pixels, dstp->p_pixels,
+                    cfg->Line[i], cfg->Frame[i], w, x0, x1, y0, y1,
+                    srcp->i_pitch, dstp->i_pitch, edge_in, edge_out,
+                    spatial, spatial, temporal);
+            if (edge_out != NULL && wavefront)
+                PostBand(sys, self, y1);
+        }
+    }
+}
+
 /*****************************************************************************
  * Filter
  *****************************************************************************/
@@ -221,32 +325,23 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     }
     vlc_mutex_unlock( &sys->coefs_mutex );
 
-    deNoise(src->p[0].p_pixels, dst->p[0].p_pixels,
-            cfg->Line, &cfg->Frame[0], sys->w[0], sys->h[0],
-            src->p[0].i_pitch, dst->p[0].i_pitch,
-            cfg->Coefs[0],
-            cfg->Coefs[0],
-            cfg->Coefs[1]);
-    deNoise(src->p[1].p_pixels, dst->p[1].p_pixels,
-            cfg->Line, &cfg->Frame[1], sys->w[1], sys->h[1],
-            src->p[1].i_pitch, dst->p[1].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-    deNoise(src->p[2].p_pixels, dst->p[2].p_pixels,
-            cfg->Line, &cfg->Frame[2], sys->w[2], sys->h[2],
-            src->p[2].i_pitch, dst->p[2].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-
-    if(unlikely(!cfg->Frame[0] || !cfg->Frame[1] || !cfg->Frame[2]))
-    {
-        picture_Release( src );
-        picture_Release( dst );
-        return NULL;
+    for (int i = 0; i < 3; ++i) {
+        if (!cfg->Frame[i])
+            cfg->Frame[i] = deNoiseInit(src->p[i].p_pixels, sys->w[i],
+                                        sys->h[i], src->p[i].i_pitch);
+        if (unlikely(!cfg->Frame[i])) {
+            picture_Release(src);
+            picture_Release(dst);
+            return NULL;
+        }
     }
 
+    for (unsigned i = 0; i < 3 * sys->bands; ++i)
+        atomic_store_explicit(&sys->progress[i], 0, memory_order_relaxed);
+
+    struct hqdn3d_frame frame = { .sys = sys, .src = src, .dst = dst };
+    filter_ExecuteSlices(filter, FilterBand, &frame, sys->bands);
+
     return CopyInfoAndRelease(dst, src);
 }
 
@@ -32,7 +32,7 @@
 
 struct vf_priv_s {
         int Coefs[4][512*16];
-        unsigned int *Line;
+        unsigned int *Line[3];
         unsigned short *Frame[3];
 };
 
@@ -46,17 +46,32 @@ static /*inline*/ unsigned int LowPassMul(unsigned int PrevMul, unsigned int Cur
     return CurrMul + Coef[d];
 }
 
+/*
+ * The denoising functions below process the columns [X0, X1) of the lines
+ * [Y0, Y1) of a plane. Both the vertical and the horizontal low-pass filters
+ * are recursive, so a band of columns can only be processed once the band to
+ * its left has processed the same lines: the horizontal filter state at the
+ * right edge of each line is stored to EdgeOut, and read back from EdgeIn by
+ * the next band (EdgeIn is not used if X0 is zero, EdgeOut may be NULL).
+ * FrameAnt has W entries per line.
+ */
+
 static void deNoiseTemporal(
                     unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned short *FrameAnt,
-                    int W, int H, int sStride, int dStride,
+                    int W, int X0, int X1, int Y0, int Y1,
+                    int sStride, int dStride,
                     int *Temporal)
 {
     unsigned int PixelDst;
 
-    for (long Y = 0; Y < H; Y++){
-        for (long X = 0; X < W; X++){
+    Frame += Y0 * sStride;
+    FrameDest += Y0 * dStride;
+    FrameAnt += Y0 * W;
+
+    for (long Y = Y0; Y < Y1; Y++){
+        for (long X = X0; X < X1; X++){
             PixelDst = LowPassMul(FrameAnt[X]<<8, Frame[X]<<16, Temporal);
             FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
             FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
@@ -71,110 +86,136 @@ static void deNoiseSpacial(
                     unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned int *LineAnt,       // vf->priv->Line (width bytes)
-                    int W, int H, int sStride, int dStride,
+                    int X0, int X1, int Y0, int Y1,
+                    int sStride, int dStride,
+                    const unsigned int *EdgeIn, unsigned int *EdgeOut,
                     int *Horizontal, int *Vertical)
 {
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
-    unsigned int PixelDst;
-
-    /* First pixel has no left nor top neighbor. */
-    PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    for (long Y = Y0; Y < Y1; Y++){
+        unsigned char *Src = Frame + Y * sStride;
+        unsigned char *Dst = FrameDest + Y * dStride;
+        unsigned int PixelAnt;
+        unsigned int PixelDst;
+        long X = X0;
+
+        if (X == 0){
+            /* First pixel on each line doesn't have previous pixel,
+             * first pixel has no left nor top neighbor. */
+            PixelAnt = Src[0]<<16;
+            if (Y == 0)
+                PixelDst = LineAnt[0] = PixelAnt;
+            else
+                PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
+            Dst[0]= ((PixelDst+0x10007FFF)>>16);
+            X++;
+        }
+        else
+            PixelAnt = EdgeIn[Y];
+
+        if (Y == 0){
+            /* First line has no top neighbor, only left. */
+            for (; X < X1; X++){
+                PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Src[X]<<16, Horizontal);
+                Dst[X]= ((PixelDst+0x10007FFF)>>16);
+            }
+        }
+        else{
+            for (; X < X1; X++){
+                /* The rest are normal */
+                PixelAnt = LowPassMul(PixelAnt, Src[X]<<16, Horizontal);
+                PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
+                Dst[X]= ((PixelDst+0x10007FFF)>>16);
+            }
+        }
 
-    /* First line has no top neighbor, only left. */
-    for (long X = 1; X < W; X++){
-        PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        if (EdgeOut)
+            EdgeOut[Y] = PixelAnt;
     }
+}
 
-    for (long Y = 1; Y < H; Y++){
-        unsigned int PixelAnt;
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (long X = 1; X < W; X++){
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
-        }
+static unsigned short *deNoiseInit(unsigned char *Frame, // mpi->planes[x]
+                                   int W, int H, int sStride)
+{
+    unsigned short* FrameAnt=malloc(W*H*sizeof(unsigned short));
+    if(!FrameAnt)
+        return NULL;
+    for (long Y = 0; Y < H; Y++){
+        unsigned short* dst=&FrameAnt[Y*W];
+        unsigned char* src=Frame+Y*sStride;
+        for (long X = 0; X < W; X++) dst[X]=src[X]<<8;
     }
+    return FrameAnt;
 }
 
 static void deNoise(unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned int *LineAnt,      // vf->priv->Line (width bytes)
-                    unsigned short **FrameAntPtr,
-                    int W, int H, int sStride, int dStride,
+                    unsigned short *FrameAnt,
+                    int W, int X0, int X1, int Y0, int Y1,
+                    int sStride, int dStride,
+                    const unsigned int *EdgeIn, unsigned int *EdgeOut,
                     int *Horizontal, int *Vertical, int *Temporal)
 {
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
-    unsigned int PixelDst;
-    unsigned short* FrameAnt=(*FrameAntPtr);
-
-    if(!FrameAnt){
-        (*FrameAntPtr)=FrameAnt=malloc(W*H*sizeof(unsigned short));
-        if(!FrameAnt)
-            return;
-        for (long Y = 0; Y < H; Y++){
-            unsigned short* dst=&FrameAnt[Y*W];
-            unsigned char* src=Frame+Y*sStride;
-            for (long X = 0; X < W; X++) dst[X]=src[X]<<8;
-        }
-    }
-
     if(!Horizontal[0] && !Vertical[0]){
         deNoiseTemporal(Frame, FrameDest, FrameAnt,
-                        W, H, sStride, dStride, Temporal);
+                        W, X0, X1, Y0, Y1, sStride, dStride, Temporal);
         return;
     }
     if(!Temporal[0]){
         deNoiseSpacial(Frame, FrameDest, LineAnt,
-                       W, H, sStride, dStride, Horizontal, Vertical);
+                       X0, X1, Y0, Y1, sStride, dStride,
+                       EdgeIn, EdgeOut, Horizontal, Vertical);
         return;
     }
 
-    /* First pixel has no left nor top neighbor. Only previous frame */
-    LineAnt[0] = PixelAnt = Frame[0]<<16;
-    PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
-
-    /* First line has no top neighbor. Only left one for each pixel and
-     * last frame */
-    for (long X = 1; X < W; X++){
-        LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
-        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
-    }
-
-    for (long Y = 1; Y < H; Y++){
-        unsigned int PixelAnt;
+    for (long Y = Y0; Y < Y1; Y++){
+        unsigned char *Src = Frame + Y * sStride;
+        unsigned char *Dst = FrameDest + Y * dStride;
         unsigned short* LinePrev=&FrameAnt[Y*W];
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
-        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (long X = 1; X < W; X++){
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            PixelDst = LowPassMul(LinePrev[X]<<8, LineAnt[X], Temporal);
-            LinePrev[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+        unsigned int PixelAnt;
+        unsigned int PixelDst;
+        long X = X0;
+
+        if (X == 0){
+            /* First pixel on each line doesn't have previous pixel,
+             * first pixel has no left nor top neighbor. Only previous
+             * frame */
+            PixelAnt = Src[0]<<16;
+            if (Y == 0)
+                LineAnt[0] = PixelAnt;
+            else
+                LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
+            PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
+            LinePrev[0] = ((PixelDst+0x1000007F)>>8);
+            Dst[0]= ((PixelDst+0x10007FFF)>>16);
+            X++;
         }
+        else
+            PixelAnt = EdgeIn[Y];
+
+        if (Y == 0){
+            /* First line has no top neighbor. Only left one for each pixel
+             * and last frame */
+            for (; X < X1; X++){
+                LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Src[X]<<16, Horizontal);
+                PixelDst = LowPassMul(LinePrev[X]<<8, PixelAnt, Temporal);
+                LinePrev[X] = ((PixelDst+0x1000007F)>>8);
+                Dst[X]= ((PixelDst+0x10007FFF)>>16);
+            }
+        }
+        else{
+            for (; X < X1; X++){
+                /* The rest are normal */
+                PixelAnt = LowPassMul(PixelAnt, Src[X]<<16, Horizontal);
+                LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
+                PixelDst = LowPassMul(LinePrev[X]<<8, LineAnt[X], Temporal);
+                LinePrev[X] = ((PixelDst+0x1000007F)>>8);
+                Dst[X]= ((PixelDst+0x10007FFF)>>16);
+            }
+        }
+
+        if (EdgeOut)
+            EdgeOut[Y] = PixelAnt;
     }
 }
 
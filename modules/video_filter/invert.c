@@ -104,7 +104,7 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
 
     if( !p_pic ) return NULL;
 
-    p_outpic = filter_NewPicture( p_filter );
+    p_outpic = filter_NewPictureInPlace( p_filter, p_pic );
     if( !p_outpic )
     {
         msg_Warn( p_filter, "can't get output picture" );
@@ -116,9 +116,10 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
     {
         /* We don't want to invert the alpha plane */
         i_planes = p_pic->i_planes - 1;
-        memcpy(
-            p_outpic->p[A_PLANE].p_pixels, p_pic->p[A_PLANE].p_pixels,
-            p_pic->p[A_PLANE].i_pitch *  p_pic->p[A_PLANE].i_lines );
+        if( p_outpic != p_pic )
+            memcpy(
+                p_outpic->p[A_PLANE].p_pixels, p_pic->p[A_PLANE].p_pixels,
+                p_pic->p[A_PLANE].i_pitch *  p_pic->p[A_PLANE].i_lines );
     }
     else
     {
@@ -0,0 +1,495 @@
+/*****************************************************************************
+ * mcfps.c : motion compensated frame rate conversion
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#include "mcfps.h"
+
+static int Open( vlc_object_t * );
+static void Close( vlc_object_t * );
+static picture_t *Filter( filter_t *, picture_t * );
+static void Flush( filter_t * );
+
+#define CFG_PREFIX "mcfps-"
+
+#define FPS_TEXT N_( "Frame rate" )
+#define QUALITY_TEXT N_( "Interpolation quality" )
+#define QUALITY_LONGTEXT N_( "Blending only mixes the neighbouring frames. " \
+    "Higher qualities search the motion further, at a higher CPU cost." )
+
+static const int pi_quality_values[] = { 0, 1, 2, 3 };
+static const char *const ppsz_quality_descriptions[] =
+{ N_("Blending"), N_("Fast"), N_("Normal"), N_("Best") };
+
+vlc_module_begin ()
+    set_description( N_("Motion compensated FPS conversion video filter") )
+    set_shortname( N_("MC FPS Converter" ))
+    set_capability( "video filter", 0 )
+    set_category( CAT_VIDEO )
+    set_subcategory( SUBCAT_VIDEO_VFILTER )
+
+    add_shortcut( "mcfps" )
+    add_string( CFG_PREFIX "fps", NULL, FPS_TEXT, FPS_TEXT, false )
+    add_integer_with_range( CFG_PREFIX "quality", 2, 0, 3,
+                            QUALITY_TEXT, QUALITY_LONGTEXT, false )
+        change_integer_list( pi_quality_values, ppsz_quality_descriptions )
+    set_callbacks( Open, Close )
+vlc_module_end ()
+
+static const char *const ppsz_filter_options[] = {
+    "fps", "quality",
+    NULL
+};
+
+/* Pictures further apart than this are not interpolated */
+#define MAX_GAP CLOCK_FREQ
+
+/* Blocks matching worse than this (in average per pixel) are blended */
+#define MAX_SAD (12 * MC_BLOCK * MC_BLOCK)
+
+/* Full search range around the best candidate, per quality */
+static const int pi_search_range[] = { 0, 0, 2, 6 };
+
+struct filter_sys_t
+{
+    date_t          next_output_pts; /**< output calculated PTS */
+    picture_t      *p_previous_pic;
+    int             i_quality;
+
+    mc_sad_t        pf_sad;
+    mc_blend_t      pf_blend;
+
+    /* Vectors of the current and previous pairs of pictures */
+    unsigned        i_blocks_x, i_blocks_y; /**< all blocks */
+    unsigned        i_full_x, i_full_y; /**< blocks within the picture */
+    mc_vector_t    *p_vectors;
+    mc_vector_t    *p_last_vectors;
+    bool            b_estimated; /**< vectors of the current pair are set */
+};
+
+/*****************************************************************************
+ * Motion estimation, in slices of rows of blocks
+ *****************************************************************************/
+struct mcfps_slices
+{
+    filter_t        *p_filter;
+    const picture_t *p_prev;
+    const picture_t *p_next;
+    picture_t       *p_out;
+    unsigned         i_weight;
+};
+
+static void EstimateSlice( void *data, unsigned i_slice, unsigned i_slices )
+{
+    const struct mcfps_slices *p_ctx = data;
+    filter_sys_t *p_sys = p_ctx->p_filter->p_sys;
+    const plane_t *a = &p_ctx->p_prev->p[Y_PLANE];
+    const plane_t *b = &p_ctx->p_next->p[Y_PLANE];
+    const unsigned i_width = __MIN(a->i_visible_pitch, b->i_visible_pitch);
+    const unsigned i_height = __MIN(a->i_visible_lines, b->i_visible_lines);
+    const int i_range = pi_search_range[p_sys->i_quality];
+    unsigned i_begin, i_end;
+
+    filter_GetSliceLines( p_sys->i_full_y, i_slice, i_slices, 1,
+                          &i_begin, &i_end );
+
+    for( unsigned y = i_begin; y < i_end; y++ )
+        for( unsigned x = 0; x < p_sys->i_full_x; x++ )
+        {
+            const unsigned i = y * p_sys->i_blocks_x + x;
+            const mc_vector_t *p_last = p_sys->p_last_vectors;
+            mc_vector_t cands[4];
+            unsigned n = 0;
+
+            /* Spatial candidates only from the left, so that the result
+             * does not depend on the slices */
+            if( x > 0 )
+                cands[n++] = p_sys->p_vectors[i - 1];
+            cands[n++] = p_last[i];
+            cands[n++] = p_last[i + 1];
+            cands[n++] = p_last[i + p_sys->i_blocks_x];
+
+            mc_block_t blk;
+            mc_block_init( &blk, a->p_pixels, a->i_pitch,
+                           b->p_pixels, b->i_pitch, i_width, i_height,
+                           x * MC_BLOCK, y * MC_BLOCK, p_sys->pf_sad );
+
+            mc_vector_t v;
+            if( mc_search( &blk, cands, n, i_range, &v ) > MAX_SAD )
+                v.dx = v.dy = 0; /* no match: blend */
+            p_sys->p_vectors[i] = v;
+        }
+}
+
+/* Blocks on the right and bottom edges that do not fit in the picture get
+ * the vector of their nearest full block */
+static void EstimateEdges( filter_sys_t *p_sys )
+{
+    for( unsigned y = 0; y < p_sys->i_blocks_y; y++ )
+        for( unsigned x = 0; x < p_sys->i_blocks_x; x++ )
+        {
+            if( x < p_sys->i_full_x && y < p_sys->i_full_y )
+                continue;
+
+            mc_vector_t v = { 0, 0 };
+            if( p_sys->i_full_x > 0 && p_sys->i_full_y > 0 )
+                v = p_sys->p_vectors[
+                    __MIN(y, p_sys->i_full_y - 1) * p_sys->i_blocks_x
+                  + __MIN(x, p_sys->i_full_x - 1)];
+            p_sys->p_vectors[y * p_sys->i_blocks_x + x] = v;
+        }
+}
+
+/*****************************************************************************
+ * Motion compensation
+ *****************************************************************************/
+
+/* Rounds v * num / den to the nearest integer */
+static int Scale( int v, int num, int den )
+{
+    const int p = v * num;
+    return (p >= 0 ? p + den / 2 : p - den / 2) / den;
+}
+
+static void CompensateSlice( void *data, unsigned i_slice, unsigned i_slices )
+{
+    const struct mcfps_slices *p_ctx = data;
+    filter_sys_t *p_sys = p_ctx->p_filter->p_sys;
+    const unsigned i_weight = p_ctx->i_weight;
+    const int i_width = p_ctx->p_out->p[Y_PLANE].i_visible_pitch;
+    const int i_height = p_ctx->p_out->p[Y_PLANE].i_visible_lines;
+    unsigned i_begin, i_end;
+
+    filter_GetSliceLines( p_sys->i_blocks_y, i_slice, i_slices, 1,
+                          &i_begin, &i_end );
+
+    for( int i_plane = 0; i_plane < p_ctx->p_out->i_planes; i_plane++ )
+    {
+        const plane_t *a = &p_ctx->p_prev->p[i_plane];
+        const plane_t *b = &p_ctx->p_next->p[i_plane];
+        const plane_t *o = &p_ctx->p_out->p[i_plane];
+        const int w = __MIN(o->i_visible_pitch,
+                            __MIN(a->i_visible_pitch, b->i_visible_pitch));
+        const int h = __MIN(o->i_visible_lines,
+                            __MIN(a->i_visible_lines, b->i_visible_lines));
+
+        for( unsigned by = i_begin; by < i_end; by++ )
+        {
+            const int y0 = Scale( by * MC_BLOCK, h, i_height );
+            const int y1 = Scale( __MIN((by + 1) * MC_BLOCK,
+                                        (unsigned)i_height), h, i_height );
+
+            for( unsigned bx = 0; bx < p_sys->i_blocks_x; bx++ )
+            {
+                const int x0 = Scale( bx * MC_BLOCK, w, i_width );
+                const int x1 = Scale( __MIN((bx + 1) * MC_BLOCK,
+                                            (unsigned)i_width), w, i_width );
+                const mc_vector_t v =
+                    p_sys->p_vectors[by * p_sys->i_blocks_x + bx];
+
+                if( x1 <= x0 || y1 <= y0 )
+                    continue;
+
+                /* The motion from a to b is 2 v: the block is at the
+                 * weight fraction of it */
+                const int dax = Scale( 2 * v.dx * (int)i_weight, w,
+                                       256 * i_width );
+                const int day = Scale( 2 * v.dy * (int)i_weight, h,
+                                       256 * i_height );
+                const int dbx = Scale( 2 * v.dx, w, i_width ) - dax;
+                const int dby = Scale( 2 * v.dy, h, i_height ) - day;
+                const int ax = VLC_CLIP( x0 - dax, 0, w - (x1 - x0) );
+                const int ay = VLC_CLIP( y0 - day, 0, h - (y1 - y0) );
+                const int bx_ = VLC_CLIP( x0 + dbx, 0, w - (x1 - x0) );
+                const int by_ = VLC_CLIP( y0 + dby, 0, h - (y1 - y0) );
+
+                for( int y = 0; y < y1 - y0; y++ )
+                    p_sys->pf_blend(
+                        &o->p_pixels[(y0 + y) * o->i_pitch + x0],
+                        &a->p_pixels[(ay + y) * a->i_pitch + ax],
+                        &b->p_pixels[(by_ + y) * b->i_pitch + bx_],
+                        x1 - x0, i_weight );
+            }
+        }
+    }
+}
+
+/* Blending of whole lines, without motion */
+static void BlendSlice( void *data, unsigned i_slice, unsigned i_slices )
+{
+    const struct mcfps_slices *p_ctx = data;
+    filter_sys_t *p_sys = p_ctx->p_filter->p_sys;
+
+    for( int i_plane = 0; i_plane < p_ctx->p_out->i_planes; i_plane++ )
+    {
+        const plane_t *a = &p_ctx->p_prev->p[i_plane];
+        const plane_t *b = &p_ctx->p_next->p[i_plane];
+        const plane_t *o = &p_ctx->p_out->p[i_plane];
+        const unsigned w = __MIN(o->i_visible_pitch,
+                                 __MIN(a->i_visible_pitch, b->i_visible_pitch));
+        const unsigned h = __MIN(o->i_visible_lines,
+                                 __MIN(a->i_visible_lines, b->i_visible_lines));
+        unsigned i_begin, i_end;
+
+        filter_GetSliceLines( h, i_slice, i_slices, 1, &i_begin, &i_end );
+        for( unsigned y = i_begin; y < i_end; y++ )
+            p_sys->pf_blend( &o->p_pixels[y * o->i_pitch],
+                             &a->p_pixels[y * a->i_pitch],
+                             &b->p_pixels[y * b->i_pitch], w,
+                             p_ctx->i_weight );
+    }
+}
+
+static picture_t *Interpolate( filter_t *p_filter, picture_t *p_prev,
+                               picture_t *p_next, mtime_t i_date )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const mtime_t i_span = p_next->date - p_prev->date;
+
+    picture_t *p_out = filter_NewPicture( p_filter );
+    if( p_out == NULL )
+        return NULL;
+
+    struct mcfps_slices ctx = {
+        .p_filter = p_filter,
+        .p_prev = p_prev,
+        .p_next = p_next,
+        .p_out = p_out,
+        .i_weight = ((i_date - p_prev->date) * 256 + i_span / 2) / i_span,
+    };
+    const unsigned i_slices = filter_GetSliceCount( p_filter );
+
+    if( ctx.i_weight == 0 )
+        picture_CopyPixels( p_out, p_prev );
+    else if( p_sys->i_quality == 0 )
+        filter_ExecuteSlices( p_filter, BlendSlice, &ctx, i_slices );
+    else
+    {
+        if( !p_sys->b_estimated )
+        {
+            filter_ExecuteSlices( p_filter, EstimateSlice, &ctx, i_slices );
+            EstimateEdges( p_sys );
+            p_sys->b_estimated = true;
+        }
+        filter_ExecuteSlices( p_filter, CompensateSlice, &ctx, i_slices );
+    }
+
+    picture_CopyProperties( p_out, p_prev );
+    p_out->date = i_date;
+    return p_out;
+}
+
+/*****************************************************************************
+ * Filter
+ *****************************************************************************/
+static void Reset( filter_sys_t *p_sys, picture_t *p_picture )
+{
+    date_Set( &p_sys->next_output_pts, p_picture->date );
+    date_Increment( &p_sys->next_output_pts, 1 );
+
+    if( p_sys->p_previous_pic )
+        picture_Release( p_sys->p_previous_pic );
+    p_sys->p_previous_pic = picture_Hold( p_picture );
+
+    /* Motion is not predicted across discontinuities */
+    memset( p_sys->p_last_vectors, 0, (p_sys->i_blocks_x + 1)
+            * (p_sys->i_blocks_y + 1) * sizeof (*p_sys->p_last_vectors) );
+    p_sys->b_estimated = false;
+}
+
+static picture_t *Filter( filter_t *p_filter, picture_t *p_picture )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    picture_t *p_prev = p_sys->p_previous_pic;
+
+    /* Pictures without timestamps cannot be placed in time */
+    if( unlikely( p_picture->date < VLC_TS_0 ) )
+    {
+        msg_Dbg( p_filter, "skipping non-dated picture" );
+        picture_Release( p_picture );
+        return NULL;
+    }
+
+    p_picture->format.i_frame_rate = p_filter->fmt_out.video.i_frame_rate;
+    p_picture->format.i_frame_rate_base =
+        p_filter->fmt_out.video.i_frame_rate_base;
+
+    if( p_prev == NULL || p_picture->date <= p_prev->date
+     || p_picture->date - p_prev->date > MAX_GAP )
+    {
+        msg_Dbg( p_filter, "Resetting timestamps" );
+        Reset( p_sys, p_picture );
+        return p_picture;
+    }
+
+    /* Output the pictures falling between the previous and this one */
+    picture_t *p_first = NULL, **pp_last = &p_first;
+
+    while( date_Get( &p_sys->next_output_pts ) < p_picture->date )
+    {
+        picture_t *p_out = Interpolate( p_filter, p_prev, p_picture,
+                                        date_Get( &p_sys->next_output_pts ) );
+        if( p_out == NULL )
+            break;
+
+        *pp_last = p_out;
+        pp_last = &p_out->p_next;
+        date_Increment( &p_sys->next_output_pts, 1 );
+    }
+
+    /* The vectors of this pair predict those of the next one */
+    if( p_sys->b_estimated )
+    {
+        mc_vector_t *p_tmp = p_sys->p_last_vectors;
+        p_sys->p_last_vectors = p_sys->p_vectors;
+        p_sys->p_vectors = p_tmp;
+        p_sys->b_estimated = false;
+    }
+
+    picture_Release( p_prev );
+    p_sys->p_previous_pic = p_picture;
+    return p_first;
+}
+
+static void Flush( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->p_previous_pic )
+        picture_Release( p_sys->p_previous_pic );
+    p_sys->p_previous_pic = NULL;
+    date_Set( &p_sys->next_output_pts, VLC_TS_INVALID );
+}
+
+static int Open( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    const vlc_chroma_description_t *p_chroma =
+        vlc_fourcc_GetChromaDescription( p_filter->fmt_in.video.i_chroma );
+
+    /* Planar 8-bits YUV, with full planes of chroma */
+    if( p_chroma == NULL || !vlc_fourcc_IsYUV( p_filter->fmt_in.video.i_chroma )
+     || p_chroma->pixel_size != 1 || p_chroma->plane_count == 2
+     || p_chroma->plane_count == 0
+     || p_filter->fmt_in.video.i_chroma == VLC_CODEC_YUVP )
+        return VLC_EGENERIC;
+
+    filter_sys_t *p_sys = malloc( sizeof( *p_sys ) );
+    if( unlikely( !p_sys ) )
+        return VLC_ENOMEM;
+
+    config_ChainParse( p_filter, CFG_PREFIX, ppsz_filter_options,
+                       p_filter->p_cfg );
+
+    video_format_Clean( &p_filter->fmt_out.video );
+    video_format_Copy( &p_filter->fmt_out.video, &p_filter->fmt_in.video );
+
+    /* If we don't have fps option, use filter output values */
+    if( var_InheritURational( p_filter, &p_filter->fmt_out.video.i_frame_rate,
+                              &p_filter->fmt_out.video.i_frame_rate_base,
+                              CFG_PREFIX "fps" ) )
+    {
+        p_filter->fmt_out.video.i_frame_rate =
+            p_filter->fmt_in.video.i_frame_rate;
+        p_filter->fmt_out.video.i_frame_rate_base =
+            p_filter->fmt_in.video.i_frame_rate_base;
+    }
+    if( p_filter->fmt_out.video.i_frame_rate == 0
+     || p_filter->fmt_out.video.i_frame_rate_base == 0 )
+    {
+        msg_Err( p_filter, "no output frame rate" );
+        free( p_sys );
+        return VLC_EGENERIC;
+    }
+
+    p_sys->i_quality = var_InheritInteger( p_filter, CFG_PREFIX "quality" );
+    p_sys->i_quality = VLC_CLIP( p_sys->i_quality, 0, 3 );
+
+    msg_Dbg( p_filter, "Converting fps from %d/%d -> %d/%d (quality %d)",
+             p_filter->fmt_in.video.i_frame_rate,
+             p_filter->fmt_in.video.i_frame_rate_base,
+             p_filter->fmt_out.video.i_frame_rate,
+             p_filter->fmt_out.video.i_frame_rate_base, p_sys->i_quality );
+
+    const unsigned i_width = p_filter->fmt_in.video.i_visible_width;
+    const unsigned i_height = p_filter->fmt_in.video.i_visible_height;
+
+    p_sys->i_blocks_x = (i_width + MC_BLOCK - 1) / MC_BLOCK;
+    p_sys->i_blocks_y = (i_height + MC_BLOCK - 1) / MC_BLOCK;
+    p_sys->i_full_x = i_width / MC_BLOCK;
+    p_sys->i_full_y = i_height / MC_BLOCK;
+
+    /* One extra row and column, read as candidates at the edges */
+    const size_t i_vectors = (p_sys->i_blocks_x + 1) * (p_sys->i_blocks_y + 1);
+    p_sys->p_vectors = calloc( i_vectors, sizeof (mc_vector_t) );
+    p_sys->p_last_vectors = calloc( i_vectors, sizeof (mc_vector_t) );
+    if( unlikely( p_sys->p_vectors == NULL || p_sys->p_last_vectors == NULL ) )
+    {
+        free( p_sys->p_vectors );
+        free( p_sys->p_last_vectors );
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+    p_sys->b_estimated = false;
+
+    p_sys->pf_sad = mc_sad_c;
+    p_sys->pf_blend = mc_blend_c;
+#ifdef CAN_COMPILE_AVX2
+    if( vlc_CPU_AVX2() )
+    {
+        p_sys->pf_sad = mc_sad_avx2;
+        p_sys->pf_blend = mc_blend_avx2;
+    }
+#endif
+
+    date_Init( &p_sys->next_output_pts, p_filter->fmt_out.video.i_frame_rate,
+               p_filter->fmt_out.video.i_frame_rate_base );
+    date_Set( &p_sys->next_output_pts, VLC_TS_INVALID );
+    p_sys->p_previous_pic = NULL;
+
+    p_filter->p_sys = p_sys;
+    p_filter->pf_video_filter = Filter;
+    p_filter->pf_flush = Flush;
+    return VLC_SUCCESS;
+}
+
+static void Close( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->p_previous_pic )
+        picture_Release( p_sys->p_previous_pic );
+    free( p_sys->p_vectors );
+    free( p_sys->p_last_vectors );
+    free( p_sys );
+}
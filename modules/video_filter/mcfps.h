@@ -0,0 +1,232 @@
+/*****************************************************************************
+ * mcfps.h: motion estimation and compensation kernels for frame interpolation
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Motion is estimated per block of MC_BLOCK x MC_BLOCK pixels of the frame
+ * to interpolate, halfway between the previous frame a and the next frame b:
+ * the vector (dx, dy) matches the block of a at (x - dx, y - dy) with the
+ * block of b at (x + dx, y + dy), so that the whole motion from a to b is
+ * (2 dx, 2 dy). Vectors are searched so that both blocks lie in the frame.
+ *
+ * Blending weights are 8-bits fixed point values in [0, 256], and the SIMD
+ * kernels are bit-exact with the C ones. */
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef CAN_COMPILE_AVX2
+# include <immintrin.h>
+#endif
+
+#define MC_BLOCK  16
+#define MC_LAMBDA 4 /* cost of one pixel of motion, in SAD units */
+
+typedef struct
+{
+    int16_t dx;
+    int16_t dy;
+} mc_vector_t;
+
+typedef unsigned (*mc_sad_t)(const uint8_t *, ptrdiff_t,
+                             const uint8_t *, ptrdiff_t);
+typedef void (*mc_blend_t)(uint8_t *, const uint8_t *, const uint8_t *,
+                           unsigned, unsigned);
+
+/** Sum of absolute differences of two MC_BLOCK x MC_BLOCK blocks */
+static inline unsigned mc_sad_c(const uint8_t *a, ptrdiff_t a_pitch,
+                                const uint8_t *b, ptrdiff_t b_pitch)
+{
+    unsigned sum = 0;
+
+    for (unsigned y = 0; y < MC_BLOCK; y++)
+    {
+        for (unsigned x = 0; x < MC_BLOCK; x++)
+            sum += abs(a[x] - b[x]);
+        a += a_pitch;
+        b += b_pitch;
+    }
+    return sum;
+}
+
+/** Blends n pixels of a and b, with weight w / 256 for b */
+static inline void mc_blend_c(uint8_t *restrict dst, const uint8_t *a,
+                              const uint8_t *b, unsigned n, unsigned w)
+{
+    for (unsigned x = 0; x < n; x++)
+        dst[x] = (a[x] * (256 - w) + b[x] * w + 128) >> 8;
+}
+
+#ifdef CAN_COMPILE_AVX2
+VLC_AVX2
+static inline unsigned mc_sad_avx2(const uint8_t *a, ptrdiff_t a_pitch,
+                                   const uint8_t *b, ptrdiff_t b_pitch)
+{
+    __m256i sum = _mm256_setzero_si256();
+
+    /* Two lines of the block per vector */
+    for (unsigned y = 0; y < MC_BLOCK; y += 2)
+    {
+        __m256i va = _mm256_inserti128_si256(_mm256_castsi128_si256(
+            _mm_loadu_si128((const __m128i *)a)),
+            _mm_loadu_si128((const __m128i *)(a + a_pitch)), 1);
+        __m256i vb = _mm256_inserti128_si256(_mm256_castsi128_si256(
+            _mm_loadu_si128((const __m128i *)b)),
+            _mm_loadu_si128((const __m128i *)(b + b_pitch)), 1);
+
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(va, vb));
+        a += 2 * a_pitch;
+        b += 2 * b_pitch;
+    }
+
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(sum),
+                              _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+    return _mm_cvtsi128_si32(s);
+}
+
+VLC_AVX2
+static inline void mc_blend_avx2(uint8_t *restrict dst, const uint8_t *a,
+                                 const uint8_t *b, unsigned n, unsigned w)
+{
+    const __m256i wa = _mm256_set1_epi16(256 - w);
+    const __m256i wb = _mm256_set1_epi16(w);
+    const __m256i round = _mm256_set1_epi16(128);
+    const __m256i zero = _mm256_setzero_si256();
+    unsigned x = 0;
+
+    /* Every sum fits in 16-bits: 255 * 256 + 128 < 65536 */
+    for (; x + 32 <= n; x += 32)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i *)&a[x]);
+        __m256i vb = _mm256_loadu_si256((const __m256i *)&b[x]);
+        __m256i lo = _mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), wa),
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), wb)), round);
+        __m256i hi = _mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), wa),
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), wb)), round);
+
+        _mm256_storeu_si256((__m256i *)&dst[x], _mm256_packus_epi16(
+            _mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+    }
+    mc_blend_c(&dst[x], &a[x], &b[x], n - x, w);
+}
+#endif
+
+/** Search area of a block: the vectors keeping both blocks in the frame */
+typedef struct
+{
+    const uint8_t *a, *b;
+    ptrdiff_t a_pitch, b_pitch;
+    int max_dx, max_dy; /* maximum absolute value of each component */
+    mc_sad_t sad;
+} mc_block_t;
+
+static inline void mc_block_init(mc_block_t *blk,
+                                 const uint8_t *a, ptrdiff_t a_pitch,
+                                 const uint8_t *b, ptrdiff_t b_pitch,
+                                 unsigned width, unsigned height,
+                                 unsigned x, unsigned y, mc_sad_t sad)
+{
+    blk->a = a + y * a_pitch + x;
+    blk->b = b + y * b_pitch + x;
+    blk->a_pitch = a_pitch;
+    blk->b_pitch = b_pitch;
+    blk->max_dx = __MIN(x, width - MC_BLOCK - x);
+    blk->max_dy = __MIN(y, height - MC_BLOCK - y);
+    blk->sad = sad;
+}
+
+/* Returns the cost of a vector, or UINT_MAX if it is out of the frame */
+static inline unsigned mc_cost(const mc_block_t *blk, mc_vector_t v,
+                               unsigned *sad)
+{
+    if (abs(v.dx) > blk->max_dx || abs(v.dy) > blk->max_dy)
+        return UINT_MAX;
+
+    *sad = blk->sad(blk->a - v.dy * blk->a_pitch - v.dx, blk->a_pitch,
+                    blk->b + v.dy * blk->b_pitch + v.dx, blk->b_pitch);
+    return *sad + MC_LAMBDA * (abs(v.dx) + abs(v.dy));
+}
+
+/**
+ * Searches the vector of a block: the best of the zero vector and of the
+ * candidates (typically the vectors of neighbouring blocks) is refined with
+ * a full search within range pixels, then by steps of one pixel.
+ *
+ * \return the SAD of the best vector
+ */
+static inline unsigned mc_search(const mc_block_t *blk,
+                                 const mc_vector_t *cands, unsigned count,
+                                 int range, mc_vector_t *best)
+{
+    mc_vector_t v = { 0, 0 };
+    unsigned sad, best_sad = UINT_MAX;
+    unsigned cost = mc_cost(blk, v, &best_sad);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned c = mc_cost(blk, cands[i], &sad);
+        if (c < cost)
+        {
+            cost = c;
+            best_sad = sad;
+            v = cands[i];
+        }
+    }
+
+    const mc_vector_t center = v;
+    for (int dy = -range; dy <= range; dy++)
+        for (int dx = -range; dx <= range; dx++)
+        {
+            mc_vector_t w = { center.dx + dx, center.dy + dy };
+            unsigned c = mc_cost(blk, w, &sad);
+            if (c < cost)
+            {
+                cost = c;
+                best_sad = sad;
+                v = w;
+            }
+        }
+
+    static const mc_vector_t steps[4] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+    for (unsigned n = 0; n < 2 * MC_BLOCK; n++)
+    {
+        const mc_vector_t from = v;
+
+        for (unsigned i = 0; i < 4; i++)
+        {
+            mc_vector_t w = { from.dx + steps[i].dx, from.dy + steps[i].dy };
+            unsigned c = mc_cost(blk, w, &sad);
+            if (c < cost)
+            {
+                cost = c;
+                best_sad = sad;
+                v = w;
+            }
+        }
+        if (v.dx == from.dx && v.dy == from.dy)
+            break;
+    }
+
+    *best = v;
+    return best_sad;
+}
@@ -1,8 +1,9 @@
 /*****************************************************************************
- * scale.c: video scaling module for YUVP/A, I420 and RGBA pictures
- *  Uses the low quality "nearest neighbour" algorithm.
+ * scale.c: video scaling module for YUVP/A, planar YUV and RGBA pictures
+ *  Uses a separable polyphase filter (bilinear, bicubic or Lanczos), or the
+ *  low quality "nearest neighbour" algorithm.
  *****************************************************************************
- * Copyright (C) 2003-2007 VLC authors and VideoLAN
+ * Copyright (C) 2003-2017 VLC authors and VideoLAN
  * $Id$
  *
  * Authors: Gildas Bazin <gbazin@videolan.org>
@@ -29,49 +30,192 @@
 #ifdef HAVE_CONFIG_H
 # include "config.h"
 #endif
+#include <assert.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#include "scale.h"
 
 /****************************************************************************
  * Local prototypes
  ****************************************************************************/
 static int  OpenFilter ( vlc_object_t * );
+static void CloseFilter( vlc_object_t * );
 static picture_t *Filter( filter_t *, picture_t * );
 
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
+#define MODE_TEXT N_("Scaling mode")
+#define MODE_LONGTEXT N_("Interpolation used to scale pictures. " \
+    "Paletted pictures are always scaled with the nearest neighbour.")
+
+static const int pi_mode_values[] = { 0, 1, 2, 3 };
+static const char *const ppsz_mode_descriptions[] =
+{ N_("Nearest neighbour (bad quality)"), N_("Bilinear"),
+  N_("Bicubic (good quality)"), N_("Lanczos (best quality)") };
+
 vlc_module_begin ()
     set_description( N_("Video scaling filter") )
     set_capability( "video converter", 10 )
-    set_callbacks( OpenFilter, NULL )
+    set_category( CAT_VIDEO )
+    set_subcategory( SUBCAT_VIDEO_VFILTER )
+    set_callbacks( OpenFilter, CloseFilter )
+    add_integer( "scale-mode", 2, MODE_TEXT, MODE_LONGTEXT, true )
+        change_integer_list( pi_mode_values, ppsz_mode_descriptions )
 vlc_module_end ()
 
+/* Filter banks are cached for the most recent geometries, as the same
+ * instance scales subpicture regions of varying sizes. A picture needs at
+ * most 4 distinct banks (luma and chroma, in each direction). */
+#define BANK_CACHE 8
+
+struct filter_sys_t
+{
+    int      i_kernel;  /* -1 for nearest neighbour */
+    unsigned i_depth;   /* bits per sample */
+    unsigned i_channels;/* samples per pixel (4 for packed RGB) */
+    int      i_alpha;   /* alpha sample (packed) or plane (planar), or -1 */
+    uint32_t *p_unpremultiply;
+
+    scale_bank_t banks[BANK_CACHE];
+    uint64_t     pi_bank_used[BANK_CACHE];
+    uint64_t     i_bank_clock;
+
+    scale_v_t pf_v;
+    scale_h_t pf_h;
+};
+
+/* Chromas scaled with the polyphase filter and their bit depth */
+static const vlc_fourcc_t pi_planar_chromas[] = {
+    VLC_CODEC_I420, VLC_CODEC_YV12, VLC_CODEC_J420, VLC_CODEC_I422,
+    VLC_CODEC_J422, VLC_CODEC_I440, VLC_CODEC_J440, VLC_CODEC_I444,
+    VLC_CODEC_J444, VLC_CODEC_I411, VLC_CODEC_I410, VLC_CODEC_YUVA,
+    VLC_CODEC_GREY,
+    VLC_CODEC_I420_9L, VLC_CODEC_I420_10L, VLC_CODEC_I420_12L,
+    VLC_CODEC_I422_9L, VLC_CODEC_I422_10L, VLC_CODEC_I422_12L,
+    VLC_CODEC_I444_9L, VLC_CODEC_I444_10L, VLC_CODEC_I444_12L,
+    VLC_CODEC_YUVA_444_10L,
+};
+
+static const vlc_fourcc_t pi_packed_chromas[] = {
+    VLC_CODEC_RGB32, VLC_CODEC_RGBA, VLC_CODEC_ARGB, VLC_CODEC_BGRA,
+};
+
+/* Position of the alpha, see filter_sys_t.i_alpha */
+static int GetAlpha( vlc_fourcc_t i_chroma )
+{
+    switch( i_chroma )
+    {
+        case VLC_CODEC_YUVA:
+        case VLC_CODEC_YUVA_444_10L:
+        case VLC_CODEC_RGBA:
+        case VLC_CODEC_BGRA:
+            return 3;
+        case VLC_CODEC_ARGB:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static bool IsChromaIn( vlc_fourcc_t i_chroma, const vlc_fourcc_t *p_list,
+                        size_t i_count )
+{
+    for( size_t i = 0; i < i_count; i++ )
+        if( p_list[i] == i_chroma )
+            return true;
+    return false;
+}
+
 /*****************************************************************************
  * OpenFilter: probe the filter and return score
  *****************************************************************************/
 static int OpenFilter( vlc_object_t *p_this )
 {
     filter_t *p_filter = (filter_t*)p_this;
+    const vlc_fourcc_t i_chroma = p_filter->fmt_in.video.i_chroma;
+    unsigned i_channels;
 
-    if( ( p_filter->fmt_in.video.i_chroma != VLC_CODEC_YUVP &&
-          p_filter->fmt_in.video.i_chroma != VLC_CODEC_YUVA &&
-          p_filter->fmt_in.video.i_chroma != VLC_CODEC_I420 &&
-          p_filter->fmt_in.video.i_chroma != VLC_CODEC_YV12 &&
-          p_filter->fmt_in.video.i_chroma != VLC_CODEC_RGB32 &&
-          p_filter->fmt_in.video.i_chroma != VLC_CODEC_RGBA &&
-          p_filter->fmt_in.video.i_chroma != VLC_CODEC_ARGB ) ||
-        p_filter->fmt_in.video.i_chroma != p_filter->fmt_out.video.i_chroma )
-    {
+    if( i_chroma != p_filter->fmt_out.video.i_chroma )
+        return VLC_EGENERIC;
+
+    if( IsChromaIn( i_chroma, pi_planar_chromas,
+                    ARRAY_SIZE(pi_planar_chromas) ) )
+        i_channels = 1;
+    else if( IsChromaIn( i_chroma, pi_packed_chromas,
+                         ARRAY_SIZE(pi_packed_chromas) ) )
+        i_channels = 4;
+    else if( i_chroma == VLC_CODEC_YUVP )
+        i_channels = 0;
+    else
         return VLC_EGENERIC;
-    }
 
     if( p_filter->fmt_in.video.orientation != p_filter->fmt_out.video.orientation )
         return VLC_EGENERIC;
 
+    /* Palette indexes cannot be interpolated */
+    int i_mode = var_InheritInteger( p_filter, "scale-mode" );
+    int i_kernel = ( i_channels > 0 && i_mode > 0 && i_mode <= 3 )
+                 ? i_mode - 1 : -1;
+    unsigned i_depth = 8;
+    if( i_channels == 1 )
+        i_depth = vlc_fourcc_GetChromaDescription( i_chroma )->pixel_bits;
+    assert( i_depth <= 12 );
+
+    /* The nearest neighbour only copies bytes */
+    if( i_kernel < 0 && i_depth > 8 )
+        return VLC_EGENERIC;
+
+    filter_sys_t *p_sys = calloc( 1, sizeof(*p_sys) );
+    if( !p_sys )
+        return VLC_ENOMEM;
+
+    p_sys->i_kernel = i_kernel;
+    p_sys->i_channels = i_channels;
+    p_sys->i_depth = i_depth;
+    p_sys->i_alpha = i_kernel >= 0 ? GetAlpha( i_chroma ) : -1;
+    if( p_sys->i_alpha >= 0 )
+    {
+        p_sys->p_unpremultiply = scale_unpremultiply_table( i_depth );
+        if( !p_sys->p_unpremultiply )
+        {
+            free( p_sys );
+            return VLC_ENOMEM;
+        }
+    }
+
+    if( p_sys->i_depth > 8 )
+    {
+        p_sys->pf_v = scale_v16_c;
+        p_sys->pf_h = scale_h16_c;
+    }
+    else
+    {
+        p_sys->pf_v = scale_v8_c;
+        p_sys->pf_h = i_channels == 4 ? scale_h8x4_c : scale_h8_c;
+    }
+#ifdef CAN_COMPILE_AVX2
+    if( vlc_CPU_AVX2() )
+    {
+        if( p_sys->i_depth > 8 )
+        {
+            p_sys->pf_v = scale_v16_avx2;
+            p_sys->pf_h = scale_h16_avx2;
+        }
+        else
+        {
+            p_sys->pf_v = scale_v8_avx2;
+            p_sys->pf_h = i_channels == 4 ? scale_h8x4_avx2 : scale_h8_avx2;
+        }
+    }
+#endif
+    p_filter->p_sys = p_sys;
+
 #warning Converter cannot (really) change output format.
     video_format_ScaleCropAr( &p_filter->fmt_out.video, &p_filter->fmt_in.video );
     p_filter->pf_video_filter = Filter;
@@ -83,29 +227,360 @@ static int OpenFilter( vlc_object_t *p_this )
     return VLC_SUCCESS;
 }
 
-/****************************************************************************
- * Filter: the whole thing
- ****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+static void CloseFilter( vlc_object_t *p_this )
 {
-    picture_t *p_pic_dst;
+    filter_t *p_filter = (filter_t*)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
 
-    if( !p_pic ) return NULL;
+    for( int i = 0; i < BANK_CACHE; i++ )
+        scale_bank_Clean( &p_sys->banks[i] );
+    free( p_sys->p_unpremultiply );
+    free( p_sys );
+}
 
-#warning Converter cannot (really) change output format.
-    video_format_ScaleCropAr( &p_filter->fmt_out.video, &p_filter->fmt_in.video );
+/*****************************************************************************
+ * Filter banks cache
+ *****************************************************************************/
+static const scale_bank_t *GetBank( filter_sys_t *p_sys,
+                                    unsigned i_src, unsigned i_dst )
+{
+    int i_lru = 0;
 
-    /* Request output picture */
-    p_pic_dst = filter_NewPicture( p_filter );
-    if( !p_pic_dst )
+    for( int i = 0; i < BANK_CACHE; i++ )
     {
-        picture_Release( p_pic );
+        scale_bank_t *p_bank = &p_sys->banks[i];
+
+        if( p_bank->src_size == i_src && p_bank->dst_size == i_dst )
+        {
+            p_sys->pi_bank_used[i] = ++p_sys->i_bank_clock;
+            return p_bank;
+        }
+        if( p_sys->pi_bank_used[i] < p_sys->pi_bank_used[i_lru] )
+            i_lru = i;
+    }
+
+    scale_bank_Clean( &p_sys->banks[i_lru] );
+    if( scale_bank_Init( &p_sys->banks[i_lru], i_src, i_dst,
+                         p_sys->i_kernel ) )
         return NULL;
+    p_sys->pi_bank_used[i_lru] = ++p_sys->i_bank_clock;
+    return &p_sys->banks[i_lru];
+}
+
+/*****************************************************************************
+ * Alpha premultiplication
+ *****************************************************************************/
+struct alpha_planes
+{
+    uint8_t *p_pixels[PICTURE_PLANE_MAX];
+    int      i_pitch[PICTURE_PLANE_MAX];
+    unsigned i_width;   /* pixels */
+};
+
+/* Copies the lines [i_begin, i_end) of src to dst, premultiplied */
+static void PremultiplyLines( const filter_sys_t *p_sys,
+                              const struct alpha_planes *p_dst,
+                              const struct alpha_planes *p_src,
+                              unsigned i_begin, unsigned i_end )
+{
+    const unsigned i_width = p_src->i_width;
+    const int i_alpha = p_sys->i_alpha;
+
+    for( unsigned y = i_begin; y < i_end; y++ )
+    {
+        if( p_sys->i_channels == 4 )
+        {
+            uint8_t *p_line = p_dst->p_pixels[0] + y * p_dst->i_pitch[0];
+
+            memcpy( p_line, p_src->p_pixels[0] + y * p_src->i_pitch[0],
+                    4 * i_width );
+            for( int c = 0; c < 4; c++ )
+                if( c != i_alpha )
+                    scale_premultiply8( p_line + c, p_line + i_alpha,
+                                        i_width, 4 );
+            continue;
+        }
+
+        const size_t i_size = p_sys->i_depth > 8 ? 2 * i_width : i_width;
+        uint8_t *pp_lines[4];
+
+        for( int i = 0; i < 4; i++ )
+        {
+            pp_lines[i] = p_dst->p_pixels[i] + y * p_dst->i_pitch[i];
+            memcpy( pp_lines[i], p_src->p_pixels[i] + y * p_src->i_pitch[i],
+                    i_size );
+        }
+        for( int i = 0; i < 4; i++ )
+        {
+            if( i == i_alpha )
+                continue;
+            if( p_sys->i_depth > 8 )
+                scale_premultiply16( (uint16_t *)pp_lines[i],
+                                     (const uint16_t *)pp_lines[i_alpha],
+                                     i_width, 1, p_sys->i_depth );
+            else
+                scale_premultiply8( pp_lines[i], pp_lines[i_alpha],
+                                    i_width, 1 );
+        }
     }
+}
 
-    if( p_filter->fmt_in.video.i_chroma != VLC_CODEC_RGBA &&
-        p_filter->fmt_in.video.i_chroma != VLC_CODEC_ARGB &&
-        p_filter->fmt_in.video.i_chroma != VLC_CODEC_RGB32 )
+/* Divides the colours of the lines [i_begin, i_end) back by their alpha */
+static void UnpremultiplyLines( const filter_sys_t *p_sys,
+                                const struct alpha_planes *p_pic,
+                                unsigned i_begin, unsigned i_end )
+{
+    const unsigned i_width = p_pic->i_width;
+    const int i_alpha = p_sys->i_alpha;
+
+    for( unsigned y = i_begin; y < i_end; y++ )
+    {
+        if( p_sys->i_channels == 4 )
+        {
+            uint8_t *p_line = p_pic->p_pixels[0] + y * p_pic->i_pitch[0];
+
+            for( int c = 0; c < 4; c++ )
+                if( c != i_alpha )
+                    scale_unpremultiply8( p_line + c, p_line + i_alpha,
+                                          i_width, 4,
+                                          p_sys->p_unpremultiply );
+            continue;
+        }
+
+        const uint8_t *p_a = p_pic->p_pixels[i_alpha]
+                           + y * p_pic->i_pitch[i_alpha];
+        for( int i = 0; i < 4; i++ )
+        {
+            uint8_t *p_line = p_pic->p_pixels[i] + y * p_pic->i_pitch[i];
+
+            if( i == i_alpha )
+                continue;
+            if( p_sys->i_depth > 8 )
+                scale_unpremultiply16( (uint16_t *)p_line,
+                                       (const uint16_t *)p_a, i_width, 1,
+                                       p_sys->i_depth,
+                                       p_sys->p_unpremultiply );
+            else
+                scale_unpremultiply8( p_line, p_a, i_width, 1,
+                                      p_sys->p_unpremultiply );
+        }
+    }
+}
+
+struct premultiply_slices
+{
+    const filter_sys_t *p_sys;
+    struct alpha_planes src;
+    struct alpha_planes dst;
+    unsigned            i_lines;
+};
+
+static void PremultiplySlice( void *data, unsigned i_slice,
+                              unsigned i_slices )
+{
+    const struct premultiply_slices *p_ctx = data;
+    unsigned i_begin, i_end;
+
+    filter_GetSliceLines( p_ctx->i_lines, i_slice, i_slices, 1,
+                          &i_begin, &i_end );
+    PremultiplyLines( p_ctx->p_sys, &p_ctx->dst, &p_ctx->src,
+                      i_begin, i_end );
+}
+
+/*****************************************************************************
+ * Polyphase scaling, in slices of output lines
+ *****************************************************************************/
+struct scale_plane
+{
+    const uint8_t *p_src;
+    uint8_t       *p_dst;
+    int            i_src_pitch;
+    int            i_dst_pitch;
+    unsigned       i_src_lines;
+    unsigned       i_dst_lines;
+    const scale_bank_t *p_h;
+    const scale_bank_t *p_v;
+};
+
+struct scale_slices
+{
+    const filter_sys_t *p_sys;
+    int                 i_planes;
+    struct scale_plane  planes[PICTURE_PLANE_MAX];
+    int16_t            *p_lines;    /* intermediate line, per slice */
+    size_t              i_line;     /* samples per intermediate line */
+    const void        **pp_rows;    /* source line pointers, per slice */
+    unsigned            i_rows;
+    struct alpha_planes alpha;      /* output planes, if premultiplied */
+};
+
+static void ScaleSlice( void *data, unsigned i_slice, unsigned i_slices )
+{
+    const struct scale_slices *p_ctx = data;
+    const filter_sys_t *p_sys = p_ctx->p_sys;
+    int16_t *p_line = p_ctx->p_lines + i_slice * p_ctx->i_line;
+    const void **pp_rows = p_ctx->pp_rows + i_slice * p_ctx->i_rows;
+
+    for( int i = 0; i < p_ctx->i_planes; i++ )
+    {
+        const struct scale_plane *p = &p_ctx->planes[i];
+        unsigned i_begin, i_end;
+
+        /* Empty planes have no filter banks */
+        if( p->i_dst_lines == 0 || p->p_h == NULL )
+            continue;
+
+        const scale_bank_t *p_v = p->p_v;
+        const unsigned i_width = p->p_h->src_size * p_sys->i_channels;
+
+        filter_GetSliceLines( p->i_dst_lines, i_slice, i_slices, 1,
+                              &i_begin, &i_end );
+
+        for( unsigned y = i_begin; y < i_end; y++ )
+        {
+            /* Taps past the last line only ever have a null coefficient */
+            for( unsigned k = 0; k < p_v->taps; k++ )
+                pp_rows[k] = p->p_src + __MIN( p_v->pos[y] + k,
+                                               p->i_src_lines - 1 )
+                                        * p->i_src_pitch;
+
+            p_sys->pf_v( p_line, pp_rows, p_v->coefs + y * p_v->taps,
+                         p_v->taps, i_width, p_sys->i_depth );
+            p_sys->pf_h( p->p_dst + y * p->i_dst_pitch, p_line, p->p_h,
+                         0, p->p_h->dst_size, p_sys->i_depth );
+        }
+    }
+
+    /* The planes of the pictures with alpha all have the same size */
+    if( p_ctx->alpha.i_width > 0 )
+    {
+        unsigned i_begin, i_end;
+
+        filter_GetSliceLines( p_ctx->planes[0].i_dst_lines, i_slice,
+                              i_slices, 1, &i_begin, &i_end );
+        UnpremultiplyLines( p_sys, &p_ctx->alpha, i_begin, i_end );
+    }
+}
+
+static int PolyphaseFilter( filter_t *p_filter, picture_t *p_dst,
+                            const picture_t *p_src )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const unsigned i_pixel = p_sys->i_depth > 8 ? 2 : p_sys->i_channels;
+    struct scale_slices ctx = {
+        .p_sys = p_sys,
+        .i_planes = __MIN( p_src->i_planes, p_dst->i_planes ),
+    };
+    unsigned i_src_max = 0, i_dst_lines = 0;
+
+    for( int i = 0; i < ctx.i_planes; i++ )
+    {
+        const plane_t *p_in = &p_src->p[i], *p_out = &p_dst->p[i];
+        struct scale_plane *p = &ctx.planes[i];
+        const unsigned i_src_w = p_in->i_visible_pitch / i_pixel;
+        const unsigned i_dst_w = p_out->i_visible_pitch / i_pixel;
+
+        p->p_src = p_in->p_pixels;
+        p->p_dst = p_out->p_pixels;
+        p->i_src_pitch = p_in->i_pitch;
+        p->i_dst_pitch = p_out->i_pitch;
+        p->i_src_lines = p_in->i_visible_lines;
+        p->i_dst_lines = p_out->i_visible_lines;
+        if( i_src_w == 0 || p->i_src_lines == 0 || i_dst_w == 0
+         || p->i_dst_lines == 0 )
+        {
+            p->i_dst_lines = 0;
+            continue;
+        }
+
+        p->p_h = GetBank( p_sys, i_src_w, i_dst_w );
+        p->p_v = GetBank( p_sys, p->i_src_lines, p->i_dst_lines );
+        if( !p->p_h || !p->p_v )
+            return VLC_ENOMEM;
+
+        i_src_max = __MAX( i_src_max, i_src_w );
+        i_dst_lines = __MAX( i_dst_lines, p->i_dst_lines );
+        ctx.i_rows = __MAX( ctx.i_rows, p->p_v->taps );
+    }
+
+    /* Small pictures, such as most subpicture regions, are not worth
+     * splitting */
+    unsigned i_slices = __MIN( filter_GetSliceCount( p_filter ),
+                               __MAX( i_dst_lines / 32, 1 ) );
+
+    /* The colours of the pictures with alpha are filtered premultiplied,
+     * from a copy of the source */
+    uint8_t *p_premultiplied = NULL;
+    if( p_sys->i_alpha >= 0 && ctx.planes[0].p_h != NULL
+     && ( p_sys->i_channels == 4 || ctx.i_planes == 4 ) )
+    {
+        struct premultiply_slices pm = {
+            .p_sys = p_sys,
+            .i_lines = ctx.planes[0].i_src_lines,
+        };
+        size_t i_size = 0;
+
+        for( int i = 0; i < ctx.i_planes; i++ )
+            i_size += (size_t)p_src->p[i].i_visible_pitch
+                    * ctx.planes[i].i_src_lines;
+        p_premultiplied = malloc( i_size );
+        if( !p_premultiplied )
+            return VLC_ENOMEM;
+
+        i_size = 0;
+        pm.src.i_width = pm.dst.i_width = ctx.planes[0].p_h->src_size;
+        ctx.alpha.i_width = ctx.planes[0].p_h->dst_size;
+        for( int i = 0; i < ctx.i_planes; i++ )
+        {
+            struct scale_plane *p = &ctx.planes[i];
+
+            pm.src.p_pixels[i] = (uint8_t *)p->p_src;
+            pm.src.i_pitch[i] = p->i_src_pitch;
+            pm.dst.p_pixels[i] = p_premultiplied + i_size;
+            pm.dst.i_pitch[i] = p_src->p[i].i_visible_pitch;
+            i_size += (size_t)pm.dst.i_pitch[i] * p->i_src_lines;
+
+            p->p_src = pm.dst.p_pixels[i];
+            p->i_src_pitch = pm.dst.i_pitch[i];
+            ctx.alpha.p_pixels[i] = p->p_dst;
+            ctx.alpha.i_pitch[i] = p->i_dst_pitch;
+        }
+
+        filter_ExecuteSlices( p_filter, PremultiplySlice, &pm,
+                              __MIN( filter_GetSliceCount( p_filter ),
+                                     __MAX( pm.i_lines / 32, 1 ) ) );
+    }
+
+    ctx.i_line = (size_t)i_src_max * p_sys->i_channels + SCALE_PADDING;
+    ctx.p_lines = malloc( i_slices * ctx.i_line * sizeof(*ctx.p_lines) );
+    ctx.pp_rows = malloc( i_slices * ctx.i_rows * sizeof(*ctx.pp_rows) );
+    if( !ctx.p_lines || !ctx.pp_rows )
+    {
+        free( ctx.p_lines );
+        free( ctx.pp_rows );
+        free( p_premultiplied );
+        return VLC_ENOMEM;
+    }
+    /* The kernels may read (with null coefficients) past the line end */
+    for( unsigned i = 0; i < i_slices; i++ )
+        memset( ctx.p_lines + (i + 1) * ctx.i_line - SCALE_PADDING, 0,
+                SCALE_PADDING * sizeof(*ctx.p_lines) );
+
+    filter_ExecuteSlices( p_filter, ScaleSlice, &ctx, i_slices );
+
+    free( ctx.p_lines );
+    free( ctx.pp_rows );
+    free( p_premultiplied );
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Nearest neighbour scaling
+ *****************************************************************************/
+static void NearestFilter( filter_t *p_filter, picture_t *p_pic_dst,
+                           const picture_t *p_pic )
+{
+    if( p_filter->p_sys->i_channels != 4 )
     {
         for( int i_plane = 0; i_plane < p_pic_dst->i_planes; i_plane++ )
         {
@@ -195,6 +670,36 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
             }
         }
     }
+}
+
+/****************************************************************************
+ * Filter: the whole thing
+ ****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    picture_t *p_pic_dst;
+
+    if( !p_pic ) return NULL;
+
+#warning Converter cannot (really) change output format.
+    video_format_ScaleCropAr( &p_filter->fmt_out.video, &p_filter->fmt_in.video );
+
+    /* Request output picture */
+    p_pic_dst = filter_NewPicture( p_filter );
+    if( !p_pic_dst )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    if( p_filter->p_sys->i_kernel < 0 )
+        NearestFilter( p_filter, p_pic_dst, p_pic );
+    else if( PolyphaseFilter( p_filter, p_pic_dst, p_pic ) )
+    {
+        picture_Release( p_pic_dst );
+        picture_Release( p_pic );
+        return NULL;
+    }
 
     picture_CopyProperties( p_pic_dst, p_pic );
     picture_Release( p_pic );
@@ -0,0 +1,546 @@
+/*****************************************************************************
+ * scale.h: separable polyphase scaler filter banks and line kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Pictures are scaled one output line at a time: the source lines covered
+ * by the vertical filter are first combined into a line of 14-bits signed
+ * intermediate samples (scale_v_*), which is then filtered horizontally
+ * into the output line (scale_h_*).
+ *
+ * Filter coefficients are 14-bits fixed point values and every product and
+ * sum fits in 32-bits, so the SIMD kernels are bit-exact with the C ones. */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CAN_COMPILE_AVX2
+# include <immintrin.h>
+#endif
+
+#define SCALE_COEF_BITS  14
+#define SCALE_INTER_BITS 14 /* precision of the intermediate samples */
+#define SCALE_GROUP      8  /* outputs per horizontal SIMD block */
+#define SCALE_PADDING    16 /* samples readable past an intermediate line */
+
+enum
+{
+    SCALE_BILINEAR,
+    SCALE_BICUBIC,
+    SCALE_LANCZOS,
+};
+
+/**
+ * Filter bank for one dimension (source size to destination size).
+ *
+ * Output sample i is the sum of coefs[i * taps + k] * in[pos[i] + k] for k
+ * in [0, taps). Taps are always even, and pos[i] + taps never exceeds the
+ * source size rounded up to even, so that no kernel reads past
+ * SCALE_PADDING samples after the end of the source.
+ */
+typedef struct
+{
+    unsigned src_size;
+    unsigned dst_size;
+    int      kernel;
+    unsigned taps;
+    int32_t *pos;       /**< first source sample, per output sample */
+    int16_t *coefs;     /**< taps coefficients, per output sample */
+    /** coefficients by pairs of taps for blocks of SCALE_GROUP outputs:
+     * block b, pair p holds the (2p, 2p + 1) coefficients of the outputs
+     * [b * SCALE_GROUP, (b + 1) * SCALE_GROUP) */
+    int16_t *coefs_group;
+} scale_bank_t;
+
+static double scale_kernel(int kernel, double x)
+{
+    x = fabs(x);
+
+    switch (kernel)
+    {
+        case SCALE_BILINEAR:
+            return (x < 1.) ? 1. - x : 0.;
+
+        case SCALE_BICUBIC: /* Catmull-Rom spline */
+            if (x < 1.)
+                return (1.5 * x - 2.5) * x * x + 1.;
+            if (x < 2.)
+                return ((-0.5 * x + 2.5) * x - 4.) * x + 2.;
+            return 0.;
+
+        case SCALE_LANCZOS: /* three lobes */
+            if (x < 1e-8)
+                return 1.;
+            if (x < 3.)
+                return 3. * sin(M_PI * x) * sin(M_PI * x / 3.)
+                       / (M_PI * M_PI * x * x);
+            return 0.;
+    }
+    vlc_assert_unreachable();
+}
+
+static double scale_kernel_radius(int kernel)
+{
+    static const double radius[] = {
+        [SCALE_BILINEAR] = 1.,
+        [SCALE_BICUBIC]  = 2.,
+        [SCALE_LANCZOS]  = 3.,
+    };
+    return radius[kernel];
+}
+
+static void scale_bank_Clean(scale_bank_t *bank)
+{
+    free(bank->pos);
+    free(bank->coefs);
+    free(bank->coefs_group);
+    bank->pos = NULL;
+    bank->coefs = NULL;
+    bank->coefs_group = NULL;
+    bank->src_size = bank->dst_size = 0;
+}
+
+/**
+ * Computes the filter bank scaling src samples to dst samples.
+ * Sample centers are aligned, and the source is extended by repeating its
+ * edge samples.
+ */
+static int scale_bank_Init(scale_bank_t *bank, unsigned src, unsigned dst,
+                           int kernel)
+{
+    assert(src > 0 && dst > 0);
+
+    /* When downscaling, the kernel is stretched to low-pass the source */
+    const double ratio = (double)src / dst;
+    const double stretch = (ratio > 1.) ? ratio : 1.;
+    const double support = scale_kernel_radius(kernel) * stretch;
+    const unsigned span = 2 * ceil(support);
+    unsigned taps = span;
+
+    /* A filter wider than the source covers all of it */
+    if (taps > src)
+        taps = (src + 1) & ~1u;
+
+    const unsigned groups = (dst + SCALE_GROUP - 1) / SCALE_GROUP;
+
+    bank->src_size = src;
+    bank->dst_size = dst;
+    bank->kernel = kernel;
+    bank->taps = taps;
+    bank->pos = malloc(groups * SCALE_GROUP * sizeof (*bank->pos));
+    bank->coefs = malloc(dst * taps * sizeof (*bank->coefs));
+    bank->coefs_group = calloc(groups * SCALE_GROUP * taps,
+                               sizeof (*bank->coefs_group));
+    double *weights = malloc(taps * sizeof (*weights));
+
+    if (unlikely(bank->pos == NULL || bank->coefs == NULL
+              || bank->coefs_group == NULL || weights == NULL))
+    {
+        free(weights);
+        scale_bank_Clean(bank);
+        return VLC_ENOMEM;
+    }
+
+    for (unsigned i = 0; i < dst; i++)
+    {
+        const double center = (i + .5) * ratio - .5;
+        const int first = floor(center - support) + 1.;
+        int pos = first;
+
+        if (pos > (int)src - (int)taps)
+            pos = (int)src - (int)taps;
+        if (pos < 0)
+            pos = 0;
+
+        /* Taps outside of the source are folded onto the edge samples */
+        double sum = 0.;
+        memset(weights, 0, taps * sizeof (*weights));
+        for (int j = first; j < first + (int)span; j++)
+        {
+            int s = (j < 0) ? 0 : (j >= (int)src) ? (int)src - 1 : j;
+            double w = scale_kernel(kernel, (j - center) / stretch);
+
+            weights[s - pos] += w;
+            sum += w;
+        }
+
+        /* Quantize so that coefficients sum exactly to one, the rounding
+         * error going to the largest coefficient */
+        int16_t *coefs = bank->coefs + i * taps;
+        int total = 0;
+        unsigned largest = 0;
+        for (unsigned k = 0; k < taps; k++)
+        {
+            coefs[k] = lround(weights[k] / sum * (1 << SCALE_COEF_BITS));
+            total += coefs[k];
+            if (coefs[k] > coefs[largest])
+                largest = k;
+        }
+        coefs[largest] += (1 << SCALE_COEF_BITS) - total;
+
+        bank->pos[i] = pos;
+        for (unsigned k = 0; k < taps; k++)
+        {
+            unsigned group = i / SCALE_GROUP, lane = i % SCALE_GROUP;
+            bank->coefs_group[(group * taps / 2 + k / 2) * 2 * SCALE_GROUP
+                              + 2 * lane + (k & 1)] = coefs[k];
+        }
+    }
+
+    /* Unused outputs of the last block read the first source samples */
+    for (unsigned i = dst; i < groups * SCALE_GROUP; i++)
+        bank->pos[i] = 0;
+
+    free(weights);
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * C kernels
+ *****************************************************************************/
+
+/**
+ * Vertical filter: combines taps source lines of width samples into
+ * intermediate samples.
+ */
+static void scale_v8_c(int16_t *restrict dst, const void *const *lines,
+                       const int16_t *coefs, unsigned taps, unsigned width,
+                       unsigned depth)
+{
+    const int shift = SCALE_COEF_BITS + depth - SCALE_INTER_BITS;
+
+    for (unsigned x = 0; x < width; x++)
+    {
+        int32_t sum = 1 << (shift - 1);
+
+        for (unsigned k = 0; k < taps; k++)
+            sum += coefs[k] * ((const uint8_t *)lines[k])[x];
+        dst[x] = sum >> shift;
+    }
+}
+
+static void scale_v16_c(int16_t *restrict dst, const void *const *lines,
+                        const int16_t *coefs, unsigned taps, unsigned width,
+                        unsigned depth)
+{
+    const int shift = SCALE_COEF_BITS + depth - SCALE_INTER_BITS;
+
+    for (unsigned x = 0; x < width; x++)
+    {
+        int32_t sum = 1 << (shift - 1);
+
+        for (unsigned k = 0; k < taps; k++)
+            sum += coefs[k] * ((const uint16_t *)lines[k])[x];
+        dst[x] = sum >> shift;
+    }
+}
+
+/**
+ * Horizontal filter: filters intermediate samples into output samples of
+ * depth bits, for pixels of 1 (planar) or 4 (packed) samples.
+ * Only the outputs [begin, end) are computed.
+ */
+#define SCALE_H_C(name, type, channels) \
+static void name(void *restrict dst_, const int16_t *src, \
+                 const scale_bank_t *bank, unsigned begin, unsigned end, \
+                 unsigned depth) \
+{ \
+    type *dst = dst_; \
+    const unsigned taps = bank->taps; \
+    const int shift = SCALE_COEF_BITS + SCALE_INTER_BITS - depth; \
+    const int32_t max = (1 << depth) - 1; \
+\
+    for (unsigned i = begin; i < end; i++) \
+    { \
+        const int16_t *in = src + channels * bank->pos[i]; \
+        const int16_t *coefs = bank->coefs + i * taps; \
+\
+        for (unsigned c = 0; c < channels; c++) \
+        { \
+            int32_t sum = 1 << (shift - 1); \
+\
+            for (unsigned k = 0; k < taps; k++) \
+                sum += coefs[k] * in[channels * k + c]; \
+            sum >>= shift; \
+            dst[channels * i + c] = VLC_CLIP(sum, 0, max); \
+        } \
+    } \
+}
+
+SCALE_H_C(scale_h8_c, uint8_t, 1)
+SCALE_H_C(scale_h16_c, uint16_t, 1)
+SCALE_H_C(scale_h8x4_c, uint8_t, 4)
+#undef SCALE_H_C
+
+typedef void (*scale_v_t)(int16_t *, const void *const *, const int16_t *,
+                          unsigned, unsigned, unsigned);
+typedef void (*scale_h_t)(void *, const int16_t *, const scale_bank_t *,
+                          unsigned, unsigned, unsigned);
+
+/*****************************************************************************
+ * Alpha
+ *****************************************************************************/
+
+/* Pictures with alpha are filtered premultiplied: otherwise the colour of
+ * transparent pixels bleeds into the edges of the opaque ones. The samples
+ * of a line are step samples apart, as is their alpha. Fully opaque pixels
+ * come back unchanged, fully transparent ones come back null. */
+
+static void scale_premultiply8(uint8_t *line, const uint8_t *alpha,
+                               unsigned count, unsigned step)
+{
+    for (unsigned i = 0; i < count; i++)
+        line[i * step] = (line[i * step] * alpha[i * step] + 127) / 255;
+}
+
+static void scale_premultiply16(uint16_t *line, const uint16_t *alpha,
+                                unsigned count, unsigned step,
+                                unsigned depth)
+{
+    const uint32_t max = (1u << depth) - 1;
+
+    for (unsigned i = 0; i < count; i++)
+        line[i * step] = (line[i * step] * alpha[i * step] + max / 2) / max;
+}
+
+/**
+ * Reciprocals of the alpha values of depth bits, in 16-bits fixed point,
+ * for scale_unpremultiply*(). Free it with free().
+ */
+static uint32_t *scale_unpremultiply_table(unsigned depth)
+{
+    const uint32_t max = (1u << depth) - 1;
+    uint32_t *table = malloc((max + 1) * sizeof (*table));
+
+    if (table == NULL)
+        return NULL;
+    table[0] = 0;
+    for (uint32_t a = 1; a <= max; a++)
+        table[a] = ((max << 16) + a / 2) / a;
+    return table;
+}
+
+/* The filter overshoot can leave colours above their alpha: they are
+ * clipped */
+static void scale_unpremultiply8(uint8_t *line, const uint8_t *alpha,
+                                 unsigned count, unsigned step,
+                                 const uint32_t *table)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        uint32_t v = (line[i * step] * table[alpha[i * step]] + 0x8000) >> 16;
+        line[i * step] = v < 255 ? v : 255;
+    }
+}
+
+static void scale_unpremultiply16(uint16_t *line, const uint16_t *alpha,
+                                  unsigned count, unsigned step,
+                                  unsigned depth, const uint32_t *table)
+{
+    const uint64_t max = (1u << depth) - 1;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        uint64_t v = (line[i * step] * (uint64_t)table[alpha[i * step]]
+                      + 0x8000) >> 16;
+        line[i * step] = v < max ? v : max;
+    }
+}
+
+/*****************************************************************************
+ * AVX2 kernels
+ *****************************************************************************/
+#ifdef CAN_COMPILE_AVX2
+/* Multiplies two lines of 16-bits samples by their coefficients, and
+ * accumulates into two vectors of 32-bits sums (ordered per 128-bits lane
+ * as _mm256_packs_epi32() expects). */
+#define SCALE_V_PAIR(a, b, c0, c1) \
+    do { \
+        __m256i coef = _mm256_set1_epi32((uint16_t)(c0) \
+                                         | ((uint32_t)(uint16_t)(c1) << 16)); \
+        lo = _mm256_add_epi32(lo, _mm256_madd_epi16( \
+                              _mm256_unpacklo_epi16(a, b), coef)); \
+        hi = _mm256_add_epi32(hi, _mm256_madd_epi16( \
+                              _mm256_unpackhi_epi16(a, b), coef)); \
+    } while (0)
+
+#define SCALE_V_AVX2(name, type, load, tail) \
+VLC_AVX2 \
+static void name(int16_t *restrict dst, const void *const *lines, \
+                 const int16_t *coefs, unsigned taps, unsigned width, \
+                 unsigned depth) \
+{ \
+    const int shift = SCALE_COEF_BITS + depth - SCALE_INTER_BITS; \
+    const __m256i round = _mm256_set1_epi32(1 << (shift - 1)); \
+    const __m128i count = _mm_cvtsi32_si128(shift); \
+    unsigned x; \
+\
+    for (x = 0; x + 16 <= width; x += 16) \
+    { \
+        __m256i lo = round, hi = round; \
+\
+        for (unsigned k = 0; k < taps; k += 2) \
+        { \
+            __m256i a = load((const type *)lines[k] + x); \
+            __m256i b = load((const type *)lines[k + 1] + x); \
+            SCALE_V_PAIR(a, b, coefs[k], coefs[k + 1]); \
+        } \
+        lo = _mm256_sra_epi32(lo, count); \
+        hi = _mm256_sra_epi32(hi, count); \
+        _mm256_storeu_si256((__m256i *)(dst + x), \
+                            _mm256_packs_epi32(lo, hi)); \
+    } \
+\
+    if (x < width) \
+    { \
+        const void *rest[taps]; \
+        for (unsigned k = 0; k < taps; k++) \
+            rest[k] = (const type *)lines[k] + x; \
+        tail(dst + x, rest, coefs, taps, width - x, depth); \
+    } \
+}
+
+#define LOAD8(p)  _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#define LOAD16(p) _mm256_loadu_si256((const __m256i *)(p))
+SCALE_V_AVX2(scale_v8_avx2, uint8_t, LOAD8, scale_v8_c)
+SCALE_V_AVX2(scale_v16_avx2, uint16_t, LOAD16, scale_v16_c)
+#undef LOAD8
+#undef LOAD16
+#undef SCALE_V_AVX2
+#undef SCALE_V_PAIR
+
+/* Planar horizontal filter: SCALE_GROUP outputs at a time, gathering two
+ * adjacent intermediate samples per output and tap pair. */
+VLC_AVX2
+static __m256i scale_h_group_avx2(const int16_t *src, const scale_bank_t *bank,
+                                  unsigned group, int shift)
+{
+    const unsigned taps = bank->taps;
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    const __m256i *coefs = (const __m256i *)(bank->coefs_group
+                                             + group * SCALE_GROUP * taps);
+    __m256i pos = _mm256_loadu_si256((const __m256i *)(bank->pos
+                                                       + group * SCALE_GROUP));
+    __m256i sum = _mm256_set1_epi32(1 << (shift - 1));
+
+    for (unsigned k = 0; k < taps; k += 2)
+    {
+        __m256i in = _mm256_i32gather_epi32((const int *)src, pos, 2);
+
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(in,
+                                    _mm256_loadu_si256(coefs++)));
+        pos = _mm256_add_epi32(pos, _mm256_set1_epi32(2));
+    }
+    return _mm256_sra_epi32(sum, count);
+}
+
+VLC_AVX2
+static void scale_h8_avx2(void *restrict dst_, const int16_t *src,
+                          const scale_bank_t *bank, unsigned begin,
+                          unsigned end, unsigned depth)
+{
+    uint8_t *dst = dst_;
+    const int shift = SCALE_COEF_BITS + SCALE_INTER_BITS - depth;
+    unsigned i = begin;
+
+    assert(begin % SCALE_GROUP == 0);
+    for (; i + SCALE_GROUP <= end; i += SCALE_GROUP)
+    {
+        __m256i sum = scale_h_group_avx2(src, bank, i / SCALE_GROUP, shift);
+        __m128i s16 = _mm_packs_epi32(_mm256_castsi256_si128(sum),
+                                      _mm256_extracti128_si256(sum, 1));
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(s16, s16));
+    }
+    if (i < end)
+        scale_h8_c(dst, src, bank, i, end, depth);
+}
+
+VLC_AVX2
+static void scale_h16_avx2(void *restrict dst_, const int16_t *src,
+                           const scale_bank_t *bank, unsigned begin,
+                           unsigned end, unsigned depth)
+{
+    uint16_t *dst = dst_;
+    const int shift = SCALE_COEF_BITS + SCALE_INTER_BITS - depth;
+    const __m128i max = _mm_set1_epi16((1 << depth) - 1);
+    unsigned i = begin;
+
+    assert(begin % SCALE_GROUP == 0);
+    for (; i + SCALE_GROUP <= end; i += SCALE_GROUP)
+    {
+        __m256i sum = scale_h_group_avx2(src, bank, i / SCALE_GROUP, shift);
+        __m128i s16 = _mm_packus_epi32(_mm256_castsi256_si128(sum),
+                                       _mm256_extracti128_si256(sum, 1));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_min_epu16(s16, max));
+    }
+    if (i < end)
+        scale_h16_c(dst, src, bank, i, end, depth);
+}
+
+/* Packed horizontal filter: two output pixels at a time (one per 128-bits
+ * lane), two taps of the four channels per iteration. */
+VLC_AVX2
+static void scale_h8x4_avx2(void *restrict dst_, const int16_t *src,
+                            const scale_bank_t *bank, unsigned begin,
+                            unsigned end, unsigned depth)
+{
+    uint32_t *dst = dst_;
+    const unsigned taps = bank->taps;
+    const int shift = SCALE_COEF_BITS + SCALE_INTER_BITS - depth;
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    const __m256i round = _mm256_set1_epi32(1 << (shift - 1));
+    /* (c0 c1 c2 c3 c0' c1' c2' c3') -> (c0 c0' c1 c1' c2 c2' c3 c3') */
+    const __m256i interleave = _mm256_setr_epi8(
+        0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+        0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+    const __m256i broadcast = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    unsigned i = begin;
+
+    assert(begin % SCALE_GROUP == 0);
+    for (; i + 2 <= end; i += 2)
+    {
+        const int16_t *in0 = src + 4 * bank->pos[i];
+        const int16_t *in1 = src + 4 * bank->pos[i + 1];
+        const int16_t *coefs = bank->coefs_group
+                             + (i / SCALE_GROUP) * SCALE_GROUP * taps
+                             + 2 * (i % SCALE_GROUP);
+        __m256i sum = round;
+
+        for (unsigned k = 0; k < taps; k += 2)
+        {
+            __m256i pix = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                _mm_loadu_si128((const __m128i *)(in0 + 4 * k))),
+                _mm_loadu_si128((const __m128i *)(in1 + 4 * k)), 1);
+            __m256i coef = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(
+                _mm_loadl_epi64((const __m128i *)coefs)), broadcast);
+
+            pix = _mm256_shuffle_epi8(pix, interleave);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pix, coef));
+            coefs += 2 * SCALE_GROUP;
+        }
+
+        sum = _mm256_sra_epi32(sum, count);
+        __m128i s16 = _mm_packs_epi32(_mm256_castsi256_si128(sum),
+                                      _mm256_extracti128_si256(sum, 1));
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(s16, s16));
+    }
+    if (i < end)
+        scale_h8x4_c(dst, src, bank, i, end, depth);
+}
+#endif
@@ -0,0 +1,265 @@
+/*****************************************************************************
+ * tonemap.c : HDR to SDR tone mapping video filter
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#include "tonemap.h"
+
+static int Open( vlc_object_t * );
+static void Close( vlc_object_t * );
+static picture_t *Filter( filter_t *, picture_t * );
+
+#define CFG_PREFIX "tonemap-"
+
+#define PEAK_TEXT N_( "HDR peak luminance (cd/m²)" )
+#define PEAK_LONGTEXT N_( "Brightest luminance of the source, mapped to " \
+    "the SDR white. 0 uses the light level or mastering display metadata " \
+    "of the video." )
+#define WHITE_TEXT N_( "SDR white luminance (cd/m²)" )
+#define WHITE_LONGTEXT N_( "Luminance of the HDR signal shown as the SDR " \
+    "white. Lower values give a brighter picture." )
+
+vlc_module_begin ()
+    set_description( N_("HDR to SDR tone mapping video filter") )
+    set_shortname( N_("Tone mapping" ))
+    set_capability( "video filter", 0 )
+    set_category( CAT_VIDEO )
+    set_subcategory( SUBCAT_VIDEO_VFILTER )
+
+    add_shortcut( "tonemap" )
+    add_integer_with_range( CFG_PREFIX "peak", 0, 0, 10000,
+                            PEAK_TEXT, PEAK_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "white", TONEMAP_WHITE, 50, 1000,
+                            WHITE_TEXT, WHITE_LONGTEXT, false )
+    set_callbacks( Open, Close )
+vlc_module_end ()
+
+static const char *const ppsz_filter_options[] = {
+    "peak", "white",
+    NULL
+};
+
+struct filter_sys_t
+{
+    tonemap_t      *p_tm;
+    tonemap_line_t  pf_line;
+    unsigned        i_white;
+    unsigned        i_peak_option; /**< 0 if taken from the metadata */
+    unsigned        i_peak; /**< peak of the current tone curve */
+    unsigned        i_hshift, i_vshift;
+};
+
+/* Peak luminance of a picture, from its metadata */
+static unsigned GetPeak( const filter_sys_t *p_sys, const video_format_t *fmt )
+{
+    unsigned i_peak = p_sys->i_peak_option;
+
+    if( i_peak == 0 && fmt->transfer == TRANSFER_FUNC_SMPTE_ST2084 )
+    {
+        if( fmt->lighting.MaxCLL != 0 )
+            i_peak = fmt->lighting.MaxCLL;
+        else /* in units of 0.0001 cd/m² */
+            i_peak = fmt->mastering.max_luminance / 10000;
+    }
+    if( i_peak == 0 )
+        i_peak = TONEMAP_PEAK;
+    return __MIN(i_peak, 10000);
+}
+
+/*****************************************************************************
+ * Conversion, in slices of lines
+ *****************************************************************************/
+struct tonemap_slices
+{
+    filter_sys_t    *p_sys;
+    const picture_t *p_in;
+    picture_t       *p_out;
+};
+
+static void ConvertSlice( void *data, unsigned i_slice, unsigned i_slices )
+{
+    const struct tonemap_slices *p_ctx = data;
+    const filter_sys_t *p_sys = p_ctx->p_sys;
+    const plane_t *in = p_ctx->p_in->p, *out = p_ctx->p_out->p;
+    const unsigned i_width = __MIN(in[Y_PLANE].i_visible_pitch / 2,
+                                   out[Y_PLANE].i_visible_pitch);
+    const unsigned i_height = __MIN(in[Y_PLANE].i_visible_lines,
+                                    out[Y_PLANE].i_visible_lines);
+    const unsigned i_vmask = (1 << p_sys->i_vshift) - 1;
+    unsigned i_begin, i_end;
+
+    filter_GetSliceLines( i_height, i_slice, i_slices, i_vmask + 1,
+                          &i_begin, &i_end );
+
+    for( unsigned y = i_begin; y < i_end; y++ )
+    {
+        const unsigned c = y >> p_sys->i_vshift;
+        uint8_t *u_out = NULL, *v_out = NULL;
+
+        /* The chroma is taken from the first line of each pair */
+        if( (y & i_vmask) == 0 )
+        {
+            u_out = &out[U_PLANE].p_pixels[c * out[U_PLANE].i_pitch];
+            v_out = &out[V_PLANE].p_pixels[c * out[V_PLANE].i_pitch];
+        }
+
+        p_sys->pf_line( p_sys->p_tm,
+            &out[Y_PLANE].p_pixels[y * out[Y_PLANE].i_pitch], u_out, v_out,
+            (const uint16_t *)&in[Y_PLANE].p_pixels[y * in[Y_PLANE].i_pitch],
+            (const uint16_t *)&in[U_PLANE].p_pixels[c * in[U_PLANE].i_pitch],
+            (const uint16_t *)&in[V_PLANE].p_pixels[c * in[V_PLANE].i_pitch],
+            i_width, p_sys->i_hshift );
+    }
+}
+
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    /* The metadata may change along the stream */
+    const unsigned i_peak = GetPeak( p_sys, &p_pic->format );
+    if( i_peak != p_sys->i_peak )
+    {
+        msg_Dbg( p_filter, "mapping %u cd/m² to the SDR white", i_peak );
+        tonemap_set_peak( p_sys->p_tm, i_peak, p_sys->i_white );
+        p_sys->i_peak = i_peak;
+    }
+
+    picture_t *p_outpic = filter_NewPicture( p_filter );
+    if( !p_outpic )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    struct tonemap_slices ctx = {
+        .p_sys = p_sys,
+        .p_in = p_pic,
+        .p_out = p_outpic,
+    };
+    filter_ExecuteSlices( p_filter, ConvertSlice, &ctx,
+                          filter_GetSliceCount( p_filter ) );
+
+    picture_CopyProperties( p_outpic, p_pic );
+    picture_Release( p_pic );
+    return p_outpic;
+}
+
+static int Open( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    const video_format_t *fmt = &p_filter->fmt_in.video;
+    vlc_fourcc_t i_chroma;
+    unsigned i_hshift, i_vshift;
+
+    switch( fmt->i_chroma )
+    {
+        case VLC_CODEC_I420_10L:
+            i_chroma = VLC_CODEC_I420;
+            i_hshift = i_vshift = 1;
+            break;
+        case VLC_CODEC_I422_10L:
+            i_chroma = VLC_CODEC_I422;
+            i_hshift = 1;
+            i_vshift = 0;
+            break;
+        case VLC_CODEC_I444_10L:
+            i_chroma = VLC_CODEC_I444;
+            i_hshift = i_vshift = 0;
+            break;
+        default:
+            return VLC_EGENERIC;
+    }
+
+    if( fmt->transfer != TRANSFER_FUNC_SMPTE_ST2084
+     && fmt->transfer != TRANSFER_FUNC_HLG )
+    {
+        msg_Dbg( p_filter, "not an HDR transfer function" );
+        return VLC_EGENERIC;
+    }
+
+    filter_sys_t *p_sys = malloc( sizeof( *p_sys ) );
+    if( unlikely( !p_sys ) )
+        return VLC_ENOMEM;
+    p_sys->p_tm = malloc( sizeof( *p_sys->p_tm ) );
+    if( unlikely( !p_sys->p_tm ) )
+    {
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+
+    config_ChainParse( p_filter, CFG_PREFIX, ppsz_filter_options,
+                       p_filter->p_cfg );
+    p_sys->i_white = var_InheritInteger( p_filter, CFG_PREFIX "white" );
+    p_sys->i_white = VLC_CLIP( p_sys->i_white, 50, 1000 );
+    p_sys->i_peak_option = var_InheritInteger( p_filter, CFG_PREFIX "peak" );
+    p_sys->i_hshift = i_hshift;
+    p_sys->i_vshift = i_vshift;
+
+    p_sys->i_peak = GetPeak( p_sys, fmt );
+    tonemap_init( p_sys->p_tm, fmt, p_sys->i_peak, p_sys->i_white );
+
+    p_sys->pf_line = tonemap_line_c;
+#ifdef CAN_COMPILE_AVX2
+    if( vlc_CPU_AVX2() )
+        p_sys->pf_line = tonemap_line_avx2;
+#endif
+
+    msg_Dbg( p_filter, "%s to SDR, mapping %u cd/m² to the %u cd/m² white",
+             fmt->transfer == TRANSFER_FUNC_HLG ? "HLG" : "PQ",
+             p_sys->i_peak, p_sys->i_white );
+
+    /* 8-bits BT.709 output, without HDR metadata */
+    video_format_t *fmt_out = &p_filter->fmt_out.video;
+    video_format_Clean( fmt_out );
+    video_format_Copy( fmt_out, fmt );
+    fmt_out->i_chroma = p_filter->fmt_out.i_codec = i_chroma;
+    fmt_out->primaries = COLOR_PRIMARIES_BT709;
+    fmt_out->transfer = TRANSFER_FUNC_BT709;
+    fmt_out->space = COLOR_SPACE_BT709;
+    fmt_out->b_color_range_full = false;
+    memset( &fmt_out->mastering, 0, sizeof( fmt_out->mastering ) );
+    memset( &fmt_out->lighting, 0, sizeof( fmt_out->lighting ) );
+
+    p_filter->p_sys = p_sys;
+    p_filter->pf_video_filter = Filter;
+    return VLC_SUCCESS;
+}
+
+static void Close( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    free( p_sys->p_tm );
+    free( p_sys );
+}
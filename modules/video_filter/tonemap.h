@@ -0,0 +1,552 @@
+/*****************************************************************************
+ * tonemap.h: HDR to SDR tone mapping kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Each pixel of 10-bits Y'CbCr is converted to non-linear R'G'B', then to
+ * linear light through a lookup table of the PQ or HLG EOTF. Light is
+ * expressed relatively to the SDR reference white. The linear RGB is mapped
+ * to the BT.709 primaries, and compressed to the SDR range with the BT.2390
+ * EETF: the largest component is mapped, and the others are scaled with
+ * it, which preserves the hue. Looking up the mapped component rather than
+ * its gain keeps the greys monotonic. The BT.709 OETF gives the 8-bits
+ * Y'CbCr output.
+ *
+ * Linear values index their tables by their square root, which leaves
+ * enough precision in the dark. The SIMD kernels match the C ones within
+ * one code value, as the compiler may reorder the floating point
+ * operations of the latter. */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef CAN_COMPILE_AVX2
+# include <immintrin.h>
+#endif
+
+#define TONEMAP_LUT_SIZE 4096
+#define TONEMAP_WHITE    203 /* default SDR white, in cd/m² (BT.2408) */
+#define TONEMAP_PEAK     1000 /* default HDR peak, in cd/m² */
+
+typedef struct
+{
+    /* Y'CbCr to R'G'B', with the inputs normalized as
+     * y = Y * y_scale + y_offset and c = C * c_scale + c_offset */
+    float y_scale, y_offset, c_scale, c_offset;
+    float cr_r, cb_g, cr_g, cb_b;
+    /* Luminance of the input RGB, for the HLG OOTF */
+    float lum[3];
+    bool hlg;
+    /* Linear input RGB to linear BT.709 RGB */
+    float gamut[9];
+    /* 1 / peak, relative to the white */
+    float inv_peak;
+    /* BT.709 R'G'B' to 8-bits Y'CbCr, without the offsets */
+    float out_y[3], out_cb[3], out_cr[3];
+
+    float eotf[TONEMAP_LUT_SIZE]; /* E' to linear light */
+    float ootf[TONEMAP_LUT_SIZE]; /* HLG: sqrt(scene luminance) to gain */
+    float tone[TONEMAP_LUT_SIZE]; /* sqrt(largest component / peak) to its
+                                   * tone mapped value */
+    float oetf[TONEMAP_LUT_SIZE]; /* sqrt(linear light) to E' */
+} tonemap_t;
+
+typedef void (*tonemap_line_t)(const tonemap_t *, uint8_t *, uint8_t *,
+                               uint8_t *, const uint16_t *, const uint16_t *,
+                               const uint16_t *, unsigned, unsigned);
+
+/*****************************************************************************
+ * Tables
+ *****************************************************************************/
+
+/** SMPTE ST 2084: E' in [0, 1] to cd/m² */
+static inline double tonemap_pq_eotf(double e)
+{
+    const double m1 = 2610. / 16384., m2 = 2523. / 4096. * 128.;
+    const double c1 = 3424. / 4096., c2 = 2413. / 4096. * 32.,
+                 c3 = 2392. / 4096. * 32.;
+    const double p = pow(e, 1. / m2);
+
+    return 10000. * pow(fmax(p - c1, 0.) / (c2 - c3 * p), 1. / m1);
+}
+
+/** SMPTE ST 2084: cd/m² to E' in [0, 1] */
+static inline double tonemap_pq_oetf(double l)
+{
+    const double m1 = 2610. / 16384., m2 = 2523. / 4096. * 128.;
+    const double c1 = 3424. / 4096., c2 = 2413. / 4096. * 32.,
+                 c3 = 2392. / 4096. * 32.;
+    const double y = pow(fmax(l, 0.) / 10000., m1);
+
+    return pow((c1 + c2 * y) / (1. + c3 * y), m2);
+}
+
+/** ARIB STD-B67: E' in [0, 1] to scene linear light in [0, 1] */
+static inline double tonemap_hlg_inverse_oetf(double e)
+{
+    const double a = 0.17883277, b = 1. - 4. * a, c = 0.5 - a * log(4. * a);
+
+    return e <= 0.5 ? e * e / 3. : (exp((e - c) / a) + b) / 12.;
+}
+
+/** BT.709 OETF: linear light in [0, 1] to E' */
+static inline double tonemap_bt709_oetf(double l)
+{
+    return l < 0.018 ? 4.5 * l : 1.099 * pow(l, 0.45) - 0.099;
+}
+
+static inline void tonemap_mat_mul(double r[9], const double a[9],
+                                   const double b[9])
+{
+    for (unsigned i = 0; i < 3; i++)
+        for (unsigned j = 0; j < 3; j++)
+            r[3 * i + j] = a[3 * i] * b[j] + a[3 * i + 1] * b[3 + j]
+                         + a[3 * i + 2] * b[6 + j];
+}
+
+static inline void tonemap_mat_inv(double r[9], const double m[9])
+{
+    const double det = m[0] * (m[4] * m[8] - m[5] * m[7])
+                     - m[1] * (m[3] * m[8] - m[5] * m[6])
+                     + m[2] * (m[3] * m[7] - m[4] * m[6]);
+
+    r[0] = (m[4] * m[8] - m[5] * m[7]) / det;
+    r[1] = (m[2] * m[7] - m[1] * m[8]) / det;
+    r[2] = (m[1] * m[5] - m[2] * m[4]) / det;
+    r[3] = (m[5] * m[6] - m[3] * m[8]) / det;
+    r[4] = (m[0] * m[8] - m[2] * m[6]) / det;
+    r[5] = (m[2] * m[3] - m[0] * m[5]) / det;
+    r[6] = (m[3] * m[7] - m[4] * m[6]) / det;
+    r[7] = (m[1] * m[6] - m[0] * m[7]) / det;
+    r[8] = (m[0] * m[4] - m[1] * m[3]) / det;
+}
+
+/* RGB to XYZ matrix of primaries { rx, ry, gx, gy, bx, by, wx, wy } */
+static inline void tonemap_rgb_to_xyz(double m[9], const double p[8])
+{
+    double prim[9], inv[9];
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        prim[i] = p[2 * i] / p[2 * i + 1];
+        prim[3 + i] = 1.;
+        prim[6 + i] = (1. - p[2 * i] - p[2 * i + 1]) / p[2 * i + 1];
+    }
+    tonemap_mat_inv(inv, prim);
+
+    const double w[3] = { p[6] / p[7], 1., (1. - p[6] - p[7]) / p[7] };
+    for (unsigned j = 0; j < 3; j++)
+    {
+        const double s = inv[3 * j] * w[0] + inv[3 * j + 1] * w[1]
+                       + inv[3 * j + 2] * w[2];
+        for (unsigned i = 0; i < 3; i++)
+            m[3 * i + j] = prim[3 * i + j] * s;
+    }
+}
+
+static inline const double *tonemap_primaries(video_color_primaries_t p)
+{
+    static const double bt709[8] =
+        { 0.640, 0.330, 0.300, 0.600, 0.150, 0.060, 0.3127, 0.3290 };
+    static const double bt601_525[8] =
+        { 0.630, 0.340, 0.310, 0.595, 0.155, 0.070, 0.3127, 0.3290 };
+    static const double bt601_625[8] =
+        { 0.640, 0.330, 0.290, 0.600, 0.150, 0.060, 0.3127, 0.3290 };
+    static const double bt2020[8] =
+        { 0.708, 0.292, 0.170, 0.797, 0.131, 0.046, 0.3127, 0.3290 };
+    static const double p3_d65[8] =
+        { 0.680, 0.320, 0.265, 0.690, 0.150, 0.060, 0.3127, 0.3290 };
+
+    switch (p)
+    {
+        case COLOR_PRIMARIES_BT601_525: return bt601_525;
+        case COLOR_PRIMARIES_BT601_625: return bt601_625;
+        case COLOR_PRIMARIES_BT2020:    return bt2020;
+        case COLOR_PRIMARIES_DCI_P3:    return p3_d65;
+        default:                        return bt709;
+    }
+}
+
+/**
+ * Sets the tone curve mapping peak cd/m² to the SDR white. For HLG, peak is
+ * the nominal peak of the display, which also sets the OOTF.
+ */
+static inline void tonemap_set_peak(tonemap_t *tm, unsigned peak,
+                                    unsigned white)
+{
+    if (tm->hlg)
+    {
+        /* BT.2100 OOTF, with the extended range of the system gamma */
+        const double gamma = 1.2 + 0.42 * log10(peak / 1000.);
+
+        for (unsigned i = 0; i < TONEMAP_LUT_SIZE; i++)
+        {
+            const double t = (double)i / (TONEMAP_LUT_SIZE - 1);
+            tm->ootf[i] = (double)peak / white * pow(t * t, gamma - 1.);
+        }
+    }
+
+    /* A source darker than the white is left as is */
+    const unsigned range = __MAX(peak, white);
+    tm->inv_peak = (float)white / range;
+
+    /* BT.2390 EETF in the PQ domain, the black level being zero */
+    const double src = tonemap_pq_oetf(peak);
+    const double max_lum = tonemap_pq_oetf(white) / src;
+    const double ks = 1.5 * max_lum - 0.5;
+
+    tm->tone[0] = 0.f;
+    for (unsigned i = 1; i < TONEMAP_LUT_SIZE; i++)
+    {
+        const double t = (double)i / (TONEMAP_LUT_SIZE - 1);
+        const double l = t * t * range;
+        double e = tonemap_pq_oetf(l) / src;
+
+        if (max_lum < 1. && e > ks)
+        {
+            const double s = (e - ks) / (1. - ks);
+            const double s2 = s * s, s3 = s2 * s;
+
+            e = (2. * s3 - 3. * s2 + 1.) * ks + (s3 - 2. * s2 + s) * (1. - ks)
+              + (-2. * s3 + 3. * s2) * max_lum;
+        }
+        tm->tone[i] = tonemap_pq_eotf(e * src) / white;
+    }
+}
+
+/**
+ * Sets up the conversion of a PQ or HLG format with 10-bits samples to
+ * BT.709, white being the luminance of the SDR white in cd/m², and peak
+ * that of the brightest pixels of the source.
+ */
+static inline void tonemap_init(tonemap_t *tm, const video_format_t *fmt,
+                                unsigned peak, unsigned white)
+{
+    /* Luma coefficients of the input */
+    double kr = 0.2627, kb = 0.0593;
+    if (fmt->space == COLOR_SPACE_BT709)
+        kr = 0.2126, kb = 0.0722;
+    else if (fmt->space == COLOR_SPACE_BT601)
+        kr = 0.299, kb = 0.114;
+    const double kg = 1. - kr - kb;
+
+    if (fmt->b_color_range_full)
+    {
+        tm->y_scale = 1.f / 1023.f;
+        tm->y_offset = 0.f;
+        tm->c_scale = 1.f / 1023.f;
+    }
+    else
+    {
+        tm->y_scale = 1.f / 876.f;
+        tm->y_offset = -64.f / 876.f;
+        tm->c_scale = 1.f / 896.f;
+    }
+    tm->c_offset = -512.f * tm->c_scale;
+    tm->cr_r = 2. * (1. - kr);
+    tm->cb_g = -2. * kb * (1. - kb) / kg;
+    tm->cr_g = -2. * kr * (1. - kr) / kg;
+    tm->cb_b = 2. * (1. - kb);
+
+    /* Gamut mapping, through XYZ */
+    double in[9], out[9], inv[9], m[9];
+    tonemap_rgb_to_xyz(in, tonemap_primaries(fmt->primaries));
+    tonemap_rgb_to_xyz(out, tonemap_primaries(COLOR_PRIMARIES_BT709));
+    tonemap_mat_inv(inv, out);
+    tonemap_mat_mul(m, inv, in);
+    for (unsigned i = 0; i < 9; i++)
+        tm->gamut[i] = m[i];
+    for (unsigned i = 0; i < 3; i++)
+        tm->lum[i] = in[3 + i];
+
+    /* BT.709 limited range output */
+    static const double kr709 = 0.2126, kb709 = 0.0722;
+    static const double kg709 = 1. - kr709 - kb709;
+    const double out_y[3] = { kr709, kg709, kb709 };
+    for (unsigned i = 0; i < 3; i++)
+    {
+        tm->out_y[i] = 219. * out_y[i];
+        tm->out_cb[i] = 224. * ((i == 2) - out_y[i]) / (2. * (1. - kb709));
+        tm->out_cr[i] = 224. * ((i == 0) - out_y[i]) / (2. * (1. - kr709));
+    }
+
+    tm->hlg = fmt->transfer == TRANSFER_FUNC_HLG;
+    for (unsigned i = 0; i < TONEMAP_LUT_SIZE; i++)
+    {
+        const double e = (double)i / (TONEMAP_LUT_SIZE - 1);
+
+        if (tm->hlg)
+            tm->eotf[i] = tonemap_hlg_inverse_oetf(e);
+        else
+            tm->eotf[i] = tonemap_pq_eotf(e) / white;
+        tm->oetf[i] = tonemap_bt709_oetf(e * e);
+    }
+    tonemap_set_peak(tm, peak, white);
+}
+
+/*****************************************************************************
+ * Kernels
+ *****************************************************************************/
+
+/* Table index of a value in [0, 1] */
+static inline unsigned tonemap_index(float v)
+{
+    v *= TONEMAP_LUT_SIZE - 1;
+    v = v > 0.f ? v : 0.f;
+    v = v < (float)(TONEMAP_LUT_SIZE - 1) ? v : (float)(TONEMAP_LUT_SIZE - 1);
+    return lrintf(v);
+}
+
+static inline uint8_t tonemap_clip(float v)
+{
+    long l = lrintf(v);
+    return l < 0 ? 0 : l > 255 ? 255 : l;
+}
+
+/* Converts one pixel to 8-bits Y' and to Cb and Cr without their offset */
+static inline void tonemap_pixel(const tonemap_t *tm, unsigned y,
+                                 unsigned cb, unsigned cr, float out[3])
+{
+    const float fy = (float)y * tm->y_scale + tm->y_offset;
+    const float fcb = (float)cb * tm->c_scale + tm->c_offset;
+    const float fcr = (float)cr * tm->c_scale + tm->c_offset;
+
+    float r = tm->eotf[tonemap_index(fy + tm->cr_r * fcr)];
+    float g = tm->eotf[tonemap_index(fy + tm->cb_g * fcb + tm->cr_g * fcr)];
+    float b = tm->eotf[tonemap_index(fy + tm->cb_b * fcb)];
+
+    if (tm->hlg)
+    {
+        const float ys = tm->lum[0] * r + tm->lum[1] * g + tm->lum[2] * b;
+        const float gain = tm->ootf[tonemap_index(sqrtf(ys))];
+        r *= gain;
+        g *= gain;
+        b *= gain;
+    }
+
+    float lr = tm->gamut[0] * r + tm->gamut[1] * g + tm->gamut[2] * b;
+    float lg = tm->gamut[3] * r + tm->gamut[4] * g + tm->gamut[5] * b;
+    float lb = tm->gamut[6] * r + tm->gamut[7] * g + tm->gamut[8] * b;
+    lr = lr > 0.f ? lr : 0.f;
+    lg = lg > 0.f ? lg : 0.f;
+    lb = lb > 0.f ? lb : 0.f;
+
+    float m = lr > lg ? lr : lg;
+    m = m > lb ? m : lb;
+    const float gain = tm->tone[tonemap_index(sqrtf(m * tm->inv_peak))]
+                     / (m > 1e-9f ? m : 1e-9f);
+
+    r = tm->oetf[tonemap_index(sqrtf(lr * gain))];
+    g = tm->oetf[tonemap_index(sqrtf(lg * gain))];
+    b = tm->oetf[tonemap_index(sqrtf(lb * gain))];
+
+    out[0] = tm->out_y[0] * r + tm->out_y[1] * g + tm->out_y[2] * b;
+    out[1] = tm->out_cb[0] * r + tm->out_cb[1] * g + tm->out_cb[2] * b;
+    out[2] = tm->out_cr[0] * r + tm->out_cr[1] * g + tm->out_cr[2] * b;
+}
+
+/**
+ * Converts a line of width pixels. The chroma lines are subsampled
+ * horizontally by 1 << hshift (0 or 1); they are not written if u_out is
+ * NULL, for the lines skipped by the vertical subsampling.
+ */
+static inline void tonemap_line_c(const tonemap_t *tm, uint8_t *restrict y_out,
+                                  uint8_t *restrict u_out,
+                                  uint8_t *restrict v_out,
+                                  const uint16_t *y_in, const uint16_t *u_in,
+                                  const uint16_t *v_in, unsigned width,
+                                  unsigned hshift)
+{
+    for (unsigned x = 0; x < width; x += 1 << hshift)
+    {
+        const unsigned c = x >> hshift;
+        const unsigned n = __MIN(1u << hshift, width - x);
+        float cb = 0.f, cr = 0.f;
+
+        for (unsigned i = 0; i < n; i++)
+        {
+            float out[3];
+
+            tonemap_pixel(tm, y_in[x + i], u_in[c], v_in[c], out);
+            y_out[x + i] = tonemap_clip(out[0] + 16.f);
+            cb += out[1];
+            cr += out[2];
+        }
+        if (u_out != NULL)
+        {
+            u_out[c] = tonemap_clip(cb / n + 128.f);
+            v_out[c] = tonemap_clip(cr / n + 128.f);
+        }
+    }
+}
+
+#ifdef CAN_COMPILE_AVX2
+VLC_AVX2
+static inline __m256i tonemap_index_avx2(__m256 v)
+{
+    const __m256 max = _mm256_set1_ps(TONEMAP_LUT_SIZE - 1);
+
+    v = _mm256_mul_ps(v, max);
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), max);
+    return _mm256_cvtps_epi32(v);
+}
+
+VLC_AVX2
+static inline __m256 tonemap_lookup_avx2(const float *lut, __m256 v)
+{
+    return _mm256_i32gather_ps(lut, tonemap_index_avx2(v), 4);
+}
+
+VLC_AVX2
+static inline __m256 tonemap_dot_avx2(const float k[3], __m256 a, __m256 b,
+                                      __m256 c)
+{
+    return _mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(_mm256_set1_ps(k[0]), a),
+        _mm256_mul_ps(_mm256_set1_ps(k[1]), b)),
+        _mm256_mul_ps(_mm256_set1_ps(k[2]), c));
+}
+
+/* Packs 8 values to bytes, with saturation */
+VLC_AVX2
+static inline __m128i tonemap_pack_avx2(__m256 v)
+{
+    const __m256i i = _mm256_cvtps_epi32(v);
+    const __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(i),
+                                      _mm256_extracti128_si256(i, 1));
+    return _mm_packus_epi16(w, w);
+}
+
+VLC_AVX2
+static inline void tonemap_line_avx2(const tonemap_t *tm,
+                                     uint8_t *restrict y_out,
+                                     uint8_t *restrict u_out,
+                                     uint8_t *restrict v_out,
+                                     const uint16_t *y_in,
+                                     const uint16_t *u_in,
+                                     const uint16_t *v_in, unsigned width,
+                                     unsigned hshift)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    unsigned x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        const unsigned c = x >> hshift;
+        __m128i vy = _mm_loadu_si128((const __m128i *)&y_in[x]);
+        __m128i vu, vv;
+
+        if (hshift)
+        {
+            vu = _mm_loadl_epi64((const __m128i *)&u_in[c]);
+            vv = _mm_loadl_epi64((const __m128i *)&v_in[c]);
+            vu = _mm_unpacklo_epi16(vu, vu);
+            vv = _mm_unpacklo_epi16(vv, vv);
+        }
+        else
+        {
+            vu = _mm_loadu_si128((const __m128i *)&u_in[c]);
+            vv = _mm_loadu_si128((const __m128i *)&v_in[c]);
+        }
+
+        const __m256 fy = _mm256_add_ps(_mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(vy)),
+            _mm256_set1_ps(tm->y_scale)), _mm256_set1_ps(tm->y_offset));
+        const __m256 fcb = _mm256_add_ps(_mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(vu)),
+            _mm256_set1_ps(tm->c_scale)), _mm256_set1_ps(tm->c_offset));
+        const __m256 fcr = _mm256_add_ps(_mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(vv)),
+            _mm256_set1_ps(tm->c_scale)), _mm256_set1_ps(tm->c_offset));
+
+        __m256 r = tonemap_lookup_avx2(tm->eotf, _mm256_add_ps(fy,
+            _mm256_mul_ps(_mm256_set1_ps(tm->cr_r), fcr)));
+        __m256 g = tonemap_lookup_avx2(tm->eotf, _mm256_add_ps(
+            _mm256_add_ps(fy, _mm256_mul_ps(_mm256_set1_ps(tm->cb_g), fcb)),
+            _mm256_mul_ps(_mm256_set1_ps(tm->cr_g), fcr)));
+        __m256 b = tonemap_lookup_avx2(tm->eotf, _mm256_add_ps(fy,
+            _mm256_mul_ps(_mm256_set1_ps(tm->cb_b), fcb)));
+
+        if (tm->hlg)
+        {
+            const __m256 gain = tonemap_lookup_avx2(tm->ootf,
+                _mm256_sqrt_ps(tonemap_dot_avx2(tm->lum, r, g, b)));
+            r = _mm256_mul_ps(r, gain);
+            g = _mm256_mul_ps(g, gain);
+            b = _mm256_mul_ps(b, gain);
+        }
+
+        const __m256 lr = _mm256_max_ps(
+            tonemap_dot_avx2(&tm->gamut[0], r, g, b), zero);
+        const __m256 lg = _mm256_max_ps(
+            tonemap_dot_avx2(&tm->gamut[3], r, g, b), zero);
+        const __m256 lb = _mm256_max_ps(
+            tonemap_dot_avx2(&tm->gamut[6], r, g, b), zero);
+
+        const __m256 m = _mm256_max_ps(_mm256_max_ps(lr, lg), lb);
+        const __m256 gain = _mm256_div_ps(tonemap_lookup_avx2(tm->tone,
+            _mm256_sqrt_ps(_mm256_mul_ps(m, _mm256_set1_ps(tm->inv_peak)))),
+            _mm256_max_ps(m, _mm256_set1_ps(1e-9f)));
+
+        r = tonemap_lookup_avx2(tm->oetf,
+                                _mm256_sqrt_ps(_mm256_mul_ps(lr, gain)));
+        g = tonemap_lookup_avx2(tm->oetf,
+                                _mm256_sqrt_ps(_mm256_mul_ps(lg, gain)));
+        b = tonemap_lookup_avx2(tm->oetf,
+                                _mm256_sqrt_ps(_mm256_mul_ps(lb, gain)));
+
+        _mm_storel_epi64((__m128i *)&y_out[x], tonemap_pack_avx2(
+            _mm256_add_ps(tonemap_dot_avx2(tm->out_y, r, g, b),
+                          _mm256_set1_ps(16.f))));
+        if (u_out == NULL)
+            continue;
+
+        const __m256 cb = tonemap_dot_avx2(tm->out_cb, r, g, b);
+        const __m256 cr = tonemap_dot_avx2(tm->out_cr, r, g, b);
+        const __m256 offset = _mm256_set1_ps(128.f);
+
+        if (hshift)
+        {
+            /* Sums of pairs, as cb 0-3 then cr 0-3 */
+            __m256 sum = _mm256_permutevar8x32_ps(_mm256_hadd_ps(cb, cr),
+                _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+            sum = _mm256_add_ps(_mm256_mul_ps(sum, _mm256_set1_ps(0.5f)),
+                                offset);
+
+            const __m128i p = tonemap_pack_avx2(sum);
+            const uint32_t u = _mm_cvtsi128_si32(p);
+            const uint32_t v = _mm_extract_epi32(p, 1);
+            memcpy(&u_out[c], &u, 4);
+            memcpy(&v_out[c], &v, 4);
+        }
+        else
+        {
+            _mm_storel_epi64((__m128i *)&u_out[c],
+                             tonemap_pack_avx2(_mm256_add_ps(cb, offset)));
+            _mm_storel_epi64((__m128i *)&v_out[c],
+                             tonemap_pack_avx2(_mm256_add_ps(cr, offset)));
+        }
+    }
+
+    tonemap_line_c(tm, &y_out[x], u_out ? &u_out[x >> hshift] : NULL,
+                   v_out ? &v_out[x >> hshift] : NULL, &y_in[x],
+                   &u_in[x >> hshift], &v_in[x >> hshift], width - x, hshift);
+}
+#endif
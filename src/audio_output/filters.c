@@ -42,6 +42,23 @@
 #include <libvlc.h>
 #include "aout_internal.h"
 
+/* Define to log the time spent in each filter when the chain is deleted.
+ * This reads the clock twice per filter and per buffer. */
+#undef AOUT_FILTERS_TIMING
+
+#ifdef AOUT_FILTERS_TIMING
+# define aout_filter_clock() mdate()
+#else
+# define aout_filter_clock() INT64_C(0)
+#endif
+
+/** Time spent in a filter */
+typedef struct
+{
+    mtime_t  time;
+    uint64_t frames; /**< Input frames */
+} aout_filter_stats_t;
+
 static filter_t *CreateFilter (vlc_object_t *obj, const char *type,
                                const char *name, filter_owner_sys_t *owner,
                                const audio_sample_format_t *infmt,
@@ -271,29 +288,122 @@ error:
     return -1;
 }
 
+/**
+ * Reports the time spent in a chain of filters.
+ */
+static void aout_FiltersPipelineReport(filter_t *const *filters,
+                                       const aout_filter_stats_t *stats,
+                                       unsigned count)
+{
+#ifdef AOUT_FILTERS_TIMING
+    for (unsigned i = 0; i < count; i++)
+    {
+        const filter_t *filter = filters[i];
+        const unsigned rate = filter->fmt_in.audio.i_rate;
+
+        if (stats[i].frames == 0 || rate == 0)
+            continue;
+
+        const mtime_t duration = stats[i].frames * CLOCK_FREQ / rate;
+        msg_Dbg (filters[i], "%s: %"PRIu64" frames in %"PRId64" us "
+                 "(%.3f%% of real time)", module_get_object (filter->p_module),
+                 stats[i].frames, stats[i].time,
+                 duration > 0 ? 100. * stats[i].time / duration : 0.);
+    }
+#else
+    VLC_UNUSED(filters); VLC_UNUSED(stats); VLC_UNUSED(count);
+#endif
+}
+
 /**
  * Filters an audio buffer through a chain of filters.
  */
 static block_t *aout_FiltersPipelinePlay(filter_t *const *filters,
+                                         aout_filter_stats_t *stats,
                                          unsigned count, block_t *block)
 {
     /* TODO: use filter chain */
     for (unsigned i = 0; (i < count) && (block != NULL); i++)
     {
         filter_t *filter = filters[i];
+        const unsigned frames = block->i_nb_samples;
+        const mtime_t start = aout_filter_clock ();
 
         /* Please note that p_block->i_nb_samples & i_buffer
          * shall be set by the filter plug-in. */
         block = filter->pf_audio_filter (filter, block);
+
+        stats[i].time += aout_filter_clock () - start;
+        stats[i].frames += frames;
     }
     return block;
 }
 
+/**
+ * Gathers a chain of audio buffers into one.
+ */
+static block_t *aout_FiltersGather(block_t *chain)
+{
+    if (chain == NULL || chain->p_next == NULL)
+        return chain;
+
+    unsigned frames = 0;
+    for (const block_t *b = chain; b != NULL; b = b->p_next)
+        frames += b->i_nb_samples;
+
+    block_t *block = block_ChainGather (chain);
+    if (likely(block != NULL))
+        block->i_nb_samples = frames;
+    return block;
+}
+
+/**
+ * Splits an audio buffer into a chain of chunks of at most max frames.
+ * On error, the buffer is returned whole.
+ */
+static block_t *aout_FiltersSplit(block_t *block, unsigned max,
+                                  size_t frame_size)
+{
+    const unsigned frames = block->i_nb_samples;
+    block_t *chain = NULL, **last = &chain;
+
+    assert (block->i_buffer >= frames * frame_size);
+
+    for (unsigned offset = 0; offset < frames; offset += max)
+    {
+        const unsigned n = __MIN(max, frames - offset);
+        block_t *chunk = block_Alloc (n * frame_size);
+        if (unlikely(chunk == NULL))
+        {
+            block_ChainRelease (chain);
+            return block;
+        }
+
+        memcpy (chunk->p_buffer, block->p_buffer + offset * frame_size,
+                n * frame_size);
+        chunk->i_nb_samples = n;
+        chunk->i_flags = (offset == 0) ? block->i_flags : 0;
+
+        /* Share the timestamps proportionally, whatever the playback rate */
+        const mtime_t begin = block->i_length * offset / frames;
+        const mtime_t end = block->i_length * (offset + n) / frames;
+        chunk->i_pts = (block->i_pts > VLC_TS_INVALID)
+                     ? block->i_pts + begin : block->i_pts;
+        chunk->i_dts = (block->i_dts > VLC_TS_INVALID)
+                     ? block->i_dts + begin : block->i_dts;
+        chunk->i_length = end - begin;
+        block_ChainLastAppend (&last, chunk);
+    }
+    block_Release (block);
+    return chain;
+}
+
 
 /**
  * Drain the chain of filters.
  */
 static block_t *aout_FiltersPipelineDrain(filter_t *const *filters,
+                                          aout_filter_stats_t *stats,
                                           unsigned count)
 {
     block_t *chain = NULL;
@@ -301,24 +411,24 @@ static block_t *aout_FiltersPipelineDrain(filter_t *const *filters,
     for (unsigned i = 0; i < count; i++)
     {
         filter_t *filter = filters[i];
+        const mtime_t start = aout_filter_clock ();
 
         block_t *block = filter_DrainAudio (filter);
+        stats[i].time += aout_filter_clock () - start;
         if (block)
         {
             /* If there is a drained block, filter it through the following
              * chain of filters  */
             if (i + 1 < count)
                 block = aout_FiltersPipelinePlay (&filters[i + 1],
+                                                  &stats[i + 1],
                                                   count - i - 1, block);
             if (block)
                 block_ChainAppend (&chain, block);
         }
     }
 
-    if (chain)
-        return block_ChainGather(chain);
-    else
-        return NULL;
+    return aout_FiltersGather (chain);
 }
 
 /**
@@ -341,16 +451,29 @@ static void aout_FiltersPipelineChangeViewpoint(filter_t *const *filters,
 
 #define AOUT_MAX_FILTERS 10
 
+/* Larger input buffers are processed in chunks, which stay in the cache
+ * from one filter to the next. Splitting copies the samples in and out of
+ * the chunks, so this is kept above the usual decoder buffers (up to 4608
+ * frames with FLAC). */
+#define AOUT_CHUNK_FRAMES 8192
+
 struct aout_filters
 {
     filter_t *rate_filter; /**< The filter adjusting samples count
         (either the scaletempo filter or a resampler) */
     filter_t *resampler; /**< The resampler */
+    filter_t *converter; /**< Conversion to the output format, if the
+        resampler does not use it */
     int resampling; /**< Current resampling (Hz) */
+    size_t frame_size; /**< Input frame size, 0 if the input is not split */
 
     unsigned count; /**< Number of filters */
     filter_t *tab[AOUT_MAX_FILTERS]; /**< Configured user filters
         (e.g. equalization) and their conversions */
+
+    aout_filter_stats_t stats[AOUT_MAX_FILTERS];
+    aout_filter_stats_t resampler_stats;
+    aout_filter_stats_t converter_stats;
 };
 
 /** Callback for visualization selection */
@@ -509,8 +632,13 @@ aout_filters_t *aout_FiltersNew (vlc_object_t *obj,
 
     filters->rate_filter = NULL;
     filters->resampler = NULL;
+    filters->converter = NULL;
     filters->resampling = 0;
+    filters->frame_size = 0;
     filters->count = 0;
+    memset (filters->stats, 0, sizeof (filters->stats));
+    memset (&filters->resampler_stats, 0, sizeof (filters->resampler_stats));
+    memset (&filters->converter_stats, 0, sizeof (filters->converter_stats));
 
     /* Prepare format structure */
     aout_FormatPrint (obj, "input", infmt);
@@ -541,6 +669,9 @@ aout_filters_t *aout_FiltersNew (vlc_object_t *obj,
         msg_Warn (obj, "No ouput channel mask, cannot setup filters");
         goto error;
     }
+    if (AOUT_FMT_LINEAR(infmt) && infmt->i_bytes_per_frame > 0
+     && infmt->i_frame_length == 1)
+        filters->frame_size = infmt->i_bytes_per_frame;
 
     assert(output_format.channel_type == AUDIO_CHANNEL_TYPE_BITMAP);
     if (input_format.channel_type != output_format.channel_type)
@@ -627,6 +758,24 @@ aout_filters_t *aout_FiltersNew (vlc_object_t *obj,
         free (visual);
     }
 
+    /* Keep the samples in float through the resampler if they are processed
+     * at all, rather than converting them back and forth between stages.
+     * The conversion to the output format then comes last. */
+    output_format.i_rate = outfmt->i_rate;
+    assert (AOUT_FMTS_IDENTICAL(&output_format, outfmt));
+    if (output_format.i_format != VLC_CODEC_FL32
+     && (input_format.i_format == VLC_CODEC_FL32 || filters->count > 0
+      || input_format.i_rate != outfmt->i_rate
+      || input_format.i_physical_channels != outfmt->i_physical_channels))
+    {
+        output_format.i_format = VLC_CODEC_FL32;
+        aout_FormatPrepare (&output_format);
+
+        filters->converter = FindConverter (obj, &output_format, outfmt);
+        if (filters->converter == NULL)
+            output_format = *outfmt;
+    }
+
     /* convert to the output format (minus resampling) if necessary */
     output_format.i_rate = input_format.i_rate;
     if (aout_FiltersPipelineCreate (obj, filters->tab, &filters->count,
@@ -639,7 +788,6 @@ aout_filters_t *aout_FiltersNew (vlc_object_t *obj,
 
     /* insert the resampler */
     output_format.i_rate = outfmt->i_rate;
-    assert (AOUT_FMTS_IDENTICAL(&output_format, outfmt));
     filters->resampler = FindResampler (obj, &input_format,
                                         &output_format);
     if (filters->resampler == NULL && input_format.i_rate != outfmt->i_rate)
@@ -653,6 +801,8 @@ aout_filters_t *aout_FiltersNew (vlc_object_t *obj,
     return filters;
 
 error:
+    if (filters->converter != NULL)
+        aout_FiltersPipelineDestroy (&filters->converter, 1);
     aout_FiltersPipelineDestroy (filters->tab, filters->count);
     if (request_vout != NULL)
         var_DelCallback (obj, "visual", VisualizationCallback, NULL);
@@ -671,8 +821,19 @@ error:
  */
 void aout_FiltersDelete (vlc_object_t *obj, aout_filters_t *filters)
 {
+    aout_FiltersPipelineReport (filters->tab, filters->stats, filters->count);
     if (filters->resampler != NULL)
+    {
+        aout_FiltersPipelineReport (&filters->resampler,
+                                    &filters->resampler_stats, 1);
         aout_FiltersPipelineDestroy (&filters->resampler, 1);
+    }
+    if (filters->converter != NULL)
+    {
+        aout_FiltersPipelineReport (&filters->converter,
+                                    &filters->converter_stats, 1);
+        aout_FiltersPipelineDestroy (&filters->converter, 1);
+    }
     aout_FiltersPipelineDestroy (filters->tab, filters->count);
     if (obj != NULL)
         var_DelCallback (obj, "visual", VisualizationCallback, NULL);
@@ -713,21 +874,46 @@ block_t *aout_FiltersPlay (aout_filters_t *filters, block_t *block, int rate)
             (nominal_rate * INPUT_RATE_DEFAULT) / rate;
     }
 
-    block = aout_FiltersPipelinePlay (filters->tab, filters->count, block);
+    if (filters->frame_size != 0 && block->i_nb_samples > AOUT_CHUNK_FRAMES)
+        block = aout_FiltersSplit (block, AOUT_CHUNK_FRAMES,
+                                   filters->frame_size);
+
+    /* NOTE: the resampler needs to run even if resampling is 0.
+     * The decoder and output rates can still be different. */
     if (filters->resampler != NULL)
-    {   /* NOTE: the resampler needs to run even if resampling is 0.
-         * The decoder and output rates can still be different. */
         filters->resampler->fmt_in.audio.i_rate += filters->resampling;
-        block = aout_FiltersPipelinePlay (&filters->resampler, 1, block);
-        filters->resampler->fmt_in.audio.i_rate -= filters->resampling;
+
+    /* Each chunk goes through all the stages before the next one */
+    block_t *chain = NULL, **last = &chain;
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        block->p_next = NULL;
+        block = aout_FiltersPipelinePlay (filters->tab, filters->stats,
+                                          filters->count, block);
+        if (filters->resampler != NULL)
+            block = aout_FiltersPipelinePlay (&filters->resampler,
+                                              &filters->resampler_stats, 1,
+                                              block);
+        if (filters->converter != NULL)
+            block = aout_FiltersPipelinePlay (&filters->converter,
+                                              &filters->converter_stats, 1,
+                                              block);
+        if (block != NULL)
+            block_ChainLastAppend (&last, block);
+        block = next;
     }
 
+    if (filters->resampler != NULL)
+        filters->resampler->fmt_in.audio.i_rate -= filters->resampling;
+
     if (nominal_rate != 0)
     {   /* Restore input rate */
         assert (filters->rate_filter != NULL);
         filters->rate_filter->fmt_in.audio.i_rate = nominal_rate;
     }
-    return block;
+    return aout_FiltersGather (chain);
 
 drop:
     block_Release (block);
@@ -737,7 +923,8 @@ drop:
 block_t *aout_FiltersDrain (aout_filters_t *filters)
 {
     /* Drain the filters pipeline */
-    block_t *block = aout_FiltersPipelineDrain (filters->tab, filters->count);
+    block_t *block = aout_FiltersPipelineDrain (filters->tab, filters->stats,
+                                                filters->count);
 
     if (filters->resampler != NULL)
     {
@@ -748,22 +935,29 @@ block_t *aout_FiltersDrain (aout_filters_t *filters)
         if (block)
         {
             /* Resample the drained block from the filters pipeline */
-            block = aout_FiltersPipelinePlay (&filters->resampler, 1, block);
+            block = aout_FiltersPipelinePlay (&filters->resampler,
+                                              &filters->resampler_stats, 1,
+                                              block);
             if (block)
                 block_ChainAppend (&chain, block);
         }
 
         /* Drain the resampler filter */
-        block = aout_FiltersPipelineDrain (&filters->resampler, 1);
+        block = aout_FiltersPipelineDrain (&filters->resampler,
+                                           &filters->resampler_stats, 1);
         if (block)
             block_ChainAppend (&chain, block);
 
         filters->resampler->fmt_in.audio.i_rate -= filters->resampling;
 
-        return chain ? block_ChainGather (chain) : NULL;
+        block = aout_FiltersGather (chain);
     }
-    else
-        return block;
+
+    /* The converter keeps no state */
+    if (filters->converter != NULL && block != NULL)
+        block = aout_FiltersPipelinePlay (&filters->converter,
+                                          &filters->converter_stats, 1, block);
+    return block;
 }
 
 void aout_FiltersFlush (aout_filters_t *filters)
@@ -772,6 +966,8 @@ void aout_FiltersFlush (aout_filters_t *filters)
 
     if (filters->resampler != NULL)
         aout_FiltersPipelineFlush (&filters->resampler, 1);
+    if (filters->converter != NULL)
+        aout_FiltersPipelineFlush (&filters->converter, 1);
 }
 
 void aout_FiltersChangeViewpoint (aout_filters_t *filters,
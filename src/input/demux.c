@@ -35,6 +35,7 @@
 #include <vlc_url.h>
 #include <vlc_modules.h>
 #include <vlc_strings.h>
+#include "../modules/modules.h"
 
 typedef const struct
 {
@@ -191,6 +192,42 @@ static int demux_Probe(void *func, va_list ap)
     return probe(VLC_OBJECT(demux));
 }
 
+/* Number of bytes peeked to match the demuxers magic pre-filters */
+#define DEMUX_PROBE_PEEK 64
+
+/**
+ * Describes the input stream for the demuxers pre-filters.
+ * The start of the stream is copied to buf, as probed demuxers will
+ * invalidate the peek buffer.
+ */
+static void demux_ProbeHints(demux_t *demux, struct vlc_probe_hints *hints,
+                             uint8_t buf[DEMUX_PROBE_PEEK], char **mime)
+{
+    const char *name = (demux->psz_file != NULL) ? demux->psz_file
+                                                 : demux->psz_location;
+    const char *ext = strrchr(name, '.');
+
+    hints->extension = (ext != NULL) ? ext + 1 : NULL;
+    hints->mime_type = *mime = stream_MimeType(demux->s);
+    hints->peek = NULL;
+    hints->peek_size = 0;
+    hints->peek_eof = false;
+
+    if (vlc_stream_Tell(demux->s) == 0)
+    {
+        const uint8_t *peek;
+        ssize_t val = vlc_stream_Peek(demux->s, &peek, DEMUX_PROBE_PEEK);
+
+        if (val >= 0)
+        {
+            memcpy(buf, peek, val);
+            hints->peek = buf;
+            hints->peek_size = val;
+            hints->peek_eof = val < DEMUX_PROBE_PEEK;
+        }
+    }
+}
+
 /*****************************************************************************
  * demux_NewAdvanced:
  *  if s is NULL then load a access_demux
@@ -261,8 +298,15 @@ demux_t *demux_NewAdvanced( vlc_object_t *p_obj, input_thread_t *p_parent_input,
         if( psz_module == NULL )
             psz_module = p_demux->psz_demux;
 
-        p_demux->p_module = vlc_module_load(p_demux, "demux", psz_module,
-             !strcmp(psz_module, p_demux->psz_demux), demux_Probe, p_demux);
+        struct vlc_probe_hints hints;
+        uint8_t peek[DEMUX_PROBE_PEEK];
+        char *psz_mime;
+
+        demux_ProbeHints( p_demux, &hints, peek, &psz_mime );
+        p_demux->p_module = vlc_module_load_hinted(p_demux, "demux",
+             psz_module, !strcmp(psz_module, p_demux->psz_demux), &hints,
+             demux_Probe, p_demux);
+        free( psz_mime );
     }
     else
     {
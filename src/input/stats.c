@@ -25,7 +25,10 @@
 # include "config.h"
 #endif
 
+#include <math.h>
+
 #include <vlc_common.h>
+#include <vlc_aout.h>
 #include "input/input_internal.h"
 
 /**
@@ -78,13 +81,37 @@ input_stats_t *stats_NewInputStats( input_thread_t *p_input )
     return p_stats;
 }
 
+/* Reads the meters that the loudness audio filter publishes on the output */
+static void stats_GetLoudness(input_thread_t *input, float *values)
+{
+    static const char *const names[] = {
+        "loudness-momentary", "loudness-short-term", "loudness-integrated",
+        "loudness-peak",
+    };
+
+    for (unsigned i = 0; i < ARRAY_SIZE(names); i++)
+        values[i] = NAN;
+
+    audio_output_t *aout =
+        input_resource_HoldAout(input_priv(input)->p_resource);
+    if (aout == NULL)
+        return;
+    if (var_Type(aout, names[0]) != 0)
+        for (unsigned i = 0; i < ARRAY_SIZE(names); i++)
+            values[i] = var_GetFloat(aout, names[i]);
+    vlc_object_release(aout);
+}
+
 void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
 {
     input_thread_private_t *priv = input_priv(input);
+    float loudness[4];
 
     if (!libvlc_stats(input))
         return;
 
+    stats_GetLoudness(input, loudness);
+
     vlc_mutex_lock(&priv->counters.counters_lock);
     vlc_mutex_lock(&st->lock);
 
@@ -117,6 +144,18 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->i_displayed_pictures = stats_GetTotal(priv->counters.p_displayed_pictures);
     st->i_lost_pictures = stats_GetTotal(priv->counters.p_lost_pictures);
 
+    /* Block pool */
+    uint64_t hits, misses;
+    block_PoolGetStats(&hits, &misses, &st->i_block_pool_retained);
+    st->i_block_pool_hits = hits;
+    st->i_block_pool_misses = misses;
+
+    /* Loudness */
+    st->f_loudness_momentary = loudness[0];
+    st->f_loudness_short_term = loudness[1];
+    st->f_loudness_integrated = loudness[2];
+    st->f_true_peak = loudness[3];
+
     vlc_mutex_unlock(&st->lock);
     vlc_mutex_unlock(&priv->counters.counters_lock);
 }
@@ -132,8 +171,11 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     p_stats->i_displayed_pictures = p_stats->i_lost_pictures =
     p_stats->i_played_abuffers = p_stats->i_lost_abuffers =
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
-    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate
-     = 0;
+    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate =
+    p_stats->i_block_pool_hits = p_stats->i_block_pool_misses =
+    p_stats->i_block_pool_retained = 0;
+    p_stats->f_loudness_momentary = p_stats->f_loudness_short_term =
+    p_stats->f_loudness_integrated = p_stats->f_true_peak = NAN;
     vlc_mutex_unlock( &p_stats->lock );
 }
 
@@ -388,6 +388,11 @@ static const char *const ppsz_pos_descriptions[] =
     "picture quality, for instance deinterlacing, or distort " \
     "the video.")
 
+#define FILTER_THREADS_TEXT N_("Video filter threads")
+#define FILTER_THREADS_LONGTEXT N_( \
+    "Number of threads that video filters can use to process pictures in " \
+    "slices, including the video output thread (0 = number of CPUs).")
+
 #define SNAP_PATH_TEXT N_("Video snapshot directory (or filename)")
 #define SNAP_PATH_LONGTEXT N_( \
     "Directory where the video snapshots will be stored.")
@@ -1041,6 +1046,11 @@ static const char *const ppsz_prefres[] = {
     "Scan plugin directories for new plugins at startup. " \
     "This increases the startup time of VLC.")
 
+#define PROBE_TRACE_TEXT N_("Trace module probing")
+#define PROBE_TRACE_LONGTEXT N_( \
+    "Log every module tried or skipped while looking for a module, " \
+    "with the time spent in each probe.")
+
 #define KEYSTORE_TEXT N_("Preferred keystore list")
 #define KEYSTORE_LONGTEXT N_( \
     "List of keystores that VLC will use in " \
@@ -1624,6 +1634,8 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_VIDEO_VFILTER )
     add_module_list( "video-filter", "video filter", NULL,
                      VIDEO_FILTER_TEXT, VIDEO_FILTER_LONGTEXT, false )
+    add_integer( "filter-threads", 0,
+                 FILTER_THREADS_TEXT, FILTER_THREADS_LONGTEXT, true )
 
     set_subcategory( SUBCAT_VIDEO_SPLITTER )
     add_module_list( "video-splitter", "video splitter", NULL,
@@ -1981,6 +1993,8 @@ vlc_module_begin ()
               PLUGINS_SCAN_LONGTEXT, true )
     add_obsolete_string( "plugin-path" ) /* since 2.0.0 */
 #endif
+    add_bool( "probe-trace", false, PROBE_TRACE_TEXT,
+              PROBE_TRACE_LONGTEXT, true )
     add_obsolete_string( "data-path" ) /* since 2.1.0 */
     add_string( "keystore", NULL, KEYSTORE_TEXT,
                 KEYSTORE_LONGTEXT, true )
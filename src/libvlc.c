@@ -93,6 +93,7 @@ libvlc_int_t * libvlc_InternalCreate( void )
     priv = libvlc_priv (p_libvlc);
     priv->playlist = NULL;
     priv->p_vlm = NULL;
+    priv->slices = NULL;
 
     vlc_ExitInit( &priv->exit );
 
@@ -417,6 +418,7 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
         playlist_preparser_Delete(priv->parser);
 
     libvlc_InternalActionsClean( p_libvlc );
+    vlc_slices_Destroy( p_libvlc );
 
     /* Save the configuration */
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
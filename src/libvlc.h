@@ -72,6 +72,17 @@ int vlc_LogPreinit(libvlc_int_t *);
 int vlc_LogInit(libvlc_int_t *);
 void vlc_LogDeinit(libvlc_int_t *);
 
+/*
+ * Slice threads
+ */
+typedef struct vlc_slices vlc_slices_t;
+
+vlc_slices_t *vlc_slices_Get(libvlc_int_t *);
+unsigned vlc_slices_Count(const vlc_slices_t *);
+void vlc_slices_Execute(vlc_slices_t *, void (*)(void *, unsigned, unsigned),
+                        void *, unsigned);
+void vlc_slices_Destroy(libvlc_int_t *);
+
 /*
  * LibVLC exit event handling
  */
@@ -189,6 +200,7 @@ typedef struct libvlc_priv_t
     struct playlist_t *playlist; ///< Playlist for interfaces
     struct playlist_preparser_t *parser; ///< Input item meta data handler
     vlc_actions_t *actions; ///< Hotkeys handler
+    vlc_slices_t *slices; ///< Video filter slice threads (or NULL)
 
     /* Exit callback */
     vlc_exit_t       exit;
@@ -264,4 +276,9 @@ void stats_CounterClean (counter_t * );
 void stats_ComputeInputStats(input_thread_t*, input_stats_t*);
 void stats_ReinitInputStats(input_stats_t *);
 
+/*
+ * Block pool
+ */
+void block_PoolGetStats(uint64_t *hits, uint64_t *misses, int64_t *retained);
+
 #endif
@@ -34,6 +34,8 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+#include "libvlc.h"
 
 #ifndef NDEBUG
 static void BlockNoRelease( block_t *b )
@@ -99,6 +101,271 @@ static void block_generic_Release (block_t *block)
     free (block);
 }
 
+/*****************************************************************************
+ * Block recycling pool
+ *****************************************************************************
+ * Small and medium blocks (demuxed packets, datagrams, encoded frames) are
+ * allocated from power-of-two size classes. Released blocks are kept in a
+ * small per-thread cache first, and exchanged in batches with a global depot
+ * protected by a mutex. Both levels have bounded retention: surplus blocks
+ * are returned to the C heap.
+ *****************************************************************************/
+
+/** Smallest and largest pooled allocation, as a power of two. */
+#define BLOCK_POOL_MIN_SHIFT  9 /* 512 bytes */
+#define BLOCK_POOL_MAX_SHIFT 17 /* 128 KiB */
+#define BLOCK_POOL_CLASSES   (BLOCK_POOL_MAX_SHIFT - BLOCK_POOL_MIN_SHIFT + 1)
+
+/** Per-thread retention per size class (in bytes, at least 4 blocks). */
+#define BLOCK_CACHE_BYTES  (256 << 10)
+/** Global depot retention per size class (in bytes). */
+#define BLOCK_DEPOT_BYTES  (4 << 20)
+
+typedef struct
+{
+    block_t *head;
+    unsigned count;
+} block_list_t;
+
+typedef struct
+{
+    block_list_t classes[BLOCK_POOL_CLASSES];
+    uint64_t hits;
+    uint64_t misses;
+    int64_t bytes; /**< bytes held in this cache */
+    int64_t bytes_published; /**< part of bytes accounted in the stats */
+} block_cache_t;
+
+static struct
+{
+    vlc_mutex_t lock;
+    block_list_t classes[BLOCK_POOL_CLASSES];
+    vlc_threadvar_t key;
+    bool key_ready;
+
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+    atomic_int_fast64_t retained;
+} block_depot = { .lock = VLC_STATIC_MUTEX, };
+
+/** Sentinel for threads whose cache was already torn down. */
+static block_cache_t block_cache_dead;
+static thread_local block_cache_t *block_cache;
+
+static inline size_t block_class_size (unsigned idx)
+{
+    return (size_t)1 << (idx + BLOCK_POOL_MIN_SHIFT);
+}
+
+static inline unsigned block_class_depth (unsigned idx)
+{
+    size_t n = BLOCK_CACHE_BYTES / block_class_size (idx);
+    return (n < 4) ? 4 : n;
+}
+
+/** Returns the size class index for a total allocation size,
+ * or -1 if the allocation is not pooled. */
+static inline int block_class_index (size_t alloc)
+{
+    if (alloc > block_class_size (BLOCK_POOL_CLASSES - 1))
+        return -1;
+    if (alloc <= block_class_size (0))
+        return 0;
+
+    unsigned shift = (sizeof (unsigned) * 8) - clz ((unsigned)alloc - 1);
+    return shift - BLOCK_POOL_MIN_SHIFT;
+}
+
+static void block_cache_Publish (block_cache_t *cache)
+{
+    atomic_fetch_add_explicit (&block_depot.hits, cache->hits,
+                               memory_order_relaxed);
+    atomic_fetch_add_explicit (&block_depot.misses, cache->misses,
+                               memory_order_relaxed);
+    atomic_fetch_add_explicit (&block_depot.retained,
+                               cache->bytes - cache->bytes_published,
+                               memory_order_relaxed);
+    cache->hits = cache->misses = 0;
+    cache->bytes_published = cache->bytes;
+}
+
+/** Moves up to count blocks from one list to another. */
+static unsigned block_list_Move (block_list_t *dst, block_list_t *src,
+                                 unsigned count)
+{
+    unsigned moved = 0;
+
+    while (moved < count && src->head != NULL)
+    {
+        block_t *b = src->head;
+
+        src->head = b->p_next;
+        b->p_next = dst->head;
+        dst->head = b;
+        moved++;
+    }
+    src->count -= moved;
+    dst->count += moved;
+    return moved;
+}
+
+static void block_list_Free (block_list_t *list)
+{
+    for (block_t *b = list->head, *next; b != NULL; b = next)
+    {
+        next = b->p_next;
+        free (b);
+    }
+    list->head = NULL;
+    list->count = 0;
+}
+
+static void block_cache_Destroy (void *data)
+{
+    block_cache_t *cache = data;
+    block_list_t surplus[BLOCK_POOL_CLASSES];
+
+    block_cache = &block_cache_dead;
+
+    vlc_mutex_lock (&block_depot.lock);
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+    {
+        block_list_t *depot = &block_depot.classes[i];
+        size_t room = BLOCK_DEPOT_BYTES / block_class_size (i);
+
+        room = (depot->count < room) ? room - depot->count : 0;
+        cache->bytes -= block_list_Move (depot, &cache->classes[i], room)
+                        * block_class_size (i);
+        surplus[i] = cache->classes[i];
+        cache->bytes -= surplus[i].count * block_class_size (i);
+    }
+    vlc_mutex_unlock (&block_depot.lock);
+
+    block_cache_Publish (cache);
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+        block_list_Free (&surplus[i]);
+    free (cache);
+}
+
+static block_cache_t *block_cache_Get (void)
+{
+    block_cache_t *cache = block_cache;
+
+    if (likely(cache != NULL))
+        return (cache != &block_cache_dead) ? cache : NULL;
+
+    /* The thread variable only serves to flush the cache at thread exit. */
+    vlc_mutex_lock (&block_depot.lock);
+    if (!block_depot.key_ready)
+        block_depot.key_ready =
+            !vlc_threadvar_create (&block_depot.key, block_cache_Destroy);
+    vlc_mutex_unlock (&block_depot.lock);
+
+    if (!block_depot.key_ready)
+        return NULL;
+
+    cache = calloc (1, sizeof (*cache));
+    if (unlikely(cache == NULL))
+        return NULL;
+    if (vlc_threadvar_set (block_depot.key, cache))
+    {
+        free (cache);
+        return NULL;
+    }
+    block_cache = cache;
+    return cache;
+}
+
+static void block_pool_Release (block_t *block)
+{
+    assert (block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate (block);
+
+    int idx = block_class_index (sizeof (*block) + block->i_size);
+    assert (idx >= 0);
+    assert (block_class_size (idx) == sizeof (*block) + block->i_size);
+
+    block_cache_t *cache = block_cache_Get ();
+    if (cache == NULL)
+    {
+        free (block);
+        return;
+    }
+
+    block_list_t *list = &cache->classes[idx];
+    const unsigned depth = block_class_depth (idx);
+
+    block->p_next = list->head;
+    list->head = block;
+    list->count++;
+    cache->bytes += block_class_size (idx);
+
+    if (list->count <= depth)
+        return;
+
+    /* Cache overflow: hand half of it over to the depot. */
+    block_list_t surplus = { NULL, 0 };
+
+    block_list_Move (&surplus, list, depth / 2);
+
+    vlc_mutex_lock (&block_depot.lock);
+    block_list_t *depot = &block_depot.classes[idx];
+    size_t room = BLOCK_DEPOT_BYTES / block_class_size (idx);
+
+    room = (depot->count < room) ? room - depot->count : 0;
+    block_list_Move (depot, &surplus, room);
+    vlc_mutex_unlock (&block_depot.lock);
+
+    cache->bytes -= surplus.count * block_class_size (idx);
+    block_list_Free (&surplus);
+    block_cache_Publish (cache);
+}
+
+static block_t *block_pool_Alloc (unsigned idx)
+{
+    block_cache_t *cache = block_cache_Get ();
+    block_t *b = NULL;
+
+    if (likely(cache != NULL))
+    {
+        block_list_t *list = &cache->classes[idx];
+
+        if (list->head == NULL)
+        {   /* Cache underflow: refill half of it from the depot. */
+            vlc_mutex_lock (&block_depot.lock);
+            cache->bytes += block_list_Move (list, &block_depot.classes[idx],
+                                             block_class_depth (idx) / 2)
+                            * block_class_size (idx);
+            vlc_mutex_unlock (&block_depot.lock);
+            block_cache_Publish (cache);
+        }
+
+        b = list->head;
+        if (b != NULL)
+        {
+            list->head = b->p_next;
+            list->count--;
+            cache->bytes -= block_class_size (idx);
+            cache->hits++;
+        }
+        else
+            cache->misses++;
+    }
+
+    if (b == NULL)
+        b = malloc (block_class_size (idx));
+    return b;
+}
+
+void block_PoolGetStats (uint64_t *restrict hits, uint64_t *restrict misses,
+                         int64_t *restrict retained)
+{
+    *hits = atomic_load_explicit (&block_depot.hits, memory_order_relaxed);
+    *misses = atomic_load_explicit (&block_depot.misses, memory_order_relaxed);
+    *retained = atomic_load_explicit (&block_depot.retained,
+                                      memory_order_relaxed);
+}
+
 static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 {
     out->p_next    = in->p_next;
@@ -120,12 +387,21 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 block_t *block_Alloc (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
+                 + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
+    int idx = block_class_index (alloc);
+    block_t *b;
+
+    if (idx >= 0)
+    {   /* The spare room of the size class is left for block_Realloc(). */
+        alloc = block_class_size (idx);
+        b = block_pool_Alloc (idx);
+    }
+    else
+        b = malloc (alloc);
     if (unlikely(b == NULL))
         return NULL;
 
@@ -135,7 +411,7 @@ block_t *block_Alloc (size_t size)
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = (idx >= 0) ? block_pool_Release : block_generic_Release;
     return b;
 }
 
@@ -30,6 +30,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "libvlc.h"
 
 /**
@@ -44,8 +45,51 @@ struct block_fifo_t
     block_t             **pp_last;
     size_t              i_depth;
     size_t              i_size;
+
+    /* Lock-less producers (see block_FifoNewLockless()) */
+    bool                b_lockless;
+    _Atomic(block_t *)  p_intake; /**< LIFO of blocks not dequeued yet */
+    atomic_uint         i_waiters; /**< consumers sleeping in vlc_fifo_Wait() */
 };
 
+/**
+ * Moves the blocks pushed by lock-less producers to the locked queue.
+ *
+ * Producers push blocks onto a lock-less stack (in reverse order), so the
+ * list is reversed here to restore the queuing order.
+ */
+static void vlc_fifo_Drain(vlc_fifo_t *fifo)
+{
+    vlc_assert_locked(&fifo->lock);
+
+    if (!fifo->b_lockless
+     || atomic_load_explicit(&fifo->p_intake, memory_order_relaxed) == NULL)
+        return;
+
+    block_t *block = atomic_exchange_explicit(&fifo->p_intake, NULL,
+                                              memory_order_acquire);
+    block_t *list = NULL;
+
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        block->p_next = list;
+        list = block;
+        block = next;
+    }
+
+    assert(*(fifo->pp_last) == NULL);
+    *(fifo->pp_last) = list;
+
+    for (block = list; block != NULL; block = block->p_next)
+    {
+        fifo->pp_last = &block->p_next;
+        fifo->i_depth++;
+        fifo->i_size += block->i_buffer;
+    }
+}
+
 void vlc_fifo_Lock(vlc_fifo_t *fifo)
 {
     vlc_mutex_lock(&fifo->lock);
@@ -61,34 +105,62 @@ void vlc_fifo_Signal(vlc_fifo_t *fifo)
     vlc_cond_signal(&fifo->wait);
 }
 
+static void vlc_fifo_WaitCleanup(void *data)
+{
+    vlc_fifo_t *fifo = data;
+
+    atomic_fetch_sub(&fifo->i_waiters, 1);
+}
+
 void vlc_fifo_Wait(vlc_fifo_t *fifo)
 {
-    vlc_fifo_WaitCond(fifo, &fifo->wait);
+    if (!fifo->b_lockless)
+    {
+        vlc_cond_wait(&fifo->wait, &fifo->lock);
+        return;
+    }
+
+    /* Lock-less producers only signal if they see a waiter. Conversely, the
+     * intake is checked after registering as a waiter, so that a block
+     * pushed concurrently is not missed. */
+    atomic_fetch_add(&fifo->i_waiters, 1);
+    vlc_cleanup_push(vlc_fifo_WaitCleanup, fifo);
+    if (atomic_load(&fifo->p_intake) == NULL)
+        vlc_cond_wait(&fifo->wait, &fifo->lock);
+    vlc_cleanup_pop();
+    vlc_fifo_WaitCleanup(fifo);
 }
 
+/* Lock-less producers cannot signal a condition they do not know of */
 void vlc_fifo_WaitCond(vlc_fifo_t *fifo, vlc_cond_t *condvar)
 {
+    assert(!fifo->b_lockless);
     vlc_cond_wait(condvar, &fifo->lock);
 }
 
 int vlc_fifo_TimedWaitCond(vlc_fifo_t *fifo, vlc_cond_t *condvar, mtime_t deadline)
 {
+    assert(!fifo->b_lockless);
     return vlc_cond_timedwait(condvar, &fifo->lock, deadline);
 }
 
 size_t vlc_fifo_GetCount(const vlc_fifo_t *fifo)
 {
+    /* The intake is logically part of the queue, hence the cast. */
+    vlc_fifo_Drain((vlc_fifo_t *)fifo);
     return fifo->i_depth;
 }
 
 size_t vlc_fifo_GetBytes(const vlc_fifo_t *fifo)
 {
+    vlc_fifo_Drain((vlc_fifo_t *)fifo);
     return fifo->i_size;
 }
 
 void vlc_fifo_QueueUnlocked(block_fifo_t *fifo, block_t *block)
 {
     vlc_assert_locked(&fifo->lock);
+    vlc_fifo_Drain(fifo);
     assert(*(fifo->pp_last) == NULL);
 
     *(fifo->pp_last) = block;
@@ -108,6 +180,7 @@ void vlc_fifo_QueueUnlocked(block_fifo_t *fifo, block_t *block)
 block_t *vlc_fifo_DequeueUnlocked(block_fifo_t *fifo)
 {
     vlc_assert_locked(&fifo->lock);
+    vlc_fifo_Drain(fifo);
 
     block_t *block = fifo->p_first;
 
@@ -130,6 +203,7 @@ block_t *vlc_fifo_DequeueUnlocked(block_fifo_t *fifo)
 block_t *vlc_fifo_DequeueAllUnlocked(block_fifo_t *fifo)
 {
     vlc_assert_locked(&fifo->lock);
+    vlc_fifo_Drain(fifo);
 
     block_t *block = fifo->p_first;
 
@@ -152,12 +226,24 @@ block_fifo_t *block_FifoNew( void )
     p_fifo->p_first = NULL;
     p_fifo->pp_last = &p_fifo->p_first;
     p_fifo->i_depth = p_fifo->i_size = 0;
+    p_fifo->b_lockless = false;
+    atomic_init( &p_fifo->p_intake, NULL );
+    atomic_init( &p_fifo->i_waiters, 0 );
 
     return p_fifo;
 }
 
+block_fifo_t *block_FifoNewLockless( void )
+{
+    block_fifo_t *p_fifo = block_FifoNew();
+    if( p_fifo != NULL )
+        p_fifo->b_lockless = true;
+    return p_fifo;
+}
+
 void block_FifoRelease( block_fifo_t *p_fifo )
 {
+    block_ChainRelease( atomic_load( &p_fifo->p_intake ) );
     block_ChainRelease( p_fifo->p_first );
     vlc_cond_destroy( &p_fifo->wait );
     vlc_mutex_destroy( &p_fifo->lock );
@@ -174,8 +260,51 @@ void block_FifoEmpty(block_fifo_t *fifo)
     block_ChainRelease(block);
 }
 
+/**
+ * Pushes a list of blocks without locking the FIFO.
+ *
+ * The list is reversed and pushed onto the intake stack at once, so that
+ * concurrent producers do not interleave. The FIFO lock is only taken to
+ * wake up a consumer sleeping in vlc_fifo_Wait().
+ */
+static void block_FifoPush(block_fifo_t *fifo, block_t *block)
+{
+    if (block == NULL)
+        return;
+
+    block_t *last = block, *list = NULL;
+
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        block->p_next = list;
+        list = block;
+        block = next;
+    }
+
+    block_t *head = atomic_load_explicit(&fifo->p_intake,
+                                         memory_order_relaxed);
+    do
+        last->p_next = head;
+    while (!atomic_compare_exchange_weak(&fifo->p_intake, &head, list));
+
+    if (atomic_load(&fifo->i_waiters) > 0)
+    {
+        vlc_fifo_Lock(fifo);
+        vlc_fifo_Signal(fifo);
+        vlc_fifo_Unlock(fifo);
+    }
+}
+
 void block_FifoPut(block_fifo_t *fifo, block_t *block)
 {
+    if (fifo->b_lockless)
+    {
+        block_FifoPush(fifo, block);
+        return;
+    }
+
     vlc_fifo_Lock(fifo);
     vlc_fifo_QueueUnlocked(fifo, block);
     vlc_fifo_Unlock(fifo);
@@ -205,6 +334,7 @@ block_t *block_FifoShow( block_fifo_t *p_fifo )
     block_t *b;
 
     vlc_mutex_lock( &p_fifo->lock );
+    vlc_fifo_Drain( p_fifo );
     assert(p_fifo->p_first != NULL);
     b = p_fifo->p_first;
     vlc_mutex_unlock( &p_fifo->lock );
@@ -218,6 +348,7 @@ size_t block_FifoSize (block_fifo_t *fifo)
     size_t size;
 
     vlc_mutex_lock (&fifo->lock);
+    vlc_fifo_Drain (fifo);
     size = fifo->i_size;
     vlc_mutex_unlock (&fifo->lock);
     return size;
@@ -229,6 +360,7 @@ size_t block_FifoCount (block_fifo_t *fifo)
     size_t depth;
 
     vlc_mutex_lock (&fifo->lock);
+    vlc_fifo_Drain (fifo);
     depth = fifo->i_depth;
     vlc_mutex_unlock (&fifo->lock);
     return depth;
@@ -180,6 +180,21 @@ void filter_DeleteBlend( filter_t *p_blend )
     vlc_object_release( p_blend );
 }
 
+unsigned filter_GetSliceCount( filter_t *p_filter )
+{
+    vlc_slices_t *slices = vlc_slices_Get( p_filter->obj.libvlc );
+
+    return (slices != NULL) ? vlc_slices_Count( slices ) : 1;
+}
+
+void filter_ExecuteSlices( filter_t *p_filter,
+                           void (*func)( void *, unsigned, unsigned ),
+                           void *data, unsigned count )
+{
+    vlc_slices_Execute( vlc_slices_Get( p_filter->obj.libvlc ),
+                        func, data, count );
+}
+
 /* */
 #include <vlc_video_splitter.h>
 
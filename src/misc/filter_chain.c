@@ -28,6 +28,7 @@
 #include <vlc_filter.h>
 #include <vlc_modules.h>
 #include <vlc_mouse.h>
+#include <vlc_picture_pool.h>
 #include <vlc_spu.h>
 #include <libvlc.h>
 #include <assert.h>
@@ -48,6 +49,19 @@ static inline chained_filter_t *chained(filter_t *filter)
     return container_of(filter, chained_filter_t, filter);
 }
 
+/* Pictures of the intermediate filters are taken from pools shared by all
+ * the filters with the same output format, rather than allocated for every
+ * picture. The pools are created on first use, sized after the number of
+ * filters using them, and dropped whenever the chain changes. */
+#define CHAIN_POOL_PICTURES 3 /* pictures per filter */
+
+typedef struct chain_pool_t
+{
+    struct chain_pool_t *next;
+    video_format_t fmt;
+    picture_pool_t *pool;
+} chain_pool_t;
+
 /* */
 struct filter_chain_t
 {
@@ -61,12 +75,15 @@ struct filter_chain_t
     bool b_allow_fmt_out_change; /**< Can the output format be changed? */
     const char *filter_cap; /**< Filter modules capability */
     const char *conv_cap; /**< Converter modules capability */
+    chain_pool_t *pools; /**< Intermediate pictures pools */
+    unsigned heap_pictures; /**< Intermediate pictures out of the pools */
 };
 
 /**
  * Local prototypes
  */
 static void FilterDeletePictures( picture_t * );
+static void FilterChainDropPools( filter_chain_t * );
 
 static filter_chain_t *filter_chain_NewInner( const filter_owner_t *callbacks,
     const char *cap, const char *conv_cap, bool fmt_out_change,
@@ -89,6 +106,8 @@ static filter_chain_t *filter_chain_NewInner( const filter_owner_t *callbacks,
     chain->b_allow_fmt_out_change = fmt_out_change;
     chain->filter_cap = cap;
     chain->conv_cap = conv_cap;
+    chain->pools = NULL;
+    chain->heap_pictures = 0;
     return chain;
 }
 
@@ -106,14 +125,73 @@ filter_chain_t *filter_chain_New( vlc_object_t *obj, const char *cap,
     return filter_chain_NewInner( &callbacks, cap, NULL, false, NULL, cat );
 }
 
+static bool FilterChainPoolMatch( const video_format_t *a,
+                                  const video_format_t *b )
+{
+    return a->i_chroma == b->i_chroma
+        && a->i_width == b->i_width && a->i_height == b->i_height
+        && a->i_x_offset == b->i_x_offset && a->i_y_offset == b->i_y_offset
+        && a->i_visible_width == b->i_visible_width
+        && a->i_visible_height == b->i_visible_height;
+}
+
+static picture_pool_t *FilterChainGetPool( filter_chain_t *chain,
+                                           const video_format_t *fmt )
+{
+    chain_pool_t *p;
+
+    for( p = chain->pools; p != NULL; p = p->next )
+        if( FilterChainPoolMatch( &p->fmt, fmt ) )
+            return p->pool;
+
+    /* Not for the last filter, whose pictures come from the owner */
+    unsigned count = 0;
+    for( chained_filter_t *f = chain->first; f != chain->last; f = f->next )
+        if( FilterChainPoolMatch( &f->filter.fmt_out.video, fmt )
+         && count + CHAIN_POOL_PICTURES <= 64 /* pool size limit */ )
+            count += CHAIN_POOL_PICTURES;
+
+    p = malloc( sizeof (*p) );
+    if( unlikely(p == NULL) )
+        return NULL;
+
+    p->fmt = *fmt;
+    p->fmt.p_palette = NULL;
+    p->pool = picture_pool_NewFromFormat( fmt, count );
+    p->next = chain->pools;
+    chain->pools = p;
+    return p->pool;
+}
+
 /** Chained filter picture allocator function */
 static picture_t *filter_chain_VideoBufferNew( filter_t *filter )
 {
     if( chained(filter)->next != NULL )
     {
-        picture_t *pic = picture_NewFromFormat( &filter->fmt_out.video );
+        filter_chain_t *chain = filter->owner.sys;
+        const video_format_t *fmt = &filter->fmt_out.video;
+        picture_t *pic = NULL;
+
+        /* Palettes are owned by the formats: do not share them */
+        if( fmt->p_palette == NULL )
+        {
+            picture_pool_t *pool = FilterChainGetPool( chain, fmt );
+            if( pool != NULL )
+                pic = picture_pool_Get( pool );
+            if( pic != NULL )
+            {
+                picture_Reset( pic );
+                pic->format = *fmt;
+                return pic;
+            }
+        }
+
+        /* All the pooled pictures are still held downstream */
+        pic = picture_NewFromFormat( fmt );
         if( pic == NULL )
             msg_Err( filter, "Failed to allocate picture" );
+        else
+            chain->heap_pictures++;
         return pic;
     }
     else
@@ -151,6 +229,11 @@ void filter_chain_Delete( filter_chain_t *p_chain )
     while( p_chain->first != NULL )
         filter_chain_DeleteFilter( p_chain, &p_chain->first->filter );
 
+    FilterChainDropPools( p_chain );
+    if( p_chain->heap_pictures > 0 )
+        msg_Dbg( (vlc_object_t *)p_chain->callbacks.sys,
+                 "%u intermediate pictures allocated out of the pools",
+                 p_chain->heap_pictures );
     es_format_Clean( &p_chain->fmt_in );
     es_format_Clean( &p_chain->fmt_out );
 
@@ -241,6 +324,7 @@ static filter_t *filter_chain_AppendInner( filter_chain_t *chain,
     chained->prev = chain->last;
     chain->last = chained;
     chained->next = NULL;
+    FilterChainDropPools( chain );
 
     vlc_mouse_t *mouse = malloc( sizeof(*mouse) );
     if( likely(mouse != NULL) )
@@ -302,6 +386,7 @@ void filter_chain_DeleteFilter( filter_chain_t *chain, filter_t *filter )
     }
 
     module_unneed( filter, filter->p_module );
+    FilterChainDropPools( chain );
 
     msg_Dbg( obj, "Filter %p removed from chain", (void *)filter );
     FilterDeletePictures( chained->pending );
@@ -527,3 +612,17 @@ static void FilterDeletePictures( picture_t *picture )
         picture = next;
     }
 }
+
+/* Pictures still held are only returned to the pools once released */
+static void FilterChainDropPools( filter_chain_t *chain )
+{
+    while( chain->pools != NULL )
+    {
+        chain_pool_t *p = chain->pools;
+
+        chain->pools = p->next;
+        if( p->pool != NULL )
+            picture_pool_Release( p->pool );
+        free( p );
+    }
+}
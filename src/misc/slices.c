@@ -0,0 +1,253 @@
+/*****************************************************************************
+ * slices.c: slice threads for video filters
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include "libvlc.h"
+
+/*
+ * The slice threads are created on first use and shared by all the filters
+ * of a LibVLC instance. Every call to vlc_slices_Execute() queues a job.
+ * Idle threads pick slices from the oldest queued job, while the submitting
+ * thread processes slices of its own job, then waits for the slices handed
+ * out to other threads to complete. Jobs therefore always make progress,
+ * even if all slice threads are busy with other filters.
+ */
+
+#define VLC_SLICES_MAX 64 /* maximum thread count, including the caller */
+
+struct vlc_slices_job
+{
+    void (*func)(void *, unsigned, unsigned);
+    void *data;
+    unsigned count; /**< Number of slices */
+    unsigned next; /**< Next slice to hand out */
+    unsigned pending; /**< Number of uncompleted slices */
+    struct vlc_slices_job *next_job;
+};
+
+struct vlc_slices
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait; /**< Signaled when a job is queued or on exit */
+    vlc_cond_t done; /**< Signaled when a job completes */
+    struct vlc_slices_job *first, **lastp;
+    bool exiting;
+    unsigned threads;
+    vlc_thread_t thread[];
+};
+
+static vlc_mutex_t slices_lock = VLC_STATIC_MUTEX;
+
+/**
+ * Removes a job from the queue once its last slice has been handed out.
+ */
+static void vlc_slices_Dequeue(vlc_slices_t *slices,
+                               struct vlc_slices_job *job)
+{
+    struct vlc_slices_job **pp = &slices->first;
+
+    while (*pp != job)
+        pp = &(*pp)->next_job;
+
+    *pp = job->next_job;
+    if (slices->lastp == &job->next_job)
+        slices->lastp = pp;
+}
+
+/**
+ * Processes the next slice of a job.
+ * This function is called and returns with the lock held.
+ */
+static void vlc_slices_Run(vlc_slices_t *slices, struct vlc_slices_job *job)
+{
+    unsigned index = job->next++;
+
+    assert(index < job->count);
+    if (job->next == job->count)
+        vlc_slices_Dequeue(slices, job);
+    vlc_mutex_unlock(&slices->lock);
+
+    job->func(job->data, index, job->count);
+
+    vlc_mutex_lock(&slices->lock);
+    assert(job->pending > 0);
+    if (--job->pending == 0)
+        vlc_cond_broadcast(&slices->done);
+}
+
+static void *vlc_slices_Thread(void *data)
+{
+    vlc_slices_t *slices = data;
+
+    vlc_mutex_lock(&slices->lock);
+    for (;;)
+    {
+        struct vlc_slices_job *job = slices->first;
+
+        if (job != NULL)
+            vlc_slices_Run(slices, job);
+        else if (!slices->exiting)
+            vlc_cond_wait(&slices->wait, &slices->lock);
+        else
+            break;
+    }
+    vlc_mutex_unlock(&slices->lock);
+    return NULL;
+}
+
+static vlc_slices_t *vlc_slices_Create(libvlc_int_t *libvlc)
+{
+    int64_t count = var_InheritInteger(libvlc, "filter-threads");
+
+    if (count <= 0)
+        count = vlc_GetCPUCount();
+    if (count > VLC_SLICES_MAX)
+        count = VLC_SLICES_MAX;
+
+    /* The calling thread always processes slices as well */
+    unsigned threads = (count > 1) ? count - 1 : 0;
+    vlc_slices_t *slices = malloc(sizeof (*slices)
+                                  + threads * sizeof (slices->thread[0]));
+    if (unlikely(slices == NULL))
+        return NULL;
+
+    vlc_mutex_init(&slices->lock);
+    vlc_cond_init(&slices->wait);
+    vlc_cond_init(&slices->done);
+    slices->first = NULL;
+    slices->lastp = &slices->first;
+    slices->exiting = false;
+
+    for (slices->threads = 0; slices->threads < threads; slices->threads++)
+        if (vlc_clone(&slices->thread[slices->threads], vlc_slices_Thread,
+                      slices, VLC_THREAD_PRIORITY_VIDEO))
+            break;
+
+    msg_Dbg(libvlc, "using %u video filter slice thread(s)",
+            slices->threads + 1);
+    return slices;
+}
+
+/**
+ * Gets the slice threads of a LibVLC instance, creating them if needed.
+ *
+ * \return the slice threads, or NULL on memory error
+ */
+vlc_slices_t *vlc_slices_Get(libvlc_int_t *libvlc)
+{
+    libvlc_priv_t *priv = libvlc_priv(libvlc);
+    vlc_slices_t *slices;
+
+    vlc_mutex_lock(&slices_lock);
+    slices = priv->slices;
+    if (slices == NULL)
+        slices = priv->slices = vlc_slices_Create(libvlc);
+    vlc_mutex_unlock(&slices_lock);
+    return slices;
+}
+
+/**
+ * Gets the number of slices that can be processed concurrently.
+ */
+unsigned vlc_slices_Count(const vlc_slices_t *slices)
+{
+    return slices->threads + 1;
+}
+
+/**
+ * Processes slices, then waits for their completion.
+ */
+void vlc_slices_Execute(vlc_slices_t *slices,
+                        void (*func)(void *, unsigned, unsigned),
+                        void *data, unsigned count)
+{
+    if (slices == NULL || slices->threads == 0 || count <= 1)
+    {
+        for (unsigned i = 0; i < count; i++)
+            func(data, i, count);
+        return;
+    }
+
+    struct vlc_slices_job job = {
+        .func = func,
+        .data = data,
+        .count = count,
+        .next = 0,
+        .pending = count,
+        .next_job = NULL,
+    };
+
+    /* The job lives on this stack: do not let cancellation unwind it while
+     * other threads may still be processing its slices. */
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock(&slices->lock);
+    *slices->lastp = &job;
+    slices->lastp = &job.next_job;
+    if (count - 1 < slices->threads)
+        for (unsigned i = 0; i < count - 1; i++)
+            vlc_cond_signal(&slices->wait);
+    else
+        vlc_cond_broadcast(&slices->wait);
+
+    while (job.next < job.count)
+        vlc_slices_Run(slices, &job);
+    while (job.pending > 0)
+        vlc_cond_wait(&slices->done, &slices->lock);
+    vlc_mutex_unlock(&slices->lock);
+
+    vlc_restorecancel(canc);
+}
+
+/**
+ * Stops and destroys the slice threads of a LibVLC instance, if any.
+ */
+void vlc_slices_Destroy(libvlc_int_t *libvlc)
+{
+    libvlc_priv_t *priv = libvlc_priv(libvlc);
+    vlc_slices_t *slices = priv->slices;
+
+    if (slices == NULL)
+        return;
+
+    priv->slices = NULL;
+
+    vlc_mutex_lock(&slices->lock);
+    assert(slices->first == NULL);
+    slices->exiting = true;
+    vlc_cond_broadcast(&slices->wait);
+    vlc_mutex_unlock(&slices->lock);
+
+    for (unsigned i = 0; i < slices->threads; i++)
+        vlc_join(slices->thread[i], NULL);
+
+    vlc_cond_destroy(&slices->done);
+    vlc_cond_destroy(&slices->wait);
+    vlc_mutex_destroy(&slices->lock);
+    free(slices);
+}
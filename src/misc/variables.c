@@ -28,9 +28,6 @@
 # include "config.h"
 #endif
 
-#ifdef HAVE_SEARCH_H
-# include <search.h>
-#endif
 #include <assert.h>
 #include <float.h>
 #include <math.h>
@@ -73,10 +70,14 @@ typedef struct callback_table_t
  */
 struct variable_t
 {
-    char *       psz_name; /**< The variable unique name (must be first) */
+    char *       psz_name; /**< The variable unique name */
+    uint32_t     i_hash;   /**< Hash of the name */
+    variable_t  *p_next;   /**< Next variable in the same hash bucket */
 
     /** The variable's exported value */
     vlc_value_t  val;
+    /** Copy of the value for lock-less readers (non-string types only) */
+    atomic_uint_least64_t snapshot;
 
     /** The variable display name, mainly for use by the interfaces */
     char *       psz_text;
@@ -141,23 +142,127 @@ int_ops    = { CmpInt,     DupDummy,  FreeDummy,  },
 string_ops = { CmpString,  DupString, FreeString, },
 coords_ops = { NULL,       DupDummy,  FreeDummy,  };
 
-static int varcmp( const void *a, const void *b )
+/**
+ * Per-object variables are kept in a chained hash table, indexed by the
+ * FNV-1a hash of their name. The table doubles when the load factor exceeds
+ * one, and is only ever accessed with the object variable lock held.
+ */
+#define VAR_TABLE_MIN_SIZE 16
+
+static uint32_t HashName( const char *psz_name )
 {
-    const variable_t *va = a, *vb = b;
+    uint32_t h = 2166136261u;
 
-    /* psz_name must be first */
-    assert( va == (const void *)&va->psz_name );
-    return strcmp( va->psz_name, vb->psz_name );
+    for( const unsigned char *p = (const unsigned char *)psz_name; *p; p++ )
+        h = (h ^ *p) * 16777619u;
+    return h;
+}
+
+static variable_t *TableFind( vlc_object_internals_t *priv,
+                              const char *psz_name, uint32_t i_hash )
+{
+    if( priv->var_table.i_size == 0 )
+        return NULL;
+
+    variable_t *var = priv->var_table.pp_buckets[i_hash & (priv->var_table.i_size - 1)];
+    while( var != NULL
+        && (var->i_hash != i_hash || strcmp( var->psz_name, psz_name )) )
+        var = var->p_next;
+    return var;
+}
+
+static int TableInsert( vlc_object_internals_t *priv, variable_t *var )
+{
+    unsigned i_size = priv->var_table.i_size;
+
+    if( priv->var_table.i_count >= i_size )
+    {
+        unsigned i_new_size = i_size ? 2 * i_size : VAR_TABLE_MIN_SIZE;
+        variable_t **pp_buckets = calloc( i_new_size, sizeof(*pp_buckets) );
+
+        if( pp_buckets != NULL )
+        {
+            for( unsigned i = 0; i < i_size; i++ )
+                for( variable_t *p = priv->var_table.pp_buckets[i], *next;
+                     p != NULL; p = next )
+                {
+                    next = p->p_next;
+                    p->p_next = pp_buckets[p->i_hash & (i_new_size - 1)];
+                    pp_buckets[p->i_hash & (i_new_size - 1)] = p;
+                }
+
+            free( priv->var_table.pp_buckets );
+            priv->var_table.pp_buckets = pp_buckets;
+            priv->var_table.i_size = i_size = i_new_size;
+        }
+        else if( i_size == 0 )
+            return VLC_ENOMEM;
+        /* else keep going with an overloaded table */
+    }
+
+    variable_t **pp_head = &priv->var_table.pp_buckets[var->i_hash & (i_size - 1)];
+    var->p_next = *pp_head;
+    *pp_head = var;
+    priv->var_table.i_count++;
+    return VLC_SUCCESS;
+}
+
+static void TableRemove( vlc_object_internals_t *priv, variable_t *var )
+{
+    variable_t **pp = &priv->var_table.pp_buckets[var->i_hash & (priv->var_table.i_size - 1)];
+
+    while( *pp != var )
+        pp = &(*pp)->p_next;
+    *pp = var->p_next;
+    priv->var_table.i_count--;
+}
+
+/**
+ * Collects all variables of an object, sorted by name.
+ * The variable lock must be held. The array must be freed by the caller.
+ */
+static int CmpVarName( const void *a, const void *b )
+{
+    const variable_t *const *va = a, *const *vb = b;
+
+    return strcmp( (*va)->psz_name, (*vb)->psz_name );
+}
+
+static variable_t **TableSorted( vlc_object_internals_t *priv )
+{
+    variable_t **pp_vars = malloc( priv->var_table.i_count * sizeof(*pp_vars) );
+    if( pp_vars == NULL )
+        return NULL;
+
+    size_t n = 0;
+    for( unsigned i = 0; i < priv->var_table.i_size; i++ )
+        for( variable_t *var = priv->var_table.pp_buckets[i]; var; var = var->p_next )
+            pp_vars[n++] = var;
+    assert( n == priv->var_table.i_count );
+
+    qsort( pp_vars, n, sizeof(*pp_vars), CmpVarName );
+    return pp_vars;
 }
 
 static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
-    variable_t **pp_var;
 
     vlc_mutex_lock(&priv->var_lock);
-    pp_var = tfind( &psz_name, &priv->var_root, varcmp );
-    return (pp_var != NULL) ? *pp_var : NULL;
+    return TableFind( priv, psz_name, HashName( psz_name ) );
+}
+
+/**
+ * Updates the lock-less copy of the value after it has changed.
+ * The variable lock must be held.
+ */
+static void PublishValue( variable_t *var )
+{
+    uint_least64_t raw = 0;
+
+    static_assert( sizeof (var->val) <= sizeof (raw), "Value too large" );
+    memcpy( &raw, &var->val, sizeof (var->val) );
+    atomic_store_explicit( &var->snapshot, raw, memory_order_release );
 }
 
 static void Destroy( variable_t *p_var )
@@ -304,6 +409,7 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
         return VLC_ENOMEM;
 
     p_var->psz_name = strdup( psz_name );
+    p_var->i_hash = HashName( psz_name );
     p_var->psz_text = NULL;
 
     p_var->i_type = i_type & ~VLC_VAR_DOINHERIT;
@@ -360,18 +466,22 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
 
     if (i_type & VLC_VAR_DOINHERIT)
         var_Inherit(p_this, psz_name, i_type, &p_var->val);
+    atomic_init( &p_var->snapshot, 0 );
+    PublishValue( p_var );
 
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
-    variable_t **pp_var, *p_oldvar;
+    variable_t *p_oldvar;
     int ret = VLC_SUCCESS;
 
     vlc_mutex_lock( &p_priv->var_lock );
 
-    pp_var = tsearch( p_var, &p_priv->var_root, varcmp );
-    if( unlikely(pp_var == NULL) )
-        ret = VLC_ENOMEM;
-    else if( (p_oldvar = *pp_var) == p_var ) /* Variable create */
-        p_var = NULL; /* Variable created */
+    p_oldvar = TableFind( p_priv, psz_name, p_var->i_hash );
+    if( p_oldvar == NULL ) /* Variable create */
+    {
+        ret = TableInsert( p_priv, p_var );
+        if( ret == VLC_SUCCESS )
+            p_var = NULL; /* Variable created */
+    }
     else /* Variable already exists */
     {
         assert (((i_type ^ p_oldvar->i_type) & VLC_VAR_CLASS) == 0);
@@ -410,7 +520,7 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
     else if( --p_var->i_usage == 0 )
     {
         assert(!p_var->b_incallback);
-        tdelete( p_var, &p_priv->var_root, varcmp );
+        TableRemove( p_priv, p_var );
     }
     else
     {
@@ -423,17 +533,22 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
         Destroy( p_var );
 }
 
-static void CleanupVar( void *var )
-{
-    Destroy( var );
-}
-
 void var_DestroyAll( vlc_object_t *obj )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
 
-    tdestroy( priv->var_root, CleanupVar );
-    priv->var_root = NULL;
+    for( unsigned i = 0; i < priv->var_table.i_size; i++ )
+        for( variable_t *var = priv->var_table.pp_buckets[i], *next;
+             var != NULL; var = next )
+        {
+            next = var->p_next;
+            Destroy( var );
+        }
+
+    free( priv->var_table.pp_buckets );
+    priv->var_table.pp_buckets = NULL;
+    priv->var_table.i_size = 0;
+    priv->var_table.i_count = 0;
 }
 
 #undef var_Change
@@ -482,6 +597,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             assert(p_var->ops->pf_free == FreeDummy);
             p_var->step = *p_val;
             CheckValue( p_var, &p_var->val );
+            PublishValue( p_var );
             break;
         case VLC_VAR_GETSTEP:
             switch (p_var->i_type & VLC_VAR_TYPE)
@@ -569,6 +685,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             CheckValue( p_var, &newval );
             /* Set the variable */
             p_var->val = newval;
+            PublishValue( p_var );
             /* Free data if needed */
             p_var->ops->pf_free( &oldval );
             break;
@@ -680,6 +797,7 @@ int var_GetAndSet( vlc_object_t *p_this, const char *psz_name, int i_action,
 
     /*  Check boundaries */
     CheckValue( p_var, &p_var->val );
+    PublishValue( p_var );
     *p_val = p_var->val;
 
     /* Deal with callbacks.*/
@@ -718,26 +836,14 @@ int var_Type( vlc_object_t *p_this, const char *psz_name )
     return i_type;
 }
 
-#undef var_SetChecked
-int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
-                    int expected_type, vlc_value_t val )
+/**
+ * Sets the value of a variable and triggers its callbacks.
+ * The variable lock must be held.
+ */
+static void SetValue( vlc_object_t *p_this, variable_t *p_var, vlc_value_t val )
 {
-    variable_t *p_var;
     vlc_value_t oldval;
 
-    assert( p_this );
-
-    vlc_object_internals_t *p_priv = vlc_internals( p_this );
-
-    p_var = Lookup( p_this, psz_name );
-    if( p_var == NULL )
-    {
-        vlc_mutex_unlock( &p_priv->var_lock );
-        return VLC_ENOVAR;
-    }
-
-    assert( expected_type == 0 ||
-            (p_var->i_type & VLC_VAR_CLASS) == expected_type );
     assert ((p_var->i_type & VLC_VAR_CLASS) != VLC_VAR_VOID);
 
     WaitUnused( p_this, p_var );
@@ -753,12 +859,36 @@ int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
 
     /* Set the variable */
     p_var->val = val;
+    PublishValue( p_var );
 
     /* Deal with callbacks */
-    TriggerCallback( p_this, p_var, psz_name, oldval );
+    TriggerCallback( p_this, p_var, p_var->psz_name, oldval );
 
     /* Free data if needed */
     p_var->ops->pf_free( &oldval );
+}
+
+#undef var_SetChecked
+int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
+                    int expected_type, vlc_value_t val )
+{
+    variable_t *p_var;
+
+    assert( p_this );
+
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    p_var = Lookup( p_this, psz_name );
+    if( p_var == NULL )
+    {
+        vlc_mutex_unlock( &p_priv->var_lock );
+        return VLC_ENOVAR;
+    }
+
+    assert( expected_type == 0 ||
+            (p_var->i_type & VLC_VAR_CLASS) == expected_type );
+
+    SetValue( p_this, p_var, val );
 
     vlc_mutex_unlock( &p_priv->var_lock );
     return VLC_SUCCESS;
@@ -821,6 +951,80 @@ int var_Get( vlc_object_t *p_this, const char *psz_name, vlc_value_t *p_val )
     return var_GetChecked( p_this, psz_name, 0, p_val );
 }
 
+static inline variable_t *var_FromHandle( vlc_var_handle_t *handle )
+{
+    return (variable_t *)handle;
+}
+
+#undef var_Lookup
+vlc_var_handle_t *var_Lookup( vlc_object_t *p_this, const char *psz_name )
+{
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+    variable_t *p_var = Lookup( p_this, psz_name );
+
+    if( p_var != NULL )
+    {
+        assert ((p_var->i_type & VLC_VAR_CLASS) != VLC_VAR_VOID);
+        p_var->i_usage++;
+    }
+    vlc_mutex_unlock( &p_priv->var_lock );
+    return (vlc_var_handle_t *)p_var;
+}
+
+#undef var_HandleRelease
+void var_HandleRelease( vlc_object_t *p_this, vlc_var_handle_t *handle )
+{
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+    variable_t *p_var = var_FromHandle( handle );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    assert( p_var->i_usage > 0 );
+    if( --p_var->i_usage == 0 )
+    {
+        assert(!p_var->b_incallback);
+        TableRemove( p_priv, p_var );
+    }
+    else
+        p_var = NULL;
+    vlc_mutex_unlock( &p_priv->var_lock );
+
+    if( p_var != NULL )
+        Destroy( p_var );
+}
+
+#undef var_HandleGet
+void var_HandleGet( vlc_object_t *p_this, vlc_var_handle_t *handle,
+                    vlc_value_t *p_val )
+{
+    variable_t *p_var = var_FromHandle( handle );
+
+    if( p_var->ops->pf_dup == DupDummy )
+    {   /* No ownership to deal with: use the lock-less copy */
+        uint_least64_t raw = atomic_load_explicit( &p_var->snapshot,
+                                                   memory_order_acquire );
+        memcpy( p_val, &raw, sizeof (*p_val) );
+        return;
+    }
+
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    *p_val = p_var->val;
+    p_var->ops->pf_dup( p_val );
+    vlc_mutex_unlock( &p_priv->var_lock );
+}
+
+#undef var_HandleSet
+void var_HandleSet( vlc_object_t *p_this, vlc_var_handle_t *handle,
+                    vlc_value_t val )
+{
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    SetValue( p_this, var_FromHandle( handle ), val );
+    vlc_mutex_unlock( &p_priv->var_lock );
+}
+
 typedef enum
 {
     vlc_value_callback,
@@ -1309,13 +1513,8 @@ void var_FreeList( vlc_value_t *p_val, vlc_value_t *p_val2 )
     }
 }
 
-static void DumpVariable(const void *data, const VISIT which, const int depth)
+static void DumpVariable(const variable_t *var)
 {
-    if (which != postorder && which != leaf)
-        return;
-    (void) depth;
-
-    const variable_t *var = *(const variable_t **)data;
     const char *typename = "unknown";
 
     switch (var->i_type & VLC_VAR_TYPE)
@@ -1370,27 +1569,22 @@ static void DumpVariable(const void *data, const VISIT which, const int depth)
 
 void DumpVariables(vlc_object_t *obj)
 {
-    vlc_mutex_lock(&vlc_internals(obj)->var_lock);
-    if (vlc_internals(obj)->var_root == NULL)
+    vlc_object_internals_t *priv = vlc_internals(obj);
+
+    vlc_mutex_lock(&priv->var_lock);
+    if (priv->var_table.i_count == 0)
         puts(" `-o No variables");
     else
-        twalk(vlc_internals(obj)->var_root, DumpVariable);
-    vlc_mutex_unlock(&vlc_internals(obj)->var_lock);
-}
-
-static thread_local void *twalk_ctx;
-
-static void TwalkGetNames(const void *data, const VISIT which, const int depth)
-{
-    if (which != postorder && which != leaf)
-        return;
-    (void) depth;
-
-    const variable_t *var = *(const variable_t **)data;
-    DECL_ARRAY(char *) *names = twalk_ctx;
-    char *dup = strdup(var->psz_name);
-    if (dup != NULL)
-        ARRAY_APPEND(*names, dup);
+    {
+        variable_t **vars = TableSorted(priv);
+        if (vars != NULL)
+        {
+            for (size_t i = 0; i < priv->var_table.i_count; i++)
+                DumpVariable(vars[i]);
+            free(vars);
+        }
+    }
+    vlc_mutex_unlock(&priv->var_lock);
 }
 
 char **var_GetAllNames(vlc_object_t *obj)
@@ -1400,9 +1594,18 @@ char **var_GetAllNames(vlc_object_t *obj)
     DECL_ARRAY(char *) names;
     ARRAY_INIT(names);
 
-    twalk_ctx = &names;
     vlc_mutex_lock(&priv->var_lock);
-    twalk(priv->var_root, TwalkGetNames);
+    variable_t **vars = TableSorted(priv);
+    if (vars != NULL)
+    {
+        for (size_t i = 0; i < priv->var_table.i_count; i++)
+        {
+            char *dup = strdup(vars[i]->psz_name);
+            if (dup != NULL)
+                ARRAY_APPEND(names, dup);
+        }
+        free(vars);
+    }
     vlc_mutex_unlock(&priv->var_lock);
 
     if (names.i_size == 0)
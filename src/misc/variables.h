@@ -39,7 +39,12 @@ struct vlc_object_internals
     char           *psz_name; /* given name */
 
     /* Object variables */
-    void           *var_root;
+    struct
+    {
+        struct variable_t **pp_buckets; /* hash table, see variables.c */
+        unsigned        i_size; /* number of buckets (power of two) */
+        unsigned        i_count; /* number of variables */
+    } var_table;
     vlc_mutex_t     var_lock;
     vlc_cond_t      var_wait;
 
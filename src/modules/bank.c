@@ -258,7 +258,7 @@ typedef struct module_bank
 
     size_t        size;
     vlc_plugin_t **plugins;
-    vlc_plugin_t *cache;
+    struct vlc_cache *cache;
 } module_bank_t;
 
 /**
@@ -270,9 +270,9 @@ static int AllocatePluginFile (module_bank_t *bank, const char *abspath,
     vlc_plugin_t *plugin = NULL;
 
     /* Check our plugins cache first then load plugin if needed */
-    if (bank->mode & CACHE_READ_FILE)
+    if (bank->cache != NULL)
     {
-        plugin = vlc_cache_lookup(&bank->cache, relpath);
+        plugin = vlc_cache_lookup(bank->cache, relpath);
 
         if (plugin != NULL
          && (plugin->mtime != (int64_t)st->st_mtime
@@ -419,15 +419,16 @@ static void AllocatePluginPath(vlc_object_t *obj, const char *path,
     }
 
     /* Deal with unmatched cache entries from cache file */
-    while (bank.cache != NULL)
+    if (bank.cache != NULL)
     {
-        vlc_plugin_t *plugin = bank.cache;
+        if (!(mode & CACHE_SCAN_DIR))
+        {
+            vlc_plugin_t *plugin;
 
-        bank.cache = plugin->next;
-        if (mode & CACHE_SCAN_DIR)
-            vlc_plugin_destroy(plugin);
-        else
-            vlc_plugin_store(plugin);
+            while ((plugin = vlc_cache_next(bank.cache)) != NULL)
+                vlc_plugin_store(plugin);
+        }
+        vlc_cache_close(bank.cache);
     }
 
     if (mode & CACHE_WRITE_FILE)
@@ -57,13 +57,107 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 34
+#define CACHE_SUBVERSION_NUM 36
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
 /* Magic for the cache filename */
 #define CACHE_STRING "cache "PACKAGE_NAME" "PACKAGE_VERSION
 
+/*
+ * The cache file is memory-mapped and used in place. After the header
+ * strings and marker, it contains an index pointing to two areas:
+ *  - the records area, holding fixed-size records and arrays,
+ *  - the strings area, holding nul-terminated strings.
+ * Records refer to other records by offset within the records area, and to
+ * strings by offset within the strings area. A string offset of zero stands
+ * for NULL; the strings area starts with a nul byte so that empty strings are
+ * never stored at offset zero. The plug-ins table is sorted by relative path.
+ */
+struct vlc_cache_index
+{
+    uint32_t plugins_count;
+    uint32_t plugins; /**< Plug-ins table (records area offset) */
+    uint32_t records_offset; /**< Records area (file offset) */
+    uint32_t records_size;
+    uint32_t strings_offset; /**< Strings area (file offset) */
+    uint32_t strings_size;
+};
+
+struct vlc_cache_plugin
+{
+    int64_t mtime;
+    uint64_t size;
+    uint32_t path;
+    uint32_t textdomain;
+    uint32_t modules; /**< Array of vlc_cache_module */
+    uint32_t modules_count;
+    uint32_t config; /**< Array of vlc_cache_config */
+    uint32_t config_count;
+    uint32_t unloadable;
+};
+
+struct vlc_cache_module
+{
+    uint32_t shortname;
+    uint32_t longname;
+    uint32_t help;
+    uint32_t capability;
+    uint32_t activate;
+    uint32_t deactivate;
+    uint32_t shortcuts; /**< Array of string offsets */
+    uint32_t shortcuts_count;
+    int32_t score;
+    uint32_t probe_extensions;
+    uint32_t probe_mime_types;
+    uint32_t probe_magic;
+    uint32_t probe_magic_offset;
+};
+
+#define CACHE_CONFIG_ADVANCED   0x01
+#define CACHE_CONFIG_INTERNAL   0x02
+#define CACHE_CONFIG_UNSAVEABLE 0x04
+#define CACHE_CONFIG_SAFE       0x08
+#define CACHE_CONFIG_REMOVED    0x10
+
+union vlc_cache_value
+{
+    int64_t i;
+    double f;
+    uint32_t psz; /**< String offset */
+};
+
+struct vlc_cache_config
+{
+    union vlc_cache_value orig;
+    union vlc_cache_value min;
+    union vlc_cache_value max;
+    uint32_t type;
+    uint32_t flags;
+    int32_t i_short;
+    uint32_t psz_type;
+    uint32_t name;
+    uint32_t text;
+    uint32_t longtext;
+    uint32_t list_count;
+    uint32_t list; /**< Array of string offsets or of integers */
+    uint32_t list_text; /**< Array of string offsets */
+    uint32_t list_cb_name;
+};
+
+/** Loaded plugins cache */
+struct vlc_cache
+{
+    char *dir;
+    const unsigned char *records;
+    size_t records_size;
+    const char *strings;
+    size_t strings_size;
+    const struct vlc_cache_plugin *plugins;
+    size_t count;
+    size_t next; /**< Next entry for vlc_cache_next() */
+    bool used[];
+};
 
 static int vlc_cache_load_immediate(void *out, block_t *in, size_t size)
 {
@@ -76,202 +170,184 @@ static int vlc_cache_load_immediate(void *out, block_t *in, size_t size)
     return 0;
 }
 
-static int vlc_cache_load_bool(bool *out, block_t *in)
+static int vlc_cache_load_align(size_t align, block_t *file)
 {
-    unsigned char b;
-
-    if (vlc_cache_load_immediate(&b, in, 1) || b > 1)
-        return -1;
-
-    *out = b;
-    return 0;
-}
+    assert(align > 0);
 
-static int vlc_cache_load_array(const void **p, size_t size, size_t n,
-                                block_t *file)
-{
-    if (n == 0)
-    {
-        *p = NULL;
+    size_t skip = (-(uintptr_t)file->p_buffer) % align;
+    if (skip == 0)
         return 0;
-    }
-
-    if (unlikely(size * n < size))
-        return -1;
 
-    size *= n;
+    assert(skip < align);
 
-    if (file->i_buffer < size)
+    if (file->i_buffer < skip)
         return -1;
 
-    *p = file->p_buffer;
-    file->p_buffer += size;
-    file->i_buffer -= size;
+    file->p_buffer += skip;
+    file->i_buffer -= skip;
+    assert((((uintptr_t)file->p_buffer) % align) == 0);
     return 0;
 }
 
-static int vlc_cache_load_string(const char **restrict p, block_t *file)
+/**
+ * Resolves an array within the records area.
+ * \return a pointer to the array, NULL if empty or out of bounds
+ */
+static const void *vlc_cache_array(const struct vlc_cache *cache,
+                                   uint32_t offset, size_t size, size_t n,
+                                   size_t align)
 {
-    uint16_t size;
-
-    if (vlc_cache_load_immediate(&size, file, sizeof (size)) || size > 16384)
-        return -1;
-
-    if (size == 0)
-    {
-        *p = NULL;
-        return 0;
-    }
+    if (n == 0 || offset % align)
+        return NULL;
+    if (offset > cache->records_size
+     || n > (cache->records_size - offset) / size)
+        return NULL;
+    return cache->records + offset;
+}
 
-    const char *str = (char *)file->p_buffer;
+#define CACHE_ARRAY(cache, off, type, n) \
+    ((const type *)vlc_cache_array(cache, off, sizeof (type), n, \
+                                   alignof (type)))
 
-    if (file->i_buffer < size || str[size - 1] != '\0')
+static int vlc_cache_string(const struct vlc_cache *cache, uint32_t offset,
+                            const char **restrict p)
+{
+    if (offset >= cache->strings_size)
         return -1;
 
-    file->p_buffer += size;
-    file->i_buffer -= size;
-    *p = str;
+    *p = (offset != 0) ? (cache->strings + offset) : NULL;
     return 0;
 }
 
-static int vlc_cache_load_align(size_t align, block_t *file)
+/**
+ * Resolves an array of string offsets into an allocated array of pointers.
+ * NULL entries are replaced by empty strings.
+ */
+static int vlc_cache_strings(const struct vlc_cache *cache, uint32_t offset,
+                             size_t n, const char ***restrict pp)
 {
-    assert(align > 0);
-
-    size_t skip = (-(uintptr_t)file->p_buffer) % align;
-    if (skip == 0)
+    if (n == 0)
+    {
+        *pp = NULL;
         return 0;
+    }
 
-    assert(skip < align);
+    const uint32_t *offsets = CACHE_ARRAY(cache, offset, uint32_t, n);
+    if (offsets == NULL)
+        return -1;
 
-    if (file->i_buffer < skip)
+    const char **tab = malloc(n * sizeof (*tab));
+    if (unlikely(tab == NULL))
         return -1;
 
-    file->p_buffer += skip;
-    file->i_buffer -= skip;
-    assert((((uintptr_t)file->p_buffer) % align) == 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (offsets[i] >= cache->strings_size)
+        {
+            free(tab);
+            return -1;
+        }
+        tab[i] = cache->strings + offsets[i];
+    }
+    *pp = tab;
     return 0;
 }
 
-#define LOAD_IMMEDIATE(a) \
-    if (vlc_cache_load_immediate(&(a), file, sizeof (a))) \
-        goto error
-#define LOAD_FLAG(a) \
-    do \
-    { \
-        bool b; \
-        if (vlc_cache_load_bool(&b, file)) \
-            goto error; \
-        (a) = b; \
-    } while (0)
-#define LOAD_ARRAY(a,n) \
-    do \
-    { \
-        const void *base; \
-        if (vlc_cache_load_array(&base, sizeof (*(a)), (n), file)) \
-            goto error; \
-        (a) = base; \
-    } while (0)
-#define LOAD_STRING(a) \
-    if (vlc_cache_load_string(&(a), file)) \
-        goto error
-#define LOAD_ALIGNOF(t) \
-    if (vlc_cache_load_align(alignof(t), file)) \
+#define LOAD_STRING(a, off) \
+    if (vlc_cache_string(cache, (off), &(a))) \
         goto error
 
-static int vlc_cache_load_config(module_config_t *cfg, block_t *file)
+static int vlc_cache_load_config(const struct vlc_cache *cache,
+                                 module_config_t *cfg,
+                                 const struct vlc_cache_config *rec)
 {
-    LOAD_IMMEDIATE (cfg->i_type);
-    LOAD_IMMEDIATE (cfg->i_short);
-    LOAD_FLAG (cfg->b_advanced);
-    LOAD_FLAG (cfg->b_internal);
-    LOAD_FLAG (cfg->b_unsaveable);
-    LOAD_FLAG (cfg->b_safe);
-    LOAD_FLAG (cfg->b_removed);
-    LOAD_STRING (cfg->psz_type);
-    LOAD_STRING (cfg->psz_name);
-    LOAD_STRING (cfg->psz_text);
-    LOAD_STRING (cfg->psz_longtext);
-    LOAD_IMMEDIATE (cfg->list_count);
+    if (rec->type > UINT8_MAX || rec->list_count > UINT16_MAX)
+        goto error;
+
+    cfg->i_type = rec->type;
+    cfg->i_short = rec->i_short;
+    cfg->b_advanced = (rec->flags & CACHE_CONFIG_ADVANCED) != 0;
+    cfg->b_internal = (rec->flags & CACHE_CONFIG_INTERNAL) != 0;
+    cfg->b_unsaveable = (rec->flags & CACHE_CONFIG_UNSAVEABLE) != 0;
+    cfg->b_safe = (rec->flags & CACHE_CONFIG_SAFE) != 0;
+    cfg->b_removed = (rec->flags & CACHE_CONFIG_REMOVED) != 0;
+    LOAD_STRING(cfg->psz_type, rec->psz_type);
+    LOAD_STRING(cfg->psz_name, rec->name);
+    LOAD_STRING(cfg->psz_text, rec->text);
+    LOAD_STRING(cfg->psz_longtext, rec->longtext);
+    LOAD_STRING(cfg->list_cb_name, rec->list_cb_name);
 
     if (IsConfigStringType (cfg->i_type))
     {
         const char *psz;
-        LOAD_STRING(psz);
+        LOAD_STRING(psz, rec->orig.psz);
         cfg->orig.psz = (char *)psz;
         cfg->value.psz = (psz != NULL) ? strdup (cfg->orig.psz) : NULL;
 
-        if (cfg->list_count)
-            cfg->list.psz = xmalloc (cfg->list_count * sizeof (char *));
-        else
-            LOAD_STRING(cfg->list_cb_name);
-        for (unsigned i = 0; i < cfg->list_count; i++)
-        {
-            LOAD_STRING (cfg->list.psz[i]);
-            if (cfg->list.psz[i] == NULL /* NULL -> empty string */
-             && (cfg->list.psz[i] = calloc (1, 1)) == NULL)
-                goto error;
-        }
+        if (vlc_cache_strings(cache, rec->list, rec->list_count,
+                              &cfg->list.psz))
+            goto error;
     }
     else
     {
-        LOAD_IMMEDIATE (cfg->orig);
-        LOAD_IMMEDIATE (cfg->min);
-        LOAD_IMMEDIATE (cfg->max);
-        cfg->value = cfg->orig;
-
-        if (cfg->list_count)
+        if (IsConfigIntegerType(cfg->i_type))
         {
-            LOAD_ALIGNOF(*cfg->list.i);
+            cfg->orig.i = rec->orig.i;
+            cfg->min.i = rec->min.i;
+            cfg->max.i = rec->max.i;
         }
         else
-            LOAD_STRING(cfg->list_cb_name);
+        {
+            cfg->orig.f = rec->orig.f;
+            cfg->min.f = rec->min.f;
+            cfg->max.f = rec->max.f;
+        }
+        cfg->value = cfg->orig;
 
-        LOAD_ARRAY(cfg->list.i, cfg->list_count);
+        if (rec->list_count > 0)
+        {
+            cfg->list.i = CACHE_ARRAY(cache, rec->list, int, rec->list_count);
+            if (cfg->list.i == NULL)
+                goto error;
+        }
     }
 
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
-    for (unsigned i = 0; i < cfg->list_count; i++)
-    {
-        LOAD_STRING (cfg->list_text[i]);
-        if (cfg->list_text[i] == NULL /* NULL -> empty string */
-         && (cfg->list_text[i] = calloc (1, 1)) == NULL)
-            goto error;
-    }
+    /* Only set the count once the list is valid, for config_Free() */
+    cfg->list_count = rec->list_count;
+
+    if (vlc_cache_strings(cache, rec->list_text, rec->list_count,
+                          &cfg->list_text))
+        goto error;
 
     return 0;
 error:
-    return -1; /* FIXME: leaks */
+    return -1;
 }
 
-static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file)
+static int vlc_cache_load_plugin_config(const struct vlc_cache *cache,
+                                        vlc_plugin_t *plugin,
+                                        const struct vlc_cache_plugin *rec)
 {
-    uint16_t lines;
+    size_t lines = rec->config_count;
 
-    /* Calculate the structure length */
-    LOAD_IMMEDIATE (lines);
+    if (lines == 0)
+        return 0;
 
-    /* Allocate memory */
-    if (lines)
-    {
-        plugin->conf.items = calloc(sizeof (module_config_t), lines);
-        if (unlikely(plugin->conf.items == NULL))
-        {
-            plugin->conf.size = 0;
-            return -1;
-        }
-    }
-    else
-        plugin->conf.items = NULL;
+    const struct vlc_cache_config *recs =
+        CACHE_ARRAY(cache, rec->config, struct vlc_cache_config, lines);
+    if (recs == NULL)
+        return -1;
 
-    plugin->conf.size = lines;
+    plugin->conf.items = calloc(sizeof (module_config_t), lines);
+    if (unlikely(plugin->conf.items == NULL))
+        return -1;
 
-    /* Do the duplication job */
     for (size_t i = 0; i < lines; i++)
     {
         module_config_t *item = plugin->conf.items + i;
 
-        if (vlc_cache_load_config(item, file))
+        plugin->conf.size++;
+        if (vlc_cache_load_config(cache, item, recs + i))
             return -1;
 
         if (CONFIG_ITEM(item->i_type))
@@ -284,60 +360,69 @@ static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file)
     }
 
     return 0;
-error:
-    return -1; /* FIXME: leaks */
 }
 
-static int vlc_cache_load_module(vlc_plugin_t *plugin, block_t *file)
+static int vlc_cache_load_module(const struct vlc_cache *cache,
+                                 vlc_plugin_t *plugin,
+                                 const struct vlc_cache_module *rec)
 {
     module_t *module = vlc_module_create(plugin);
     if (unlikely(module == NULL))
         return -1;
 
-    LOAD_STRING(module->psz_shortname);
-    LOAD_STRING(module->psz_longname);
-    LOAD_STRING(module->psz_help);
+    LOAD_STRING(module->psz_shortname, rec->shortname);
+    LOAD_STRING(module->psz_longname, rec->longname);
+    LOAD_STRING(module->psz_help, rec->help);
 
-    LOAD_IMMEDIATE(module->i_shortcuts);
-    if (module->i_shortcuts > MODULE_SHORTCUT_MAX)
+    if (rec->shortcuts_count > MODULE_SHORTCUT_MAX
+     || vlc_cache_strings(cache, rec->shortcuts, rec->shortcuts_count,
+                          &module->pp_shortcuts))
         goto error;
-    else
-    {
-        module->pp_shortcuts =
-            xmalloc (sizeof (*module->pp_shortcuts) * module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            LOAD_STRING(module->pp_shortcuts[j]);
-    }
-
-    LOAD_STRING(module->activate_name);
-    LOAD_STRING(module->deactivate_name);
-    LOAD_STRING(module->psz_capability);
-    LOAD_IMMEDIATE(module->i_score);
+    module->i_shortcuts = rec->shortcuts_count;
+
+    LOAD_STRING(module->activate_name, rec->activate);
+    LOAD_STRING(module->deactivate_name, rec->deactivate);
+    LOAD_STRING(module->psz_capability, rec->capability);
+    module->i_score = rec->score;
+    LOAD_STRING(module->probe_extensions, rec->probe_extensions);
+    LOAD_STRING(module->probe_mime_types, rec->probe_mime_types);
+    LOAD_STRING(module->probe_magic, rec->probe_magic);
+    module->probe_magic_offset = rec->probe_magic_offset;
     return 0;
 error:
     return -1;
 }
 
-static vlc_plugin_t *vlc_cache_load_plugin(block_t *file)
+/**
+ * Materializes a plug-in from its cache record.
+ */
+static vlc_plugin_t *vlc_cache_load_plugin(const struct vlc_cache *cache,
+                                           const struct vlc_cache_plugin *rec)
 {
     vlc_plugin_t *plugin = vlc_plugin_create();
     if (unlikely(plugin == NULL))
         return NULL;
 
-    uint32_t modules;
-    LOAD_IMMEDIATE(modules);
-
-    for (size_t i = 0; i < modules; i++)
-        if (vlc_cache_load_module(plugin, file))
+    if (rec->modules_count > 0)
+    {
+        const struct vlc_cache_module *modules =
+            CACHE_ARRAY(cache, rec->modules, struct vlc_cache_module,
+                        rec->modules_count);
+        if (modules == NULL)
             goto error;
 
-    if (vlc_cache_load_plugin_config(plugin, file))
+        for (size_t i = 0; i < rec->modules_count; i++)
+            if (vlc_cache_load_module(cache, plugin, modules + i))
+                goto error;
+    }
+
+    if (vlc_cache_load_plugin_config(cache, plugin, rec))
         goto error;
 
-    LOAD_STRING(plugin->textdomain);
+    LOAD_STRING(plugin->textdomain, rec->textdomain);
 
     const char *path;
-    LOAD_STRING(path);
+    LOAD_STRING(path, rec->path);
     if (path == NULL)
         goto error;
 
@@ -345,9 +430,16 @@ static vlc_plugin_t *vlc_cache_load_plugin(block_t *file)
     if (unlikely(plugin->path == NULL))
         goto error;
 
-    LOAD_FLAG(plugin->unloadable);
-    LOAD_IMMEDIATE(plugin->mtime);
-    LOAD_IMMEDIATE(plugin->size);
+    if (unlikely(asprintf(&plugin->abspath, "%s" DIR_SEP "%s", cache->dir,
+                          plugin->path) == -1))
+    {
+        plugin->abspath = NULL;
+        goto error;
+    }
+
+    plugin->unloadable = rec->unloadable != 0;
+    plugin->mtime = rec->mtime;
+    plugin->size = rec->size;
 
     if (plugin->textdomain != NULL)
         vlc_bindtextdomain(plugin->textdomain);
@@ -362,20 +454,27 @@ error:
 /**
  * Loads a plugins cache file.
  *
- * This function will load the plugin cache if present and valid. This cache
+ * This function will map the plugin cache if present and valid. This cache
  * will in turn be queried by AllocateAllPlugins() to see if it needs to
  * actually load the dynamically loadable module.
  * This allows us to only fully load plugins when they are actually used.
+ *
+ * The file is used in place: only the plug-ins that are looked up get
+ * materialized, see vlc_cache_lookup() and vlc_cache_next().
+ *
+ * \param backingp list of cache files to keep mapped for as long as any of
+ *                 the materialized plug-ins lives
+ * \return a cache handle to release with vlc_cache_close(), or NULL
  */
-vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
-                             block_t **backingp)
+struct vlc_cache *vlc_cache_load(vlc_object_t *p_this, const char *dir,
+                                 block_t **backingp)
 {
     char *psz_filename;
 
     assert( dir != NULL );
 
     if( asprintf( &psz_filename, "%s"DIR_SEP CACHE_NAME, dir ) == -1 )
-        return 0;
+        return NULL;
 
     msg_Dbg( p_this, "loading plugins cache file %s", psz_filename );
 
@@ -385,7 +484,10 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
                  vlc_strerror_c(errno));
     free(psz_filename);
     if (file == NULL)
-        return 0;
+        return NULL;
+
+    const unsigned char *base = file->p_buffer;
+    size_t size = file->i_buffer;
 
     /* Check the file is a plugins cache */
     char cachestr[sizeof (CACHE_STRING) - 1];
@@ -395,7 +497,7 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
         block_Release(file);
-        return 0;
+        return NULL;
     }
 
 #ifdef DISTRO_VERSION
@@ -407,7 +509,7 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
         block_Release(file);
-        return 0;
+        return NULL;
     }
 #endif
 
@@ -420,7 +522,7 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
         block_Release(file);
-        return 0;
+        return NULL;
     }
 
     /* Check header marker */
@@ -435,28 +537,51 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
         block_Release(file);
-        return 0;
+        return NULL;
     }
 
-    vlc_plugin_t *cache = NULL;
+    /* Check the index */
+    struct vlc_cache_index index;
+
+    if (vlc_cache_load_align(alignof (uint64_t), file)
+     || vlc_cache_load_immediate(&index, file, sizeof (index))
+     || index.records_offset > size
+     || index.records_size > size - index.records_offset
+     || index.strings_offset > size
+     || index.strings_size > size - index.strings_offset
+     || index.strings_size == 0
+     || index.plugins_count > index.records_size
+                              / sizeof (struct vlc_cache_plugin)
+     || base[index.strings_offset] != '\0'
+     || base[index.strings_offset + index.strings_size - 1] != '\0'
+     || ((uintptr_t)(base + index.records_offset)) % alignof (uint64_t))
+        goto error;
 
-    while (file->i_buffer > 0)
+    struct vlc_cache *cache = malloc(sizeof (*cache)
+                                     + index.plugins_count * sizeof (bool));
+    if (unlikely(cache == NULL))
     {
-        vlc_plugin_t *plugin = vlc_cache_load_plugin(file);
-        if (plugin == NULL)
-            goto error;
-
-        if (unlikely(asprintf(&plugin->abspath, "%s" DIR_SEP "%s", dir,
-                              plugin->path) == -1))
-        {
-            plugin->abspath = NULL;
-            vlc_plugin_destroy(plugin);
-            goto error;
-        }
+        block_Release(file);
+        return NULL;
+    }
 
-        plugin->next = cache;
-        cache = plugin;
+    cache->dir = strdup(dir);
+    cache->records = base + index.records_offset;
+    cache->records_size = index.records_size;
+    cache->strings = (const char *)base + index.strings_offset;
+    cache->strings_size = index.strings_size;
+    cache->count = index.plugins_count;
+    cache->next = 0;
+    cache->plugins = CACHE_ARRAY(cache, index.plugins,
+                                 struct vlc_cache_plugin, cache->count);
+    if (unlikely(cache->dir == NULL)
+     || (cache->plugins == NULL && cache->count > 0))
+    {
+        free(cache->dir);
+        free(cache);
+        goto error;
     }
+    memset(cache->used, 0, cache->count * sizeof (bool));
 
     file->p_next = *backingp;
     *backingp = file;
@@ -464,138 +589,238 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
 
 error:
     msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
-
-    /* TODO: cleanup */
     block_Release(file);
     return NULL;
 }
 
-#define SAVE_IMMEDIATE( a ) \
-    if (fwrite (&(a), sizeof(a), 1, file) != 1) \
-        goto error
-#define SAVE_FLAG(a) \
-    do { \
-        char b = (a); \
-        SAVE_IMMEDIATE(b); \
-    } while (0)
+/**
+ * Releases a plugins cache handle.
+ *
+ * Plug-ins materialized from the cache remain valid.
+ */
+void vlc_cache_close(struct vlc_cache *cache)
+{
+    free(cache->dir);
+    free(cache);
+}
 
-static int CacheSaveString (FILE *file, const char *str)
+struct cache_buf
 {
-    uint16_t size = (str != NULL) ? (strlen (str) + 1) : 0;
+    unsigned char *data;
+    size_t size;
+    size_t alloc;
+    bool error;
+};
 
-    SAVE_IMMEDIATE (size);
-    if (size != 0 && fwrite(str, 1, size, file) != size)
+/**
+ * Reserves space at the end of a buffer.
+ * \return the offset of the reserved space within the buffer
+ */
+static uint32_t CacheReserve(struct cache_buf *buf, size_t size, size_t align)
+{
+    size_t offset = (buf->size + align - 1) & ~(align - 1);
+
+    if (buf->error || offset + size > UINT32_MAX)
+        goto error;
+
+    if (offset + size > buf->alloc)
     {
-error:
-        return -1;
+        size_t alloc = buf->alloc ? buf->alloc : 4096;
+
+        while (alloc < offset + size)
+            alloc *= 2;
+
+        unsigned char *data = realloc(buf->data, alloc);
+        if (unlikely(data == NULL))
+            goto error;
+
+        buf->data = data;
+        buf->alloc = alloc;
     }
+
+    memset(buf->data + buf->size, 0, offset + size - buf->size);
+    buf->size = offset + size;
+    return offset;
+error:
+    buf->error = true;
     return 0;
 }
 
-#define SAVE_STRING( a ) \
-    if (CacheSaveString (file, (a))) \
-        goto error
+#define CACHE_RESERVE(buf, type, n) \
+    CacheReserve(buf, sizeof (type) * (n), alignof (type))
+#define CACHE_AT(buf, type, off) \
+    ((type *)((buf)->data + (off)))
 
-static int CacheSaveAlign(FILE *file, size_t align)
+static uint32_t CacheSaveString(struct cache_buf *strings, const char *str)
 {
-    assert(align > 0);
-
-    size_t skip = (-ftell(file)) % align;
-    if (skip == 0)
+    if (str == NULL)
         return 0;
 
-    assert(((ftell(file) + skip) % align) == 0);
-    return fseek(file, skip, SEEK_CUR);
+    size_t len = strlen(str) + 1;
+    uint32_t offset = CacheReserve(strings, len, 1);
+
+    if (!strings->error)
+        memcpy(strings->data + offset, str, len);
+    return offset;
 }
 
-#define SAVE_ALIGNOF(t) \
-    if (CacheSaveAlign(file, alignof (t))) \
-        goto error
+static uint32_t CacheSaveStrings(struct cache_buf *records,
+                                 struct cache_buf *strings,
+                                 const char *const *tab, size_t n)
+{
+    if (n == 0)
+        return 0;
+
+    uint32_t offset = CACHE_RESERVE(records, uint32_t, n);
 
-static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t str = CacheSaveString(strings, tab[i]);
+
+        if (!records->error)
+            CACHE_AT(records, uint32_t, offset)[i] = str;
+    }
+    return offset;
+}
+
+static void CacheSaveConfig(struct cache_buf *records,
+                            struct cache_buf *strings, uint32_t offset,
+                            const module_config_t *cfg)
 {
-    SAVE_IMMEDIATE (cfg->i_type);
-    SAVE_IMMEDIATE (cfg->i_short);
-    SAVE_FLAG (cfg->b_advanced);
-    SAVE_FLAG (cfg->b_internal);
-    SAVE_FLAG (cfg->b_unsaveable);
-    SAVE_FLAG (cfg->b_safe);
-    SAVE_FLAG (cfg->b_removed);
-    SAVE_STRING (cfg->psz_type);
-    SAVE_STRING (cfg->psz_name);
-    SAVE_STRING (cfg->psz_text);
-    SAVE_STRING (cfg->psz_longtext);
-    SAVE_IMMEDIATE (cfg->list_count);
+    struct vlc_cache_config rec = {
+        .type = cfg->i_type,
+        .i_short = cfg->i_short,
+        .flags = (cfg->b_advanced ? CACHE_CONFIG_ADVANCED : 0)
+               | (cfg->b_internal ? CACHE_CONFIG_INTERNAL : 0)
+               | (cfg->b_unsaveable ? CACHE_CONFIG_UNSAVEABLE : 0)
+               | (cfg->b_safe ? CACHE_CONFIG_SAFE : 0)
+               | (cfg->b_removed ? CACHE_CONFIG_REMOVED : 0),
+        .psz_type = CacheSaveString(strings, cfg->psz_type),
+        .name = CacheSaveString(strings, cfg->psz_name),
+        .text = CacheSaveString(strings, cfg->psz_text),
+        .longtext = CacheSaveString(strings, cfg->psz_longtext),
+        .list_count = cfg->list_count,
+    };
+
+    if (cfg->list_count == 0)
+        rec.list_cb_name = CacheSaveString(strings, cfg->list_cb_name);
 
     if (IsConfigStringType (cfg->i_type))
     {
-        SAVE_STRING (cfg->orig.psz);
-        if (cfg->list_count == 0)
-            SAVE_STRING(cfg->list_cb_name);
-
-        for (unsigned i = 0; i < cfg->list_count; i++)
-            SAVE_STRING (cfg->list.psz[i]);
+        rec.orig.psz = CacheSaveString(strings, cfg->orig.psz);
+        rec.list = CacheSaveStrings(records, strings, cfg->list.psz,
+                                    cfg->list_count);
     }
     else
     {
-        SAVE_IMMEDIATE (cfg->orig);
-        SAVE_IMMEDIATE (cfg->min);
-        SAVE_IMMEDIATE (cfg->max);
-
-        if (cfg->list_count > 0)
+        if (IsConfigIntegerType(cfg->i_type))
         {
-            SAVE_ALIGNOF(*cfg->list.i);
+            rec.orig.i = cfg->orig.i;
+            rec.min.i = cfg->min.i;
+            rec.max.i = cfg->max.i;
         }
         else
-            SAVE_STRING(cfg->list_cb_name);
+        {
+            rec.orig.f = cfg->orig.f;
+            rec.min.f = cfg->min.f;
+            rec.max.f = cfg->max.f;
+        }
 
-        for (unsigned i = 0; i < cfg->list_count; i++)
-             SAVE_IMMEDIATE (cfg->list.i[i]);
+        if (cfg->list_count > 0)
+        {
+            rec.list = CACHE_RESERVE(records, int, cfg->list_count);
+            if (!records->error)
+                memcpy(CACHE_AT(records, int, rec.list), cfg->list.i,
+                       cfg->list_count * sizeof (int));
+        }
     }
-    for (unsigned i = 0; i < cfg->list_count; i++)
-        SAVE_STRING (cfg->list_text[i]);
 
-    return 0;
-error:
-    return -1;
+    rec.list_text = CacheSaveStrings(records, strings, cfg->list_text,
+                                     cfg->list_count);
+
+    if (!records->error)
+        *CACHE_AT(records, struct vlc_cache_config, offset) = rec;
 }
 
-static int CacheSaveModuleConfig(FILE *file, const vlc_plugin_t *plugin)
+static void CacheSaveModule(struct cache_buf *records,
+                            struct cache_buf *strings, uint32_t offset,
+                            const module_t *module)
 {
-    uint16_t lines = plugin->conf.size;
-
-    SAVE_IMMEDIATE (lines);
-
-    for (size_t i = 0; i < lines; i++)
-        if (CacheSaveConfig(file, plugin->conf.items + i))
-           goto error;
+    struct vlc_cache_module rec = {
+        .shortname = CacheSaveString(strings, module->psz_shortname),
+        .longname = CacheSaveString(strings, module->psz_longname),
+        .help = CacheSaveString(strings, module->psz_help),
+        .capability = CacheSaveString(strings, module->psz_capability),
+        .activate = CacheSaveString(strings, module->activate_name),
+        .deactivate = CacheSaveString(strings, module->deactivate_name),
+        .shortcuts = CacheSaveStrings(records, strings, module->pp_shortcuts,
+                                      module->i_shortcuts),
+        .shortcuts_count = module->i_shortcuts,
+        .score = module->i_score,
+        .probe_extensions = CacheSaveString(strings, module->probe_extensions),
+        .probe_mime_types = CacheSaveString(strings, module->probe_mime_types),
+        .probe_magic = CacheSaveString(strings, module->probe_magic),
+        .probe_magic_offset = module->probe_magic_offset,
+    };
+
+    if (!records->error)
+        *CACHE_AT(records, struct vlc_cache_module, offset) = rec;
+}
 
-    return 0;
-error:
-    return -1;
+static void CacheSavePlugin(struct cache_buf *records,
+                            struct cache_buf *strings, uint32_t offset,
+                            const vlc_plugin_t *plugin)
+{
+    struct vlc_cache_plugin rec = {
+        .mtime = plugin->mtime,
+        .size = plugin->size,
+        .path = CacheSaveString(strings, plugin->path),
+        .textdomain = CacheSaveString(strings, plugin->textdomain),
+        .modules_count = plugin->modules_count,
+        .config_count = plugin->conf.size,
+        .unloadable = plugin->unloadable,
+    };
+
+    rec.modules = CACHE_RESERVE(records, struct vlc_cache_module,
+                                rec.modules_count);
+
+    size_t i = 0;
+    for (const module_t *module = plugin->module;
+         module != NULL;
+         module = module->next)
+        CacheSaveModule(records, strings,
+                        rec.modules + i++ * sizeof (struct vlc_cache_module),
+                        module);
+    assert(i == rec.modules_count);
+
+    rec.config = CACHE_RESERVE(records, struct vlc_cache_config,
+                               rec.config_count);
+
+    for (i = 0; i < rec.config_count; i++)
+        CacheSaveConfig(records, strings,
+                        rec.config + i * sizeof (struct vlc_cache_config),
+                        plugin->conf.items + i);
+
+    if (!records->error)
+        *CACHE_AT(records, struct vlc_cache_plugin, offset) = rec;
 }
 
-static int CacheSaveModule(FILE *file, const module_t *module)
+static int CacheComparePath(const void *a, const void *b)
 {
-    SAVE_STRING(module->psz_shortname);
-    SAVE_STRING(module->psz_longname);
-    SAVE_STRING(module->psz_help);
-    SAVE_IMMEDIATE(module->i_shortcuts);
-
-    for (size_t j = 0; j < module->i_shortcuts; j++)
-         SAVE_STRING(module->pp_shortcuts[j]);
-
-    SAVE_STRING(module->activate_name);
-    SAVE_STRING(module->deactivate_name);
-    SAVE_STRING(module->psz_capability);
-    SAVE_IMMEDIATE(module->i_score);
-    return 0;
-error:
-    return -1;
+    const vlc_plugin_t *const *pa = a, *const *pb = b;
+
+    return strcmp((*pa)->path, (*pb)->path);
 }
 
+#define SAVE_IMMEDIATE( a ) \
+    if (fwrite (&(a), sizeof(a), 1, file) != 1) \
+        goto error
+
 static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
 {
+    struct cache_buf records = { NULL, 0, 0, false };
+    struct cache_buf strings = { NULL, 0, 0, false };
+    vlc_plugin_t **sorted = NULL;
     uint32_t i_file_size = 0;
 
     /* Contains version number */
@@ -617,36 +842,66 @@ static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
     if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1)
         goto error;
 
-    for (size_t i = 0; i < n; i++)
+    /* Sort the plug-ins by path for vlc_cache_lookup() */
+    if (n > 0)
     {
-        const vlc_plugin_t *plugin = cache[i];
-        uint32_t count = plugin->modules_count;
+        sorted = malloc(n * sizeof (*sorted));
+        if (unlikely(sorted == NULL))
+            goto error;
+        memcpy(sorted, cache, n * sizeof (*sorted));
+        qsort(sorted, n, sizeof (*sorted), CacheComparePath);
+    }
 
-        SAVE_IMMEDIATE(count);
+    CacheReserve(&strings, 1, 1); /* offset zero is NULL */
 
-        for (module_t *module = plugin->module;
-             module != NULL;
-             module = module->next)
-            if (CacheSaveModule(file, module))
-                goto error;
+    struct vlc_cache_index index = {
+        .plugins_count = n,
+        .plugins = CACHE_RESERVE(&records, struct vlc_cache_plugin, n),
+    };
 
-        /* Config stuff */
-        if (CacheSaveModuleConfig(file, plugin))
-            goto error;
+    for (size_t i = 0; i < n; i++)
+        CacheSavePlugin(&records, &strings,
+                        index.plugins + i * sizeof (struct vlc_cache_plugin),
+                        sorted[i]);
 
-        /* Save common info */
-        SAVE_STRING(plugin->textdomain);
-        SAVE_STRING(plugin->path);
-        SAVE_FLAG(plugin->unloadable);
-        SAVE_IMMEDIATE(plugin->mtime);
-        SAVE_IMMEDIATE(plugin->size);
-    }
+    if (records.error || strings.error)
+        goto error;
+
+    /* Lay out the areas after the index, 64-bits aligned */
+    long offset = ftell(file);
+    if (offset < 0)
+        goto error;
+
+    size_t pad = (-offset) % alignof (uint64_t);
+    offset += pad + sizeof (index);
+    index.records_offset = offset;
+    index.records_size = records.size;
+    offset += records.size;
+    index.strings_offset = offset;
+    index.strings_size = strings.size;
+    if ((uint64_t)offset + strings.size > UINT32_MAX)
+        goto error;
+
+    static const unsigned char zeroes[8];
+    if (fwrite(zeroes, 1, pad, file) != pad)
+        goto error;
+    SAVE_IMMEDIATE(index);
+    if (fwrite(records.data, 1, records.size, file) != records.size
+     || fwrite(strings.data, 1, strings.size, file) != strings.size)
+        goto error;
 
     if (fflush (file)) /* flush libc buffers */
         goto error;
+
+    free(sorted);
+    free(records.data);
+    free(strings.data);
     return 0; /* success! */
 
 error:
+    free(sorted);
+    free(records.data);
+    free(strings.data);
     return -1;
 }
 
@@ -697,25 +952,68 @@ out:
     free (tmpname);
 }
 
+
+struct vlc_cache_key
+{
+    const struct vlc_cache *cache;
+    const char *path;
+};
+
+static int vlc_cache_compare_path(const void *a, const void *b)
+{
+    const struct vlc_cache_key *key = a;
+    const struct vlc_cache_plugin *rec = b;
+    const char *path;
+
+    if (vlc_cache_string(key->cache, rec->path, &path) || path == NULL)
+        return -1; /* corrupted entry, cannot match anyway */
+    return strcmp(key->path, path);
+}
+
 /**
  * Looks up a plugin file in a table of cached plugins.
+ *
+ * The plug-in is materialized from the cache on success. A given entry is
+ * returned at most once.
  */
-vlc_plugin_t *vlc_cache_lookup(vlc_plugin_t **cache, const char *path)
+vlc_plugin_t *vlc_cache_lookup(struct vlc_cache *cache, const char *path)
 {
-    vlc_plugin_t **pp = cache, *plugin;
+    struct vlc_cache_key key = { cache, path };
+    const struct vlc_cache_plugin *rec =
+        bsearch(&key, cache->plugins, cache->count, sizeof (*rec),
+                vlc_cache_compare_path);
+    if (rec == NULL)
+        return NULL;
 
-    while ((plugin = *pp) != NULL)
+    size_t i = rec - cache->plugins;
+    if (cache->used[i])
+        return NULL;
+
+    cache->used[i] = true;
+    return vlc_cache_load_plugin(cache, rec);
+}
+
+/**
+ * Materializes the next cached plugin that was not looked up yet.
+ *
+ * \return a plug-in, or NULL once all entries have been returned
+ */
+vlc_plugin_t *vlc_cache_next(struct vlc_cache *cache)
+{
+    while (cache->next < cache->count)
     {
-        if (plugin->path != NULL && !strcmp(plugin->path, path))
-        {
-            *pp = plugin->next;
-            plugin->next = NULL;
-            return plugin;
-        }
+        size_t i = cache->next++;
 
-        pp = &plugin->next;
-    }
+        if (cache->used[i])
+            continue;
 
+        cache->used[i] = true;
+
+        vlc_plugin_t *plugin = vlc_cache_load_plugin(cache,
+                                                     cache->plugins + i);
+        if (plugin != NULL)
+            return plugin;
+    }
     return NULL;
 }
 #endif /* HAVE_DYNAMIC_PLUGINS */
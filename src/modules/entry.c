@@ -70,6 +70,10 @@ module_t *vlc_module_create(vlc_plugin_t *plugin)
     module->i_shortcuts = 0;
     module->psz_capability = NULL;
     module->i_score = (parent != NULL) ? parent->i_score : 1;
+    module->probe_extensions = NULL;
+    module->probe_mime_types = NULL;
+    module->probe_magic = NULL;
+    module->probe_magic_offset = 0;
     module->activate_name = NULL;
     module->deactivate_name = NULL;
     module->pf_activate = NULL;
@@ -316,6 +320,20 @@ static int vlc_plugin_desc_cb(void *ctx, void *tgt, int propid, ...)
             plugin->textdomain = va_arg(ap, const char *);
             break;
 
+        case VLC_MODULE_PROBE_EXTENSIONS:
+            module->probe_extensions = va_arg (ap, const char *);
+            break;
+
+        case VLC_MODULE_PROBE_MIME_TYPES:
+            module->probe_mime_types = va_arg (ap, const char *);
+            break;
+
+        case VLC_MODULE_PROBE_MAGIC:
+            module->probe_magic_offset = va_arg (ap, unsigned);
+            module->probe_magic = va_arg (ap, const char *);
+            assert(module->probe_magic[0] != '\0');
+            break;
+
         case VLC_CONFIG_NAME:
         {
             const char *name = va_arg (ap, const char *);
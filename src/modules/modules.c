@@ -190,30 +190,111 @@ static int module_load (vlc_object_t *obj, module_t *m,
     return ret;
 }
 
-#undef vlc_module_load
 /**
- * Finds and instantiates the best module of a certain type.
- * All candidates modules having the specified capability and name will be
- * sorted in decreasing order of priority. Then the probe callback will be
- * invoked for each module, until it succeeds (returns 0), or all candidate
- * module failed to initialize.
- *
- * The probe callback first parameter is the address of the module entry point.
- * Further parameters are passed as an argument list; it corresponds to the
- * variable arguments passed to this function. This scheme is meant to
- * support arbitrary prototypes for the module entry point.
- *
- * \param obj VLC object
- * \param capability capability, i.e. class of module
- * \param name name of the module asked, if any
- * \param strict if true, do not fallback to plugin with a different name
- *                 but the same capability
- * \param probe module probe callback
- * \return the module or NULL in case of a failure
+ * Matches a value against a comma-separated list (case-insensitive).
  */
-module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
-                          const char *name, bool strict,
-                          vlc_activate_t probe, ...)
+static bool module_match_list(const char *list, const char *value)
+{
+    size_t len = strlen(value);
+
+    while (*list)
+    {
+        size_t n = strcspn(list, ",");
+
+        if (n == len && !strncasecmp(list, value, n))
+            return true;
+        list += n;
+        list += strspn(list, ",");
+    }
+    return false;
+}
+
+/**
+ * Checks the probing pre-filters of a module against an input.
+ * \return false if the module is known not to handle the input
+ */
+static bool module_match_hints(const module_t *m,
+                               const struct vlc_probe_hints *hints)
+{
+    bool filtered = false;
+
+    if (m->probe_extensions != NULL)
+    {
+        if (hints->extension != NULL
+         && module_match_list(m->probe_extensions, hints->extension))
+            return true;
+        filtered = true;
+    }
+
+    if (m->probe_mime_types != NULL)
+    {
+        if (hints->mime_type != NULL
+         && module_match_list(m->probe_mime_types, hints->mime_type))
+            return true;
+        filtered = true;
+    }
+
+    if (m->probe_magic != NULL && m->probe_magic[0] != '\0')
+    {
+        size_t offset = m->probe_magic_offset;
+        size_t len = strlen(m->probe_magic);
+
+        if (hints->peek == NULL)
+            return true; /* cannot tell */
+
+        if (offset <= hints->peek_size && len <= hints->peek_size - offset)
+        {
+            if (!memcmp(hints->peek + offset, m->probe_magic, len))
+                return true;
+        }
+        else if (!hints->peek_eof)
+            return true; /* cannot tell */
+        filtered = true;
+    }
+
+    return !filtered;
+}
+
+struct module_probe_report
+{
+    const struct vlc_probe_hints *hints;
+    bool trace;
+    unsigned tried;
+    unsigned skipped;
+    mtime_t duration;
+};
+
+static int module_try(vlc_object_t *obj, module_t *m,
+                      struct module_probe_report *report,
+                      vlc_activate_t init, va_list args)
+{
+    if (report->hints != NULL && !obj->obj.force
+     && !module_match_hints(m, report->hints))
+    {
+        report->skipped++;
+        if (report->trace)
+            msg_Dbg(obj, "skipping %s module \"%s\" (pre-filter)",
+                    m->psz_capability, module_get_object(m));
+        return VLC_EGENERIC;
+    }
+
+    mtime_t start = mdate();
+    int ret = module_load(obj, m, init, args);
+    mtime_t duration = mdate() - start;
+
+    report->tried++;
+    report->duration += duration;
+    if (report->trace)
+        msg_Dbg(obj, "probed %s module \"%s\": %s in %"PRId64" us",
+                m->psz_capability, module_get_object(m),
+                (ret == VLC_SUCCESS) ? "success" : "failure", duration);
+    return ret;
+}
+
+static module_t *vlc_module_load_va(vlc_object_t *obj, const char *capability,
+                                    const char *name, bool strict,
+                                    const struct vlc_probe_hints *hints,
+                                    vlc_activate_t probe, va_list args)
 {
     char *var = NULL;
 
@@ -242,9 +323,11 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
 
     module_t *module = NULL;
     const bool b_force_backup = obj->obj.force; /* FIXME: remove this */
-    va_list args;
+    struct module_probe_report report = {
+        .hints = hints,
+        .trace = var_InheritBool(obj, "probe-trace"),
+    };
 
-    va_start(args, probe);
     while (*name)
     {
         char buf[32];
@@ -276,7 +359,7 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
                 continue;
             mods[i] = NULL; // only try each module once at most...
 
-            int ret = module_load (obj, cand, probe, args);
+            int ret = module_try (obj, cand, &report, probe, args);
             switch (ret)
             {
                 case VLC_SUCCESS:
@@ -298,7 +381,7 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
             if (cand == NULL || module_get_score (cand) <= 0)
                 continue;
 
-            int ret = module_load (obj, cand, probe, args);
+            int ret = module_try (obj, cand, &report, probe, args);
             switch (ret)
             {
                 case VLC_SUCCESS:
@@ -310,11 +393,15 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
         }
     }
 done:
-    va_end (args);
     obj->obj.force = b_force_backup;
     module_list_free (mods);
     free (var);
 
+    if (hints != NULL || report.trace)
+        msg_Dbg (obj, "%s probing: %u module(s) tried in %"PRId64" us, "
+                 "%u skipped", capability, report.tried, report.duration,
+                 report.skipped);
+
     if (module != NULL)
     {
         msg_Dbg (obj, "using %s module \"%s\"", capability,
@@ -326,6 +413,64 @@ done:
     return module;
 }
 
+#undef vlc_module_load
+/**
+ * Finds and instantiates the best module of a certain type.
+ * All candidates modules having the specified capability and name will be
+ * sorted in decreasing order of priority. Then the probe callback will be
+ * invoked for each module, until it succeeds (returns 0), or all candidate
+ * module failed to initialize.
+ *
+ * The probe callback first parameter is the address of the module entry point.
+ * Further parameters are passed as an argument list; it corresponds to the
+ * variable arguments passed to this function. This scheme is meant to
+ * support arbitrary prototypes for the module entry point.
+ *
+ * \param obj VLC object
+ * \param capability capability, i.e. class of module
+ * \param name name of the module asked, if any
+ * \param strict if true, do not fallback to plugin with a different name
+ *                 but the same capability
+ * \param probe module probe callback
+ * \return the module or NULL in case of a failure
+ */
+module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
+                          const char *name, bool strict,
+                          vlc_activate_t probe, ...)
+{
+    va_list args;
+
+    va_start(args, probe);
+    module_t *module = vlc_module_load_va(obj, capability, name, strict,
+                                          NULL, probe, args);
+    va_end(args);
+    return module;
+}
+
+#undef vlc_module_load_hinted
+/**
+ * Finds and instantiates the best module of a certain type for an input.
+ *
+ * This works like vlc_module_load(), except that modules whose probing
+ * pre-filters do not match the input description are skipped without being
+ * loaded, unless they are explicitly requested.
+ *
+ * \param hints description of the input
+ */
+module_t *vlc_module_load_hinted(vlc_object_t *obj, const char *capability,
+                                 const char *name, bool strict,
+                                 const struct vlc_probe_hints *hints,
+                                 vlc_activate_t probe, ...)
+{
+    va_list args;
+
+    va_start(args, probe);
+    module_t *module = vlc_module_load_va(obj, capability, name, strict,
+                                          hints, probe, args);
+    va_end(args);
+    return module;
+}
+
 #undef vlc_module_unload
 /**
  * Deinstantiates a module.
@@ -25,6 +25,7 @@
 # define LIBVLC_MODULES_H 1
 
 # include <vlc_atomic.h>
+# include <vlc_modules.h>
 
 /** The plugin handle type */
 typedef void *module_handle_t;
@@ -96,6 +97,12 @@ struct module_t
     const char *psz_capability;                              /**< Capability */
     int      i_score;                          /**< Score for the capability */
 
+    /* Probing pre-filters (see set_probe_extensions() and co) */
+    const char *probe_extensions;
+    const char *probe_mime_types;
+    const char *probe_magic;
+    unsigned    probe_magic_offset;
+
     /* Callbacks */
     const char *activate_name;
     const char *deactivate_name;
@@ -103,6 +110,25 @@ struct module_t
     void *pf_deactivate;
 };
 
+/**
+ * Description of the input to probe, matched against the module pre-filters.
+ */
+struct vlc_probe_hints
+{
+    const char *extension; /**< File extension without dot, or NULL */
+    const char *mime_type; /**< MIME type, or NULL */
+    const uint8_t *peek; /**< Start of the input, or NULL if unknown */
+    size_t peek_size; /**< Number of bytes available at peek */
+    bool peek_eof; /**< Whether the input ends after peek_size bytes */
+};
+
+module_t *vlc_module_load_hinted(vlc_object_t *, const char *capability,
+                                 const char *name, bool strict,
+                                 const struct vlc_probe_hints *,
+                                 vlc_activate_t probe, ...);
+#define vlc_module_load_hinted(o, c, n, s, h, ...) \
+        vlc_module_load_hinted(VLC_OBJECT(o), c, n, s, h, __VA_ARGS__)
+
 vlc_plugin_t *vlc_plugin_create(void);
 void vlc_plugin_destroy(vlc_plugin_t *);
 module_t *vlc_module_create(vlc_plugin_t *);
@@ -127,8 +153,11 @@ void *module_Lookup (module_handle_t, const char *);
 void module_Unload (module_handle_t);
 
 /* Plugins cache */
-vlc_plugin_t *vlc_cache_load(vlc_object_t *, const char *, block_t **);
-vlc_plugin_t *vlc_cache_lookup(vlc_plugin_t **, const char *relpath);
+struct vlc_cache;
+struct vlc_cache *vlc_cache_load(vlc_object_t *, const char *, block_t **);
+vlc_plugin_t *vlc_cache_lookup(struct vlc_cache *, const char *relpath);
+vlc_plugin_t *vlc_cache_next(struct vlc_cache *);
+void vlc_cache_close(struct vlc_cache *);
 
 void CacheSave(vlc_object_t *, const char *, vlc_plugin_t *const *, size_t);
 
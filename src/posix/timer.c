@@ -1,5 +1,5 @@
 /*****************************************************************************
- * timer.c: simple threaded timer
+ * timer.c: timer wheel
  *****************************************************************************
  * Copyright (C) 2009-2012 Rémi Denis-Courmont
  *
@@ -22,8 +22,8 @@
 # include "config.h"
 #endif
 
-#include <stdnoreturn.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 #include <assert.h>
 
@@ -36,127 +36,582 @@
  * they typically require one thread per timer plus one thread per iteration,
  * which is inefficient and overkill (unless you need multiple iteration
  * of the same timer concurrently).
- * Thus, this is a generic manual implementation of timers using a thread.
+ *
+ * Thus, this is a generic manual implementation of timers. All timers of the
+ * process share a hierarchical timer wheel served by a single dispatch
+ * thread. Expired timers are queued to a small pool of worker threads, so that
+ * a slow callback does not delay the other timers. A given timer callback
+ * never runs concurrently with itself.
+ *
+ * The wheel has TIMER_LEVELS levels of TIMER_SLOTS slots. Each level-0 slot
+ * spans one tick, and each slot of level N spans a whole rotation of level
+ * N-1. Slots of higher levels are cascaded into the lower ones as time goes.
+ * Arming and disarming a timer are O(1). Ticks are only used to sort timers:
+ * the dispatch thread wakes up at the exact deadline of due timers.
  */
+#define TIMER_TICK_SHIFT 10 /* 1.024 ms per tick */
+#define TIMER_SLOT_BITS  5
+#define TIMER_SLOTS      (1 << TIMER_SLOT_BITS)
+#define TIMER_SLOT_MASK  (TIMER_SLOTS - 1)
+#define TIMER_LEVELS     5 /* about 9.5 hours */
+#define TIMER_SPAN       (INT64_C(1) << (TIMER_SLOT_BITS * TIMER_LEVELS))
+
+#define TIMER_MAX_WORKERS  16
+#define TIMER_IDLE_TIMEOUT (5 * CLOCK_FREQ)
+
+struct vlc_timer_wheel;
 
 struct vlc_timer
 {
-    vlc_thread_t thread;
-    vlc_cond_t   reschedule;
-    vlc_mutex_t  lock;
+    struct vlc_timer_wheel *wheel;
+    struct vlc_timer *next; /**< Next timer in the same slot */
+    struct vlc_timer **pprev; /**< Link to this timer, NULL if not armed */
+    struct vlc_timer *next_pending; /**< Next timer in the workers queue */
+    uint8_t      level, slot;
+    bool         pending; /**< Queued for the workers */
+    bool         running; /**< Callback running */
+    bool         rerun; /**< Expired again while running */
+
     void       (*func) (void *);
     void        *data;
     mtime_t      value, interval;
     atomic_uint  overruns;
 };
 
-noreturn static void *vlc_timer_thread (void *data)
+struct vlc_timer_worker
 {
-    struct vlc_timer *timer = data;
+    struct vlc_timer_wheel *wheel;
+    struct vlc_timer_worker *next; /**< Next exited worker */
+    vlc_thread_t thread;
+};
 
-    vlc_mutex_lock (&timer->lock);
-    mutex_cleanup_push (&timer->lock);
+struct vlc_timer_wheel
+{
+    vlc_mutex_t  lock;
+    vlc_cond_t   reschedule; /**< Wakes the dispatch thread up */
+    vlc_cond_t   work; /**< Wakes an idle worker up */
+    vlc_cond_t   done; /**< Signals the end of a callback */
+    vlc_thread_t thread;
+    bool         stop;
 
-    for (;;)
+    int64_t      tick; /**< Current tick */
+    unsigned     armed; /**< Number of timers in the wheel */
+    uint32_t     bitmap[TIMER_LEVELS]; /**< Non-empty slots */
+    struct vlc_timer *slots[TIMER_LEVELS][TIMER_SLOTS];
+
+    struct vlc_timer *pending_head, **pending_tailp;
+    unsigned     workers; /**< Live worker threads */
+    unsigned     idle; /**< Idle worker threads */
+    struct vlc_timer_worker *zombies; /**< Exited worker threads */
+};
+
+static vlc_mutex_t wheel_lock = VLC_STATIC_MUTEX;
+static struct vlc_timer_wheel *wheel = NULL;
+static unsigned wheel_refs = 0;
+
+/*** Wheel ***/
+
+static void vlc_timer_link(struct vlc_timer_wheel *w, struct vlc_timer *timer)
+{
+    int64_t expires = timer->value >> TIMER_TICK_SHIFT;
+    int64_t delta = expires - w->tick;
+    unsigned level = 0;
+
+    assert(timer->pprev == NULL);
+
+    if (delta < 0)
+        expires = w->tick; /* already due */
+    else
     {
-        while (timer->value == 0)
-        {
-            assert(timer->interval == 0);
-            vlc_cond_wait (&timer->reschedule, &timer->lock);
+        if (delta >= TIMER_SPAN)
+        {   /* Beyond the wheel: park in the last slot, re-cascade later */
+            expires = w->tick + TIMER_SPAN - 1;
+            delta = TIMER_SPAN - 1;
         }
 
-        if (timer->interval != 0)
+        while (delta >= (INT64_C(1) << (TIMER_SLOT_BITS * (level + 1))))
+            level++;
+    }
+
+    unsigned slot = (expires >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK;
+    struct vlc_timer **head = &w->slots[level][slot];
+
+    timer->level = level;
+    timer->slot = slot;
+    timer->next = *head;
+    if (timer->next != NULL)
+        timer->next->pprev = &timer->next;
+    timer->pprev = head;
+    *head = timer;
+    w->bitmap[level] |= 1u << slot;
+    w->armed++;
+}
+
+static void vlc_timer_unlink(struct vlc_timer_wheel *w,
+                             struct vlc_timer *timer)
+{
+    if (timer->pprev == NULL)
+        return;
+
+    *timer->pprev = timer->next;
+    if (timer->next != NULL)
+        timer->next->pprev = timer->pprev;
+    timer->pprev = NULL;
+
+    if (w->slots[timer->level][timer->slot] == NULL)
+        w->bitmap[timer->level] &= ~(1u << timer->slot);
+    assert(w->armed > 0);
+    w->armed--;
+}
+
+/**
+ * Finds the first tick after the current one that has work to do: either a
+ * non-empty level-0 slot, or a non-empty slot of a higher level to cascade.
+ */
+static int64_t vlc_timer_next_tick(const struct vlc_timer_wheel *w)
+{
+    int64_t next = INT64_MAX;
+
+    for (unsigned level = 0; level < TIMER_LEVELS; level++)
+    {
+        uint32_t bitmap = w->bitmap[level];
+        if (bitmap == 0)
+            continue;
+
+        unsigned shift = TIMER_SLOT_BITS * level;
+        int64_t base = (w->tick >> shift) + 1;
+        unsigned rot = base & TIMER_SLOT_MASK;
+
+        /* Rotate so that bit 0 stands for the slot after the current one */
+        if (rot != 0)
+            bitmap = (bitmap >> rot) | (bitmap << (TIMER_SLOTS - rot));
+
+        int64_t tick = (base + ctz(bitmap)) << shift;
+        if (tick < next)
+            next = tick;
+    }
+    return next;
+}
+
+static void vlc_timer_cascade(struct vlc_timer_wheel *w, unsigned level)
+{
+    unsigned slot = (w->tick >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK;
+    struct vlc_timer *timer = w->slots[level][slot];
+
+    while (timer != NULL)
+    {
+        struct vlc_timer *next = timer->next;
+
+        vlc_timer_unlink(w, timer);
+        vlc_timer_link(w, timer);
+        timer = next;
+    }
+}
+
+/**
+ * Advances the wheel up to the given date.
+ * \return an expired timer (already rearmed or disarmed), or NULL if none
+ */
+static struct vlc_timer *vlc_timer_expire(struct vlc_timer_wheel *w,
+                                          mtime_t now)
+{
+    int64_t now_tick = now >> TIMER_TICK_SHIFT;
+
+    for (;;)
+    {
+        struct vlc_timer *timer = w->slots[0][w->tick & TIMER_SLOT_MASK];
+
+        while (timer != NULL)
         {
-            mtime_t now = mdate();
+            if (timer->value <= now)
+            {
+                vlc_timer_unlink(w, timer);
 
-            if (now > timer->value)
-            {   /* Update overrun counter */
-                unsigned misses = (now - timer->value) / timer->interval;
+                if (timer->interval != 0)
+                {   /* Update overrun counter and rearm */
+                    unsigned misses = (now - timer->value) / timer->interval;
 
-                timer->value += misses * timer->interval;
-                assert(timer->value <= now);
-                atomic_fetch_add_explicit(&timer->overruns, misses,
-                                          memory_order_relaxed);
+                    atomic_fetch_add_explicit(&timer->overruns, misses,
+                                              memory_order_relaxed);
+                    timer->value += (misses + 1) * timer->interval;
+                    vlc_timer_link(w, timer);
+                }
+                else
+                    timer->value = 0; /* disarm */
+                return timer;
             }
+            timer = timer->next;
         }
 
-        mtime_t value = timer->value;
+        if (w->tick >= now_tick)
+            return NULL;
 
-        if (vlc_cond_timedwait(&timer->reschedule, &timer->lock, value) == 0)
-            continue;
+        int64_t next = vlc_timer_next_tick(w);
+        if (next > now_tick)
+        {   /* Nothing to do in between */
+            w->tick = now_tick;
+            return NULL;
+        }
+
+        w->tick = next;
+        /* Cascade higher levels first, so that their timers can be cascaded
+         * further down during the same tick if needed. */
+        for (unsigned level = TIMER_LEVELS - 1; level > 0; level--)
+            if ((next & ((INT64_C(1) << (TIMER_SLOT_BITS * level)) - 1)) == 0)
+                vlc_timer_cascade(w, level);
+    }
+}
 
-        if (likely(timer->value <= value))
+/**
+ * \return the date at which the dispatch thread must wake up
+ */
+static mtime_t vlc_timer_deadline(const struct vlc_timer_wheel *w)
+{
+    if (w->armed == 0)
+        return INT64_MAX;
+
+    const struct vlc_timer *timer = w->slots[0][w->tick & TIMER_SLOT_MASK];
+    if (timer != NULL)
+    {   /* Timers of the current tick are not due yet */
+        mtime_t deadline = INT64_MAX;
+
+        for (; timer != NULL; timer = timer->next)
+            if (timer->value < deadline)
+                deadline = timer->value;
+        return deadline;
+    }
+
+    return vlc_timer_next_tick(w) << TIMER_TICK_SHIFT;
+}
+
+/*** Workers ***/
+
+static void vlc_timer_reap(struct vlc_timer_wheel *w)
+{
+    while (w->zombies != NULL)
+    {
+        struct vlc_timer_worker *worker = w->zombies;
+
+        w->zombies = worker->next;
+        vlc_join(worker->thread, NULL);
+        free(worker);
+    }
+}
+
+static void *vlc_timer_worker_thread(void *data)
+{
+    struct vlc_timer_worker *worker = data;
+    struct vlc_timer_wheel *w = worker->wheel;
+
+    vlc_mutex_lock(&w->lock);
+    for (;;)
+    {
+        struct vlc_timer *timer = w->pending_head;
+
+        if (timer == NULL)
         {
-            timer->value += timer->interval; /* rearm */
+            if (w->stop)
+                break;
+
+            w->idle++;
+            int val = vlc_cond_timedwait(&w->work, &w->lock,
+                                         mdate() + TIMER_IDLE_TIMEOUT);
+            w->idle--;
 
-            if (timer->interval == 0)
-                timer->value = 0; /* disarm */
+            if (val != 0 && w->pending_head == NULL && w->workers > 1)
+                break; /* surplus worker */
+            continue;
         }
 
-        vlc_mutex_unlock (&timer->lock);
+        w->pending_head = timer->next_pending;
+        if (w->pending_head == NULL)
+            w->pending_tailp = &w->pending_head;
+        timer->pending = false;
+        timer->running = true;
+        vlc_mutex_unlock(&w->lock);
+
+        int canc = vlc_savecancel();
+        timer->func(timer->data);
+        vlc_restorecancel(canc);
+
+        vlc_mutex_lock(&w->lock);
+        timer->running = false;
 
-        int canc = vlc_savecancel ();
-        timer->func (timer->data);
-        vlc_restorecancel (canc);
+        if (timer->rerun)
+        {
+            timer->rerun = false;
+            timer->pending = true;
+            timer->next_pending = NULL;
+            *w->pending_tailp = timer;
+            w->pending_tailp = &timer->next_pending;
+        }
+        vlc_cond_broadcast(&w->done);
+    }
+
+    w->workers--;
+    worker->next = w->zombies;
+    w->zombies = worker;
+    vlc_cond_broadcast(&w->done);
+    vlc_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+static int vlc_timer_worker_spawn(struct vlc_timer_wheel *w)
+{
+    struct vlc_timer_worker *worker = malloc(sizeof (*worker));
+    if (unlikely(worker == NULL))
+        return ENOMEM;
+
+    vlc_timer_reap(w);
+
+    worker->wheel = w;
+    if (vlc_clone(&worker->thread, vlc_timer_worker_thread, worker,
+                  VLC_THREAD_PRIORITY_INPUT))
+    {
+        free(worker);
+        return ENOMEM;
+    }
+    w->workers++;
+    return 0;
+}
+
+/**
+ * Hands an expired timer over to the workers.
+ */
+static void vlc_timer_queue(struct vlc_timer_wheel *w, struct vlc_timer *timer)
+{
+    if (timer->pending || timer->rerun)
+    {   /* Already going to run */
+        if (timer->interval != 0)
+            atomic_fetch_add_explicit(&timer->overruns, 1,
+                                      memory_order_relaxed);
+        return;
+    }
 
-        vlc_mutex_lock (&timer->lock);
+    if (timer->running)
+    {   /* Run again once the callback returns */
+        timer->rerun = true;
+        return;
     }
 
-    vlc_cleanup_pop ();
-    vlc_assert_unreachable ();
+    timer->pending = true;
+    timer->next_pending = NULL;
+    *w->pending_tailp = timer;
+    w->pending_tailp = &timer->next_pending;
+
+    if (w->idle > 0)
+        vlc_cond_signal(&w->work);
+    else if (w->workers < TIMER_MAX_WORKERS)
+        vlc_timer_worker_spawn(w); /* on error, an existing worker will do */
 }
 
+static void vlc_timer_dequeue(struct vlc_timer_wheel *w,
+                              struct vlc_timer *timer)
+{
+    timer->rerun = false;
+    if (!timer->pending)
+        return;
+
+    struct vlc_timer **pp = &w->pending_head;
+
+    while (*pp != timer)
+        pp = &(*pp)->next_pending;
+
+    *pp = timer->next_pending;
+    if (*pp == NULL)
+        w->pending_tailp = pp;
+    timer->pending = false;
+}
+
+static void *vlc_timer_thread(void *data)
+{
+    struct vlc_timer_wheel *w = data;
+
+    vlc_mutex_lock(&w->lock);
+    while (!w->stop)
+    {
+        struct vlc_timer *timer;
+        mtime_t now = mdate();
+
+        while ((timer = vlc_timer_expire(w, now)) != NULL)
+            vlc_timer_queue(w, timer);
+
+        mtime_t deadline = vlc_timer_deadline(w);
+
+        if (deadline == INT64_MAX)
+            vlc_cond_wait(&w->reschedule, &w->lock);
+        else
+            vlc_cond_timedwait(&w->reschedule, &w->lock, deadline);
+    }
+    vlc_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/*** Wheel life cycle ***/
+
+static struct vlc_timer_wheel *vlc_timer_wheel_hold(void)
+{
+    struct vlc_timer_wheel *w;
+
+    vlc_mutex_lock(&wheel_lock);
+    if (wheel_refs == 0)
+    {
+        w = calloc(1, sizeof (*w));
+        if (unlikely(w == NULL))
+            goto error;
+
+        vlc_mutex_init(&w->lock);
+        vlc_cond_init(&w->reschedule);
+        vlc_cond_init(&w->work);
+        vlc_cond_init(&w->done);
+        w->pending_tailp = &w->pending_head;
+
+        /* Always keep one worker around */
+        if (vlc_timer_worker_spawn(w))
+            goto error_worker;
+
+        if (vlc_clone(&w->thread, vlc_timer_thread, w,
+                      VLC_THREAD_PRIORITY_INPUT))
+        {
+            vlc_mutex_lock(&w->lock);
+            w->stop = true;
+            vlc_cond_broadcast(&w->work);
+            while (w->workers > 0)
+                vlc_cond_wait(&w->done, &w->lock);
+            vlc_timer_reap(w);
+            vlc_mutex_unlock(&w->lock);
+            goto error_worker;
+        }
+        wheel = w;
+    }
+    else
+        w = wheel;
+
+    wheel_refs++;
+    vlc_mutex_unlock(&wheel_lock);
+    return w;
+
+error_worker:
+    vlc_cond_destroy(&w->done);
+    vlc_cond_destroy(&w->work);
+    vlc_cond_destroy(&w->reschedule);
+    vlc_mutex_destroy(&w->lock);
+    free(w);
+error:
+    vlc_mutex_unlock(&wheel_lock);
+    return NULL;
+}
+
+static void vlc_timer_wheel_release(void)
+{
+    vlc_mutex_lock(&wheel_lock);
+    assert(wheel_refs > 0);
+    if (--wheel_refs == 0)
+    {
+        struct vlc_timer_wheel *w = wheel;
+
+        assert(w->armed == 0 && w->pending_head == NULL);
+        vlc_mutex_lock(&w->lock);
+        w->stop = true;
+        vlc_cond_signal(&w->reschedule);
+        vlc_cond_broadcast(&w->work);
+        vlc_mutex_unlock(&w->lock);
+        vlc_join(w->thread, NULL);
+
+        vlc_mutex_lock(&w->lock);
+        while (w->workers > 0)
+            vlc_cond_wait(&w->done, &w->lock);
+        vlc_timer_reap(w);
+        vlc_mutex_unlock(&w->lock);
+
+        vlc_cond_destroy(&w->done);
+        vlc_cond_destroy(&w->work);
+        vlc_cond_destroy(&w->reschedule);
+        vlc_mutex_destroy(&w->lock);
+        free(w);
+        wheel = NULL;
+    }
+    vlc_mutex_unlock(&wheel_lock);
+}
+
+/*** API ***/
+
 int vlc_timer_create (vlc_timer_t *id, void (*func) (void *), void *data)
 {
     struct vlc_timer *timer = malloc (sizeof (*timer));
 
     if (unlikely(timer == NULL))
         return ENOMEM;
-    vlc_mutex_init (&timer->lock);
-    vlc_cond_init (&timer->reschedule);
+
+    timer->wheel = vlc_timer_wheel_hold();
+    if (unlikely(timer->wheel == NULL))
+    {
+        free (timer);
+        return ENOMEM;
+    }
+
     assert (func);
+    timer->pprev = NULL;
+    timer->pending = false;
+    timer->running = false;
+    timer->rerun = false;
     timer->func = func;
     timer->data = data;
     timer->value = 0;
     timer->interval = 0;
     atomic_init(&timer->overruns, 0);
 
-    if (vlc_clone (&timer->thread, vlc_timer_thread, timer,
-                   VLC_THREAD_PRIORITY_INPUT))
-    {
-        vlc_cond_destroy (&timer->reschedule);
-        vlc_mutex_destroy (&timer->lock);
-        free (timer);
-        return ENOMEM;
-    }
-
     *id = timer;
     return 0;
 }
 
 void vlc_timer_destroy (vlc_timer_t timer)
 {
-    vlc_cancel (timer->thread);
-    vlc_join (timer->thread, NULL);
-    vlc_cond_destroy (&timer->reschedule);
-    vlc_mutex_destroy (&timer->lock);
+    struct vlc_timer_wheel *w = timer->wheel;
+
+    vlc_mutex_lock (&w->lock);
+    for (;;)
+    {
+        vlc_timer_unlink (w, timer);
+        vlc_timer_dequeue (w, timer);
+        if (!timer->running)
+            break;
+        /* The callback may rearm the timer: disarm again afterwards */
+        vlc_cond_wait (&w->done, &w->lock);
+    }
+    vlc_mutex_unlock (&w->lock);
+
     free (timer);
+    vlc_timer_wheel_release ();
 }
 
 void vlc_timer_schedule (vlc_timer_t timer, bool absolute,
                          mtime_t value, mtime_t interval)
 {
+    struct vlc_timer_wheel *w = timer->wheel;
+    mtime_t now = mdate();
+
     if (value == 0)
         interval = 0;
     else
     if (!absolute)
-        value += mdate();
+        value += now;
 
-    vlc_mutex_lock (&timer->lock);
+    vlc_mutex_lock (&w->lock);
+    /* An expiry not run yet belongs to the former schedule */
+    vlc_timer_unlink (w, timer);
+    vlc_timer_dequeue (w, timer);
     timer->value = value;
     timer->interval = interval;
-    vlc_cond_signal (&timer->reschedule);
-    vlc_mutex_unlock (&timer->lock);
+
+    if (value != 0)
+    {
+        if (w->armed == 0)
+            w->tick = now >> TIMER_TICK_SHIFT; /* skip idle time */
+        vlc_timer_link (w, timer);
+        vlc_cond_signal (&w->reschedule);
+    }
+    vlc_mutex_unlock (&w->lock);
 }
 
 unsigned vlc_timer_getoverrun (vlc_timer_t timer)
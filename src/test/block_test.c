@@ -86,11 +86,167 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void *test_block_pool_thread (void *data)
+{
+    block_t *chain = data, **pp = &chain;
+
+    /* Release blocks allocated by another thread, and allocate new ones */
+    while (*pp != NULL)
+    {
+        block_t *b = *pp;
+        size_t size = b->i_buffer;
+
+        for (size_t i = 0; i < size; i++)
+            assert (b->p_buffer[i] == (uint8_t)size);
+
+        *pp = block_Alloc (size);
+        assert (*pp != NULL);
+        memset ((*pp)->p_buffer, (uint8_t)size, size);
+        (*pp)->p_next = b->p_next;
+        b->p_next = NULL;
+        block_Release (b);
+        pp = &(*pp)->p_next;
+    }
+    return chain;
+}
+
+static void test_block_pool (void)
+{
+    static const size_t sizes[] = { 0, 1, 188, 1316, 1500, 4096, 65536,
+                                    200000, 1 << 20 };
+    block_t *chain = NULL;
+
+    for (unsigned round = 0; round < 100; round++)
+        for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+        {
+            block_t *b = block_Alloc (sizes[i]);
+            assert (b != NULL);
+            assert (b->i_buffer == sizes[i]);
+            assert (((uintptr_t)b->p_buffer % 32) == 0);
+            memset (b->p_buffer, (uint8_t)sizes[i], sizes[i]);
+            block_ChainAppend (&chain, b);
+        }
+
+    vlc_thread_t th;
+    void *ret;
+
+    assert (vlc_clone (&th, test_block_pool_thread, chain,
+                       VLC_THREAD_PRIORITY_LOW) == 0);
+    vlc_join (th, &ret);
+    chain = ret;
+
+    /* Grow recycled blocks in place and across size classes */
+    for (block_t *b = chain; b != NULL; b = b->p_next)
+        for (size_t i = 0; i < b->i_buffer; i++)
+            assert (b->p_buffer[i] == (uint8_t)b->i_buffer);
+
+    block_t *b = block_Alloc (188);
+    assert (b != NULL);
+    memcpy (b->p_buffer, text, sizeof (text));
+    for (size_t size = 188; size < 300000; size *= 3)
+    {
+        b = block_Realloc (b, 0, size);
+        assert (b != NULL);
+        assert (!memcmp (b->p_buffer, text, sizeof (text)));
+    }
+    block_Release (b);
+    block_ChainRelease (chain);
+}
+
+#define FIFO_PRODUCERS 4
+#define FIFO_BLOCKS    10000
+
+static void *test_fifo_producer (void *data)
+{
+    block_fifo_t *fifo = data;
+
+    for (unsigned i = 0; i < FIFO_BLOCKS; i++)
+    {
+        block_t *b = block_Alloc (sizeof (unsigned));
+        assert (b != NULL);
+        memcpy (b->p_buffer, &i, sizeof (i));
+        block_FifoPut (fifo, b);
+    }
+    return NULL;
+}
+
+static void test_fifo_lockless (void)
+{
+    block_fifo_t *fifo = block_FifoNewLockless ();
+    assert (fifo != NULL);
+
+    /* Single producer: chains keep their order */
+    block_t *chain = NULL;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        block_t *b = block_Alloc (i);
+        assert (b != NULL);
+        block_ChainAppend (&chain, b);
+    }
+    block_FifoPut (fifo, chain);
+    vlc_fifo_Lock (fifo);
+    assert (vlc_fifo_GetCount (fifo) == 3);
+    assert (vlc_fifo_GetBytes (fifo) == 0 + 1 + 2);
+    vlc_fifo_Unlock (fifo);
+    for (unsigned i = 0; i < 3; i++)
+    {
+        block_t *b = block_FifoGet (fifo);
+        assert (b->i_buffer == i);
+        block_Release (b);
+    }
+
+    /* Multiple producers: per-producer order is preserved */
+    vlc_thread_t th[FIFO_PRODUCERS];
+    for (unsigned i = 0; i < FIFO_PRODUCERS; i++)
+        assert (vlc_clone (th + i, test_fifo_producer, fifo,
+                           VLC_THREAD_PRIORITY_LOW) == 0);
+
+    /* The first block of each producer is tagged by its value 0, so only
+     * count ordering violations over the whole stream. */
+    unsigned last[FIFO_PRODUCERS] = { 0 }, zeros = 0;
+    for (unsigned n = 0; n < FIFO_PRODUCERS * FIFO_BLOCKS; n++)
+    {
+        block_t *b = block_FifoGet (fifo);
+        unsigned v;
+
+        memcpy (&v, b->p_buffer, sizeof (v));
+        block_Release (b);
+
+        if (v == 0)
+        {
+            assert (zeros < FIFO_PRODUCERS);
+            last[zeros++] = 0;
+            continue;
+        }
+
+        /* Some producer must have sent v - 1 last */
+        unsigned i;
+        for (i = 0; i < zeros; i++)
+            if (last[i] == v - 1)
+                break;
+        assert (i < zeros);
+        last[i] = v;
+    }
+
+    for (unsigned i = 0; i < FIFO_PRODUCERS; i++)
+    {
+        vlc_join (th[i], NULL);
+        assert (last[i] == FIFO_BLOCKS - 1);
+    }
+
+    vlc_fifo_Lock (fifo);
+    assert (vlc_fifo_IsEmpty (fifo));
+    vlc_fifo_Unlock (fifo);
+    block_FifoRelease (fifo);
+}
+
 int main (void)
 {
     test_block_File(false);
     test_block_File(true);
     test_block ();
+    test_block_pool ();
+    test_fifo_lockless ();
     return 0;
 }
 
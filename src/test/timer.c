@@ -48,6 +48,214 @@ static void callback (void *ptr)
     vlc_mutex_unlock (&data->lock);
 }
 
+#define MANY_TIMERS 100
+
+struct many_data
+{
+    vlc_timer_t timer;
+    vlc_mutex_t *lock;
+    vlc_cond_t  *wait;
+    unsigned    *count;
+    mtime_t      deadline;
+    mtime_t      fired;
+};
+
+static void many_callback (void *ptr)
+{
+    struct many_data *data = ptr;
+    mtime_t now = mdate ();
+
+    vlc_mutex_lock (data->lock);
+    assert (data->fired == 0); /* one-shot timers */
+    data->fired = now;
+    (*data->count)++;
+    vlc_cond_signal (data->wait);
+    vlc_mutex_unlock (data->lock);
+}
+
+/* Many one-shot timers sharing the same timer service, some of them far
+ * beyond the others, some of them rescheduled or disarmed. */
+static void test_many (void)
+{
+    struct many_data data[MANY_TIMERS];
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    unsigned count = 0, expected = 0;
+
+    vlc_mutex_init (&lock);
+    vlc_cond_init (&wait);
+
+    for (unsigned i = 0; i < MANY_TIMERS; i++)
+    {
+        data[i].lock = &lock;
+        data[i].wait = &wait;
+        data[i].count = &count;
+        data[i].fired = 0;
+        int val = vlc_timer_create (&data[i].timer, many_callback, data + i);
+        assert (val == 0);
+    }
+
+    mtime_t now = mdate ();
+
+    for (unsigned i = 0; i < MANY_TIMERS; i++)
+    {
+        /* Spread over 0 to 200 ms, with a few timers far away */
+        mtime_t delay = (i % 10 == 9) ? (CLOCK_FREQ << 10)
+                                      : (i * CLOCK_FREQ / 500);
+
+        data[i].deadline = now + delay;
+        vlc_timer_schedule (data[i].timer, true, data[i].deadline, 0);
+    }
+
+    /* Disarm some, move some others */
+    for (unsigned i = 0; i < MANY_TIMERS; i++)
+    {
+        if (i % 10 == 9)
+            continue; /* far timers stay armed until destroyed */
+        if (i % 7 == 3)
+        {
+            vlc_timer_schedule (data[i].timer, false, 0, 0);
+            data[i].deadline = 0;
+            continue;
+        }
+        if (i % 5 == 1)
+        {
+            data[i].deadline = now + CLOCK_FREQ / 20;
+            vlc_timer_schedule (data[i].timer, true, data[i].deadline, 0);
+        }
+        expected++;
+    }
+
+    vlc_mutex_lock (&lock);
+    while (count < expected)
+        vlc_cond_wait (&wait, &lock);
+    vlc_mutex_unlock (&lock);
+
+    for (unsigned i = 0; i < MANY_TIMERS; i++)
+        vlc_timer_destroy (data[i].timer);
+
+    assert (count == expected);
+    for (unsigned i = 0; i < MANY_TIMERS; i++)
+    {
+        if (i % 10 == 9 || data[i].deadline == 0)
+            assert (data[i].fired == 0);
+        else
+            assert (data[i].fired >= data[i].deadline);
+    }
+
+    vlc_cond_destroy (&wait);
+    vlc_mutex_destroy (&lock);
+}
+
+#define BLOCKERS 20 /* more than the timer threads */
+
+struct block_data
+{
+    vlc_timer_t timer;
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;
+    unsigned    entered;
+    unsigned    count;
+    bool        release;
+};
+
+static void block_callback (void *ptr)
+{
+    struct block_data *data = ptr;
+
+    vlc_mutex_lock (&data->lock);
+    data->entered++;
+    vlc_cond_broadcast (&data->wait);
+    while (!data->release)
+        vlc_cond_wait (&data->wait, &data->lock);
+    vlc_mutex_unlock (&data->lock);
+}
+
+static void count_callback (void *ptr)
+{
+    struct block_data *data = ptr;
+
+    vlc_mutex_lock (&data->lock);
+    data->count++;
+    vlc_mutex_unlock (&data->lock);
+}
+
+/* A timer disarmed after it expired, but before its callback ran, or while
+ * its callback runs, must not call it (again). */
+static void test_disarm (void)
+{
+    struct block_data data;
+    vlc_timer_t blockers[BLOCKERS];
+    int val;
+
+    vlc_mutex_init (&data.lock);
+    vlc_cond_init (&data.wait);
+    data.entered = 0;
+    data.count = 0;
+    data.release = false;
+
+    /* Disarmed while running, having expired again meanwhile */
+    val = vlc_timer_create (&data.timer, block_callback, &data);
+    assert (val == 0);
+    vlc_timer_schedule (data.timer, false, 1, CLOCK_FREQ / 1000);
+
+    vlc_mutex_lock (&data.lock);
+    while (data.entered == 0)
+        vlc_cond_wait (&data.wait, &data.lock);
+    vlc_mutex_unlock (&data.lock);
+
+    msleep (CLOCK_FREQ / 50);
+    vlc_timer_schedule (data.timer, false, 0, 0);
+
+    vlc_mutex_lock (&data.lock);
+    data.release = true;
+    vlc_cond_broadcast (&data.wait);
+    vlc_mutex_unlock (&data.lock);
+
+    msleep (CLOCK_FREQ / 20);
+    vlc_mutex_lock (&data.lock);
+    assert (data.entered == 1);
+    vlc_mutex_unlock (&data.lock);
+    vlc_timer_destroy (data.timer);
+
+    /* Disarmed while queued, all the timer threads being busy */
+    data.entered = 0;
+    data.release = false;
+    for (unsigned i = 0; i < BLOCKERS; i++)
+    {
+        val = vlc_timer_create (&blockers[i], block_callback, &data);
+        assert (val == 0);
+        vlc_timer_schedule (blockers[i], false, 1, 0);
+    }
+
+    vlc_mutex_lock (&data.lock);
+    while (data.entered == 0)
+        vlc_cond_wait (&data.wait, &data.lock);
+    vlc_mutex_unlock (&data.lock);
+    msleep (CLOCK_FREQ / 50); /* let every thread take a blocker */
+
+    val = vlc_timer_create (&data.timer, count_callback, &data);
+    assert (val == 0);
+    vlc_timer_schedule (data.timer, false, 1, 0);
+    msleep (CLOCK_FREQ / 50);
+    vlc_timer_schedule (data.timer, false, 0, 0);
+
+    vlc_mutex_lock (&data.lock);
+    data.release = true;
+    vlc_cond_broadcast (&data.wait);
+    while (data.entered < BLOCKERS)
+        vlc_cond_wait (&data.wait, &data.lock);
+    vlc_mutex_unlock (&data.lock);
+
+    for (unsigned i = 0; i < BLOCKERS; i++)
+        vlc_timer_destroy (blockers[i]);
+    msleep (CLOCK_FREQ / 20);
+    vlc_timer_destroy (data.timer);
+    assert (data.count == 0);
+
+    vlc_cond_destroy (&data.wait);
+    vlc_mutex_destroy (&data.lock);
+}
 
 int main (void)
 {
@@ -108,5 +316,7 @@ int main (void)
     vlc_cond_destroy (&data.wait);
     vlc_mutex_destroy (&data.lock);
 
+    test_many ();
+    test_disarm ();
     return 0;
 }
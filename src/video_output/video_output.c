@@ -1005,6 +1005,7 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
             if (blent) {
                 VideoFormatCopyCropAr(&blent->format, &filtered->format);
                 picture_Copy(blent, filtered);
+                vout->p->render_copies.copied++;
                 if (picture_BlendSubpicture(blent, vout->p->spu_blend, subpic)) {
                     picture_Release(todisplay);
                     todisplay = blent;
@@ -1034,6 +1035,7 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
          * pictures from the decoder to the output is unavoidable. */
         VideoFormatCopyCropAr(&direct->format, &todisplay->format);
         picture_Copy(direct, todisplay);
+        vout->p->render_copies.copied++;
         picture_Release(todisplay);
         todisplay = direct;
     }
@@ -1092,6 +1094,7 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
     vout_display_Display(vd, todisplay, subpic);
 
     vout_statistic_AddDisplayed(&vout->p->statistic, 1);
+    vout->p->render_copies.displayed++;
 
     return VLC_SUCCESS;
 }
@@ -1462,6 +1465,9 @@ static int ThreadStart(vout_thread_t *vout, vout_display_state_t *state)
     vout->p->spu_blend_chroma        = 0;
     vout->p->spu_blend               = NULL;
 
+    vout->p->render_copies.displayed = 0;
+    vout->p->render_copies.copied    = 0;
+
     video_format_Print(VLC_OBJECT(vout), "original format", &vout->p->original);
     return VLC_SUCCESS;
 error:
@@ -1480,6 +1486,15 @@ error:
 
 static void ThreadStop(vout_thread_t *vout, vout_display_state_t *state)
 {
+    /* Without copies, the renderer passed the pictures straight through */
+    if (vout->p->render_copies.displayed > 0)
+        msg_Dbg(vout, "%u pictures displayed with %u copies in the renderer "
+                "(%.2f copies per picture)",
+                vout->p->render_copies.displayed,
+                vout->p->render_copies.copied,
+                (double)vout->p->render_copies.copied
+                    / vout->p->render_copies.displayed);
+
     if (vout->p->spu_blend)
         filter_DeleteBlend(vout->p->spu_blend);
 
@@ -136,6 +136,14 @@ struct vout_thread_sys_t
     picture_pool_t  *decoder_pool;
     picture_fifo_t  *decoder_fifo;
     vout_chrono_t   render;           /**< picture render time estimator */
+
+    /* Pictures copied by the renderer of the vout thread, for the blending
+     * of the subpictures or into the display pool. Copies made upstream, by
+     * the decoders or the filters, are not counted (vout thread only) */
+    struct {
+        unsigned    displayed;
+        unsigned    copied;
+    } render_copies;
 };
 
 /* TODO to move them to vlc_vout.h */
@@ -61,14 +61,38 @@ typedef struct {
     spu_heap_entry_t entry[VOUT_MAX_SUBPICTURES];
 } spu_heap_t;
 
+/* Number of scaled region pictures kept across subpictures */
+#define SPU_CACHE_SIZE 16
+
+/* A region picture scaled and converted for a given output. The source
+ * picture is held, so its address identifies it as long as the entry lives.
+ */
+typedef struct {
+    picture_t      *source;                  /**< region picture (key) */
+    video_format_t fmt;                       /**< region format (key) */
+    unsigned       width;                  /**< destination width (key) */
+    unsigned       height;                /**< destination height (key) */
+    vlc_fourcc_t   chroma;                /**< destination chroma (key) */
+    picture_t      *picture;                         /**< scaled picture */
+    uint64_t       last_use;
+} spu_cache_entry_t;
+
+typedef struct {
+    spu_cache_entry_t entry[SPU_CACHE_SIZE];
+    uint64_t          counter;
+} spu_cache_t;
+
 struct spu_private_t {
     vlc_mutex_t  lock;            /* lock to protect all followings fields */
     vlc_object_t *input;
 
     spu_heap_t   heap;
+    spu_cache_t  cache;
 
     int channel;             /**< number of subpicture channels registered */
     filter_t *text;                              /**< text renderer module */
+    vlc_var_handle_t *text_elapsed;       /**< text "spu-elapsed" variable */
+    vlc_var_handle_t *text_rerender;    /**< text "text-rerender" variable */
     filter_t *scale_yuvp;                     /**< scaling module for YUVP */
     filter_t *scale;                    /**< scaling module (all but YUVP) */
     bool force_crop;                     /**< force cropping of subpicture */
@@ -159,6 +183,144 @@ static void SpuHeapClean(spu_heap_t *heap)
     }
 }
 
+/*****************************************************************************
+ * scaled region cache
+ *****************************************************************************
+ * Regions are scaled once and the result is kept in the region private data
+ * for its lifetime. Sources sending the same picture again in new
+ * subpictures (logo, static overlays) share it between regions instead:
+ * the scaled pictures of shared region pictures are cached here, so that
+ * they are not scaled again for every new subpicture. Shared pictures must
+ * not be modified once they are sent, as is already the case for regions.
+ *****************************************************************************/
+static void SpuCacheInit(spu_cache_t *cache)
+{
+    for (int i = 0; i < SPU_CACHE_SIZE; i++)
+        cache->entry[i].source = NULL;
+    cache->counter = 0;
+}
+
+static void SpuCacheDeleteAt(spu_cache_t *cache, int index)
+{
+    spu_cache_entry_t *e = &cache->entry[index];
+
+    picture_Release(e->source);
+    picture_Release(e->picture);
+    video_format_Clean(&e->fmt);
+    e->source = NULL;
+}
+
+static bool SpuCacheMatch(const spu_cache_entry_t *e,
+                          const subpicture_region_t *region,
+                          unsigned width, unsigned height, vlc_fourcc_t chroma)
+{
+    const video_format_t *fmt = &region->fmt;
+
+    if (e->source != region->p_picture ||
+        e->width != width || e->height != height || e->chroma != chroma)
+        return false;
+    if (e->fmt.i_chroma         != fmt->i_chroma ||
+        e->fmt.i_x_offset       != fmt->i_x_offset ||
+        e->fmt.i_y_offset       != fmt->i_y_offset ||
+        e->fmt.i_visible_width  != fmt->i_visible_width ||
+        e->fmt.i_visible_height != fmt->i_visible_height)
+        return false;
+    if (fmt->i_chroma == VLC_CODEC_YUVP &&
+        (e->fmt.p_palette == NULL || fmt->p_palette == NULL ||
+         memcmp(e->fmt.p_palette, fmt->p_palette, sizeof(*fmt->p_palette))))
+        return false;
+    return true;
+}
+
+/**
+ * Looks up the scaled picture of a region, and holds it.
+ */
+static picture_t *SpuCacheGet(spu_cache_t *cache,
+                              const subpicture_region_t *region,
+                              unsigned width, unsigned height,
+                              vlc_fourcc_t chroma)
+{
+    for (int i = 0; i < SPU_CACHE_SIZE; i++) {
+        spu_cache_entry_t *e = &cache->entry[i];
+
+        if (e->source && SpuCacheMatch(e, region, width, height, chroma)) {
+            e->last_use = ++cache->counter;
+            return picture_Hold(e->picture);
+        }
+    }
+    return NULL;
+}
+
+static void SpuCachePut(spu_cache_t *cache, subpicture_region_t *region,
+                        unsigned width, unsigned height, vlc_fourcc_t chroma,
+                        picture_t *picture)
+{
+    /* Use a free entry, or the least recently used one */
+    int index = 0;
+    for (int i = 0; i < SPU_CACHE_SIZE; i++) {
+        const spu_cache_entry_t *e = &cache->entry[i];
+
+        if (!e->source) {
+            index = i;
+            break;
+        }
+        if (e->last_use < cache->entry[index].last_use)
+            index = i;
+    }
+
+    spu_cache_entry_t *e = &cache->entry[index];
+    if (e->source)
+        SpuCacheDeleteAt(cache, index);
+    if (video_format_Copy(&e->fmt, &region->fmt))
+        return;
+    e->source   = picture_Hold(region->p_picture);
+    e->width    = width;
+    e->height   = height;
+    e->chroma   = chroma;
+    e->picture  = picture_Hold(picture);
+    e->last_use = ++cache->counter;
+}
+
+/**
+ * Drops the entries whose source picture is only held by the cache
+ * anymore: it cannot be sent again.
+ */
+static void SpuCachePurge(spu_cache_t *cache)
+{
+    for (int i = 0; i < SPU_CACHE_SIZE; i++) {
+        picture_t *source = cache->entry[i].source;
+        if (!source)
+            continue;
+
+        /* The same source may be cached for several outputs: leave out the
+         * references of the following entries while checking it */
+        unsigned holds = 0;
+        for (int j = i + 1; j < SPU_CACHE_SIZE; j++) {
+            if (cache->entry[j].source == source) {
+                picture_Release(source);
+                holds++;
+            }
+        }
+        const bool unused = !picture_IsReferenced(source);
+        for (unsigned j = 0; j < holds; j++)
+            picture_Hold(source);
+
+        if (unused) {
+            for (int j = SPU_CACHE_SIZE - 1; j >= i; j--)
+                if (cache->entry[j].source == source)
+                    SpuCacheDeleteAt(cache, j);
+        }
+    }
+}
+
+static void SpuCacheClean(spu_cache_t *cache)
+{
+    for (int i = 0; i < SPU_CACHE_SIZE; i++) {
+        if (cache->entry[i].source)
+            SpuCacheDeleteAt(cache, i);
+    }
+}
+
 static void FilterRelease(filter_t *filter)
 {
     if (filter->p_module)
@@ -189,6 +351,10 @@ static int spu_get_attachments(filter_t *filter,
 
 static filter_t *SpuRenderCreateAndLoadText(spu_t *spu)
 {
+    spu_private_t *sys = spu->p;
+
+    sys->text_elapsed = sys->text_rerender = NULL;
+
     filter_t *text = vlc_custom_create(spu, sizeof(*text), "spu text");
     if (!text)
         return NULL;
@@ -210,10 +376,23 @@ static filter_t *SpuRenderCreateAndLoadText(spu_t *spu)
     /* Create a few variables used for enhanced text rendering */
     var_Create(text, "spu-elapsed",   VLC_VAR_INTEGER);
     var_Create(text, "text-rerender", VLC_VAR_BOOL);
+    sys->text_elapsed  = var_Lookup(text, "spu-elapsed");
+    sys->text_rerender = var_Lookup(text, "text-rerender");
 
     return text;
 }
 
+static void SpuRenderReleaseText(spu_t *spu)
+{
+    spu_private_t *sys = spu->p;
+
+    if (sys->text_elapsed)
+        var_HandleRelease(sys->text, sys->text_elapsed);
+    if (sys->text_rerender)
+        var_HandleRelease(sys->text, sys->text_rerender);
+    FilterRelease(sys->text);
+}
+
 static filter_t *SpuRenderCreateAndLoadScale(vlc_object_t *object,
                                              vlc_fourcc_t src_chroma,
                                              vlc_fourcc_t dst_chroma,
@@ -255,6 +434,8 @@ static void SpuRenderText(spu_t *spu, bool *rerender_text,
 
     if (!text || !text->p_module)
         return;
+    if (!spu->p->text_elapsed || !spu->p->text_rerender)
+        return;
 
     /* Setup 3 variables which can be used to render
      * time-dependent text (and effects). The first indicates
@@ -275,12 +456,12 @@ static void SpuRenderText(spu_t *spu, bool *rerender_text,
      * least show up on screen, but the effect won't change
      * the text over time.
      */
-    var_SetInteger(text, "spu-elapsed", elapsed_time);
-    var_SetBool(text, "text-rerender", false);
+    var_HandleSetInteger(text, spu->p->text_elapsed, elapsed_time);
+    var_HandleSetBool(text, spu->p->text_rerender, false);
 
     if ( region->p_text )
         text->pf_render(text, region, region, chroma_list);
-    *rerender_text = var_GetBool(text, "text-rerender");
+    *rerender_text = var_HandleGetBool(text, spu->p->text_rerender);
 }
 
 /**
@@ -827,6 +1008,22 @@ static void SpuRenderRegion(spu_t *spu,
             }
         }
 
+        /* Use the scaling of the same picture sent in another region */
+        const vlc_fourcc_t dst_chroma = using_palette || convert_chroma ?
+                                        chroma_list[0] : region->fmt.i_chroma;
+        if (!region->p_private && dst_width > 0 && dst_height > 0) {
+            picture_t *picture = SpuCacheGet(&sys->cache, region,
+                                              dst_width, dst_height,
+                                              dst_chroma);
+            if (picture) {
+                region->p_private = subpicture_region_private_New(&picture->format);
+                if (region->p_private)
+                    region->p_private->p_picture = picture;
+                else
+                    picture_Release(picture);
+            }
+        }
+
         /* Scale if needed into cache */
         if (!region->p_private && dst_width > 0 && dst_height > 0) {
             filter_t *scale = sys->scale;
@@ -891,6 +1088,13 @@ static void SpuRenderRegion(spu_t *spu,
                 } else {
                     picture_Release(picture);
                 }
+
+                /* The picture is also held by its source, which may send
+                 * it again */
+                if (region->p_private && picture != region->p_picture &&
+                    picture_IsReferenced(region->p_picture))
+                    SpuCachePut(&sys->cache, region, dst_width, dst_height,
+                                dst_chroma, picture);
             }
         }
 
@@ -956,14 +1160,12 @@ static void SpuRenderRegion(spu_t *spu,
         }
     }
 
-    subpicture_region_t *dst = *dst_ptr = subpicture_region_New(&region_fmt);
+    subpicture_region_t *dst = *dst_ptr =
+        subpicture_region_NewFromPicture(&region_fmt, region_picture);
     if (dst) {
         dst->i_x       = x_offset;
         dst->i_y       = y_offset;
         dst->i_align   = 0;
-        if (dst->p_picture)
-            picture_Release(dst->p_picture);
-        dst->p_picture = picture_Hold(region_picture);
         int fade_alpha = 255;
         if (subpic->b_fade) {
             mtime_t fade_start = subpic->i_start + 3 * (subpic->i_stop - subpic->i_start) / 4;
@@ -1297,6 +1499,7 @@ spu_t *spu_Create(vlc_object_t *object, vout_thread_t *vout)
     vlc_mutex_init(&sys->lock);
 
     SpuHeapInit(&sys->heap);
+    SpuCacheInit(&sys->cache);
 
     sys->text = NULL;
     sys->scale = NULL;
@@ -1344,7 +1547,7 @@ void spu_Destroy(spu_t *spu)
     spu_private_t *sys = spu->p;
 
     if (sys->text)
-        FilterRelease(sys->text);
+        SpuRenderReleaseText(spu);
 
     if (sys->scale_yuvp)
         FilterRelease(sys->scale_yuvp);
@@ -1370,6 +1573,7 @@ void spu_Destroy(spu_t *spu)
 
     /* Destroy all remaining subpictures */
     SpuHeapClean(&sys->heap);
+    SpuCacheClean(&sys->cache);
 
     vlc_mutex_destroy(&sys->lock);
 
@@ -1393,7 +1597,7 @@ void spu_Attach(spu_t *spu, vlc_object_t *input, bool attach)
         spu->p->input = input;
 
         if (spu->p->text)
-            FilterRelease(spu->p->text);
+            SpuRenderReleaseText(spu);
         spu->p->text = SpuRenderCreateAndLoadText(spu);
 
         vlc_mutex_unlock(&spu->p->lock);
@@ -1605,6 +1809,7 @@ subpicture_t *spu_Render(spu_t *spu,
                                                 fmt_src,
                                                 render_subtitle_date,
                                                 render_osd_date);
+    SpuCachePurge(&sys->cache);
     vlc_mutex_unlock(&sys->lock);
 
     return render;
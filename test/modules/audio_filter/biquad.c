@@ -0,0 +1,221 @@
+/*****************************************************************************
+ * biquad.c: test for the cascades and banks of biquad filters
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Compares the sections in cascade and in parallel with a direct
+ * implementation, for various numbers of sections and channels, fed in
+ * random chunks, and checks the ramps of the coefficients. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include "../../../modules/audio_filter/biquad.h"
+
+#define FRAMES 4000
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static float frnd(void)
+{
+    return (rnd() % 20001) / 10000.f - 1.f;
+}
+
+/* Stable section, with poles of radius up to 0.9 */
+static void random_section(float *coeffs)
+{
+    const double r = .9 * (rnd() % 1001) / 1000.;
+    const double theta = M_PI * (rnd() % 1001) / 1000.;
+
+    for (unsigned i = 0; i < 3; i++)
+        coeffs[i] = frnd();
+    coeffs[3] = -2. * r * cos(theta);
+    coeffs[4] = r * r;
+}
+
+static void test_biquads(unsigned sections, unsigned channels, bool parallel,
+                         bool inplace)
+{
+    float *coeffs = malloc(sections * 5 * sizeof (*coeffs));
+    float *gains = malloc(sections * sizeof (*gains));
+    float *in = malloc(FRAMES * channels * sizeof (*in));
+    float *out = malloc(FRAMES * channels * sizeof (*out));
+    double *state = calloc(sections * channels * 4, sizeof (*state));
+    assert(coeffs != NULL && gains != NULL && in != NULL && out != NULL
+        && state != NULL);
+
+    biquads_t *bq = BiquadsNew(sections, channels, parallel);
+    assert(bq != NULL);
+
+    const float direct = frnd();
+    for (unsigned s = 0; s < sections; s++)
+    {
+        random_section(&coeffs[s * 5]);
+        gains[s] = frnd();
+        BiquadsSetSection(bq, s, &coeffs[s * 5]);
+        BiquadsSetGain(bq, s, gains[s]);
+    }
+    BiquadsSetDirect(bq, direct);
+    BiquadsCommit(bq, 0);
+
+    for (size_t i = 0; i < FRAMES * channels; i++)
+        in[i] = frnd();
+    if (inplace)
+        memcpy(out, in, FRAMES * channels * sizeof (*in));
+
+    for (size_t done = 0; done < FRAMES;)
+    {
+        size_t n = 1 + rnd() % 200;
+        if (n > FRAMES - done)
+            n = FRAMES - done;
+        BiquadsProcess(bq, inplace ? &out[done * channels]
+                                   : &in[done * channels],
+                       &out[done * channels], n);
+        done += n;
+    }
+
+    double max_err = 0., max_ref = 0.;
+    for (size_t t = 0; t < FRAMES; t++)
+        for (unsigned c = 0; c < channels; c++)
+        {
+            const double x = in[t * channels + c];
+            double v = x, ref = parallel ? direct * x : 0.;
+
+            for (unsigned s = 0; s < sections; s++)
+            {
+                const float *k = &coeffs[s * 5];
+                double *h = &state[(c * sections + s) * 4];
+                const double u = parallel ? x : v;
+                const double y = k[0] * u + k[1] * h[0] + k[2] * h[1]
+                               - k[3] * h[2] - k[4] * h[3];
+
+                h[1] = h[0];
+                h[0] = u;
+                h[3] = h[2];
+                h[2] = y;
+                if (parallel)
+                    ref += gains[s] * y;
+                else
+                    v = y;
+            }
+            if (!parallel)
+                ref = v;
+
+            max_err = fmax(max_err, fabs(out[t * channels + c] - ref));
+            max_ref = fmax(max_ref, fabs(ref));
+        }
+    printf("%u sections in %s, %u channels%s: error %g\n", sections,
+           parallel ? "parallel" : "cascade", channels,
+           inplace ? " in place" : "", max_err / max_ref);
+    assert(max_err < 1e-4 * max_ref);
+
+    /* Nothing remains after a reset */
+    BiquadsReset(bq);
+    memset(in, 0, FRAMES * channels * sizeof (*in));
+    BiquadsProcess(bq, in, out, 100);
+    for (size_t i = 0; i < 100 * channels; i++)
+        assert(out[i] == 0.f);
+
+    BiquadsDelete(bq);
+    free(state);
+    free(out);
+    free(in);
+    free(gains);
+    free(coeffs);
+}
+
+static void test_ramp(bool parallel)
+{
+    static const float pass[5] = { 1.f, 0.f, 0.f, 0.f, 0.f };
+    static const float twice[5] = { 2.f, 0.f, 0.f, 0.f, 0.f };
+    const unsigned ramp = 32 * BIQUADS_RAMP_STEP;
+    float in[2 * 2000], out[2 * 2000];
+
+    biquads_t *bq = BiquadsNew(3, 2, parallel);
+    assert(bq != NULL);
+
+    /* Unity gain, then twice the gain, ramped */
+    for (unsigned s = 0; s < 3; s++)
+    {
+        BiquadsSetSection(bq, s, pass);
+        BiquadsSetGain(bq, s, s == 0);
+    }
+    BiquadsCommit(bq, 0);
+    for (unsigned i = 0; i < 2 * 2000; i++)
+        in[i] = 1.f;
+    BiquadsProcess(bq, in, out, 10);
+    assert(out[18] == 1.f && out[19] == 1.f);
+
+    if (parallel)
+        BiquadsSetGain(bq, 0, 2.f);
+    else
+        BiquadsSetSection(bq, 1, twice);
+    BiquadsCommit(bq, ramp);
+
+    for (unsigned done = 0; done < 2000; done += 77)
+        BiquadsProcess(bq, &in[2 * done], &out[2 * done],
+                       __MIN(77u, 2000 - done));
+
+    assert(out[0] > 1.f);
+    for (unsigned i = 1; i < 2000; i++)
+        for (unsigned c = 0; c < 2; c++)
+        {
+            const float step = out[2 * i + c] - out[2 * (i - 1) + c];
+            assert(step >= -1e-6f && step <= 1.f / 32 + 1e-6f);
+        }
+    for (unsigned i = ramp; i < 2000; i++)
+        assert(out[2 * i] == 2.f && out[2 * i + 1] == 2.f);
+
+    BiquadsDelete(bq);
+    printf("ramp in %s: OK\n", parallel ? "parallel" : "cascade");
+}
+
+int main(void)
+{
+    static const unsigned counts[] = { 1, 2, 3, 6, 9 };
+
+    for (unsigned i = 0; i < ARRAY_SIZE(counts); i++)
+    {
+        test_biquads(5, counts[i], false, i & 1);
+        test_biquads(10, counts[i], true, i & 1);
+    }
+    test_biquads(1, 2, false, false);
+    test_biquads(7, 8, false, true);
+    test_biquads(1, 2, true, false);
+    test_biquads(31, 2, true, true);
+    test_ramp(false);
+    test_ramp(true);
+    return 0;
+}
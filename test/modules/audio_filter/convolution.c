@@ -0,0 +1,245 @@
+/*****************************************************************************
+ * convolution.c: test for the partitioned convolution
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Compares the convolver with a direct convolution, for responses shorter
+ * and longer than a block, fed in random chunks, and checks the loading of
+ * responses from WAV files. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include "../../../modules/audio_filter/convolution.h"
+
+#define FRAMES 12000
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static float frnd(void)
+{
+    return (rnd() % 20001) / 10000.f - 1.f;
+}
+
+static void test_convolver(unsigned inputs, unsigned outputs, unsigned block,
+                           size_t max_length)
+{
+    const unsigned pairs = inputs * outputs;
+    float *in = malloc(FRAMES * inputs * sizeof (*in));
+    float *out = malloc(FRAMES * outputs * sizeof (*out));
+    float *ir = malloc(pairs * max_length * sizeof (*ir));
+    size_t *lengths = malloc(pairs * sizeof (*lengths));
+    assert(in != NULL && out != NULL && ir != NULL && lengths != NULL);
+
+    convolver_t *conv = ConvolverNew(inputs, outputs, block, max_length);
+    assert(conv != NULL);
+
+    /* Some responses are null, some shorter than a block */
+    float bound = 0.f;
+    for (unsigned p = 0; p < pairs; p++)
+    {
+        lengths[p] = (p % 3 == 2) ? 0 : 1 + rnd() % max_length;
+        for (size_t j = 0; j < lengths[p]; j++)
+            ir[p * max_length + j] = frnd() / (1 + j / 16);
+        if (lengths[p] > 0)
+            assert(ConvolverSetResponse(conv, p / outputs, p % outputs,
+                                        &ir[p * max_length], lengths[p])
+                   == VLC_SUCCESS);
+    }
+    for (unsigned o = 0; o < outputs; o++)
+    {
+        float sum = 0.f;
+        for (unsigned c = 0; c < inputs; c++)
+            for (size_t j = 0; j < lengths[c * outputs + o]; j++)
+                sum += fabsf(ir[(c * outputs + o) * max_length + j]);
+        bound = __MAX(bound, sum);
+    }
+
+    for (size_t i = 0; i < FRAMES * inputs; i++)
+        in[i] = frnd();
+
+    for (size_t done = 0; done < FRAMES;)
+    {
+        size_t n = 1 + rnd() % (3 * block);
+        if (n > FRAMES - done)
+            n = FRAMES - done;
+        ConvolverProcess(conv, &in[done * inputs], &out[done * outputs], n);
+        done += n;
+    }
+
+    /* The output is delayed by a block */
+    double max_err = 0.;
+    for (size_t t = 0; t < FRAMES; t++)
+        for (unsigned o = 0; o < outputs; o++)
+        {
+            double ref = 0.;
+            for (unsigned c = 0; c < inputs; c++)
+            {
+                const unsigned p = c * outputs + o;
+                for (size_t j = 0; j < lengths[p] && j + block <= t; j++)
+                    ref += ir[p * max_length + j]
+                         * in[(t - block - j) * inputs + c];
+            }
+            max_err = fmax(max_err, fabs(out[t * outputs + o] - ref));
+        }
+    printf("%u -> %u channels, %u frames blocks, %zu taps: error %g\n",
+           inputs, outputs, block, max_length, max_err / bound);
+    assert(max_err < 1e-5 * bound);
+
+    /* Nothing remains after a reset */
+    ConvolverReset(conv);
+    memset(in, 0, FRAMES * inputs * sizeof (*in));
+    ConvolverProcess(conv, in, out, 4 * block);
+    for (size_t i = 0; i < 4 * block * outputs; i++)
+        assert(out[i] == 0.f);
+
+    ConvolverDelete(conv);
+    free(lengths);
+    free(ir);
+    free(out);
+    free(in);
+}
+
+static void put16(FILE *f, unsigned v)
+{
+    fputc(v & 0xff, f);
+    fputc(v >> 8, f);
+}
+
+static void put32(FILE *f, uint32_t v)
+{
+    put16(f, v & 0xffff);
+    put16(f, v >> 16);
+}
+
+static void write_wav(const char *path, unsigned format, unsigned bits,
+                      unsigned channels, unsigned rate, const float *samples,
+                      size_t frames)
+{
+    const unsigned bytes = bits / 8;
+    FILE *f = fopen(path, "wb");
+    assert(f != NULL);
+
+    fwrite("RIFF", 1, 4, f);
+    put32(f, 4 + 8 + 16 + 8 + 6 + 8 + frames * channels * bytes);
+    fwrite("WAVE", 1, 4, f);
+    fwrite("fmt ", 1, 4, f);
+    put32(f, 16);
+    put16(f, format);
+    put16(f, channels);
+    put32(f, rate);
+    put32(f, rate * channels * bytes);
+    put16(f, channels * bytes);
+    put16(f, bits);
+    /* An unknown chunk, of odd size */
+    fwrite("junk", 1, 4, f);
+    put32(f, 5);
+    fwrite("abcde", 1, 6, f);
+    fwrite("data", 1, 4, f);
+    put32(f, frames * channels * bytes);
+    for (size_t i = 0; i < frames * channels; i++)
+    {
+        if (format == 3)
+        {
+            uint32_t u;
+            memcpy(&u, &samples[i], sizeof (u));
+            put32(f, u);
+        }
+        else
+            put16(f, lroundf(samples[i] * 32767.f) & 0xffff);
+    }
+    fclose(f);
+}
+
+static void test_load(void)
+{
+    char path[] = "/tmp/vlc-convolution-XXXXXX";
+    const int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+
+    /* Same rate, 16-bits: as is */
+    float ir[2 * 300];
+    for (unsigned i = 0; i < 2 * 300; i++)
+        ir[i] = frnd() * .9f;
+    write_wav(path, 1, 16, 2, 48000, ir, 300);
+
+    impulse_responses_t irs;
+    assert(ImpulseResponsesLoad(&irs, path, 48000) == VLC_SUCCESS);
+    assert(irs.count == 2 && irs.length == 300);
+    for (unsigned c = 0; c < 2; c++)
+        for (unsigned i = 0; i < 300; i++)
+            assert(fabsf(irs.samples[c * 300 + i] - ir[i * 2 + c]) < 1e-4f);
+    ImpulseResponsesClean(&irs);
+
+    /* Other rate, float: the gain is kept */
+    float smooth[256];
+    double sum = 0.;
+    for (unsigned i = 0; i < 256; i++)
+    {
+        smooth[i] = .5f - .5f * cosf(2.f * M_PI * i / 256);
+        sum += smooth[i];
+    }
+    write_wav(path, 3, 32, 1, 44100, smooth, 256);
+    assert(ImpulseResponsesLoad(&irs, path, 48000) == VLC_SUCCESS);
+    assert(irs.count == 1 && irs.length == (256 * 48000 + 44099) / 44100);
+
+    double resampled = 0.;
+    for (size_t i = 0; i < irs.length; i++)
+        resampled += irs.samples[i];
+    assert(fabs(resampled - sum) < sum * 1e-2);
+    ImpulseResponsesClean(&irs);
+
+    /* Not a WAV file */
+    FILE *f = fopen(path, "wb");
+    assert(f != NULL);
+    fputs("RIFF0000AVI LIST", f);
+    fclose(f);
+    assert(ImpulseResponsesLoad(&irs, path, 48000) != VLC_SUCCESS);
+
+    unlink(path);
+    printf("impulse responses loading: OK\n");
+}
+
+int main(void)
+{
+    test_convolver(1, 1, 8, 1);
+    test_convolver(1, 1, 64, 1000);
+    test_convolver(3, 2, 256, 100);
+    test_convolver(6, 2, 128, 3000);
+    test_load();
+    return 0;
+}
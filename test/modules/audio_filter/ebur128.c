@@ -0,0 +1,174 @@
+/*****************************************************************************
+ * ebur128.c: test for the loudness and true peak meter
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks the meter against synthetic versions of the test signals of EBU
+ * Tech 3341 (1 kHz sines at given levels, with the expected loudness within
+ * 0.1 LU), and the true peak of a sine sampled away from its peaks. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_aout.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include "../../../modules/audio_filter/ebur128.h"
+
+/* Feeds seconds of a sine of level dBFS on the channels of the mask */
+static void feed_sine(ebur128_t *meter, unsigned rate, unsigned channels,
+                      unsigned mask, double seconds, double freq,
+                      double level)
+{
+    const size_t frames = seconds * rate;
+    const double amp = pow(10., level / 20.);
+    float *buf = malloc(frames * channels * sizeof (*buf));
+    assert(buf != NULL);
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const float v = amp * sin(2. * M_PI * freq * i / rate);
+
+        for (unsigned c = 0; c < channels; c++)
+            buf[i * channels + c] = (mask >> c) & 1 ? v : 0.f;
+    }
+
+    /* In uneven blocks */
+    for (size_t done = 0; done < frames;)
+    {
+        size_t n = 1 + (done * 7919) % 3000;
+        if (n > frames - done)
+            n = frames - done;
+        EbuR128Process(meter, &buf[done * channels], NULL, n);
+        done += n;
+    }
+    free(buf);
+}
+
+static void check(const char *what, float value, float expected)
+{
+    printf("%-32s %7.2f (expected %.1f)\n", what, value, expected);
+    assert(fabsf(value - expected) <= .1f);
+}
+
+static void test_stereo(unsigned rate)
+{
+    ebur128_t *meter = EbuR128New(rate, 2, AOUT_CHANS_STEREO);
+    assert(meter != NULL);
+
+    /* Tech 3341 case 1: -23 dBFS */
+    feed_sine(meter, rate, 2, 3, 20., 1000., -23.);
+    check("momentary, -23 dBFS", EbuR128Momentary(meter), -23.f);
+    check("short-term, -23 dBFS", EbuR128ShortTerm(meter), -23.f);
+    check("integrated, -23 dBFS", EbuR128Integrated(meter), -23.f);
+
+    /* Case 3: the quieter parts are below the relative gate */
+    EbuR128Reset(meter);
+    assert(EbuR128Integrated(meter) == -INFINITY);
+    feed_sine(meter, rate, 2, 3, 10., 1000., -36.);
+    feed_sine(meter, rate, 2, 3, 60., 1000., -23.);
+    feed_sine(meter, rate, 2, 3, 10., 1000., -36.);
+    check("integrated, relative gate", EbuR128Integrated(meter), -23.f);
+    check("short-term, -36 dBFS", EbuR128ShortTerm(meter), -36.f);
+
+    /* Case 5: all the parts are above the gates */
+    EbuR128Reset(meter);
+    feed_sine(meter, rate, 2, 3, 20., 1000., -26.);
+    feed_sine(meter, rate, 2, 3, 20.1, 1000., -20.);
+    feed_sine(meter, rate, 2, 3, 20., 1000., -26.);
+    check("integrated, -26/-20/-26 dBFS", EbuR128Integrated(meter), -23.f);
+
+    /* Silence is below the absolute gate */
+    EbuR128Reset(meter);
+    feed_sine(meter, rate, 2, 3, 2., 1000., -80.);
+    assert(EbuR128Integrated(meter) == -INFINITY);
+
+    EbuR128Delete(meter);
+}
+
+static void test_surround(void)
+{
+    /* The surround channels weigh 1.5 dB more, the LFE nothing */
+    ebur128_t *meter = EbuR128New(48000, 6, AOUT_CHANS_5_1);
+    assert(meter != NULL);
+
+    /* L R RL RR C LFE: the rear channels, and the LFE at full scale */
+    feed_sine(meter, 48000, 6, 0x0c, 10., 1000., -24.5);
+    feed_sine(meter, 48000, 6, 0x2c, 10., 1000., -24.5);
+    check("integrated, 5.1 surround", EbuR128Integrated(meter), -23.f);
+    EbuR128Delete(meter);
+}
+
+static void test_true_peak(unsigned rate)
+{
+    const size_t frames = rate;
+    float *buf = malloc(frames * sizeof (*buf));
+    float *peaks = malloc(frames * sizeof (*peaks));
+    assert(buf != NULL && peaks != NULL);
+
+    /* At a quarter of the rate, sampled 45 degrees off its peaks, a sine
+     * of amplitude 1 has sample peaks at -3 dB */
+    ebur128_t *meter = EbuR128New(rate, 1, AOUT_CHAN_CENTER);
+    assert(meter != NULL);
+    for (size_t i = 0; i < frames; i++)
+        buf[i] = sin(M_PI / 2. * i + M_PI / 4.);
+    EbuR128Process(meter, buf, NULL, frames);
+    printf("true peak at %u Hz: %.2f dBTP\n", rate, EbuR128TruePeak(meter));
+    assert(EbuR128TruePeak(meter) > -.4f && EbuR128TruePeak(meter) < .2f);
+    EbuR128Delete(meter);
+
+    /* The peaks of the frames come after the delay */
+    meter = EbuR128New(rate, 1, AOUT_CHAN_CENTER);
+    assert(meter != NULL);
+    memset(buf, 0, frames * sizeof (*buf));
+    buf[1000] = -.5f;
+    EbuR128Process(meter, buf, peaks, frames);
+
+    size_t max = 0;
+    for (size_t i = 0; i < frames; i++)
+        if (peaks[i] > peaks[max])
+            max = i;
+    assert(max == 1000 + EbuR128PeakDelay(meter));
+    assert(peaks[max] == .5f);
+    for (size_t i = 0; i < 1000; i++)
+        assert(peaks[i] == 0.f);
+    EbuR128Delete(meter);
+
+    free(peaks);
+    free(buf);
+}
+
+int main(void)
+{
+    test_stereo(48000);
+    test_stereo(44100);
+    test_surround();
+    test_true_peak(48000);
+    test_true_peak(44100);
+    test_true_peak(96000);
+    return 0;
+}
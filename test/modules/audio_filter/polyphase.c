@@ -0,0 +1,204 @@
+/*****************************************************************************
+ * polyphase.c: test for the polyphase resampling kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks the filter banks, the SIMD dot products against the C one, and
+ * the resampling of sine waves, fed by chunks, with exact and interpolated
+ * phases. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include "../../../modules/audio_filter/resampler/polyphase.h"
+
+#define CHANNELS 3
+#define SECONDS  1
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static void test_bank(void)
+{
+    pp_bank_t bank;
+
+    assert(pp_bank_init(&bank, 160, pp_taps(pp_cutoff(44100, 48000)),
+                        pp_cutoff(44100, 48000), false) == 0);
+    assert(bank.taps == PP_TAPS);
+    for (unsigned p = 0; p < bank.phases; p++)
+    {
+        double sum = 0.;
+        for (unsigned k = 0; k < bank.taps; k++)
+            sum += bank.coeffs[p * bank.taps + k];
+        assert(fabs(sum - 1.) < 1e-6);
+    }
+    /* The first phase is centered on the last tap of the first half */
+    for (unsigned k = 0; k < bank.taps; k++)
+        assert(fabsf(bank.coeffs[k]) <= bank.coeffs[bank.taps / 2 - 1]);
+    pp_bank_clean(&bank);
+
+    /* Decimation needs longer filters */
+    assert(pp_taps(pp_cutoff(192000, 44100)) > 4 * PP_TAPS);
+    assert(pp_taps(pp_cutoff(1000000, 8000)) == PP_MAX_TAPS);
+    printf("filter banks: OK\n");
+}
+
+static void test_dot(const char *name, pp_dot_t dot)
+{
+    float *a = aligned_alloc(32, PP_MAX_TAPS * sizeof (float));
+    float b[PP_MAX_TAPS + 1];
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        const unsigned n = 8 * (1 + rnd() % (PP_MAX_TAPS / 8));
+        double ref = 0.;
+
+        for (unsigned k = 0; k < n; k++)
+        {
+            a[k] = (int)(rnd() % 2001 - 1000) / 1000.f;
+            b[k + 1] = (int)(rnd() % 2001 - 1000) / 1000.f;
+            ref += (double)a[k] * b[k + 1];
+        }
+        /* The input samples are not aligned */
+        assert(fabs(dot(a, &b[1], n) - ref) < 1e-4 * n);
+    }
+    aligned_free(a);
+    printf("%s dot product: OK\n", name);
+}
+
+/* Resamples sine waves, and compares them with the expected output */
+static void test_resample(unsigned in_rate, unsigned out_rate, pp_dot_t dot)
+{
+    const double cutoff = pp_cutoff(in_rate, out_rate);
+    unsigned gcd = in_rate, r = out_rate;
+    while (r != 0)
+    {
+        const unsigned t = gcd % r;
+        gcd = r;
+        r = t;
+    }
+    const unsigned phases = out_rate / gcd;
+    const bool interp = phases > PP_MAX_PHASES;
+    pp_bank_t bank;
+
+    assert(pp_bank_init(&bank, interp ? PP_INTERP_PHASES : phases,
+                        pp_taps(cutoff), cutoff, interp) == 0);
+
+    const unsigned taps = bank.taps;
+    const size_t frames = SECONDS * in_rate + taps;
+    const size_t out_max = SECONDS * out_rate + 16;
+    float *planes[CHANNELS];
+    float *out = malloc(out_max * CHANNELS * sizeof (float));
+    assert(out != NULL);
+
+    /* Sine waves at a tenth of the lowest rate, after taps / 2 - 1 frames
+     * of silence, as the filter does it */
+    for (unsigned c = 0; c < CHANNELS; c++)
+    {
+        planes[c] = calloc(frames, sizeof (float));
+        assert(planes[c] != NULL);
+        for (size_t i = 0; i < SECONDS * in_rate; i++)
+            planes[c][taps / 2 - 1 + i] =
+                sin(2. * M_PI * __MIN(in_rate, out_rate) / 10. * i / in_rate
+                    + c);
+    }
+
+    const uint64_t step = interp ? ((uint64_t)in_rate << 32) / out_rate
+                                 : in_rate / gcd;
+    pp_pos_t pos = { 0, 0 };
+    size_t avail = 0, count = 0;
+    while (avail < frames)
+    {
+        const size_t chunk = rnd() % 2000;
+        avail = __MIN(avail + chunk, frames);
+        count += pp_resample(&bank, dot, &pos, step,
+                             (const float *const *)planes, CHANNELS, avail,
+                             &out[count * CHANNELS], out_max - count);
+    }
+    assert(count + 1 >= (size_t)SECONDS * out_rate);
+    assert(count <= (size_t)SECONDS * out_rate + out_rate / in_rate + 2);
+
+    /* Away from the edges of the input */
+    double err = 0.;
+    for (size_t n = 0; n < count; n++)
+        for (unsigned c = 0; c < CHANNELS; c++)
+        {
+            const double t = (double)n * in_rate / out_rate;
+            if (t < taps || t + taps > SECONDS * in_rate)
+                continue;
+
+            const double ref = sin(2. * M_PI * __MIN(in_rate, out_rate) / 10.
+                                   * t / in_rate + c);
+            err = fmax(err, fabs(out[n * CHANNELS + c] - ref));
+        }
+    printf("%u -> %u Hz%s: max error %.1f dB\n", in_rate, out_rate,
+           interp ? " (interpolated)" : "", 20. * log10(err));
+    assert(err < 1e-3);
+
+    for (unsigned c = 0; c < CHANNELS; c++)
+        free(planes[c]);
+    free(out);
+    pp_bank_clean(&bank);
+}
+
+static void test_rates(pp_dot_t dot)
+{
+    static const unsigned rates[][2] = {
+        { 44100, 48000 }, { 48000, 44100 }, { 8000, 48000 },
+        { 96000, 44100 }, { 48000, 48000 }, { 48002, 48000 },
+        { 44100, 47998 },
+    };
+
+    for (unsigned i = 0; i < ARRAY_SIZE(rates); i++)
+        test_resample(rates[i][0], rates[i][1], dot);
+}
+
+int main(void)
+{
+    test_bank();
+    test_dot("C", pp_dot_c);
+    test_rates(pp_dot_c);
+
+#ifdef CAN_COMPILE_SSE
+    if (vlc_CPU_SSE())
+        test_dot("SSE", pp_dot_sse);
+#endif
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        test_dot("AVX2", pp_dot_avx2);
+        test_rates(pp_dot_avx2);
+    }
+#endif
+    return 0;
+}
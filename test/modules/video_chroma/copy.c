@@ -0,0 +1,194 @@
+/*****************************************************************************
+ * copy.c: test for the surface copy helpers
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks the copies from NV12 and I420 surfaces against a plain C version,
+ * for pitches up to 8K 16-bits lines, which are wider than the copy cache,
+ * and checks that nothing is written past the lines of the destination. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_picture.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include "../../../modules/video_chroma/copy.h"
+
+#define GUARD 0xa5
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static uint8_t *alloc_plane(size_t pitch, unsigned lines, bool random)
+{
+    /* Aligned as surfaces are, with a guard line at the end */
+    uint8_t *buf = aligned_alloc(64, (pitch * (lines + 1) + 63) & ~63);
+    assert(buf != NULL);
+    for (size_t i = 0; i < pitch * (lines + 1); i++)
+        buf[i] = random ? rnd() : GUARD;
+    return buf;
+}
+
+/* Destination planes of width bytes in lines of pitch bytes */
+static void init_picture(picture_t *pic, unsigned planes,
+                         const size_t pitch[], const unsigned lines[])
+{
+    memset(pic, 0, sizeof (*pic));
+    pic->i_planes = planes;
+    for (unsigned i = 0; i < planes; i++)
+    {
+        pic->p[i].p_pixels = alloc_plane(pitch[i], lines[i], false);
+        pic->p[i].i_pitch = pitch[i];
+        pic->p[i].i_lines = lines[i];
+    }
+}
+
+static void clean_picture(picture_t *pic)
+{
+    for (int i = 0; i < pic->i_planes; i++)
+        aligned_free(pic->p[i].p_pixels);
+}
+
+/* Checks a destination plane: the first width bytes of each line must
+ * match, and the rest of the lines and the guard line must be untouched */
+static void check_plane(const plane_t *p, unsigned width,
+                        const uint8_t *src, size_t src_pitch,
+                        size_t src_step, size_t src_offset)
+{
+    for (int y = 0; y <= p->i_lines; y++)
+        for (int x = 0; x < p->i_pitch; x++)
+        {
+            const uint8_t v = p->p_pixels[y * p->i_pitch + x];
+
+            if (y < p->i_lines && (unsigned)x < width)
+                assert(v == src[y * src_pitch + x * src_step + src_offset]);
+            else
+                assert(v == GUARD);
+        }
+}
+
+static void test_nv12(unsigned width, unsigned height, size_t src_pitch,
+                      copy_cache_t *cache)
+{
+    uint8_t *y = alloc_plane(src_pitch, height, true);
+    uint8_t *uv = alloc_plane(src_pitch, height / 2, true);
+    uint8_t *src[2] = { y, uv };
+    size_t pitch[2] = { src_pitch, src_pitch };
+    picture_t pic;
+
+    /* NV12 to I420, the destination chroma lines are narrower */
+    const size_t i420_pitch[3] = { width, width / 2, width / 2 };
+    const unsigned i420_lines[3] = { height, height / 2, height / 2 };
+    init_picture(&pic, 3, i420_pitch, i420_lines);
+    CopyFromNv12ToI420(&pic, src, pitch, height, cache);
+    check_plane(&pic.p[0], width, y, src_pitch, 1, 0);
+    check_plane(&pic.p[1], width / 2, uv, src_pitch, 2, 0);
+    check_plane(&pic.p[2], width / 2, uv, src_pitch, 2, 1);
+    clean_picture(&pic);
+
+    /* NV12 to NV12 */
+    const size_t nv12_pitch[2] = { width, width };
+    const unsigned nv12_lines[2] = { height, height / 2 };
+    init_picture(&pic, 2, nv12_pitch, nv12_lines);
+    CopyFromNv12ToNv12(&pic, src, pitch, height, cache);
+    check_plane(&pic.p[0], width, y, src_pitch, 1, 0);
+    check_plane(&pic.p[1], width, uv, src_pitch, 1, 0);
+    clean_picture(&pic);
+
+    aligned_free(y);
+    aligned_free(uv);
+}
+
+static void test_i420(unsigned width, unsigned height, size_t src_pitch,
+                      copy_cache_t *cache)
+{
+    uint8_t *y = alloc_plane(src_pitch, height, true);
+    uint8_t *u = alloc_plane(src_pitch / 2, height / 2, true);
+    uint8_t *v = alloc_plane(src_pitch / 2, height / 2, true);
+    uint8_t *src[3] = { y, u, v };
+    size_t pitch[3] = { src_pitch, src_pitch / 2, src_pitch / 2 };
+    picture_t pic;
+
+    /* I420 to NV12, checked one chroma at a time */
+    const size_t nv12_pitch[2] = { width, width };
+    const unsigned nv12_lines[2] = { height, height / 2 };
+    init_picture(&pic, 2, nv12_pitch, nv12_lines);
+    CopyFromI420ToNv12(&pic, src, pitch, height, cache);
+    check_plane(&pic.p[0], width, y, src_pitch, 1, 0);
+    for (unsigned l = 0; l < height / 2; l++)
+        for (unsigned x = 0; x < width / 2; x++)
+        {
+            assert(pic.p[1].p_pixels[l * width + 2 * x]
+                   == u[l * src_pitch / 2 + x]);
+            assert(pic.p[1].p_pixels[l * width + 2 * x + 1]
+                   == v[l * src_pitch / 2 + x]);
+        }
+    for (unsigned x = 0; x < width; x++)
+        assert(pic.p[1].p_pixels[height / 2 * width + x] == GUARD);
+    clean_picture(&pic);
+
+    aligned_free(y);
+    aligned_free(u);
+    aligned_free(v);
+}
+
+int main(void)
+{
+    static const struct
+    {
+        unsigned width;
+        unsigned height;
+        size_t pitch;
+    } sizes[] = {
+        { 64, 4, 64 },
+        { 720, 10, 768 },
+        { 1920, 8, 2048 },
+        { 3840, 6, 4096 },
+        { 7680, 4, 8192 },
+        { 15360, 4, 15360 }, /* 8K, 16-bits samples */
+        { 15360, 2, 16384 },
+    };
+
+    for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++)
+    {
+        copy_cache_t cache;
+
+        /* The cache is sized from the width, but the pitch may be larger */
+        assert(CopyInitCache(&cache, sizes[i].width) == VLC_SUCCESS);
+        test_nv12(sizes[i].width, sizes[i].height, sizes[i].pitch, &cache);
+        test_i420(sizes[i].width, sizes[i].height, sizes[i].pitch, &cache);
+        CopyCleanCache(&cache);
+        printf("%ux%u (pitch %zu): OK\n", sizes[i].width, sizes[i].height,
+               sizes[i].pitch);
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*****************************************************************************
+ * pack.c: test for the packed and semi-planar conversion kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks the C conversion kernels against a few known pixels, and that
+ * their SIMD counterparts are bit-exact and write no byte past the line. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include "../../../modules/video_chroma/pack.h"
+
+#define WIDTH 300 /* maximum line width, in pixels */
+#define SIZE  (8 * WIDTH + 64) /* buffer size, in bytes */
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static void fill(uint8_t *buf, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        buf[i] = rnd();
+}
+
+static void test_c(void)
+{
+    const uint8_t u[] = { 1, 2 }, v[] = { 3, 4 };
+    const uint8_t yuyv[] = { 10, 11, 12, 13, 14, 15, 16, 17 };
+    const uint8_t rgb[] = { 1, 2, 3, 4, 5, 6 };
+    const uint16_t u16[] = { 0x3ff }, v16[] = { 0x001 };
+    uint8_t out[8], y[4], cu[2], cv[2];
+    uint16_t out16[2];
+
+    pack_uv8_c(out, u, v, 2);
+    assert(!memcmp(out, (uint8_t[]){ 1, 3, 2, 4 }, 4));
+    unpack_uv8_c(cu, cv, out, 2);
+    assert(!memcmp(cu, u, 2) && !memcmp(cv, v, 2));
+
+    pack_uv16_c(out16, u16, v16, 1, 6);
+    assert(out16[0] == 0xffc0 && out16[1] == 0x0040);
+
+    unpack_422_c(y, cu, cv, yuyv, 4, false);
+    assert(!memcmp(y, (uint8_t[]){ 10, 12, 14, 16 }, 4));
+    assert(!memcmp(cu, (uint8_t[]){ 11, 15 }, 2));
+    assert(!memcmp(cv, (uint8_t[]){ 13, 17 }, 2));
+    unpack_422_c(y, cu, cv, yuyv, 4, true);
+    assert(!memcmp(y, (uint8_t[]){ 11, 13, 15, 17 }, 4));
+    assert(!memcmp(cu, (uint8_t[]){ 10, 14 }, 2));
+    assert(!memcmp(cv, (uint8_t[]){ 12, 16 }, 2));
+
+    pack_grey_c(out, y, 2);
+    assert(!memcmp(out, (uint8_t[]){ 11, 0x80, 13, 0x80 }, 4));
+
+    rgb24_rgb32_c(out, rgb, 2);
+    assert(!memcmp(out, (uint8_t[]){ 3, 2, 1, 0xff, 6, 5, 4, 0xff }, 8));
+    printf("C kernels: OK\n");
+}
+
+#ifdef CAN_COMPILE_AVX2
+/* The output buffers are compared in full, so that a store past the end of
+ * the line is caught as a mismatch. */
+static void test_avx2(void)
+{
+    static uint8_t in[3][SIZE], ref[3][SIZE], simd[3][SIZE];
+
+    for (unsigned n = 0; n <= WIDTH; n += (n < 80) ? 1 : 23)
+        for (unsigned align = 0; align < 32; align += 5)
+        {
+            const unsigned even = n & ~1u;
+
+#define RESET() do { \
+    fill(&in[0][0], sizeof (in)); \
+    fill(&ref[0][0], sizeof (ref)); \
+    memcpy(simd, ref, sizeof (ref)); \
+} while (0)
+#define CHECK(what) do { \
+    if (memcmp(ref, simd, sizeof (ref))) { \
+        fprintf(stderr, "%s: mismatch (%u pixels)\n", what, n); \
+        abort(); \
+    } \
+} while (0)
+
+            RESET();
+            pack_uv8_c(ref[0] + align, in[0] + align, in[1], n);
+            pack_uv8_avx2(simd[0] + align, in[0] + align, in[1], n);
+            CHECK("NV12 packing");
+
+            RESET();
+            unpack_uv8_c(ref[0] + align, ref[1], in[0] + align, n);
+            unpack_uv8_avx2(simd[0] + align, simd[1], in[0] + align, n);
+            CHECK("NV12 unpacking");
+
+            RESET();
+            for (unsigned shift = 0; shift <= 6; shift += 6)
+            {
+                pack_uv16_c((uint16_t *)ref[0], (uint16_t *)in[0],
+                            (uint16_t *)in[1], n, shift);
+                pack_uv16_avx2((uint16_t *)simd[0], (uint16_t *)in[0],
+                               (uint16_t *)in[1], n, shift);
+                shift16_c((uint16_t *)ref[1], (uint16_t *)in[2], n, shift);
+                shift16_avx2((uint16_t *)simd[1], (uint16_t *)in[2], n,
+                             shift);
+                CHECK("P010 packing");
+            }
+
+            for (int uyvy = 0; uyvy < 2; uyvy++)
+            {
+                RESET();
+                unpack_422_c(ref[0] + align, ref[1], ref[2], in[0] + align,
+                             even, uyvy);
+                unpack_422_avx2(simd[0] + align, simd[1], simd[2],
+                                in[0] + align, even, uyvy);
+                CHECK("4:2:2 unpacking");
+
+                RESET();
+                unpack_422_c(ref[0], NULL, NULL, in[0], even, uyvy);
+                unpack_422_avx2(simd[0], NULL, NULL, in[0], even, uyvy);
+                CHECK("4:2:2 luma unpacking");
+            }
+
+            RESET();
+            pack_grey_c(ref[0] + align, in[0], even);
+            pack_grey_avx2(simd[0] + align, in[0], even);
+            CHECK("grey packing");
+
+            RESET();
+            rgb24_rgb32_c(ref[0], in[0] + align, n);
+            rgb24_rgb32_avx2(simd[0], in[0] + align, n);
+            CHECK("RGB24 to RGB32");
+#undef CHECK
+#undef RESET
+        }
+    printf("AVX2 kernels: OK\n");
+}
+#endif
+
+int main(void)
+{
+    test_c();
+
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+        test_avx2();
+    else
+#endif
+        printf("no SIMD kernel supported, skipping\n");
+    return 0;
+}
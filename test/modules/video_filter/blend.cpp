@@ -0,0 +1,192 @@
+/*****************************************************************************
+ * blend.cpp: test for the picture blending fast paths
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks that the fast paths of the blender, by blocks, are bit-exact with
+ * the generic per pixel templates, for every pair they handle. The SIMD
+ * kernels are checked too if the CPU supports them. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../../modules/video_filter/blend.cpp"
+
+#undef NDEBUG
+#include <assert.h>
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+/* Samples of the pictures with more than 8 bits are kept in their range */
+static void fill_dst(picture_t *pic, vlc_fourcc_t chroma)
+{
+    for (int i = 0; i < pic->i_planes; i++) {
+        plane_t *p = &pic->p[i];
+
+        for (int y = 0; y < p->i_lines; y++) {
+            uint8_t *line = &p->p_pixels[y * p->i_pitch];
+
+            if (chroma == VLC_CODEC_I420_10L || chroma == VLC_CODEC_P010) {
+                const unsigned shift = chroma == VLC_CODEC_P010 ? 6 : 0;
+                for (int x = 0; x < p->i_pitch / 2; x++)
+                    SetWLE(&line[2 * x], (rnd() % 1024) << shift);
+            } else {
+                for (int x = 0; x < p->i_pitch; x++)
+                    line[x] = rnd();
+            }
+        }
+    }
+}
+
+/* Runs of transparent, opaque and translucent pixels, so that blocks are
+ * skipped, partly skipped or blended */
+static void fill_src(picture_t *pic, vlc_fourcc_t chroma)
+{
+    const int alpha_plane = chroma == VLC_CODEC_YUVA ? 3 : 0;
+    const int alpha_step = chroma == VLC_CODEC_YUVA ? 1 : 4;
+    const int alpha_offset = chroma == VLC_CODEC_YUVA ? 0 : 3;
+
+    for (int i = 0; i < pic->i_planes; i++)
+        for (int j = 0; j < pic->p[i].i_lines * pic->p[i].i_pitch; j++)
+            pic->p[i].p_pixels[j] = rnd();
+
+    plane_t *p = &pic->p[alpha_plane];
+    for (int y = 0; y < p->i_lines; y++) {
+        uint8_t *line = &p->p_pixels[y * p->i_pitch];
+        const int width = p->i_pitch / alpha_step;
+        int x = 0;
+
+        while (x < width) {
+            int run = 1 + rnd() % 150;
+            const unsigned kind = rnd() % 4;
+
+            for (; run > 0 && x < width; run--, x++) {
+                uint8_t *a = &line[x * alpha_step + alpha_offset];
+                *a = kind == 0 ? 0 : kind == 1 ? 255 : rnd();
+            }
+        }
+    }
+}
+
+static bool same_pictures(const picture_t *a, const picture_t *b)
+{
+    for (int i = 0; i < a->i_planes; i++)
+        for (int y = 0; y < a->p[i].i_visible_lines; y++)
+            if (memcmp(&a->p[i].p_pixels[y * a->p[i].i_pitch],
+                       &b->p[i].p_pixels[y * b->p[i].i_pitch],
+                       a->p[i].i_visible_pitch))
+                return false;
+    return true;
+}
+
+static void test_pair(vlc_fourcc_t dst_chroma, vlc_fourcc_t src_chroma,
+                      blend_function_t generic, blend_function_t fast,
+                      const char *kernels)
+{
+    static const struct {
+        unsigned dst_w, dst_h, src_w, src_h, x, y;
+    } geometries[] = {
+        { 64, 64, 64, 64, 0, 0 },
+        { 320, 180, 150, 33, 17, 9 },
+        { 321, 181, 200, 40, 1, 1 },
+        { 97, 31, 97, 31, 0, 0 },
+        { 200, 100, 3, 3, 198, 98 },
+    };
+    static const int alphas[] = { 255, 128, 1 };
+
+    for (size_t g = 0; g < ARRAY_SIZE(geometries); g++) {
+        video_format_t dst_fmt, src_fmt;
+
+        video_format_Init(&dst_fmt, dst_chroma);
+        video_format_Setup(&dst_fmt, dst_chroma,
+                           geometries[g].dst_w, geometries[g].dst_h,
+                           geometries[g].dst_w, geometries[g].dst_h, 1, 1);
+        video_format_FixRgb(&dst_fmt);
+        video_format_Init(&src_fmt, src_chroma);
+        video_format_Setup(&src_fmt, src_chroma,
+                           geometries[g].src_w, geometries[g].src_h,
+                           geometries[g].src_w, geometries[g].src_h, 1, 1);
+
+        picture_t *ref = picture_NewFromFormat(&dst_fmt);
+        picture_t *out = picture_NewFromFormat(&dst_fmt);
+        picture_t *src = picture_NewFromFormat(&src_fmt);
+        assert(ref != NULL && out != NULL && src != NULL);
+
+        for (size_t a = 0; a < ARRAY_SIZE(alphas); a++) {
+            const unsigned x = geometries[g].x, y = geometries[g].y;
+            const unsigned width = __MIN(geometries[g].src_w,
+                                         geometries[g].dst_w - x);
+            const unsigned height = __MIN(geometries[g].src_h,
+                                          geometries[g].dst_h - y);
+
+            fill_dst(ref, dst_chroma);
+            picture_CopyPixels(out, ref);
+            fill_src(src, src_chroma);
+
+            generic(CPicture(ref, &dst_fmt, x, y),
+                    CPicture(src, &src_fmt, 0, 0), width, height, alphas[a]);
+            fast(CPicture(out, &dst_fmt, x, y),
+                 CPicture(src, &src_fmt, 0, 0), width, height, alphas[a]);
+            if (!same_pictures(ref, out)) {
+                fprintf(stderr, "%4.4s -> %4.4s (%s), %ux%u at %u,%u, "
+                        "alpha %d: mismatch\n", (const char *)&src_chroma,
+                        (const char *)&dst_chroma, kernels, width, height,
+                        x, y, alphas[a]);
+                abort();
+            }
+        }
+        picture_Release(src);
+        picture_Release(out);
+        picture_Release(ref);
+    }
+    printf("%4.4s -> %4.4s (%s): OK\n", (const char *)&src_chroma,
+           (const char *)&dst_chroma, kernels);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(fast_blends); i++) {
+        blend_function_t generic = NULL;
+
+        for (size_t j = 0; j < ARRAY_SIZE(blends); j++)
+            if (blends[j].dst == fast_blends[i].dst
+             && blends[j].src == fast_blends[i].src)
+                generic = blends[j].blend;
+        assert(generic != NULL);
+
+        test_pair(fast_blends[i].dst, fast_blends[i].src, generic,
+                  fast_blends[i].blend, "C");
+#ifdef CAN_COMPILE_AVX2
+        if (vlc_CPU_AVX2())
+            test_pair(fast_blends[i].dst, fast_blends[i].src, generic,
+                      fast_blends[i].blend_avx2, "AVX2");
+#endif
+    }
+    return 0;
+}
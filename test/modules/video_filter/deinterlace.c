@@ -0,0 +1,242 @@
+/*****************************************************************************
+ * deinterlace.c: test for the deinterlacer SIMD routines
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks that the SIMD routines of the deinterlacer are bit-exact with
+ * their C counterparts. Routines not supported by the CPU are skipped. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#include "../../../modules/video_filter/deinterlace/helpers.c"
+/* Only the intrinsics kernels of yadif are tested, not the inline assembly */
+#undef CAN_COMPILE_MMX
+#undef CAN_COMPILE_SSE2
+#undef CAN_COMPILE_SSSE3
+#include "../../../modules/video_filter/deinterlace/yadif.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#define WIDTH  600 /* maximum line width, in pixels */
+#define MARGIN 64  /* room for reads before and after the lines */
+#define STRIDE (2 * (WIDTH + 2 * MARGIN)) /* in bytes */
+#define LINES  5
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+/* Mixes smooth areas, edges and noise, so that every branch is taken */
+static void fill(uint8_t *buf, size_t size, unsigned max)
+{
+    unsigned base = rnd() % (max + 1);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        switch (rnd() % 4)
+        {
+            case 0:
+                base = rnd() % (max + 1);
+                break;
+            case 1:
+                base = (base + rnd() % 8) % (max + 1);
+                break;
+        }
+        buf[i] = base;
+        if (max > 255)
+        {   /* 16-bits pixels, little or big endian does not matter */
+            buf[++i] = base >> 8;
+        }
+    }
+}
+
+typedef void (*yadif_line_t)(uint8_t *, uint8_t *, uint8_t *, uint8_t *,
+                             int, int, int, int, int);
+
+static void test_yadif(const char *name, yadif_line_t ref, yadif_line_t simd,
+                       unsigned size, unsigned max)
+{
+    static uint8_t prev[LINES * STRIDE], cur[LINES * STRIDE],
+                   next[LINES * STRIDE];
+    static uint8_t out_ref[STRIDE], out_simd[STRIDE];
+    const int offset = 2 * STRIDE + MARGIN * size; /* middle line */
+
+    for (int w = 1; w <= WIDTH; w += (w < 80) ? 1 : 37)
+        for (int parity = 0; parity < 2; parity++)
+            for (int mode = 0; mode <= 2; mode += 2)
+                for (int edge = 0; edge < 2; edge++)
+                {
+                    /* At the picture edges, one reference is mirrored */
+                    int prefs = STRIDE, mrefs = edge ? STRIDE : -STRIDE;
+
+                    fill(prev, sizeof (prev), max);
+                    fill(cur, sizeof (cur), max);
+                    fill(next, sizeof (next), max);
+                    fill(out_ref, sizeof (out_ref), 255);
+                    memcpy(out_simd, out_ref, sizeof (out_ref));
+
+                    ref(out_ref + MARGIN, prev + offset, cur + offset,
+                        next + offset, w * size, prefs, mrefs, parity, mode);
+                    simd(out_simd + MARGIN, prev + offset, cur + offset,
+                         next + offset, w * size, prefs, mrefs, parity, mode);
+
+                    if (memcmp(out_ref, out_simd, sizeof (out_ref)))
+                    {
+                        fprintf(stderr, "%s: mismatch (width %d, parity %d, "
+                                "mode %d)\n", name, w, parity, mode);
+                        abort();
+                    }
+                }
+    printf("%s: OK\n", name);
+}
+
+typedef void (*merge_t)(void *, const void *, const void *, size_t);
+
+static void test_merge(const char *name, merge_t ref, merge_t simd,
+                       unsigned size)
+{
+    static uint8_t s1[STRIDE], s2[STRIDE], out_ref[STRIDE], out_simd[STRIDE];
+
+    for (size_t bytes = 0; bytes <= 300; bytes += size)
+        for (size_t align = 0; align < 64; align += 7 * size)
+        {
+            fill(s1, sizeof (s1), 255);
+            fill(s2, sizeof (s2), 255);
+            fill(out_ref, sizeof (out_ref), 255);
+            memcpy(out_simd, out_ref, sizeof (out_ref));
+
+            ref(out_ref + align, s1 + align, s2 + 2 * align, bytes);
+            simd(out_simd + align, s1 + align, s2 + 2 * align, bytes);
+
+            if (memcmp(out_ref, out_simd, sizeof (out_ref)))
+            {
+                fprintf(stderr, "%s: mismatch (%zu bytes)\n", name, bytes);
+                abort();
+            }
+        }
+    printf("%s: OK\n", name);
+}
+
+#ifdef CAN_COMPILE_AVX2
+static void test_ivtc_avx2(void)
+{
+    static uint8_t a[8 * STRIDE], b[8 * STRIDE], c[STRIDE];
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        fill(a, sizeof (a), 255);
+        memcpy(b, a, sizeof (b));
+        /* Change a varying share of the pixels, by varying amounts */
+        unsigned changes = rnd() % 256, amount = 1 + rnd() % 255;
+        for (unsigned j = 0; j < changes; j++)
+            b[rnd() % sizeof (b)] += rnd() % amount;
+
+        int top = 0, bot = 0, score = 0;
+        for (int block = 0; block < 4; block++)
+        {
+            int t, u;
+            score += TestForMotionInBlock(a + 8 * block, b + 8 * block,
+                                          STRIDE, STRIDE, &t, &u);
+            top += t;
+            bot += u;
+        }
+
+        int top_simd, bot_simd;
+        int score_simd = TestForMotionInBlocksAVX2(a, b, STRIDE, STRIDE,
+                                                   &top_simd, &bot_simd);
+        assert(score == score_simd);
+        assert(top == top_simd);
+        assert(bot == bot_simd);
+
+        fill(c, sizeof (c), 255);
+        int w = rnd() % STRIDE;
+        assert(CalculateCombScore(a, b, c, w)
+               == CalculateCombScoreAVX2(a, b, c, w));
+    }
+    printf("IVTC AVX2: OK\n");
+}
+#endif
+
+int main(void)
+{
+    bool tested = false;
+
+#ifdef HAVE_YADIF_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        test_yadif("yadif AVX2", yadif_filter_line_c,
+                   yadif_filter_line_avx2, 1, 255);
+        test_yadif("yadif 16-bits AVX2", yadif_filter_line_c_16bit,
+                   yadif_filter_line_16bit_avx2, 2, 1023);
+        test_yadif("yadif 16-bits AVX2 (full range)",
+                   yadif_filter_line_c_16bit,
+                   yadif_filter_line_16bit_avx2, 2, 65535);
+        tested = true;
+    }
+#endif
+#ifdef HAVE_YADIF_AVX512
+    if (vlc_CPU_AVX512())
+    {
+        test_yadif("yadif AVX-512", yadif_filter_line_c,
+                   yadif_filter_line_avx512, 1, 255);
+        test_yadif("yadif 16-bits AVX-512", yadif_filter_line_c_16bit,
+                   yadif_filter_line_16bit_avx512, 2, 1023);
+        test_yadif("yadif 16-bits AVX-512 (full range)",
+                   yadif_filter_line_c_16bit,
+                   yadif_filter_line_16bit_avx512, 2, 65535);
+        tested = true;
+    }
+#endif
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        test_merge("merge AVX2", Merge8BitGeneric, Merge8BitAVX2, 1);
+        test_merge("merge 16-bits AVX2", Merge16BitGeneric,
+                   Merge16BitAVX2, 2);
+        test_ivtc_avx2();
+        tested = true;
+    }
+#endif
+#ifdef CAN_COMPILE_AVX512
+    if (vlc_CPU_AVX512())
+    {
+        test_merge("merge AVX-512", Merge8BitGeneric, Merge8BitAVX512, 1);
+        test_merge("merge 16-bits AVX-512", Merge16BitGeneric,
+                   Merge16BitAVX512, 2);
+        tested = true;
+    }
+#endif
+
+    if (!tested)
+        printf("no SIMD routine supported, skipping\n");
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*****************************************************************************
+ * mcfps.c: test for the frame interpolation kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks that the block search finds the motion of a translated texture,
+ * and that the SIMD kernels are bit-exact with their C counterparts. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include "../../../modules/video_filter/mcfps.h"
+
+#define WIDTH  128
+#define HEIGHT 96
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static void test_c(void)
+{
+    uint8_t a[MC_BLOCK * MC_BLOCK], b[MC_BLOCK * MC_BLOCK], out[4];
+
+    memset(a, 10, sizeof (a));
+    memset(b, 13, sizeof (b));
+    assert(mc_sad_c(a, MC_BLOCK, b, MC_BLOCK) == 3 * MC_BLOCK * MC_BLOCK);
+    assert(mc_sad_c(b, MC_BLOCK, a, MC_BLOCK) == 3 * MC_BLOCK * MC_BLOCK);
+
+    mc_blend_c(out, (const uint8_t[]){ 0, 255, 100, 7 },
+               (const uint8_t[]){ 255, 0, 200, 9 }, 4, 64);
+    assert(!memcmp(out, (uint8_t[]){ 64, 191, 125, 8 }, 4));
+    mc_blend_c(out, a, b, 4, 0);
+    assert(!memcmp(out, a, 4));
+    mc_blend_c(out, a, b, 4, 256);
+    assert(!memcmp(out, b, 4));
+    printf("C kernels: OK\n");
+}
+
+/* b is a shifted by (mx, my): the block search must find half of it */
+static void test_search(mc_sad_t sad, int range)
+{
+    static uint8_t a[HEIGHT][WIDTH], b[HEIGHT][WIDTH];
+    static const int motions[][2] = {
+        { 0, 0 }, { 2, 0 }, { 0, -4 }, { 6, -4 }, { -10, 8 }, { 4, 14 },
+    };
+
+    /* Smooth texture, so that the search can follow its gradients */
+    for (unsigned y = 0; y < HEIGHT; y++)
+        for (unsigned x = 0; x < WIDTH; x++)
+            a[y][x] = (rnd() & 31) + 96 + 64 * ((x / 8 + y / 8) & 1);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(motions); i++)
+    {
+        const int mx = motions[i][0], my = motions[i][1];
+
+        for (int y = 0; y < HEIGHT; y++)
+            for (int x = 0; x < WIDTH; x++)
+                b[y][x] = a[VLC_CLIP(y - my, 0, HEIGHT - 1)]
+                           [VLC_CLIP(x - mx, 0, WIDTH - 1)];
+
+        /* The true vector as candidate, then as the previous vector of a
+         * neighbour, as the filter does it */
+        const mc_vector_t cand = { mx / 2, my / 2 };
+        mc_block_t blk;
+        mc_vector_t v;
+
+        mc_block_init(&blk, &a[0][0], WIDTH, &b[0][0], WIDTH, WIDTH, HEIGHT,
+                      48, 40, sad);
+        assert(mc_search(&blk, &cand, 1, range, &v) == 0);
+        assert(v.dx == mx / 2 && v.dy == my / 2);
+
+        /* Without candidate, small motions only */
+        if (abs(mx) + abs(my) <= 2 * range + 2)
+        {
+            assert(mc_search(&blk, NULL, 0, range, &v) == 0);
+            assert(v.dx == mx / 2 && v.dy == my / 2);
+        }
+    }
+
+    /* Vectors never point out of the frame */
+    for (unsigned y = 0; y < HEIGHT; y++)
+        for (unsigned x = 0; x < WIDTH; x++)
+            b[y][x] = rnd();
+    for (unsigned y = 0; y + MC_BLOCK <= HEIGHT; y += MC_BLOCK)
+        for (unsigned x = 0; x + MC_BLOCK <= WIDTH; x += MC_BLOCK)
+        {
+            const mc_vector_t far = { 40, -40 };
+            mc_block_t blk;
+            mc_vector_t v;
+
+            mc_block_init(&blk, &a[0][0], WIDTH, &b[0][0], WIDTH, WIDTH,
+                          HEIGHT, x, y, sad);
+            mc_search(&blk, &far, 1, range, &v);
+            assert((int)x - abs(v.dx) >= 0
+                && x + abs(v.dx) + MC_BLOCK <= WIDTH);
+            assert((int)y - abs(v.dy) >= 0
+                && y + abs(v.dy) + MC_BLOCK <= HEIGHT);
+        }
+}
+
+#ifdef CAN_COMPILE_AVX2
+static void test_avx2(void)
+{
+    static uint8_t a[HEIGHT][WIDTH], b[HEIGHT][WIDTH];
+    static uint8_t ref[WIDTH + 64], simd[WIDTH + 64];
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        for (unsigned y = 0; y < HEIGHT; y++)
+            for (unsigned x = 0; x < WIDTH; x++)
+            {
+                a[y][x] = rnd();
+                b[y][x] = (i & 1) ? rnd() : a[y][x] + (rnd() & 3);
+            }
+
+        const unsigned ax = rnd() % (WIDTH - MC_BLOCK);
+        const unsigned ay = rnd() % (HEIGHT - MC_BLOCK);
+        const unsigned bx = rnd() % (WIDTH - MC_BLOCK);
+        const unsigned by = rnd() % (HEIGHT - MC_BLOCK);
+        assert(mc_sad_c(&a[ay][ax], WIDTH, &b[by][bx], WIDTH)
+            == mc_sad_avx2(&a[ay][ax], WIDTH, &b[by][bx], WIDTH));
+
+        const unsigned n = rnd() % WIDTH, w = rnd() % 257;
+        memset(ref, 0x5a, sizeof (ref));
+        memset(simd, 0x5a, sizeof (simd));
+        mc_blend_c(ref, a[0], b[0], n, w);
+        mc_blend_avx2(simd, a[0], b[0], n, w);
+        assert(!memcmp(ref, simd, sizeof (ref)));
+    }
+    test_search(mc_sad_avx2, 2);
+    printf("AVX2 kernels: OK\n");
+}
+#endif
+
+int main(void)
+{
+    test_c();
+    for (int range = 0; range <= 6; range += 2)
+        test_search(mc_sad_c, range);
+    printf("block search: OK\n");
+
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+        test_avx2();
+    else
+#endif
+        printf("no SIMD kernel supported, skipping\n");
+    return 0;
+}
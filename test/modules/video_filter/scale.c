@@ -0,0 +1,301 @@
+/*****************************************************************************
+ * scale.c: test for the polyphase scaler
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks the filter banks of the scaler, that its SIMD kernels are
+ * bit-exact with their C counterparts, and that the colour of transparent
+ * pixels does not bleed when scaling pictures with alpha. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include "../../../modules/video_filter/scale.h"
+
+#define WIDTH 700 /* maximum line width, in samples */
+#define TAPS  64  /* maximum vertical taps */
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static const unsigned sizes[] = { 1, 2, 3, 5, 8, 17, 31, 64, 100, 233 };
+
+static void test_banks(void)
+{
+    for (int kernel = SCALE_BILINEAR; kernel <= SCALE_LANCZOS; kernel++)
+        for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++)
+            for (unsigned j = 0; j < ARRAY_SIZE(sizes); j++)
+            {
+                const unsigned src = sizes[i], dst = sizes[j];
+                scale_bank_t bank;
+
+                assert(scale_bank_Init(&bank, src, dst, kernel) == 0);
+                assert(bank.taps % 2 == 0);
+
+                for (unsigned x = 0; x < dst; x++)
+                {
+                    int sum = 0;
+
+                    assert(bank.pos[x] >= 0);
+                    assert(bank.pos[x] + bank.taps <= ((src + 1) & ~1u));
+                    for (unsigned k = 0; k < bank.taps; k++)
+                    {
+                        sum += bank.coefs[x * bank.taps + k];
+                        /* Padding taps past the source must be null */
+                        if (bank.pos[x] + k >= src)
+                            assert(bank.coefs[x * bank.taps + k] == 0);
+                    }
+                    assert(sum == 1 << SCALE_COEF_BITS);
+                }
+
+                /* Same size: identity */
+                if (src == dst)
+                    for (unsigned x = 0; x < dst; x++)
+                        for (unsigned k = 0; k < bank.taps; k++)
+                            assert(bank.coefs[x * bank.taps + k]
+                                   == ((bank.pos[x] + k == x)
+                                       ? 1 << SCALE_COEF_BITS : 0));
+                scale_bank_Clean(&bank);
+            }
+    printf("filter banks: OK\n");
+}
+
+/* A constant input must give the same constant, whatever the overshoot of
+ * the filter, and scaling must be the identity at the same size. */
+static void test_flat(void)
+{
+    static uint8_t in[WIDTH], out[WIDTH];
+    static int16_t inter[WIDTH + SCALE_PADDING];
+
+    for (int kernel = SCALE_BILINEAR; kernel <= SCALE_LANCZOS; kernel++)
+        for (unsigned value = 0; value < 256; value += 51)
+        {
+            scale_bank_t v, h;
+            const void *lines[TAPS];
+
+            memset(in, value, sizeof (in));
+            assert(scale_bank_Init(&v, 5, 13, kernel) == 0);
+            assert(scale_bank_Init(&h, 233, 100, kernel) == 0);
+            for (unsigned k = 0; k < v.taps; k++)
+                lines[k] = in;
+            for (unsigned y = 0; y < 13; y++)
+            {
+                scale_v8_c(inter, lines, v.coefs + y * v.taps, v.taps,
+                           233, 8);
+                scale_h8_c(out, inter, &h, 0, 100, 8);
+                for (unsigned x = 0; x < 100; x++)
+                    assert(out[x] == value);
+            }
+            scale_bank_Clean(&v);
+            scale_bank_Clean(&h);
+
+            for (unsigned x = 0; x < WIDTH; x++)
+                in[x] = rnd();
+            assert(scale_bank_Init(&h, 233, 233, kernel) == 0);
+            for (unsigned x = 0; x < 233; x++)
+                inter[x] = in[x] << (SCALE_INTER_BITS - 8);
+            scale_h8_c(out, inter, &h, 0, 233, 8);
+            assert(!memcmp(in, out, 233));
+            scale_bank_Clean(&h);
+        }
+    printf("flat and identity: OK\n");
+}
+
+/* A transparent red half next to an opaque blue half, scaled up in RGBA:
+ * no red may show, and the opaque pixels must be left alone */
+static void test_alpha(void)
+{
+    static uint8_t line[4 * 64], out[4 * 160];
+    static int16_t inter[4 * 64 + SCALE_PADDING];
+    uint32_t *table = scale_unpremultiply_table(8);
+    assert(table != NULL);
+
+    for (int kernel = SCALE_BILINEAR; kernel <= SCALE_LANCZOS; kernel++)
+    {
+        scale_bank_t h;
+
+        for (unsigned x = 0; x < 64; x++)
+        {
+            const bool opaque = x >= 32;
+
+            line[4 * x + 0] = opaque ? 0 : 255;
+            line[4 * x + 1] = 0;
+            line[4 * x + 2] = opaque ? 255 : 0;
+            line[4 * x + 3] = opaque ? 255 : 0;
+        }
+        for (unsigned c = 0; c < 3; c++)
+            scale_premultiply8(line + c, line + 3, 64, 4);
+        for (unsigned x = 0; x < 4 * 64; x++)
+            inter[x] = line[x] << (SCALE_INTER_BITS - 8);
+
+        assert(scale_bank_Init(&h, 64, 160, kernel) == 0);
+        scale_h8x4_c(out, inter, &h, 0, 160, 8);
+        for (unsigned c = 0; c < 3; c++)
+            scale_unpremultiply8(out + c, out + 3, 160, 4, table);
+        scale_bank_Clean(&h);
+
+        for (unsigned x = 0; x < 160; x++)
+        {
+            assert(out[4 * x + 0] == 0 && out[4 * x + 1] == 0);
+            if (out[4 * x + 3] == 0)
+                assert(out[4 * x + 2] == 0);
+            if (x >= 100)
+                assert(out[4 * x + 2] == 255 && out[4 * x + 3] == 255);
+        }
+    }
+
+    /* Opaque pixels round trip exactly, transparent ones become null */
+    for (unsigned v = 0; v < 256; v++)
+    {
+        uint8_t px[2] = { v, 255 }, tr[2] = { v, 0 };
+
+        scale_premultiply8(px, px + 1, 1, 2);
+        scale_unpremultiply8(px, px + 1, 1, 2, table);
+        assert(px[0] == v);
+        scale_premultiply8(tr, tr + 1, 1, 2);
+        scale_unpremultiply8(tr, tr + 1, 1, 2, table);
+        assert(tr[0] == 0);
+    }
+    free(table);
+
+    table = scale_unpremultiply_table(10);
+    assert(table != NULL);
+    for (unsigned v = 0; v < 1024; v++)
+    {
+        uint16_t px[2] = { v, 1023 };
+
+        scale_premultiply16(px, px + 1, 1, 2, 10);
+        scale_unpremultiply16(px, px + 1, 1, 2, 10, table);
+        assert(px[0] == v);
+    }
+    free(table);
+    printf("alpha: OK\n");
+}
+
+#ifdef CAN_COMPILE_AVX2
+static void fill_lines(uint8_t *buf, size_t size, unsigned depth)
+{
+    if (depth > 8)
+    {
+        uint16_t *buf16 = (uint16_t *)buf;
+        for (size_t i = 0; i < size / 2; i++)
+            buf16[i] = (rnd() & 1) ? rnd() % (1u << depth)
+                                   : (rnd() & 1) ? (1u << depth) - 1 : 0;
+    }
+    else
+        for (size_t i = 0; i < size; i++)
+            buf[i] = (rnd() & 1) ? rnd() : (rnd() & 1) ? 255 : 0;
+}
+
+static void test_kernels_avx2(int kernel, unsigned depth)
+{
+    static uint8_t in[TAPS][2 * WIDTH];
+    static int16_t inter[WIDTH + SCALE_PADDING];
+    static int16_t inter_ref[WIDTH], inter_simd[WIDTH];
+    static uint8_t out_ref[4 * WIDTH + 64], out_simd[4 * WIDTH + 64];
+    const scale_v_t v_ref = depth > 8 ? scale_v16_c : scale_v8_c;
+    const scale_v_t v_simd = depth > 8 ? scale_v16_avx2 : scale_v8_avx2;
+    const scale_h_t h_ref = depth > 8 ? scale_h16_c : scale_h8_c;
+    const scale_h_t h_simd = depth > 8 ? scale_h16_avx2 : scale_h8_avx2;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++)
+        for (unsigned j = 0; j < ARRAY_SIZE(sizes); j++)
+        {
+            const unsigned src = sizes[i] * 3, dst = sizes[j] * 3;
+            scale_bank_t bank;
+            const void *lines[TAPS];
+
+            assert(scale_bank_Init(&bank, src, dst, kernel) == 0);
+            if (bank.taps > TAPS)
+            {
+                scale_bank_Clean(&bank);
+                continue;
+            }
+
+            /* Vertical: the bank scales lines, the width is src */
+            fill_lines(&in[0][0], sizeof (in), depth);
+            for (unsigned k = 0; k < bank.taps; k++)
+                lines[k] = in[k];
+            for (unsigned y = 0; y < dst; y++)
+            {
+                const int16_t *coefs = bank.coefs + y * bank.taps;
+
+                v_ref(inter_ref, lines, coefs, bank.taps, src, depth);
+                v_simd(inter_simd, lines, coefs, bank.taps, src, depth);
+                assert(!memcmp(inter_ref, inter_simd, src * 2));
+            }
+
+            /* Horizontal, from the extreme intermediate values */
+            memcpy(inter, inter_ref, src * 2);
+            memset(inter + src, 0, SCALE_PADDING * 2);
+            fill_lines(out_ref, sizeof (out_ref), 8);
+            memcpy(out_simd, out_ref, sizeof (out_ref));
+            h_ref(out_ref, inter, &bank, 0, dst, depth);
+            h_simd(out_simd, inter, &bank, 0, dst, depth);
+            assert(!memcmp(out_ref, out_simd, sizeof (out_ref)));
+
+            /* Packed pixels */
+            if (depth == 8 && src <= WIDTH / 4)
+            {
+                for (unsigned x = 0; x < 4 * src; x++)
+                    inter[x] = inter_ref[x % src];
+                memset(inter + 4 * src, 0, SCALE_PADDING * 2);
+                scale_h8x4_c(out_ref, inter, &bank, 0, dst, 8);
+                scale_h8x4_avx2(out_simd, inter, &bank, 0, dst, 8);
+                assert(!memcmp(out_ref, out_simd, sizeof (out_ref)));
+            }
+            scale_bank_Clean(&bank);
+        }
+}
+#endif
+
+int main(void)
+{
+    test_banks();
+    test_flat();
+    test_alpha();
+
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        for (int kernel = SCALE_BILINEAR; kernel <= SCALE_LANCZOS; kernel++)
+            for (unsigned depth = 8; depth <= 12; depth += 2)
+                test_kernels_avx2(kernel, depth);
+        printf("AVX2 kernels: OK\n");
+    }
+    else
+#endif
+        printf("no SIMD kernel supported, skipping\n");
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*****************************************************************************
+ * tonemap.c: test for the HDR to SDR tone mapping kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks the transfer functions, the mapping of the black, of the peak and
+ * of the greys, and that the SIMD kernels match the C ones. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_es.h>
+#include <vlc_cpu.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include "../../../modules/video_filter/tonemap.h"
+
+#define WIDTH 203
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static tonemap_t *create(video_transfer_func_t transfer, unsigned peak)
+{
+    video_format_t fmt;
+    tonemap_t *tm = malloc(sizeof (*tm));
+    assert(tm != NULL);
+
+    video_format_Init(&fmt, 0);
+    fmt.transfer = transfer;
+    fmt.primaries = COLOR_PRIMARIES_BT2020;
+    fmt.space = COLOR_SPACE_BT2020;
+    tonemap_init(tm, &fmt, peak, TONEMAP_WHITE);
+    return tm;
+}
+
+/* Converts a grey of 10-bits luma code y */
+static uint8_t grey(const tonemap_t *tm, unsigned y, tonemap_line_t line)
+{
+    const uint16_t in_y[2] = { y, y }, in_c[1] = { 512 };
+    uint8_t out_y[2], out_u[1], out_v[1];
+
+    line(tm, out_y, out_u, out_v, in_y, in_c, in_c, 2, 1);
+    assert(out_y[0] == out_y[1]);
+    assert(abs(out_u[0] - 128) <= 1 && abs(out_v[0] - 128) <= 1);
+    return out_y[0];
+}
+
+static unsigned pq_code(double nits)
+{
+    return lround(64. + 876. * tonemap_pq_oetf(nits));
+}
+
+static void test_transfer(void)
+{
+    for (double l = 0.01; l <= 10000.; l *= 1.5)
+        assert(fabs(tonemap_pq_eotf(tonemap_pq_oetf(l)) - l) < l * 1e-6);
+    assert(tonemap_pq_oetf(10000.) > 0.999999);
+    assert(fabs(tonemap_hlg_inverse_oetf(0.5) - 1. / 12.) < 1e-9);
+    assert(fabs(tonemap_hlg_inverse_oetf(1.) - 1.) < 1e-6);
+    printf("transfer functions: OK\n");
+}
+
+static void test_pq(void)
+{
+    static const unsigned peaks[] = { 100, 400, 1000, 4000, 10000 };
+
+    for (unsigned i = 0; i < ARRAY_SIZE(peaks); i++)
+    {
+        tonemap_t *tm = create(TRANSFER_FUNC_SMPTE_ST2084, peaks[i]);
+
+        /* The black stays black, the peak is the SDR white */
+        assert(grey(tm, 64, tonemap_line_c) == 16);
+        assert(grey(tm, pq_code(__MAX(peaks[i], TONEMAP_WHITE)),
+                    tonemap_line_c) >= 234);
+
+        /* The greys are mapped monotonically */
+        uint8_t last = 0;
+        for (unsigned y = 64; y <= 940; y++)
+        {
+            const uint8_t v = grey(tm, y, tonemap_line_c);
+            assert(v >= last);
+            last = v;
+        }
+
+        /* The midtones are compressed less with a lower peak */
+        if (peaks[i] > TONEMAP_WHITE)
+        {
+            tonemap_t *lower = create(TRANSFER_FUNC_SMPTE_ST2084,
+                                      peaks[i] / 2);
+            assert(grey(lower, pq_code(100), tonemap_line_c)
+                >= grey(tm, pq_code(100), tonemap_line_c));
+            free(lower);
+        }
+        free(tm);
+    }
+    printf("PQ: OK\n");
+}
+
+static void test_hlg(void)
+{
+    tonemap_t *tm = create(TRANSFER_FUNC_HLG, 1000);
+
+    assert(grey(tm, 64, tonemap_line_c) == 16);
+    assert(grey(tm, 940, tonemap_line_c) >= 234);
+
+    uint8_t last = 0;
+    for (unsigned y = 64; y <= 940; y++)
+    {
+        const uint8_t v = grey(tm, y, tonemap_line_c);
+        assert(v >= last);
+        last = v;
+    }
+    free(tm);
+    printf("HLG: OK\n");
+}
+
+#ifdef CAN_COMPILE_AVX2
+static void compare(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        assert(abs(a[i] - b[i]) <= 1);
+}
+
+static void test_avx2(void)
+{
+    static const video_transfer_func_t transfers[] = {
+        TRANSFER_FUNC_SMPTE_ST2084, TRANSFER_FUNC_HLG,
+    };
+    uint16_t y[WIDTH], u[WIDTH], v[WIDTH];
+    uint8_t ref[3][WIDTH + 16], simd[3][WIDTH + 16];
+
+    for (unsigned t = 0; t < ARRAY_SIZE(transfers); t++)
+    {
+        tonemap_t *tm = create(transfers[t], 1000);
+
+        for (unsigned i = 0; i < 1000; i++)
+        {
+            const unsigned width = rnd() % WIDTH;
+            const unsigned hshift = i & 1;
+            const bool chroma = i & 2;
+
+            for (unsigned x = 0; x < WIDTH; x++)
+            {
+                y[x] = rnd() % 1024;
+                u[x] = (i & 4) ? rnd() % 1024 : 512 + rnd() % 16 - 8;
+                v[x] = (i & 4) ? rnd() % 1024 : 512 + rnd() % 16 - 8;
+            }
+
+            memset(ref, 0x5a, sizeof (ref));
+            memset(simd, 0x5a, sizeof (simd));
+            tonemap_line_c(tm, ref[0], chroma ? ref[1] : NULL,
+                           chroma ? ref[2] : NULL, y, u, v, width, hshift);
+            tonemap_line_avx2(tm, simd[0], chroma ? simd[1] : NULL,
+                              chroma ? simd[2] : NULL, y, u, v, width, hshift);
+            compare(&ref[0][0], &simd[0][0], sizeof (ref));
+        }
+        free(tm);
+    }
+    printf("AVX2 kernel: OK\n");
+}
+#endif
+
+int main(void)
+{
+    test_transfer();
+    test_pq();
+    test_hlg();
+
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+        test_avx2();
+    else
+#endif
+        printf("no SIMD kernel supported, skipping\n");
+    return 0;
+}
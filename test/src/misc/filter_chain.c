@@ -0,0 +1,202 @@
+/*****************************************************************************
+ * filter_chain.c: test for the pictures pools of the video filter chains
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+
+#include "../../libvlc/test.h"
+
+/* The invert filter writes in place when it can: the inputs are held while
+ * they are filtered, so that the first filter of the chain has to take its
+ * output pictures from the chain pool. */
+#define POOL_PICTURES 3 /* for one intermediate filter */
+#define HELD_PICTURES 8
+/* Pictures of the same size are kept allocated while the chain runs, so
+ * that the heap does not hand the released outputs back either */
+#define BALLAST_PICTURES 32
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static picture_t *buffer_new(filter_t *filter)
+{
+    return picture_NewFromFormat(&filter->fmt_out.video);
+}
+
+static picture_t *new_input(const video_format_t *fmt)
+{
+    picture_t *pic = picture_NewFromFormat(fmt);
+    assert(pic != NULL);
+
+    for (int i = 0; i < pic->i_planes; i++)
+        for (int j = 0; j < pic->p[i].i_lines * pic->p[i].i_pitch; j++)
+            pic->p[i].p_pixels[j] = rnd();
+    return pic;
+}
+
+/* An even number of inverts gives the input back */
+static void check_output(const picture_t *in, const picture_t *out,
+                         bool inverted)
+{
+    assert(out != NULL && out != in);
+
+    for (int i = 0; i < in->i_planes; i++)
+        for (int y = 0; y < in->p[i].i_visible_lines; y++)
+        {
+            const uint8_t *a = &in->p[i].p_pixels[y * in->p[i].i_pitch];
+            const uint8_t *b = &out->p[i].p_pixels[y * out->p[i].i_pitch];
+
+            for (int x = 0; x < in->p[i].i_visible_pitch; x++)
+                assert(b[x] == (inverted ? (uint8_t)~a[x] : a[x]));
+        }
+}
+
+static picture_t *filter(filter_chain_t *chain, const video_format_t *fmt,
+                         bool inverted)
+{
+    picture_t *in = new_input(fmt);
+    picture_t *out = filter_chain_VideoFilter(chain, picture_Hold(in));
+
+    check_output(in, out, inverted);
+    picture_Release(in);
+    return out;
+}
+
+static bool pixels_in(const picture_t *pic, const uint8_t *const *pixels,
+                      unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+        if (pixels[i] == pic->p[0].p_pixels)
+            return true;
+    return false;
+}
+
+static void test_pools(filter_chain_t *chain, const video_format_t *fmt)
+{
+    picture_t *held[HELD_PICTURES];
+    picture_t *ballast[BALLAST_PICTURES];
+    unsigned ballasts = 0;
+
+    /* Released outputs are recycled */
+    picture_t *first = filter(chain, fmt, false);
+    const uint8_t *pixels = first->p[0].p_pixels;
+    picture_Release(first);
+    for (unsigned i = 0; i < 16; i++)
+    {
+        ballast[ballasts++] = new_input(fmt);
+
+        picture_t *out = filter(chain, fmt, false);
+        assert(out->p[0].p_pixels == pixels);
+        picture_Release(out);
+    }
+
+    /* The heap takes over once all the pooled pictures are held */
+    for (unsigned i = 0; i < HELD_PICTURES; i++)
+        held[i] = filter(chain, fmt, false);
+    for (unsigned i = 0; i < HELD_PICTURES; i++)
+        for (unsigned j = 0; j < i; j++)
+            assert(held[i]->p[0].p_pixels != held[j]->p[0].p_pixels);
+
+    const uint8_t *pooled[POOL_PICTURES];
+    for (unsigned i = 0; i < POOL_PICTURES; i++)
+        pooled[i] = held[i]->p[0].p_pixels;
+    for (unsigned i = 0; i < HELD_PICTURES; i++)
+        picture_Release(held[i]);
+
+    /* Only the pooled pictures come back */
+    for (unsigned i = 0; i < HELD_PICTURES; i++)
+        ballast[ballasts++] = new_input(fmt);
+    for (unsigned i = 0; i < POOL_PICTURES; i++)
+    {
+        held[i] = filter(chain, fmt, false);
+        assert(pixels_in(held[i], pooled, POOL_PICTURES));
+    }
+    for (unsigned i = 0; i < POOL_PICTURES; i++)
+        picture_Release(held[i]);
+    for (unsigned i = 0; i < ballasts; i++)
+        picture_Release(ballast[i]);
+    printf("pools: OK\n");
+}
+
+static void test_changes(filter_chain_t *chain, const video_format_t *fmt)
+{
+    /* Pictures of the dropped pools outlive them */
+    picture_t *old = filter(chain, fmt, false);
+    assert(filter_chain_AppendFromString(chain, "invert") == 1);
+
+    picture_t *out = filter(chain, fmt, true);
+    picture_Release(old);
+    picture_Release(out);
+
+    for (unsigned i = 0; i < 4; i++)
+        picture_Release(filter(chain, fmt, true));
+
+    /* and the pools of the deleted chain too */
+    old = filter(chain, fmt, true);
+    filter_chain_Delete(chain);
+    picture_Release(old);
+    printf("changes: OK\n");
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *argv[] = { "-v" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    filter_owner_t owner = {
+        .video = { .buffer_new = buffer_new },
+    };
+    filter_chain_t *chain = filter_chain_NewVideo(vlc->p_libvlc_int, false,
+                                                  &owner);
+    assert(chain != NULL);
+
+    es_format_t fmt;
+    es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_I420);
+    video_format_Setup(&fmt.video, VLC_CODEC_I420, 64, 48, 63, 47, 1, 1);
+    filter_chain_Reset(chain, &fmt, &fmt);
+    assert(filter_chain_AppendFromString(chain, "invert:invert") == 2);
+
+    test_pools(chain, &fmt.video);
+    test_changes(chain, &fmt.video);
+
+    es_format_Clean(&fmt);
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*****************************************************************************
+ * slices.c: test for the video filter slice threads
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_filter.h>
+
+#include "../../libvlc/test.h"
+
+#define MAX_SLICES 64
+
+struct count_data
+{
+    unsigned count;
+    atomic_uint calls[MAX_SLICES];
+};
+
+static void count_slice(void *opaque, unsigned index, unsigned count)
+{
+    struct count_data *data = opaque;
+
+    assert(count == data->count);
+    assert(index < count);
+    atomic_fetch_add(&data->calls[index], 1);
+}
+
+static void test_count(filter_t *filter, unsigned count)
+{
+    struct count_data data = { .count = count };
+
+    for (unsigned i = 0; i < MAX_SLICES; i++)
+        atomic_init(&data.calls[i], 0);
+
+    filter_ExecuteSlices(filter, count_slice, &data, count);
+
+    for (unsigned i = 0; i < MAX_SLICES; i++)
+        assert(atomic_load(&data.calls[i]) == (i < count));
+}
+
+/* Each slice waits for the previous one, as in a wavefront */
+struct chain_data
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;
+    unsigned    done;
+};
+
+static void chain_slice(void *opaque, unsigned index, unsigned count)
+{
+    struct chain_data *data = opaque;
+
+    vlc_mutex_lock(&data->lock);
+    while (data->done < index)
+        vlc_cond_wait(&data->wait, &data->lock);
+    assert(data->done == index);
+    data->done++;
+    vlc_cond_broadcast(&data->wait);
+    vlc_mutex_unlock(&data->lock);
+    (void) count;
+}
+
+static void test_chain(filter_t *filter, unsigned count)
+{
+    struct chain_data data = { .done = 0 };
+
+    vlc_mutex_init(&data.lock);
+    vlc_cond_init(&data.wait);
+    filter_ExecuteSlices(filter, chain_slice, &data, count);
+    assert(data.done == count);
+    vlc_cond_destroy(&data.wait);
+    vlc_mutex_destroy(&data.lock);
+}
+
+/* Several filters submitting slices at the same time */
+static void *submit_thread(void *data)
+{
+    filter_t *filter = data;
+
+    for (unsigned i = 0; i < 200; i++)
+    {
+        test_count(filter, 1 + (i % 17));
+        test_chain(filter, 1 + (i % 5));
+    }
+    return NULL;
+}
+
+static void test_lines(void)
+{
+    static const unsigned aligns[] = { 1, 2, 4 };
+
+    for (unsigned lines = 0; lines < 100; lines++)
+        for (unsigned count = 1; count <= 9; count++)
+            for (unsigned a = 0; a < ARRAY_SIZE(aligns); a++)
+            {
+                unsigned next = 0;
+
+                for (unsigned i = 0; i < count; i++)
+                {
+                    unsigned begin, end;
+
+                    filter_GetSliceLines(lines, i, count, aligns[a],
+                                         &begin, &end);
+                    assert(begin == next);
+                    assert(begin <= end);
+                    assert(begin % aligns[a] == 0);
+                    next = end;
+                }
+                assert(next == lines);
+            }
+}
+
+static void test_instance(const char *threads, unsigned expected)
+{
+    const char *argv[] = { "--filter-threads", threads };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    filter_t *filter = vlc_object_create(vlc->p_libvlc_int, sizeof (*filter));
+    assert(filter != NULL);
+
+    unsigned slices = filter_GetSliceCount(filter);
+    assert(slices >= 1);
+    if (expected > 0)
+        assert(slices == expected);
+    printf("%s thread(s) requested: %u slice thread(s)\n", threads, slices);
+
+    for (unsigned count = 0; count <= MAX_SLICES; count++)
+        test_count(filter, count);
+    for (unsigned count = 0; count <= 2 * slices + 1; count++)
+        test_chain(filter, count);
+
+    vlc_thread_t th[3];
+    for (unsigned i = 0; i < ARRAY_SIZE(th); i++)
+    {
+        int val = vlc_clone(&th[i], submit_thread, filter,
+                            VLC_THREAD_PRIORITY_LOW);
+        assert(val == 0);
+    }
+    for (unsigned i = 0; i < ARRAY_SIZE(th); i++)
+        vlc_join(th[i], NULL);
+
+    vlc_object_release(filter);
+    libvlc_release(vlc);
+}
+
+int main(void)
+{
+    test_init();
+
+    test_lines();
+    test_instance("1", 1);
+    test_instance("4", 4);
+    test_instance("0", 0);
+    return 0;
+}
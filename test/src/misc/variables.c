@@ -443,6 +443,63 @@ static void test_creation_and_type( libvlc_int_t *p_libvlc )
     assert( var_Get( p_libvlc, "bla", &val ) == VLC_ENOVAR );
 }
 
+static void test_handles( libvlc_int_t *p_libvlc )
+{
+    vlc_value_t val;
+
+    assert( var_Lookup( p_libvlc, "bla" ) == NULL );
+
+    var_Create( p_libvlc, "bla", VLC_VAR_INTEGER );
+    var_Change( p_libvlc, "bla", VLC_VAR_SETMINMAX,
+                &(vlc_value_t){ .i_int = 0 },
+                &(vlc_value_t){ .i_int = 100 } );
+    vlc_var_handle_t *h = var_Lookup( p_libvlc, "bla" );
+    assert( h != NULL );
+
+    /* Values set by name are seen through the handle and vice versa */
+    var_SetInteger( p_libvlc, "bla", 42 );
+    assert( var_HandleGetInteger( p_libvlc, h ) == 42 );
+    var_HandleSetInteger( p_libvlc, h, 1000 );
+    assert( var_GetInteger( p_libvlc, "bla" ) == 100 );
+    assert( var_HandleGetInteger( p_libvlc, h ) == 100 );
+    val.i_int = 5;
+    var_GetAndSet( VLC_OBJECT(p_libvlc), "bla", VLC_VAR_INTEGER_NAND, &val );
+    assert( var_HandleGetInteger( p_libvlc, h ) == 96 );
+
+    /* The handle keeps the variable alive */
+    var_Destroy( p_libvlc, "bla" );
+    assert( var_HandleGetInteger( p_libvlc, h ) == 96 );
+    var_HandleRelease( p_libvlc, h );
+    assert( var_Type( p_libvlc, "bla" ) == 0 );
+
+    var_Create( p_libvlc, "bla", VLC_VAR_STRING );
+    h = var_Lookup( p_libvlc, "bla" );
+    var_SetString( p_libvlc, "bla", "foo" );
+    var_HandleGet( p_libvlc, h, &val );
+    assert( !strcmp( val.psz_string, "foo" ) );
+    free( val.psz_string );
+    var_HandleRelease( p_libvlc, h );
+    var_Destroy( p_libvlc, "bla" );
+    assert( var_Type( p_libvlc, "bla" ) == 0 );
+
+    /* Many variables, to go through table growth */
+    char name[16];
+    for( unsigned i = 0; i < 1000; i++ )
+    {
+        snprintf( name, sizeof (name), "var%u", i );
+        var_Create( p_libvlc, name, VLC_VAR_FLOAT );
+        var_SetFloat( p_libvlc, name, i );
+    }
+    for( unsigned i = 0; i < 1000; i++ )
+    {
+        snprintf( name, sizeof (name), "var%u", i );
+        h = var_Lookup( p_libvlc, name );
+        assert( var_HandleGetFloat( p_libvlc, h ) == (float)i );
+        var_HandleRelease( p_libvlc, h );
+        var_Destroy( p_libvlc, name );
+    }
+}
+
 static void test_variables( libvlc_instance_t *p_vlc )
 {
     libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
@@ -480,6 +537,9 @@ static void test_variables( libvlc_instance_t *p_vlc )
 
     log( "Testing type at creation\n" );
     test_creation_and_type( p_libvlc );
+
+    log( "Testing handles\n" );
+    test_handles( p_libvlc );
 }
 
 
@@ -0,0 +1,282 @@
+/*****************************************************************************
+ * spu.c: test for the scaled region cache of the subpicture renderer
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+#include <vlc_subpicture.h>
+#include <vlc_spu.h>
+
+#include "../../libvlc/test.h"
+
+/* Regions of SRC_WIDTH x SRC_HEIGHT, on a video of the same size, are
+ * scaled to the size of the output. Like the logo source, the test keeps
+ * the region pictures and sends them again in new subpictures. */
+#define SRC_WIDTH  40
+#define SRC_HEIGHT 20
+
+static const vlc_fourcc_t chromas[] = { VLC_CODEC_YUVA, 0 };
+
+/* Scalings done by the renderer, through the converter below */
+static unsigned scale_count;
+
+/* Nearest neighbour scaler, so that the test does not depend on the
+ * converters of the build, and the scaled values are exact */
+static picture_t *Scale(filter_t *filter, picture_t *src)
+{
+    picture_t *dst = NULL;
+
+    scale_count++;
+    if (src->format.i_chroma == filter->fmt_out.video.i_chroma)
+        dst = filter_NewPicture(filter);
+    if (dst == NULL) {
+        picture_Release(src);
+        return NULL;
+    }
+
+    for (int i = 0; i < dst->i_planes; i++) {
+        const plane_t *s = &src->p[i];
+        plane_t *d = &dst->p[i];
+        const int size = d->i_pixel_pitch;
+        const int src_width = s->i_visible_pitch / size;
+        const int dst_width = d->i_visible_pitch / size;
+
+        for (int y = 0; y < d->i_visible_lines; y++) {
+            const uint8_t *in = &s->p_pixels[y * s->i_visible_lines
+                                             / d->i_visible_lines * s->i_pitch];
+            uint8_t *out = &d->p_pixels[y * d->i_pitch];
+
+            for (int x = 0; x < dst_width; x++)
+                memcpy(&out[x * size], &in[x * src_width / dst_width * size],
+                       size);
+        }
+    }
+    picture_CopyProperties(dst, src);
+    picture_Release(src);
+    return dst;
+}
+
+static int OpenScale(vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+
+    filter->pf_video_filter = Scale;
+    return VLC_SUCCESS;
+}
+
+#define MODULE_NAME test_spu_scale
+#undef MODULE_STRING
+#define MODULE_STRING "test_spu_scale"
+#undef __PLUGIN__
+#include <vlc_plugin.h>
+
+vlc_module_begin()
+    set_capability("video converter", 1000)
+    set_callbacks(OpenScale, NULL)
+vlc_module_end()
+
+/* Provides the converter to the modules bank */
+typedef int (*vlc_plugin_cb)(int (*)(void *, void *, int, ...), void *);
+
+__attribute__((visibility("default")))
+vlc_plugin_cb vlc_static_modules[] = { vlc_entry__test_spu_scale, NULL };
+
+static picture_t *new_source(uint8_t luma)
+{
+    video_format_t fmt;
+
+    video_format_Init(&fmt, VLC_CODEC_YUVA);
+    video_format_Setup(&fmt, VLC_CODEC_YUVA, SRC_WIDTH, SRC_HEIGHT,
+                       SRC_WIDTH, SRC_HEIGHT, 1, 1);
+
+    picture_t *pic = picture_NewFromFormat(&fmt);
+    assert(pic != NULL);
+
+    for (int i = 0; i < pic->i_planes; i++) {
+        const int value = i == Y_PLANE ? luma : i == A_PLANE ? 255 : 128;
+
+        memset(pic->p[i].p_pixels, value,
+               pic->p[i].i_lines * pic->p[i].i_pitch);
+    }
+    return pic;
+}
+
+static void put(spu_t *spu, int channel, picture_t *source, int x)
+{
+    subpicture_t *subpic = subpicture_New(NULL);
+    assert(subpic != NULL);
+
+    subpic->i_channel = channel;
+    subpic->i_start = 0;
+    subpic->i_stop = INT64_MAX;
+    subpic->b_absolute = true;
+    subpic->i_original_picture_width = SRC_WIDTH;
+    subpic->i_original_picture_height = SRC_HEIGHT;
+
+    subpicture_region_t *region = subpicture_region_New(&source->format);
+    assert(region != NULL);
+    picture_Release(region->p_picture);
+    region->p_picture = picture_Hold(source);
+    region->i_x = x;
+    subpic->p_region = region;
+
+    spu_ClearChannel(spu, channel);
+    spu_PutSubpicture(spu, subpic);
+}
+
+/* Returns the scaled picture of the only region, held */
+static picture_t *render(spu_t *spu, unsigned width, unsigned height,
+                         uint8_t luma)
+{
+    video_format_t fmt_src, fmt_dst;
+
+    video_format_Init(&fmt_src, VLC_CODEC_I420);
+    video_format_Setup(&fmt_src, VLC_CODEC_I420, SRC_WIDTH, SRC_HEIGHT,
+                       SRC_WIDTH, SRC_HEIGHT, 1, 1);
+    video_format_Init(&fmt_dst, VLC_CODEC_I420);
+    video_format_Setup(&fmt_dst, VLC_CODEC_I420, width, height,
+                       width, height, 1, 1);
+
+    subpicture_t *render = spu_Render(spu, chromas, &fmt_dst, &fmt_src,
+                                      1, 1, false);
+    assert(render != NULL);
+
+    subpicture_region_t *region = render->p_region;
+    assert(region != NULL && region->p_next == NULL);
+    assert(region->fmt.i_visible_width == width);
+    assert(region->fmt.i_visible_height == height);
+
+    picture_t *pic = picture_Hold(region->p_picture);
+    const plane_t *y = &pic->p[Y_PLANE];
+    for (int i = 0; i < y->i_visible_lines; i++)
+        for (int j = 0; j < y->i_visible_pitch; j++)
+            assert(y->p_pixels[i * y->i_pitch + j] == luma);
+
+    subpicture_Delete(render);
+    return pic;
+}
+
+/* Renders the region, checking whether it had to be scaled */
+static picture_t *render_scaled(spu_t *spu, unsigned width, unsigned height,
+                                uint8_t luma, bool scaled)
+{
+    const unsigned count = scale_count;
+    picture_t *pic = render(spu, width, height, luma);
+
+    assert(scale_count == count + scaled);
+    return pic;
+}
+
+static void test_cache(spu_t *spu)
+{
+    const int channel = spu_RegisterChannel(spu);
+    picture_t *a = new_source(0x40), *b = new_source(0xc0);
+
+    /* The same picture in a new subpicture is not scaled again */
+    put(spu, channel, a, 0);
+    picture_t *first = render_scaled(spu, 3 * SRC_WIDTH, 3 * SRC_HEIGHT,
+                                     0x40, true);
+    put(spu, channel, a, 0);
+    picture_t *hit = render_scaled(spu, 3 * SRC_WIDTH, 3 * SRC_HEIGHT,
+                                   0x40, false);
+    assert(hit == first);
+    picture_Release(hit);
+    printf("hit: OK\n");
+
+    /* Another picture is scaled */
+    put(spu, channel, b, 0);
+    picture_t *other = render_scaled(spu, 3 * SRC_WIDTH, 3 * SRC_HEIGHT,
+                                     0xc0, true);
+    assert(other != first);
+
+    /* and both are kept */
+    put(spu, channel, a, 0);
+    hit = render_scaled(spu, 3 * SRC_WIDTH, 3 * SRC_HEIGHT, 0x40, false);
+    assert(hit == first);
+    picture_Release(hit);
+    put(spu, channel, b, 0);
+    hit = render_scaled(spu, 3 * SRC_WIDTH, 3 * SRC_HEIGHT, 0xc0, false);
+    assert(hit == other);
+    picture_Release(hit);
+    picture_Release(other);
+    printf("subpicture change: OK\n");
+
+    /* A new output size scales the picture again */
+    put(spu, channel, a, 0);
+    picture_t *resized = render_scaled(spu, 2 * SRC_WIDTH, 2 * SRC_HEIGHT,
+                                       0x40, true);
+    assert(resized != first);
+    picture_Release(resized);
+    put(spu, channel, a, 0);
+    picture_Release(render_scaled(spu, 2 * SRC_WIDTH, 2 * SRC_HEIGHT,
+                                  0x40, false));
+    printf("output format change: OK\n");
+
+    /* The region position does not change the scaled picture */
+    put(spu, channel, a, 4);
+    hit = render_scaled(spu, 3 * SRC_WIDTH, 3 * SRC_HEIGHT, 0x40, false);
+    assert(hit == first);
+    picture_Release(hit);
+    picture_Release(first);
+
+    /* Once its source drops the picture, the cache drops it too, for all
+     * the outputs it was scaled for */
+    put(spu, channel, a, 0);
+    picture_t *last = render_scaled(spu, 3 * SRC_WIDTH, 3 * SRC_HEIGHT,
+                                    0x40, false);
+    picture_Release(a);
+    put(spu, channel, b, 0);
+    picture_Release(b);
+    picture_Release(render_scaled(spu, 3 * SRC_WIDTH, 3 * SRC_HEIGHT,
+                                  0xc0, false));
+    assert(!picture_IsReferenced(last));
+    picture_Release(last);
+    spu_ClearChannel(spu, channel);
+    printf("purge: OK\n");
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *argv[] = { "-v" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    spu_t *spu = spu_Create(vlc->p_libvlc_int, NULL);
+    assert(spu != NULL);
+
+    test_cache(spu);
+
+    spu_Destroy(spu);
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,319 @@
+/*****************************************************************************
+ * vlc-biquad-bench.c: equalizer filters benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Times the biquad sections against the scalar loops that the equalizer and
+ * the parametric equalizer used before, for banks of 10, 18 and 31 bands and
+ * for a cascade of 5 sections, and prints the largest difference of their
+ * outputs. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+
+#include "../modules/audio_filter/biquad.h"
+
+#define RATE   48000
+#define FRAMES (10 * RATE)
+#define BLOCK  1024
+#define MAX_BANDS    32
+#define MAX_CHANNELS 8
+
+/* The equalizer bands, log-spaced from 31.25 Hz to 16 kHz */
+typedef struct
+{
+    unsigned bands;
+    float alpha[MAX_BANDS], beta[MAX_BANDS], gamma[MAX_BANDS];
+    float amp[MAX_BANDS];
+} bank_t;
+
+static void BankInit(bank_t *bank, unsigned bands)
+{
+    const float octaves = log2f(16000.f / 31.25f) / (bands - 1);
+    const float factor = powf(2.f, .5f * octaves);
+    const float factor_1 = .5f * (factor + 1.f);
+    const float factor_2 = .5f * (factor - 1.f);
+
+    bank->bands = bands;
+    for (unsigned i = 0; i < bands; i++)
+    {
+        const float freq = 31.25f * powf(2.f, i * octaves);
+        const float theta_1 = 2.f * (float)M_PI * freq / RATE;
+        const float theta_2 = theta_1 / factor;
+        const float sin_ = sinf(theta_2);
+        const float sin_prd = sinf(theta_2 * factor_1)
+                            * sinf(theta_2 * factor_2);
+        const float sin_hlf = sin_ * .5f;
+        const float den = sin_hlf + sin_prd;
+
+        bank->alpha[i] = sin_prd / den;
+        bank->beta[i] = (sin_hlf - sin_prd) / den;
+        bank->gamma[i] = sin_ * cosf(theta_1) / den;
+        bank->amp[i] = .25f * (powf(10.f, ((int)(i % 7) - 3) / 5.f) - 1.f);
+    }
+}
+
+/* The loop of the equalizer, for one or two passes */
+typedef struct
+{
+    float x[MAX_CHANNELS][2];
+    float y[MAX_CHANNELS][MAX_BANDS][2];
+    float x2[MAX_CHANNELS][2];
+    float y2[MAX_CHANNELS][MAX_BANDS][2];
+} old_eqz_t;
+
+static void OldEqzFilter(old_eqz_t *st, const bank_t *bank, float *out,
+                         const float *in, int samples, int channels,
+                         bool twopass, float gamp)
+{
+    for (int i = 0; i < samples; i++)
+    {
+        for (int ch = 0; ch < channels; ch++)
+        {
+            const float x = in[ch];
+            float o = 0.f;
+
+            for (unsigned j = 0; j < bank->bands; j++)
+            {
+                float y = bank->alpha[j] * (x - st->x[ch][1]) +
+                          bank->gamma[j] * st->y[ch][j][0] -
+                          bank->beta[j] * st->y[ch][j][1];
+
+                st->y[ch][j][1] = st->y[ch][j][0];
+                st->y[ch][j][0] = y;
+                o += y * bank->amp[j];
+            }
+            st->x[ch][1] = st->x[ch][0];
+            st->x[ch][0] = x;
+
+            if (twopass)
+            {
+                const float x2 = .25f * x + o;
+                o = 0.f;
+                for (unsigned j = 0; j < bank->bands; j++)
+                {
+                    float y = bank->alpha[j] * (x2 - st->x2[ch][1]) +
+                              bank->gamma[j] * st->y2[ch][j][0] -
+                              bank->beta[j] * st->y2[ch][j][1];
+
+                    st->y2[ch][j][1] = st->y2[ch][j][0];
+                    st->y2[ch][j][0] = y;
+                    o += y * bank->amp[j];
+                }
+                st->x2[ch][1] = st->x2[ch][0];
+                st->x2[ch][0] = x2;
+                out[ch] = gamp * gamp * (.25f * x2 + o);
+            }
+            else
+                out[ch] = gamp * (.25f * x + o);
+        }
+        in += channels;
+        out += channels;
+    }
+}
+
+/* The loop of the parametric equalizer */
+static void OldProcessEQ(const float *src, float *dest, float *state,
+                         unsigned channels, unsigned samples,
+                         const float *coeffs, unsigned eqCount)
+{
+    float y = 0.f;
+
+    for (unsigned i = 0; i < samples; i++)
+    {
+        float *state1 = state;
+        for (unsigned chn = 0; chn < channels; chn++)
+        {
+            const float *coeffs1 = coeffs;
+            float x = *src++;
+            for (unsigned eq = 0; eq < eqCount; eq++)
+            {
+                y = x * coeffs1[0] + state1[0] * coeffs1[1]
+                  + state1[1] * coeffs1[2] - state1[2] * coeffs1[3]
+                  - state1[3] * coeffs1[4];
+                coeffs1 += 5;
+                state1[1] = state1[0];
+                state1[0] = x;
+                state1[3] = state1[2];
+                state1[2] = y;
+                x = y;
+                state1 += 4;
+            }
+            *dest++ = y;
+        }
+    }
+}
+
+static float MaxDifference(const float *a, const float *b, size_t count)
+{
+    float max = 0.f;
+
+    for (size_t i = 0; i < count; i++)
+        max = fmaxf(max, fabsf(a[i] - b[i]));
+    return max;
+}
+
+static void Report(const char *what, mtime_t old, mtime_t new, float diff)
+{
+    printf("%-36s %6.2f -> %6.2f ns/frame (%4.1fx), difference %g\n", what,
+           old * 1000. / FRAMES, new * 1000. / FRAMES, (double)old / new,
+           diff);
+}
+
+static void BenchBank(const float *in, float *ref, float *out,
+                      unsigned bands, unsigned channels, bool twopass)
+{
+    const float gamp = 1.5f;
+    bank_t bank;
+    BankInit(&bank, bands);
+
+    old_eqz_t *st = calloc(1, sizeof (*st));
+    biquads_t *bq[2] = {
+        BiquadsNew(bands, channels, true),
+        BiquadsNew(bands, channels, true),
+    };
+    if (st == NULL || bq[0] == NULL || bq[1] == NULL)
+        abort();
+
+    const float gain[2] = { twopass ? 1.f : gamp, gamp * gamp };
+    for (unsigned p = 0; p < 2; p++)
+    {
+        for (unsigned i = 0; i < bands; i++)
+        {
+            const float coeffs[5] = { bank.alpha[i], 0.f, -bank.alpha[i],
+                                      -bank.gamma[i], bank.beta[i] };
+
+            BiquadsSetSection(bq[p], i, coeffs);
+            BiquadsSetGain(bq[p], i, gain[p] * bank.amp[i]);
+        }
+        BiquadsSetDirect(bq[p], gain[p] * .25f);
+        BiquadsCommit(bq[p], 0);
+    }
+
+    mtime_t start = mdate();
+    for (size_t i = 0; i < FRAMES; i += BLOCK)
+        OldEqzFilter(st, &bank, &ref[i * channels], &in[i * channels],
+                     BLOCK, channels, twopass, gamp);
+    const mtime_t old = mdate() - start;
+
+    start = mdate();
+    for (size_t i = 0; i < FRAMES; i += BLOCK)
+    {
+        BiquadsProcess(bq[0], &in[i * channels], &out[i * channels], BLOCK);
+        if (twopass)
+            BiquadsProcess(bq[1], &out[i * channels], &out[i * channels],
+                           BLOCK);
+    }
+    const mtime_t new = mdate() - start;
+
+    char what[64];
+    snprintf(what, sizeof (what), "equalizer, %u bands, %u ch, %u pass%s",
+             bands, channels, twopass ? 2 : 1, twopass ? "es" : "");
+    Report(what, old, new, MaxDifference(ref, out, FRAMES * channels));
+
+    BiquadsDelete(bq[1]);
+    BiquadsDelete(bq[0]);
+    free(st);
+}
+
+static void BenchCascade(const float *in, float *ref, float *out,
+                         unsigned channels)
+{
+    static const unsigned sections = 5;
+    float coeffs[5 * 5];
+
+    for (unsigned s = 0; s < sections; s++)
+    {
+        const double r = .5 + .09 * s, theta = .1 + .5 * s;
+
+        coeffs[s * 5 + 0] = 1.f;
+        coeffs[s * 5 + 1] = -1.2f;
+        coeffs[s * 5 + 2] = .5f;
+        coeffs[s * 5 + 3] = -2. * r * cos(theta);
+        coeffs[s * 5 + 4] = r * r;
+    }
+
+    float *state = calloc(channels * sections * 4, sizeof (*state));
+    biquads_t *bq = BiquadsNew(sections, channels, false);
+    if (state == NULL || bq == NULL)
+        abort();
+    for (unsigned s = 0; s < sections; s++)
+        BiquadsSetSection(bq, s, &coeffs[s * 5]);
+    BiquadsCommit(bq, 0);
+
+    mtime_t start = mdate();
+    for (size_t i = 0; i < FRAMES; i += BLOCK)
+        OldProcessEQ(&in[i * channels], &ref[i * channels], state, channels,
+                     BLOCK, coeffs, sections);
+    const mtime_t old = mdate() - start;
+
+    start = mdate();
+    for (size_t i = 0; i < FRAMES; i += BLOCK)
+        BiquadsProcess(bq, &in[i * channels], &out[i * channels], BLOCK);
+    const mtime_t new = mdate() - start;
+
+    char what[64];
+    snprintf(what, sizeof (what), "parametric, %u sections, %u ch", sections,
+             channels);
+    Report(what, old, new, MaxDifference(ref, out, FRAMES * channels));
+
+    BiquadsDelete(bq);
+    free(state);
+}
+
+int main(void)
+{
+    static const unsigned bands[] = { 10, 18, 31 };
+    static const unsigned channels[] = { 2, 6 };
+
+    float *in = malloc(FRAMES * MAX_CHANNELS * sizeof (*in));
+    float *ref = malloc(FRAMES * MAX_CHANNELS * sizeof (*ref));
+    float *out = malloc(FRAMES * MAX_CHANNELS * sizeof (*out));
+    if (in == NULL || ref == NULL || out == NULL)
+        abort();
+
+    unsigned seed = 1;
+    for (size_t i = 0; i < FRAMES * MAX_CHANNELS; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        in[i] = ((seed >> 16) % 20001) / 20000.f - .5f;
+    }
+
+    for (unsigned c = 0; c < ARRAY_SIZE(channels); c++)
+    {
+        for (unsigned b = 0; b < ARRAY_SIZE(bands); b++)
+        {
+            BenchBank(in, ref, out, bands[b], channels[c], false);
+            BenchBank(in, ref, out, bands[b], channels[c], true);
+        }
+        BenchCascade(in, ref, out, channels[c]);
+    }
+
+    free(out);
+    free(ref);
+    free(in);
+    return 0;
+}
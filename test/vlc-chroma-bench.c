@@ -0,0 +1,221 @@
+/*****************************************************************************
+ * vlc-chroma-bench.c: video converters benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Runs every video converter module that accepts each of a list of chroma
+ * pairs, and prints its throughput (in megabytes of input per second) and a
+ * checksum of its output, so that the SIMD and C paths can be compared. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_modules.h>
+#include <vlc_picture.h>
+#include "../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+static const struct
+{
+    vlc_fourcc_t src;
+    vlc_fourcc_t dst;
+} pairs[] = {
+    { VLC_CODEC_I420,     VLC_CODEC_NV12  },
+    { VLC_CODEC_YV12,     VLC_CODEC_NV12  },
+    { VLC_CODEC_I420_10L, VLC_CODEC_P010  },
+    { VLC_CODEC_YUYV,     VLC_CODEC_I420  },
+    { VLC_CODEC_YVYU,     VLC_CODEC_I420  },
+    { VLC_CODEC_UYVY,     VLC_CODEC_I420  },
+    { VLC_CODEC_YUYV,     VLC_CODEC_I422  },
+    { VLC_CODEC_UYVY,     VLC_CODEC_I422  },
+    { VLC_CODEC_GREY,     VLC_CODEC_I420  },
+    { VLC_CODEC_GREY,     VLC_CODEC_YUYV  },
+    { VLC_CODEC_RGB24,    VLC_CODEC_RGB32 },
+    { VLC_CODEC_RGB24,    VLC_CODEC_RGBA  },
+    { VLC_CODEC_I420,     VLC_CODEC_YUYV  },
+    { VLC_CODEC_I422,     VLC_CODEC_YUYV  },
+    { VLC_CODEC_I422,     VLC_CODEC_I420  },
+    { VLC_CODEC_I420,     VLC_CODEC_RGB32 },
+};
+
+static picture_t *NewPicture(filter_t *filter)
+{
+    return picture_NewFromFormat(&filter->fmt_out.video);
+}
+
+static size_t VisibleSize(const picture_t *pic)
+{
+    size_t size = 0;
+
+    for (int i = 0; i < pic->i_planes; i++)
+        size += (size_t)pic->p[i].i_visible_pitch * pic->p[i].i_visible_lines;
+    return size;
+}
+
+static uint32_t Checksum(const picture_t *pic)
+{
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < pic->i_planes; i++)
+        for (int y = 0; y < pic->p[i].i_visible_lines; y++)
+        {
+            const uint8_t *line = pic->p[i].p_pixels + y * pic->p[i].i_pitch;
+
+            for (int x = 0; x < pic->p[i].i_visible_pitch; x++)
+                hash = (hash ^ line[x]) * 16777619u;
+        }
+    return hash;
+}
+
+static void Bench(vlc_object_t *parent, const char *name,
+                  vlc_fourcc_t src, vlc_fourcc_t dst,
+                  unsigned width, unsigned height, unsigned frames)
+{
+    filter_t *filter = vlc_object_create(parent, sizeof (*filter));
+    if (filter == NULL)
+        return;
+
+    es_format_Init(&filter->fmt_in, VIDEO_ES, src);
+    video_format_Setup(&filter->fmt_in.video, src, width, height,
+                       width, height, 1, 1);
+    es_format_Init(&filter->fmt_out, VIDEO_ES, dst);
+    video_format_Setup(&filter->fmt_out.video, dst, width, height,
+                       width, height, 1, 1);
+    filter->owner.video.buffer_new = NewPicture;
+
+    module_t *module = module_need(filter, "video converter", name, true);
+    if (module == NULL)
+        goto out;
+
+    picture_t *in = picture_NewFromFormat(&filter->fmt_in.video);
+    if (in == NULL)
+        goto out_unneed;
+
+    /* Noise, but for 16-bits samples that keep in the 10 bits range */
+    const bool high = vlc_fourcc_GetChromaDescription(src) != NULL
+                   && vlc_fourcc_GetChromaDescription(src)->pixel_bits > 8;
+    unsigned seed = 1;
+    for (int i = 0; i < in->i_planes; i++)
+        for (int y = 0; y < in->p[i].i_lines; y++)
+            for (int x = 0; x < in->p[i].i_pitch; x++)
+            {
+                seed = seed * 1103515245 + 12345;
+                in->p[i].p_pixels[y * in->p[i].i_pitch + x] =
+                    (high && (x & 1)) ? (seed >> 16) & 3 : seed >> 16;
+            }
+
+    uint32_t hash = 0;
+    mtime_t start = mdate();
+
+    for (unsigned i = 0; i < frames; i++)
+    {
+        picture_t *out = filter->pf_video_filter(filter, picture_Hold(in));
+        if (out == NULL)
+        {
+            fprintf(stderr, "%s: conversion failed\n", name);
+            break;
+        }
+        if (i == frames - 1)
+            hash = Checksum(out);
+        picture_Release(out);
+    }
+
+    mtime_t elapsed = mdate() - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+
+    double bytes = VisibleSize(in);
+    printf("%4.4s -> %4.4s  %-14s %9.1f MB/s  %08"PRIx32"\n",
+           (const char *)&src, (const char *)&dst, name,
+           bytes * frames / elapsed, hash);
+
+    picture_Release(in);
+out_unneed:
+    module_unneed(filter, module);
+out:
+    es_format_Clean(&filter->fmt_in);
+    es_format_Clean(&filter->fmt_out);
+    vlc_object_release(filter);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned width = 1920, height = 1080, frames = 200;
+
+    switch (argc)
+    {
+        case 4:
+            frames = strtoul(argv[3], NULL, 10);
+            /* fall through */
+        case 3:
+            width = strtoul(argv[1], NULL, 10);
+            height = strtoul(argv[2], NULL, 10);
+            /* fall through */
+        case 1:
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [width height [frames]]\n", argv[0]);
+            return 1;
+    }
+    if (width == 0 || height == 0 || frames == 0)
+    {
+        fprintf(stderr, "Error: invalid size or frame count\n");
+        return 1;
+    }
+
+#ifdef TOP_BUILDDIR
+    setenv("VLC_PLUGIN_PATH", TOP_BUILDDIR"/modules", 1);
+#endif
+
+    const char *args[] = { "--quiet", NULL };
+    libvlc_instance_t *vlc = libvlc_new(1, args);
+    if (vlc == NULL)
+    {
+        fprintf(stderr, "Error: cannot initialize LibVLC.\n");
+        return 1;
+    }
+
+    size_t count;
+    module_t **modules = module_list_get(&count);
+
+    printf("%ux%u, %u frames\n", width, height, frames);
+    for (size_t i = 0; i < ARRAY_SIZE(pairs); i++)
+        for (size_t j = 0; j < count; j++)
+        {
+            const char *name = module_get_object(modules[j]);
+
+            /* The chain would only measure another module */
+            if (!module_provides(modules[j], "video converter")
+             || !strcmp(name, "chain"))
+                continue;
+            Bench(VLC_OBJECT(vlc->p_libvlc_int), name, pairs[i].src,
+                  pairs[i].dst, width, height, frames);
+        }
+
+    module_list_free(modules);
+    libvlc_release(vlc);
+    return 0;
+}